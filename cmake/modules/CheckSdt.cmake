@@ -0,0 +1,16 @@
+# - Find out if the system provides sys/sdt.h to build USDT probes
+# sys/sdt.h is shipped by systemtap-sdt-dev, it only needs to be present at
+# build time.
+
+INCLUDE(CheckIncludeFile)
+
+CHECK_INCLUDE_FILE(sys/sdt.h SDT_INCLUDE_RESULT)
+
+SET(HAVE_SYS_SDT_H NO)
+
+IF(SDT_INCLUDE_RESULT)
+    SET(HAVE_SYS_SDT_H YES)
+    MESSAGE(STATUS "System has USDT support")
+ELSE(SDT_INCLUDE_RESULT)
+    MESSAGE(STATUS "System does not have USDT support")
+ENDIF(SDT_INCLUDE_RESULT)
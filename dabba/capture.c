@@ -26,21 +26,68 @@ and to list information about currently running captures.
 
 =item get
 
-Fetch and print information about currently running captures.
-The output is formatted in YAML.
+Fetch and print information about currently running captures, or only about
+the captures given with --id. The output is formatted in YAML.
+The ring residency reports how long, in microseconds, one received frame out
+of eight waited in the ring before the capture read it. Its percentiles are
+upper bounds within 12.5%. Growing residencies show a capture which does
+not keep up with its interface before it drops packets.
 
 =item start
 
-Start a new capture.
+Start a new capture. When several interfaces are given, one capture is
+started on each of them with a single request and the status and the id
+of each capture are printed in YAML.
 
 =item stop
 
-Stop a running capture.
+Stop a running capture. When several captures are given with --id, they are
+all stopped with a single request.
+
+=item modify
+
+Modify the socket filter, the snapshot length or the sampling rate
+of a running capture without stopping it.
+
+=item resize
+
+Replace the packet mmap area of a running capture with a bigger or smaller
+one without losing packets. The command returns once the capture switched
+over. The packet mmap area can also grow automatically.
+
+=item dump
+
+Write the content of the in-memory packet buffer of a running capture
+to a new pcap file. The capture keeps running.
 
 =item stop-all
 
 Stop all running captures.
 
+=item policy-get
+
+Fetch and print the capture policies and how many captures each of them
+runs. The output is formatted in YAML.
+
+=item policy-remove
+
+Remove the capture policy given with --policy and stop its captures.
+
+=item pool-get
+
+Fetch and print the settings of the pool of packet mmap areas dabbad
+prepares ahead of time, how many of them are ready and how many captures
+found (hit) or did not find (miss) a ready one. The output is formatted
+in YAML.
+
+=item pool-modify
+
+Change the amount of packet mmap areas dabbad keeps ready with --size and
+their geometry with --frame-number and --frame-size. Only captures asking for
+the same geometry and no NUMA placement use them, they then start without
+waiting for their packet mmap area to be allocated. Used areas are replaced
+in the background. The pool is empty by default.
+
 =back
 
 =head1 OPTIONS
@@ -52,25 +99,129 @@ Stop all running captures.
 Precise on which interface the capture must run.
 Use "dabba interface get" to see the list of supported interfaces.
 (the special interface "any" captures on all up and running interfaces).
+This option can be given several times and <name> can be a shell glob,
+like 'veth*', matched against the interfaces known by dabbad.
 
 =item --pcap <path>
 
 Write all captured traffic in pcap file at <path>.
+Each "%i" in <path> is replaced by the name of the captured interface,
+which is required when captures start on several interfaces.
+
+=item --policy <name>
+
+Add a capture policy named <name> instead of starting captures (start only).
+dabbad then starts a capture with the given settings on each interface whose
+name matches the --interface glob, including the interfaces appearing later,
+and stops it when the interface disappears. The pcap file path must contain
+"%i". With policy-remove, name the policy to remove.
+
+=item --size <number>
+
+Keep <number> packet mmap areas ready, up to 64 (pool-modify only).
 
 =item --frame-number <number>
 
-Configure the packet mmap area to contain <number> of frames.
-This number must be a power of two. The default value is 32 frames.
-The lowest frame number value is 8.
+Configure the packet mmap area to contain at least <number> of frames.
+The default value is 32 frames. The frame number is rounded up
+to fill the last packet mmap block.
+
+=item --frame-size <bytes>
+
+Configure the size of each packet mmap frame. It must be a multiple of 16.
+The default value is 2048 bytes.
+
+=item --ring-size <MiB>
+
+Use up to <MiB> megabytes for the packet mmap area instead of a frame number.
+The block geometry is computed to keep kernel allocations small.
+
+=item --grow-threshold <percent>
+
+Double the packet mmap area of a running capture when <percent> percent
+of its frames were ready at once (resize only). 0 disables automatic growth.
+This option requires --ring-size-max.
+
+=item --ring-size-max <MiB>
+
+Never grow the packet mmap area beyond <MiB> megabytes (resize only).
+
+=item --numa-node <node>
+
+Allocate the packet mmap area on NUMA node <node> and only run the capture
+thread on the CPUs of this node. By default, the NUMA node of the interface
+is used on machines with several NUMA nodes. -1 disables the placement.
+
+=item --sched-policy <policy>
+
+Start the capture thread with scheduling policy <policy> (fifo, rr or other).
+
+=item --sched-prio <priority>
+
+Start the capture thread with scheduling priority <priority>. By default, the
+lowest priority of the scheduling policy is used.
+
+=item --cpu-affinity <cpu-list>
+
+Only run the capture thread on the CPUs of <cpu-list>, like 0-2,4. "auto" runs it
+next to the CPUs receiving the packets of the interface.
+
+=item --stack-prefault
+
+Touch the capture thread stack before its packet loop starts so that the first
+packets do not page fault.
 
 =item --append
 
 Append capture to existing pcap file
 
+=item --buffer-size <MiB>
+
+Keep the most recent captured packets in an in-memory buffer of <MiB> megabytes.
+The buffer can be written to a pcap file at any time with "dabba capture dump".
+When a buffer is configured, --pcap becomes optional.
+
+=item --buffer-duration <seconds>
+
+Only keep the packets received during the last <seconds> seconds
+in the in-memory buffer. By default, the buffer is only limited by its size.
+
+=item --sock-filter <path>
+
+Only capture packets matching the socket filter stored at <path>.
+
+=item --no-sock-filter
+
+Remove the socket filter of a running capture (modify only).
+
+=item --snaplen <bytes>
+
+Only write the first <bytes> bytes of each packet (default: whole frame).
+0 disables the limit.
+
+=item --sampling <number>
+
+Only keep one packet out of <number> received packets (default: keep all).
+
+=item --trigger <path>
+
+Only write packets to the pcap file once a packet matches the socket filter
+stored at <path>. Until then, packets are kept in the in-memory buffer,
+which is written to the pcap file when the trigger matches.
+The trigger sees every received packet in full, regardless of --snaplen
+and --sampling.
+This option requires --pcap and --buffer-size.
+
+=item --trigger-window <seconds>
+
+Keep writing packets to the pcap file for <seconds> seconds
+after the last packet which matched the trigger (default: 0).
+
 =item --id <thread-id>
 
 Reference a capture by its unique thread id.
 The capture id can be fetched using "dabba capture get".
+Several captures can be stopped at once by repeating this option.
 
 =item --tcp[=<hostname>:<port>]
 
@@ -104,6 +255,61 @@ contain 128 frames.
 
 Stop running capture which has the id "123456789"
 
+=item dabba capture start --interface 'veth*' --pcap /var/cap/%i.pcap
+
+Starts a capture on each interface whose name starts with "veth", each one
+writing to its own pcap file, like "/var/cap/veth0.pcap".
+
+=item dabba capture stop --id 123456789 --id 987654321
+
+Stop captures "123456789" and "987654321" at once.
+
+=item dabba capture start --policy containers --interface 'veth*' --pcap /var/cap/%i.pcap --frame-number 256
+
+Capture the traffic of every veth interface, present or created later,
+in its own pcap file until the interface is destroyed.
+
+=item dabba capture policy-remove --policy containers
+
+Remove the "containers" capture policy and stop its captures.
+
+=item dabba capture pool-modify --size 4 --frame-number 4096
+
+Keep 4 packet mmap areas of 4096 frames ready, so that the next captures
+started with "--frame-number 4096" bind one of them right away.
+
+=item dabba capture start --interface eth0 --buffer-size 64 --buffer-duration 30
+
+Starts a capture listening on eth0 which keeps the last 30 seconds of traffic
+in a 64 MiB in-memory buffer without writing anything to disk.
+
+=item dabba capture modify --id 123456789 --sock-filter tcp.bpf --snaplen 96
+
+Replace the socket filter of capture "123456789" with "tcp.bpf"
+and only keep the first 96 bytes of the next captured packets.
+
+=item dabba capture resize --id 123456789 --ring-size 64 --grow-threshold 75 --ring-size-max 512
+
+Switch capture "123456789" to a 64 MiB packet mmap area, which doubles each
+time it gets 75% full, up to 512 MiB.
+
+=item dabba capture start --interface eth0 --pcap eth0.pcap --sched-policy fifo --sched-prio 10 --cpu-affinity auto --stack-prefault
+
+Starts a capture listening on eth0 whose thread runs from its start with the
+FIFO scheduling policy at priority 10, next to the CPUs receiving the packets
+of eth0, with its stack already faulted in.
+
+=item dabba capture dump --id 123456789 --pcap incident.pcap
+
+Write the in-memory buffer of capture "123456789" to "incident.pcap".
+
+=item dabba capture start --interface eth0 --pcap rst.pcap --buffer-size 64 --buffer-duration 10 --trigger tcp-rst.bpf --trigger-window 5
+
+Starts a capture listening on eth0 which only writes to "rst.pcap"
+when a packet matches the socket filter "tcp-rst.bpf". The pcap file then
+contains the 10 seconds of traffic preceding the match and the traffic received
+until 5 seconds after the last match.
+
 =back
 
 =head1 AUTHOR
@@ -144,9 +350,11 @@ Written by Emmanuel Roullit <emmanuel.roullit@gmail.com>
 #include <getopt.h>
 #include <inttypes.h>
 #include <errno.h>
+#include <fnmatch.h>
 
 #include <libdabba/macros.h>
 #include <libdabba/packet-mmap.h>
+#include <dabba/cli.h>
 #include <dabba/dabba.h>
 #include <dabba/help.h>
 #include <dabba/macros.h>
@@ -155,6 +363,7 @@ Written by Emmanuel Roullit <emmanuel.roullit@gmail.com>
 #include <dabba/thread.h>
 
 #define DEFAULT_CAPTURE_FRAME_NUMBER 32
+#define CAPTURE_SIZE_UNIT (1024 * 1024)
 
 /**
  * \internal
@@ -181,9 +390,49 @@ static void capture_settings_print(const Dabba__CaptureList *
 		printf("    ");
 		__rpc_error_code_print(capture->status->code);
 		printf("      packet mmap size: %" PRIu64 "\n",
-		       capture->frame_nr * capture->frame_size);
+		       capture->block_nr * capture->block_size);
 		printf("      frame number: %" PRIu64 "\n", capture->frame_nr);
+		printf("      frame size: %" PRIu64 "\n", capture->frame_size);
+		printf("      block size: %" PRIu64 "\n", capture->block_size);
+		printf("      block number: %" PRIu64 "\n", capture->block_nr);
+		printf("      frame high water: %" PRIu64 "\n",
+		       capture->frame_high_water);
+
+		if (capture->has_grow_threshold) {
+			printf("      grow threshold: %" PRIu64 "\n",
+			       capture->grow_threshold);
+			printf("      ring size max: %" PRIu64 "\n",
+			       capture->ring_size_max);
+		}
+
 		printf("      pcap: %s\n", capture->pcap);
+		printf("      snaplen: %" PRIu64 "\n", capture->snaplen);
+		printf("      sampling: %" PRIu64 "\n", capture->sampling);
+		printf("      packets: %" PRIu64 "\n", capture->packet_count);
+		printf("      bytes: %" PRIu64 "\n", capture->byte_count);
+		printf("      kept packets: %" PRIu64 "\n", capture->kept_count);
+
+		if (capture->has_residency_count) {
+			printf("      ring residency:\n");
+			printf("        samples: %" PRIu64 "\n",
+			       capture->residency_count);
+			printf("        p50: %" PRIu64 "\n",
+			       capture->residency_p50);
+			printf("        p90: %" PRIu64 "\n",
+			       capture->residency_p90);
+			printf("        p99: %" PRIu64 "\n",
+			       capture->residency_p99);
+			printf("        max: %" PRIu64 "\n",
+			       capture->residency_max);
+		}
+
+		if (capture->has_buffer_size) {
+			printf("      buffer size: %" PRIu64 "\n",
+			       capture->buffer_size);
+			printf("      buffer duration: %" PRIu64 "\n",
+			       capture->buffer_duration);
+		}
+
 		printf("      interface: %s\n", capture->interface);
 		printf("      socket filter: \n");
 
@@ -193,6 +442,19 @@ static void capture_settings_print(const Dabba__CaptureList *
 			       "{ code: %#x, jt: %#x, jf: %#x, k: %#x }\n",
 			       sf->code, sf->jt, sf->jf, sf->k);
 		}
+
+		if (capture->trigger && capture->trigger->n_filter) {
+			printf("      trigger window: %" PRIu64 "\n",
+			       capture->trigger_window);
+			printf("      trigger filter: \n");
+
+			for (i = 0; i < capture->trigger->n_filter; i++) {
+				sf = capture->trigger->filter[i];
+				printf("        - "
+				       "{ code: %#x, jt: %#x, jf: %#x, k: %#x }\n",
+				       sf->code, sf->jt, sf->jf, sf->k);
+			}
+		}
 	}
 
 	*status = 1;
@@ -245,6 +507,75 @@ static int rpc_capture_stop(ProtobufCService * service,
 	return 0;
 }
 
+/**
+ * \brief Invoke capture modify remote procedure call
+ * \param[in]           service	        Pointer to protobuf service
+ * \param[in]           capture 	Pointer to capture settings to modify
+ * \return always returns zero.
+ */
+
+static int rpc_capture_modify(ProtobufCService * service,
+			      const Dabba__Capture * capture)
+{
+	protobuf_c_boolean is_done = 0;
+
+	assert(service);
+	assert(capture);
+
+	dabba__dabba_service__capture_modify(service, capture,
+					     rpc_error_code_print, &is_done);
+
+	dabba_rpc_call_is_done(&is_done);
+
+	return 0;
+}
+
+/**
+ * \brief Invoke capture resize remote procedure call
+ * \param[in]           service	        Pointer to protobuf service
+ * \param[in]           resize 	        Pointer to capture resize request
+ * \return always returns zero.
+ */
+
+static int rpc_capture_resize(ProtobufCService * service,
+			      const Dabba__CaptureResize * resize)
+{
+	protobuf_c_boolean is_done = 0;
+
+	assert(service);
+	assert(resize);
+
+	dabba__dabba_service__capture_resize(service, resize,
+					     rpc_error_code_print, &is_done);
+
+	dabba_rpc_call_is_done(&is_done);
+
+	return 0;
+}
+
+/**
+ * \brief Invoke capture dump remote procedure call
+ * \param[in]           service	        Pointer to protobuf service
+ * \param[in]           dump 	        Pointer to capture dump request
+ * \return always returns zero.
+ */
+
+static int rpc_capture_dump(ProtobufCService * service,
+			    const Dabba__CaptureDump * dump)
+{
+	protobuf_c_boolean is_done = 0;
+
+	assert(service);
+	assert(dump);
+
+	dabba__dabba_service__capture_dump(service, dump,
+					   rpc_error_code_print, &is_done);
+
+	dabba_rpc_call_is_done(&is_done);
+
+	return 0;
+}
+
 /**
  * \brief Invoke capture stop all remote procedure call
  * \param[in]           service	        Pointer to protobuf service
@@ -293,145 +624,1252 @@ static int rpc_capture_get(ProtobufCService * service,
 }
 
 /**
- * \brief Parse argument vector to prepare a capture start query
- * \param[in]           argc	        Argument counter
- * \param[in]           argv	        Argument vector
- * \return 0 on success, \c EINVAL on invalid input.
+ * \internal
+ * \brief Print capture policy list to \c stdout
+ * \param[in]           result	        Pointer to capture policy list
+ * \param[in,out]       closure_data	Pointer to protobuf closure data
  */
 
-static int cmd_capture_start(int argc, const char **argv)
+static void capture_policy_print(const Dabba__CapturePolicyList * result,
+				 void *closure_data)
 {
-	enum capture_start_option {
-		OPT_CAPTURE_INTERFACE,
-		OPT_CAPTURE_PCAP,
-		OPT_CAPTURE_FRAME_NUMBER,
-		OPT_CAPTURE_FRAME_SIZE,
-		OPT_CAPTURE_SOCK_FILTER,
-		OPT_CAPTURE_APPEND,
-		OPT_TCP,
-		OPT_LOCAL,
-		OPT_HELP
-	};
-
-	int ret, rc;
-	Dabba__Capture capture = DABBA__CAPTURE__INIT;
-	Dabba__SockFprog sfp = DABBA__SOCK_FPROG__INIT;
-	Dabba__ErrorCode err = DABBA__ERROR_CODE__INIT;
-	const char *server_id = DABBA_RPC_DEFAULT_TCP_SERVER_NAME;
-	ProtobufC_RPC_AddressType server_type = PROTOBUF_C_RPC_ADDRESS_TCP;
-	ProtobufCService *service;
-
-	static struct option capture_option[] = {
-		{"interface", required_argument, NULL, OPT_CAPTURE_INTERFACE},
-		{"pcap", required_argument, NULL, OPT_CAPTURE_PCAP},
-		{"frame-number", required_argument, NULL,
-		 OPT_CAPTURE_FRAME_NUMBER},
-		{"frame-size", required_argument, NULL, OPT_CAPTURE_FRAME_SIZE},
-		{"sock-filter", required_argument, NULL,
-		 OPT_CAPTURE_SOCK_FILTER},
-		{"append", no_argument, NULL, OPT_CAPTURE_APPEND},
-		{"tcp", optional_argument, NULL, OPT_TCP},
-		{"local", optional_argument, NULL, OPT_LOCAL},
-		{"help", no_argument, NULL, OPT_HELP},
-		{NULL, 0, NULL, 0},
-	};
-
-	/* Assume conservative values for now */
-	capture.has_frame_nr = capture.has_frame_size = 1;
-	capture.frame_size = PACKET_MMAP_ETH_FRAME_LEN;
-	capture.frame_nr = DEFAULT_CAPTURE_FRAME_NUMBER;
-	capture.status = &err;
+	const Dabba__CapturePolicy *policy;
+	protobuf_c_boolean *status = (protobuf_c_boolean *) closure_data;
+	size_t a;
 
-	/* HACK: getopt*() start to parse options at argv[1] */
-	argc++;
-	argv--;
+	assert(closure_data);
 
-	/* parse capture options */
-	while ((ret =
-		getopt_long_only(argc, (char **)argv, "", capture_option,
-				 NULL)) != EOF) {
-		switch (ret) {
-		case OPT_TCP:
-			server_type = PROTOBUF_C_RPC_ADDRESS_TCP;
-			server_id = DABBA_RPC_DEFAULT_TCP_SERVER_NAME;
+	rpc_header_print("policies");
 
-			if (optarg)
-				server_id = optarg;
-			break;
-		case OPT_LOCAL:
-			server_type = PROTOBUF_C_RPC_ADDRESS_LOCAL;
-			server_id = DABBA_RPC_DEFAULT_LOCAL_SERVER_NAME;
+	for (a = 0; result && a < result->n_list; a++) {
+		policy = result->list[a];
+		printf("    - name: %s\n", policy->name);
+		printf("    ");
+		__rpc_error_code_print(policy->status->code);
+		printf("      capture number: %" PRIu64 "\n",
+		       policy->capture_nr);
+
+		if (!policy->capture)
+			continue;
+
+		printf("      interface: %s\n", policy->capture->interface);
+		printf("      pcap: %s\n",
+		       policy->capture->pcap ? policy->capture->pcap : "");
+		printf("      frame number: %" PRIu64 "\n",
+		       policy->capture->frame_nr);
+		printf("      frame size: %" PRIu64 "\n",
+		       policy->capture->frame_size);
+
+		if (policy->capture->has_ring_size)
+			printf("      ring size: %" PRIu64 "\n",
+			       policy->capture->ring_size);
+
+		if (policy->capture->has_buffer_size)
+			printf("      buffer size: %" PRIu64 "\n",
+			       policy->capture->buffer_size);
+	}
 
-			if (optarg)
-				server_id = optarg;
-			break;
-		case OPT_CAPTURE_INTERFACE:
-			capture.interface = optarg;
-			break;
-		case OPT_CAPTURE_PCAP:
-			capture.pcap = optarg;
-			break;
-		case OPT_CAPTURE_FRAME_NUMBER:
-			capture.frame_nr = strtoull(optarg, NULL, 10);
-			break;
-		case OPT_CAPTURE_APPEND:
-			capture.has_append = 1;
-			capture.append = 1;
-			break;
-		case OPT_CAPTURE_FRAME_SIZE:
-			capture.frame_size = strtoull(optarg, NULL, 10);
-			break;
-		case OPT_CAPTURE_SOCK_FILTER:
-			rc = sock_filter_parse(optarg, &sfp);
+	*status = 1;
+}
 
-			if (rc)
-				return rc;
+/**
+ * \brief Invoke capture policy add remote procedure call
+ * \param[in]           service	        Pointer to protobuf service
+ * \param[in]           policy 	        Pointer to capture policy to add
+ * \return always returns zero.
+ */
 
-			capture.sfp = &sfp;
-			break;
-		case OPT_HELP:
-		default:
-			show_usage(capture_option);
-			return -1;
-		}
-	}
+static int rpc_capture_policy_add(ProtobufCService * service,
+				  const Dabba__CapturePolicy * policy)
+{
+	protobuf_c_boolean is_done = 0;
 
-	service = dabba_rpc_client_connect(server_id, server_type);
+	assert(service);
+	assert(policy);
 
-	if (service)
-		rc = rpc_capture_start(service, &capture);
-	else
-		rc = EINVAL;
+	dabba__dabba_service__capture_policy_add(service, policy,
+						 rpc_error_code_print,
+						 &is_done);
 
-	sock_filter_destroy(&sfp);
+	dabba_rpc_call_is_done(&is_done);
 
-	return rc;
+	return 0;
 }
 
 /**
- * \brief Parse argument vector to prepare a capture stop query
- * \param[in]           argc	        Argument counter
- * \param[in]           argv	        Argument vector
- * \return 0 on success, \c EINVAL on invalid input.
+ * \brief Invoke capture policy remove remote procedure call
+ * \param[in]           service	        Pointer to protobuf service
+ * \param[in]           policy 	        Pointer to capture policy to remove
+ * \return always returns zero.
  */
 
-static int cmd_capture_stop(int argc, const char **argv)
+static int rpc_capture_policy_remove(ProtobufCService * service,
+				     const Dabba__CapturePolicy * policy)
+{
+	protobuf_c_boolean is_done = 0;
+
+	assert(service);
+	assert(policy);
+
+	dabba__dabba_service__capture_policy_remove(service, policy,
+						    rpc_error_code_print,
+						    &is_done);
+
+	dabba_rpc_call_is_done(&is_done);
+
+	return 0;
+}
+
+/**
+ * \brief Invoke capture policy get remote procedure call
+ * \param[in]           service	        Pointer to protobuf service
+ * \param[in]           dummy 	        Pointer to unused dummy message
+ * \return always returns zero.
+ */
+
+static int rpc_capture_policy_get(ProtobufCService * service,
+				  const Dabba__Dummy * dummy)
+{
+	protobuf_c_boolean is_done = 0;
+
+	assert(service);
+	assert(dummy);
+
+	dabba__dabba_service__capture_policy_get(service, dummy,
+						 capture_policy_print,
+						 &is_done);
+
+	dabba_rpc_call_is_done(&is_done);
+
+	return 0;
+}
+
+/**
+ * \internal
+ * \brief Print the capture pool settings and counters to \c stdout
+ * \param[in]           result	        Pointer to capture pool
+ * \param[in,out]       closure_data	Pointer to protobuf closure data
+ */
+
+static void capture_pool_print(const Dabba__CapturePool * result,
+			       void *closure_data)
+{
+	protobuf_c_boolean *status = (protobuf_c_boolean *) closure_data;
+
+	assert(closure_data);
+
+	rpc_header_print("pool");
+
+	if (result) {
+		printf("  ");
+		__rpc_error_code_print(result->status->code);
+		printf("    size: %" PRIu64 "\n", result->size);
+		printf("    ready: %" PRIu64 "\n", result->ready);
+		printf("    frame number: %" PRIu64 "\n", result->frame_nr);
+		printf("    frame size: %" PRIu64 "\n", result->frame_size);
+		printf("    hit: %" PRIu64 "\n", result->hit);
+		printf("    miss: %" PRIu64 "\n", result->miss);
+	}
+
+	*status = 1;
+}
+
+/**
+ * \brief Invoke capture pool get remote procedure call
+ * \param[in]           service	        Pointer to protobuf service
+ * \param[in]           dummy 	        Pointer to unused dummy message
+ * \return always returns zero.
+ */
+
+static int rpc_capture_pool_get(ProtobufCService * service,
+				const Dabba__Dummy * dummy)
+{
+	protobuf_c_boolean is_done = 0;
+
+	assert(service);
+	assert(dummy);
+
+	dabba__dabba_service__capture_pool_get(service, dummy,
+					       capture_pool_print, &is_done);
+
+	dabba_rpc_call_is_done(&is_done);
+
+	return 0;
+}
+
+/**
+ * \brief Invoke capture pool modify remote procedure call
+ * \param[in]           service	        Pointer to protobuf service
+ * \param[in]           pool 	        Pointer to new capture pool settings
+ * \return always returns zero.
+ */
+
+static int rpc_capture_pool_modify(ProtobufCService * service,
+				   const Dabba__CapturePool * pool)
+{
+	protobuf_c_boolean is_done = 0;
+
+	assert(service);
+	assert(pool);
+
+	dabba__dabba_service__capture_pool_modify(service, pool,
+						  rpc_error_code_print,
+						  &is_done);
+
+	dabba_rpc_call_is_done(&is_done);
+
+	return 0;
+}
+
+/**
+ * \internal
+ * \brief Interfaces selected by the capture start options
+ */
+
+struct capture_interfaces {
+	char **name;		/**< selected interface names */
+	size_t n_name;		/**< amount of selected interfaces */
+	const char *pattern;	/**< interface glob being expanded */
+	protobuf_c_boolean is_done;	/**< expansion RPC status */
+	int rc;			/**< expansion status */
+};
+
+/**
+ * \internal
+ * \brief Add an interface name to the capture interfaces
+ * \param[in,out]       ifs	        Capture interfaces
+ * \param[in]           name	        Interface name to add
+ * \return 0 on success, \c ENOMEM if memory could not be allocated
+ * \note Interfaces selected twice are only added once.
+ */
+
+static int capture_interface_add(struct capture_interfaces *ifs,
+				 const char *const name)
+{
+	char **tmp;
+	size_t a;
+
+	assert(ifs);
+	assert(name);
+
+	for (a = 0; a < ifs->n_name; a++)
+		if (!strcmp(ifs->name[a], name))
+			return 0;
+
+	tmp = realloc(ifs->name, (ifs->n_name + 1) * sizeof(*ifs->name));
+
+	if (!tmp)
+		return ENOMEM;
+
+	ifs->name = tmp;
+	ifs->name[ifs->n_name] = strdup(name);
+
+	if (!ifs->name[ifs->n_name])
+		return ENOMEM;
+
+	ifs->n_name++;
+
+	return 0;
+}
+
+/**
+ * \internal
+ * \brief Free the capture interfaces
+ * \param[in,out]       ifs	        Capture interfaces
+ */
+
+static void capture_interfaces_destroy(struct capture_interfaces *ifs)
+{
+	assert(ifs);
+
+	while (ifs->n_name--)
+		free(ifs->name[ifs->n_name]);
+
+	free(ifs->name);
+	ifs->name = NULL;
+	ifs->n_name = 0;
+}
+
+/**
+ * \internal
+ * \brief Add the interfaces matching a glob to the capture interfaces
+ * \param[in]           result	        Pointer to interface status list
+ * \param[in,out]       closure_data	Pointer to capture interfaces
+ */
+
+static void capture_interface_glob_add(const Dabba__InterfaceStatusList *
+				       result, void *closure_data)
+{
+	struct capture_interfaces *ifs = closure_data;
+	size_t a;
+
+	assert(closure_data);
+
+	ifs->rc = result ? 0 : EINVAL;
+
+	for (a = 0; result && a < result->n_list && !ifs->rc; a++)
+		if (!fnmatch(ifs->pattern, result->list[a]->id->name, 0))
+			ifs->rc = capture_interface_add(ifs,
+							result->list[a]->id->
+							name);
+
+	ifs->is_done = 1;
+}
+
+/**
+ * \internal
+ * \brief Select the interfaces a capture start option designates
+ * \param[in]           service	        Pointer to protobuf service
+ * \param[in,out]       ifs	        Capture interfaces
+ * \param[in]           pattern	        Interface name or glob
+ * \return 0 on success, else on failure
+ * \note The interfaces matching a glob are listed by dabbad, the CLI may not
+ * run on the same host.
+ */
+
+static int rpc_capture_interface_select(ProtobufCService * service,
+					struct capture_interfaces *ifs,
+					const char *const pattern)
+{
+	Dabba__InterfaceIdList id_list = DABBA__INTERFACE_ID_LIST__INIT;
+	const size_t len = strcspn(pattern, "*?[");
+
+	assert(service);
+	assert(ifs);
+	assert(pattern);
+
+	if (!pattern[len])
+		return capture_interface_add(ifs, pattern);
+
+	/* Only the interfaces starting like the glob need to be listed */
+	id_list.prefix = strndup(pattern, len);
+
+	if (!id_list.prefix)
+		return ENOMEM;
+
+	ifs->pattern = pattern;
+	ifs->is_done = 0;
+	ifs->rc = 0;
+
+	dabba__dabba_service__interface_status_get(service, &id_list,
+						   capture_interface_glob_add,
+						   ifs);
+
+	dabba_rpc_call_is_done(&ifs->is_done);
+	free(id_list.prefix);
+
+	return ifs->rc;
+}
+
+/**
+ * \internal
+ * \brief Build the pcap file path of a capture
+ * \param[in]           pcap	        Requested pcap file path
+ * \param[in]           dev	        Interface the capture runs on
+ * \return Newly allocated path where each "%i" is replaced by the interface
+ * name, \c NULL if memory could not be allocated
+ */
+
+static char *capture_pcap_path(const char *const pcap, const char *const dev)
+{
+	const char *p;
+	char *path, *out;
+	size_t len = strlen(pcap) + 1;
+
+	for (p = strstr(pcap, "%i"); p; p = strstr(p + 2, "%i"))
+		len += strlen(dev);
+
+	path = out = malloc(len);
+
+	if (!path)
+		return NULL;
+
+	for (p = pcap; *p; p++) {
+		if (p[0] == '%' && p[1] == 'i') {
+			out = stpcpy(out, dev);
+			p++;
+		} else
+			*out++ = *p;
+	}
+
+	*out = '\0';
+
+	return path;
+}
+
+/**
+ * \internal
+ * \brief Client side state of a capture batch RPC
+ */
+
+struct capture_batch_reply {
+	const Dabba__CaptureList *capture_list;	/**< requested captures, \c NULL when stopping */
+	protobuf_c_boolean is_done;	/**< RPC status */
+};
+
+/**
+ * \internal
+ * \brief Print the status of each capture of a batch to \c stdout
+ * \param[in]           result	        Pointer to the batch result list
+ * \param[in,out]       closure_data	Pointer to the batch reply state
+ */
+
+static void capture_batch_print(const Dabba__ThreadResultList * result,
+				void *closure_data)
+{
+	struct capture_batch_reply *reply = closure_data;
+	const Dabba__ThreadResult *res;
+	size_t a;
+
+	assert(closure_data);
+
+	rpc_header_print("captures");
+
+	for (a = 0; result && a < result->n_list; a++) {
+		res = result->list[a];
+
+		if (res->id)
+			printf("    - id: %" PRIu64 "\n",
+			       (uint64_t) res->id->id);
+		else
+			printf("    - id: ~\n");
+
+		if (reply->capture_list && a < reply->capture_list->n_list)
+			printf("      interface: %s\n",
+			       reply->capture_list->list[a]->interface);
+
+		printf("    ");
+		__rpc_error_code_print(res->status->code);
+	}
+
+	reply->is_done = 1;
+}
+
+/**
+ * \brief Invoke capture batch start remote procedure call
+ * \param[in]           service	        Pointer to protobuf service
+ * \param[in]           capture_list	Pointer to capture settings to create
+ * \return always returns zero.
+ * \note The captures are reported in request order.
+ */
+
+static int rpc_capture_start_batch(ProtobufCService * service,
+				   const Dabba__CaptureList * capture_list)
+{
+	struct capture_batch_reply reply = { capture_list, 0 };
+
+	assert(service);
+	assert(capture_list);
+
+	dabba__dabba_service__capture_start_batch(service, capture_list,
+						  capture_batch_print, &reply);
+
+	dabba_rpc_call_is_done(&reply.is_done);
+
+	return 0;
+}
+
+/**
+ * \brief Invoke capture batch stop remote procedure call
+ * \param[in]           service	        Pointer to protobuf service
+ * \param[in]           id_list 	Pointer to capture ids to stop
+ * \return always returns zero.
+ */
+
+static int rpc_capture_stop_batch(ProtobufCService * service,
+				  const Dabba__ThreadIdList * id_list)
+{
+	struct capture_batch_reply reply = { NULL, 0 };
+
+	assert(service);
+	assert(id_list);
+
+	dabba__dabba_service__capture_stop_batch(service, id_list,
+						 capture_batch_print, &reply);
+
+	dabba_rpc_call_is_done(&reply.is_done);
+
+	return 0;
+}
+
+/**
+ * \internal
+ * \brief Start a capture on each selected interface
+ * \param[in]           service	        Pointer to protobuf service
+ * \param[in]           capture 	Pointer to capture settings to apply
+ * \param[in]           ifs	        Capture interfaces
+ * \return 0 on success, \c EINVAL when captures on several interfaces
+ * would share the same pcap file, \c ENOMEM on allocation failure
+ * \note A single interface is started with the capture start RPC.
+ */
+
+static int capture_start_interfaces(ProtobufCService * service,
+				    const Dabba__Capture * capture,
+				    const struct capture_interfaces *ifs)
+{
+	Dabba__CaptureList capture_list = DABBA__CAPTURE_LIST__INIT;
+	Dabba__Capture *captures;
+	size_t a;
+	int rc = 0;
+
+	assert(service);
+	assert(capture);
+	assert(ifs);
+
+	if (ifs->n_name > 1 && capture->pcap && !strstr(capture->pcap, "%i"))
+		return EINVAL;
+
+	captures = calloc(ifs->n_name, sizeof(*captures));
+	capture_list.list = calloc(ifs->n_name, sizeof(*capture_list.list));
+
+	if (!captures || !capture_list.list) {
+		rc = ENOMEM;
+		goto out;
+	}
+
+	for (a = 0; a < ifs->n_name; a++, capture_list.n_list++) {
+		captures[a] = *capture;
+		captures[a].interface = ifs->name[a];
+		capture_list.list[a] = &captures[a];
+
+		if (!capture->pcap)
+			continue;
+
+		captures[a].pcap = capture_pcap_path(capture->pcap,
+						     ifs->name[a]);
+
+		if (!captures[a].pcap) {
+			rc = ENOMEM;
+			goto out;
+		}
+	}
+
+	if (capture_list.n_list == 1)
+		rc = rpc_capture_start(service, capture_list.list[0]);
+	else
+		rc = rpc_capture_start_batch(service, &capture_list);
+
+ out:
+	for (a = 0; capture->pcap && a < capture_list.n_list; a++)
+		free(captures[a].pcap);
+
+	free(capture_list.list);
+	free(captures);
+
+	return rc;
+}
+
+/**
+ * \internal
+ * \brief Append a capture id to a thread id list
+ * \param[in,out]       id_list	        Thread id list to grow
+ * \param[in]           id	        Capture id to append
+ * \return 0 on success, \c ENOMEM if memory could not be allocated
+ * \note The list is freed with \c capture_id_list_destroy().
+ */
+
+static int capture_id_list_add(Dabba__ThreadIdList * id_list,
+			       const uint64_t id)
+{
+	Dabba__ThreadId **idpp, *idp;
+
+	assert(id_list);
+
+	idp = malloc(sizeof(*idp));
+
+	if (!idp)
+		return ENOMEM;
+
+	idpp = realloc(id_list->list,
+		       sizeof(*id_list->list) * (id_list->n_list + 1));
+
+	if (!idpp) {
+		free(idp);
+		return ENOMEM;
+	}
+
+	dabba__thread_id__init(idp);
+	idp->id = id;
+	id_list->list = idpp;
+	id_list->list[id_list->n_list++] = idp;
+
+	return 0;
+}
+
+/**
+ * \internal
+ * \brief Free a thread id list built by \c capture_id_list_add()
+ * \param[in,out]       id_list	        Thread id list to free
+ */
+
+static void capture_id_list_destroy(Dabba__ThreadIdList * id_list)
+{
+	assert(id_list);
+
+	while (id_list->n_list--)
+		free(id_list->list[id_list->n_list]);
+
+	free(id_list->list);
+	id_list->list = NULL;
+	id_list->n_list = 0;
+}
+
+/**
+ * \brief Parse argument vector to prepare a capture start query
+ * \param[in]           argc	        Argument counter
+ * \param[in]           argv	        Argument vector
+ * \return 0 on success, \c EINVAL on invalid input.
+ */
+
+static int cmd_capture_start(int argc, const char **argv)
+{
+	enum capture_start_option {
+		OPT_CAPTURE_INTERFACE,
+		OPT_CAPTURE_PCAP,
+		OPT_CAPTURE_FRAME_NUMBER,
+		OPT_CAPTURE_FRAME_SIZE,
+		OPT_CAPTURE_SOCK_FILTER,
+		OPT_CAPTURE_APPEND,
+		OPT_CAPTURE_BUFFER_SIZE,
+		OPT_CAPTURE_BUFFER_DURATION,
+		OPT_CAPTURE_TRIGGER,
+		OPT_CAPTURE_TRIGGER_WINDOW,
+		OPT_CAPTURE_SNAPLEN,
+		OPT_CAPTURE_SAMPLING,
+		OPT_CAPTURE_RING_SIZE,
+		OPT_CAPTURE_NUMA_NODE,
+		OPT_CAPTURE_SCHED_POLICY,
+		OPT_CAPTURE_SCHED_PRIORITY,
+		OPT_CAPTURE_CPU_AFFINITY,
+		OPT_CAPTURE_STACK_PREFAULT,
+		OPT_CAPTURE_POLICY,
+		OPT_TCP,
+		OPT_LOCAL,
+		OPT_HELP
+	};
+
+	int ret, rc = 0;
+	size_t a, n_pattern = 0;
+	const char **pattern = NULL, **tmp;
+	struct capture_interfaces ifs = { NULL, 0, NULL, 0, 0 };
+	Dabba__Capture capture = DABBA__CAPTURE__INIT;
+	Dabba__SockFprog sfp = DABBA__SOCK_FPROG__INIT;
+	Dabba__SockFprog trigger = DABBA__SOCK_FPROG__INIT;
+	Dabba__ErrorCode err = DABBA__ERROR_CODE__INIT;
+	Dabba__CapturePolicy policy = DABBA__CAPTURE_POLICY__INIT;
+	const char *server_id = DABBA_RPC_DEFAULT_TCP_SERVER_NAME;
+	ProtobufC_RPC_AddressType server_type = PROTOBUF_C_RPC_ADDRESS_TCP;
+	ProtobufCService *service;
+
+	static struct option capture_option[] = {
+		{"interface", required_argument, NULL, OPT_CAPTURE_INTERFACE},
+		{"pcap", required_argument, NULL, OPT_CAPTURE_PCAP},
+		{"frame-number", required_argument, NULL,
+		 OPT_CAPTURE_FRAME_NUMBER},
+		{"frame-size", required_argument, NULL, OPT_CAPTURE_FRAME_SIZE},
+		{"sock-filter", required_argument, NULL,
+		 OPT_CAPTURE_SOCK_FILTER},
+		{"append", no_argument, NULL, OPT_CAPTURE_APPEND},
+		{"buffer-size", required_argument, NULL,
+		 OPT_CAPTURE_BUFFER_SIZE},
+		{"buffer-duration", required_argument, NULL,
+		 OPT_CAPTURE_BUFFER_DURATION},
+		{"trigger", required_argument, NULL, OPT_CAPTURE_TRIGGER},
+		{"trigger-window", required_argument, NULL,
+		 OPT_CAPTURE_TRIGGER_WINDOW},
+		{"snaplen", required_argument, NULL, OPT_CAPTURE_SNAPLEN},
+		{"sampling", required_argument, NULL, OPT_CAPTURE_SAMPLING},
+		{"ring-size", required_argument, NULL, OPT_CAPTURE_RING_SIZE},
+		{"numa-node", required_argument, NULL, OPT_CAPTURE_NUMA_NODE},
+		{"sched-policy", required_argument, NULL,
+		 OPT_CAPTURE_SCHED_POLICY},
+		{"sched-prio", required_argument, NULL,
+		 OPT_CAPTURE_SCHED_PRIORITY},
+		{"cpu-affinity", required_argument, NULL,
+		 OPT_CAPTURE_CPU_AFFINITY},
+		{"stack-prefault", no_argument, NULL,
+		 OPT_CAPTURE_STACK_PREFAULT},
+		{"policy", required_argument, NULL, OPT_CAPTURE_POLICY},
+		{"tcp", optional_argument, NULL, OPT_TCP},
+		{"local", optional_argument, NULL, OPT_LOCAL},
+		{"help", no_argument, NULL, OPT_HELP},
+		{NULL, 0, NULL, 0},
+	};
+
+	/* Assume conservative values for now */
+	capture.has_frame_nr = capture.has_frame_size = 1;
+	capture.frame_size = PACKET_MMAP_ETH_FRAME_LEN;
+	capture.frame_nr = DEFAULT_CAPTURE_FRAME_NUMBER;
+	capture.status = &err;
+
+	/* HACK: getopt*() start to parse options at argv[1] */
+	argc++;
+	argv--;
+
+	/* parse capture options */
+	while ((ret =
+		getopt_long_only(argc, (char **)argv, "", capture_option,
+				 NULL)) != EOF) {
+		switch (ret) {
+		case OPT_TCP:
+			server_type = PROTOBUF_C_RPC_ADDRESS_TCP;
+			server_id = DABBA_RPC_DEFAULT_TCP_SERVER_NAME;
+
+			if (optarg)
+				server_id = optarg;
+			break;
+		case OPT_LOCAL:
+			server_type = PROTOBUF_C_RPC_ADDRESS_LOCAL;
+			server_id = DABBA_RPC_DEFAULT_LOCAL_SERVER_NAME;
+
+			if (optarg)
+				server_id = optarg;
+			break;
+		case OPT_CAPTURE_INTERFACE:
+			tmp = realloc(pattern, (n_pattern + 1) *
+				      sizeof(*pattern));
+
+			if (!tmp) {
+				rc = ENOMEM;
+				goto out;
+			}
+
+			pattern = tmp;
+			pattern[n_pattern++] = optarg;
+			break;
+		case OPT_CAPTURE_PCAP:
+			capture.pcap = optarg;
+			break;
+		case OPT_CAPTURE_FRAME_NUMBER:
+			capture.frame_nr = strtoull(optarg, NULL, 10);
+			break;
+		case OPT_CAPTURE_APPEND:
+			capture.has_append = 1;
+			capture.append = 1;
+			break;
+		case OPT_CAPTURE_FRAME_SIZE:
+			capture.frame_size = strtoull(optarg, NULL, 10);
+			break;
+		case OPT_CAPTURE_BUFFER_SIZE:
+			capture.has_buffer_size = 1;
+			capture.buffer_size =
+			    strtoull(optarg, NULL, 10) * CAPTURE_SIZE_UNIT;
+			break;
+		case OPT_CAPTURE_BUFFER_DURATION:
+			capture.has_buffer_duration = 1;
+			capture.buffer_duration = strtoull(optarg, NULL, 10);
+			break;
+		case OPT_CAPTURE_TRIGGER:
+			rc = sock_filter_parse(optarg, &trigger);
+
+			if (rc)
+				goto out;
+
+			capture.trigger = &trigger;
+			break;
+		case OPT_CAPTURE_TRIGGER_WINDOW:
+			capture.has_trigger_window = 1;
+			capture.trigger_window = strtoull(optarg, NULL, 10);
+			break;
+		case OPT_CAPTURE_SNAPLEN:
+			capture.has_snaplen = 1;
+			capture.snaplen = strtoull(optarg, NULL, 10);
+			break;
+		case OPT_CAPTURE_SAMPLING:
+			capture.has_sampling = 1;
+			capture.sampling = strtoull(optarg, NULL, 10);
+			break;
+		case OPT_CAPTURE_RING_SIZE:
+			capture.has_ring_size = 1;
+			capture.ring_size =
+			    strtoull(optarg, NULL, 10) * CAPTURE_SIZE_UNIT;
+			break;
+		case OPT_CAPTURE_NUMA_NODE:
+			capture.has_numa_node = 1;
+			capture.numa_node = strtol(optarg, NULL, 10);
+			break;
+		case OPT_CAPTURE_SCHED_POLICY:
+			capture.has_sched_policy = 1;
+			capture.sched_policy = str2sched_policy(optarg);
+			break;
+		case OPT_CAPTURE_SCHED_PRIORITY:
+			capture.has_sched_priority = 1;
+			capture.sched_priority = strtol(optarg, NULL, 10);
+			break;
+		case OPT_CAPTURE_CPU_AFFINITY:
+			capture.cpu_set = optarg;
+			break;
+		case OPT_CAPTURE_STACK_PREFAULT:
+			capture.has_stack_prefault = capture.stack_prefault = 1;
+			break;
+		case OPT_CAPTURE_POLICY:
+			policy.name = optarg;
+			break;
+		case OPT_CAPTURE_SOCK_FILTER:
+			rc = sock_filter_parse(optarg, &sfp);
+
+			if (rc)
+				goto out;
+
+			capture.sfp = &sfp;
+			break;
+		case OPT_HELP:
+		default:
+			show_usage(capture_option);
+			rc = -1;
+			goto out;
+		}
+	}
+
+	service = dabba_rpc_client_connect(server_id, server_type);
+
+	if (!service) {
+		rc = EINVAL;
+		goto out;
+	}
+
+	/* Let dabbad report the missing interface */
+	if (!n_pattern) {
+		rc = rpc_capture_start(service, &capture);
+		goto out;
+	}
+
+	/* dabbad matches the interface glob of a policy itself */
+	if (policy.name) {
+		if (n_pattern > 1) {
+			rc = EINVAL;
+			goto out;
+		}
+
+		capture.interface = (char *)pattern[0];
+		policy.status = &err;
+		policy.capture = &capture;
+		rc = rpc_capture_policy_add(service, &policy);
+		goto out;
+	}
+
+	for (a = 0; a < n_pattern && !rc; a++)
+		rc = rpc_capture_interface_select(service, &ifs, pattern[a]);
+
+	if (!rc && !ifs.n_name)
+		rc = ENODEV;
+
+	if (!rc)
+		rc = capture_start_interfaces(service, &capture, &ifs);
+
+ out:
+	capture_interfaces_destroy(&ifs);
+	free(pattern);
+	sock_filter_destroy(&sfp);
+	sock_filter_destroy(&trigger);
+
+	return rc;
+}
+
+/**
+ * \brief Parse argument vector to prepare a capture stop query
+ * \param[in]           argc	        Argument counter
+ * \param[in]           argv	        Argument vector
+ * \return 0 on success, \c EINVAL on invalid input.
+ */
+
+static int cmd_capture_stop(int argc, const char **argv)
+{
+	enum capture_start_option {
+		OPT_CAPTURE_ID,
+		OPT_TCP,
+		OPT_LOCAL,
+		OPT_HELP
+	};
+
+	int ret, rc = 0;
+	Dabba__ThreadId id = DABBA__THREAD_ID__INIT;
+	Dabba__ThreadIdList id_list = DABBA__THREAD_ID_LIST__INIT;
+	const char *server_id = DABBA_RPC_DEFAULT_TCP_SERVER_NAME;
+	ProtobufC_RPC_AddressType server_type = PROTOBUF_C_RPC_ADDRESS_TCP;
+	ProtobufCService *service;
+
+	static struct option capture_option[] = {
+		{"id", required_argument, NULL, OPT_CAPTURE_ID},
+		{"tcp", optional_argument, NULL, OPT_TCP},
+		{"local", optional_argument, NULL, OPT_LOCAL},
+		{"help", no_argument, NULL, OPT_HELP},
+		{NULL, 0, NULL, 0},
+	};
+
+	/* HACK: getopt*() start to parse options at argv[1] */
+	argc++;
+	argv--;
+
+	/* parse capture options */
+	while ((ret =
+		getopt_long_only(argc, (char **)argv, "", capture_option,
+				 NULL)) != EOF) {
+		switch (ret) {
+		case OPT_TCP:
+			server_type = PROTOBUF_C_RPC_ADDRESS_TCP;
+			server_id = DABBA_RPC_DEFAULT_TCP_SERVER_NAME;
+
+			if (optarg)
+				server_id = optarg;
+			break;
+		case OPT_LOCAL:
+			server_type = PROTOBUF_C_RPC_ADDRESS_LOCAL;
+			server_id = DABBA_RPC_DEFAULT_LOCAL_SERVER_NAME;
+
+			if (optarg)
+				server_id = optarg;
+			break;
+		case OPT_CAPTURE_ID:
+			rc = capture_id_list_add(&id_list,
+						 strtoull(optarg, NULL, 10));
+
+			if (rc)
+				goto out;
+			break;
+		case OPT_HELP:
+		default:
+			show_usage(capture_option);
+			rc = -1;
+			goto out;
+		}
+	}
+
+	service = dabba_rpc_client_connect(server_id, server_type);
+
+	/* Check error reporting */
+	if (!service)
+		rc = EINVAL;
+	else if (id_list.n_list > 1)
+		rc = rpc_capture_stop_batch(service, &id_list);
+	else
+		rc = rpc_capture_stop(service,
+				      id_list.n_list ? id_list.list[0] : &id);
+
+ out:
+	capture_id_list_destroy(&id_list);
+
+	return rc;
+}
+
+/**
+ * \brief Parse argument vector to prepare a capture modify query
+ * \param[in]           argc	        Argument counter
+ * \param[in]           argv	        Argument vector
+ * \return 0 on success, \c EINVAL on invalid input.
+ */
+
+static int cmd_capture_modify(int argc, const char **argv)
+{
+	enum capture_modify_option {
+		OPT_CAPTURE_ID,
+		OPT_CAPTURE_SOCK_FILTER,
+		OPT_CAPTURE_NO_SOCK_FILTER,
+		OPT_CAPTURE_SNAPLEN,
+		OPT_CAPTURE_SAMPLING,
+		OPT_TCP,
+		OPT_LOCAL,
+		OPT_HELP
+	};
+
+	int ret, rc;
+	Dabba__Capture capture = DABBA__CAPTURE__INIT;
+	Dabba__ThreadId id = DABBA__THREAD_ID__INIT;
+	Dabba__SockFprog sfp = DABBA__SOCK_FPROG__INIT;
+	Dabba__ErrorCode err = DABBA__ERROR_CODE__INIT;
+	const char *server_id = DABBA_RPC_DEFAULT_TCP_SERVER_NAME;
+	ProtobufC_RPC_AddressType server_type = PROTOBUF_C_RPC_ADDRESS_TCP;
+	ProtobufCService *service;
+
+	static struct option capture_option[] = {
+		{"id", required_argument, NULL, OPT_CAPTURE_ID},
+		{"sock-filter", required_argument, NULL,
+		 OPT_CAPTURE_SOCK_FILTER},
+		{"no-sock-filter", no_argument, NULL,
+		 OPT_CAPTURE_NO_SOCK_FILTER},
+		{"snaplen", required_argument, NULL, OPT_CAPTURE_SNAPLEN},
+		{"sampling", required_argument, NULL, OPT_CAPTURE_SAMPLING},
+		{"tcp", optional_argument, NULL, OPT_TCP},
+		{"local", optional_argument, NULL, OPT_LOCAL},
+		{"help", no_argument, NULL, OPT_HELP},
+		{NULL, 0, NULL, 0},
+	};
+
+	capture.id = &id;
+	capture.status = &err;
+
+	/* HACK: getopt*() start to parse options at argv[1] */
+	argc++;
+	argv--;
+
+	/* parse capture options */
+	while ((ret =
+		getopt_long_only(argc, (char **)argv, "", capture_option,
+				 NULL)) != EOF) {
+		switch (ret) {
+		case OPT_TCP:
+			server_type = PROTOBUF_C_RPC_ADDRESS_TCP;
+			server_id = DABBA_RPC_DEFAULT_TCP_SERVER_NAME;
+
+			if (optarg)
+				server_id = optarg;
+			break;
+		case OPT_LOCAL:
+			server_type = PROTOBUF_C_RPC_ADDRESS_LOCAL;
+			server_id = DABBA_RPC_DEFAULT_LOCAL_SERVER_NAME;
+
+			if (optarg)
+				server_id = optarg;
+			break;
+		case OPT_CAPTURE_ID:
+			id.id = strtoull(optarg, NULL, 10);
+			break;
+		case OPT_CAPTURE_SOCK_FILTER:
+			sock_filter_destroy(&sfp);
+			rc = sock_filter_parse(optarg, &sfp);
+
+			if (rc)
+				return rc;
+
+			capture.sfp = &sfp;
+			break;
+		case OPT_CAPTURE_NO_SOCK_FILTER:
+			sock_filter_destroy(&sfp);
+			capture.sfp = &sfp;
+			break;
+		case OPT_CAPTURE_SNAPLEN:
+			capture.has_snaplen = 1;
+			capture.snaplen = strtoull(optarg, NULL, 10);
+			break;
+		case OPT_CAPTURE_SAMPLING:
+			capture.has_sampling = 1;
+			capture.sampling = strtoull(optarg, NULL, 10);
+			break;
+		case OPT_HELP:
+		default:
+			sock_filter_destroy(&sfp);
+			show_usage(capture_option);
+			return -1;
+		}
+	}
+
+	service = dabba_rpc_client_connect(server_id, server_type);
+
+	if (service)
+		rc = rpc_capture_modify(service, &capture);
+	else
+		rc = EINVAL;
+
+	sock_filter_destroy(&sfp);
+
+	return rc;
+}
+
+/**
+ * \brief Parse argument vector to prepare a capture resize query
+ * \param[in]           argc	        Argument counter
+ * \param[in]           argv	        Argument vector
+ * \return 0 on success, \c EINVAL on invalid input.
+ */
+
+static int cmd_capture_resize(int argc, const char **argv)
+{
+	enum capture_resize_option {
+		OPT_CAPTURE_ID,
+		OPT_CAPTURE_FRAME_NUMBER,
+		OPT_CAPTURE_RING_SIZE,
+		OPT_CAPTURE_GROW_THRESHOLD,
+		OPT_CAPTURE_RING_SIZE_MAX,
+		OPT_TCP,
+		OPT_LOCAL,
+		OPT_HELP
+	};
+
+	int ret;
+	Dabba__CaptureResize resize = DABBA__CAPTURE_RESIZE__INIT;
+	Dabba__ThreadId id = DABBA__THREAD_ID__INIT;
+	Dabba__ErrorCode err = DABBA__ERROR_CODE__INIT;
+	const char *server_id = DABBA_RPC_DEFAULT_TCP_SERVER_NAME;
+	ProtobufC_RPC_AddressType server_type = PROTOBUF_C_RPC_ADDRESS_TCP;
+	ProtobufCService *service;
+
+	static struct option capture_option[] = {
+		{"id", required_argument, NULL, OPT_CAPTURE_ID},
+		{"frame-number", required_argument, NULL,
+		 OPT_CAPTURE_FRAME_NUMBER},
+		{"ring-size", required_argument, NULL, OPT_CAPTURE_RING_SIZE},
+		{"grow-threshold", required_argument, NULL,
+		 OPT_CAPTURE_GROW_THRESHOLD},
+		{"ring-size-max", required_argument, NULL,
+		 OPT_CAPTURE_RING_SIZE_MAX},
+		{"tcp", optional_argument, NULL, OPT_TCP},
+		{"local", optional_argument, NULL, OPT_LOCAL},
+		{"help", no_argument, NULL, OPT_HELP},
+		{NULL, 0, NULL, 0},
+	};
+
+	resize.id = &id;
+	resize.status = &err;
+
+	/* HACK: getopt*() start to parse options at argv[1] */
+	argc++;
+	argv--;
+
+	/* parse capture options */
+	while ((ret =
+		getopt_long_only(argc, (char **)argv, "", capture_option,
+				 NULL)) != EOF) {
+		switch (ret) {
+		case OPT_TCP:
+			server_type = PROTOBUF_C_RPC_ADDRESS_TCP;
+			server_id = DABBA_RPC_DEFAULT_TCP_SERVER_NAME;
+
+			if (optarg)
+				server_id = optarg;
+			break;
+		case OPT_LOCAL:
+			server_type = PROTOBUF_C_RPC_ADDRESS_LOCAL;
+			server_id = DABBA_RPC_DEFAULT_LOCAL_SERVER_NAME;
+
+			if (optarg)
+				server_id = optarg;
+			break;
+		case OPT_CAPTURE_ID:
+			id.id = strtoull(optarg, NULL, 10);
+			break;
+		case OPT_CAPTURE_FRAME_NUMBER:
+			resize.has_frame_nr = 1;
+			resize.frame_nr = strtoull(optarg, NULL, 10);
+			break;
+		case OPT_CAPTURE_RING_SIZE:
+			resize.has_ring_size = 1;
+			resize.ring_size =
+			    strtoull(optarg, NULL, 10) * CAPTURE_SIZE_UNIT;
+			break;
+		case OPT_CAPTURE_GROW_THRESHOLD:
+			resize.has_grow_threshold = 1;
+			resize.grow_threshold = strtoull(optarg, NULL, 10);
+			break;
+		case OPT_CAPTURE_RING_SIZE_MAX:
+			resize.has_ring_size_max = 1;
+			resize.ring_size_max =
+			    strtoull(optarg, NULL, 10) * CAPTURE_SIZE_UNIT;
+			break;
+		case OPT_HELP:
+		default:
+			show_usage(capture_option);
+			return -1;
+		}
+	}
+
+	service = dabba_rpc_client_connect(server_id, server_type);
+
+	return service ? rpc_capture_resize(service, &resize) : EINVAL;
+}
+
+/**
+ * \brief Parse argument vector to prepare a capture dump query
+ * \param[in]           argc	        Argument counter
+ * \param[in]           argv	        Argument vector
+ * \return 0 on success, \c EINVAL on invalid input.
+ */
+
+static int cmd_capture_dump(int argc, const char **argv)
+{
+	enum capture_dump_option {
+		OPT_CAPTURE_ID,
+		OPT_CAPTURE_PCAP,
+		OPT_TCP,
+		OPT_LOCAL,
+		OPT_HELP
+	};
+
+	int ret;
+	Dabba__CaptureDump dump = DABBA__CAPTURE_DUMP__INIT;
+	Dabba__ThreadId id = DABBA__THREAD_ID__INIT;
+	Dabba__ErrorCode err = DABBA__ERROR_CODE__INIT;
+	const char *server_id = DABBA_RPC_DEFAULT_TCP_SERVER_NAME;
+	ProtobufC_RPC_AddressType server_type = PROTOBUF_C_RPC_ADDRESS_TCP;
+	ProtobufCService *service;
+
+	static struct option capture_option[] = {
+		{"id", required_argument, NULL, OPT_CAPTURE_ID},
+		{"pcap", required_argument, NULL, OPT_CAPTURE_PCAP},
+		{"tcp", optional_argument, NULL, OPT_TCP},
+		{"local", optional_argument, NULL, OPT_LOCAL},
+		{"help", no_argument, NULL, OPT_HELP},
+		{NULL, 0, NULL, 0},
+	};
+
+	dump.id = &id;
+	dump.status = &err;
+
+	/* HACK: getopt*() start to parse options at argv[1] */
+	argc++;
+	argv--;
+
+	/* parse capture options */
+	while ((ret =
+		getopt_long_only(argc, (char **)argv, "", capture_option,
+				 NULL)) != EOF) {
+		switch (ret) {
+		case OPT_TCP:
+			server_type = PROTOBUF_C_RPC_ADDRESS_TCP;
+			server_id = DABBA_RPC_DEFAULT_TCP_SERVER_NAME;
+
+			if (optarg)
+				server_id = optarg;
+			break;
+		case OPT_LOCAL:
+			server_type = PROTOBUF_C_RPC_ADDRESS_LOCAL;
+			server_id = DABBA_RPC_DEFAULT_LOCAL_SERVER_NAME;
+
+			if (optarg)
+				server_id = optarg;
+			break;
+		case OPT_CAPTURE_ID:
+			id.id = strtoull(optarg, NULL, 10);
+			break;
+		case OPT_CAPTURE_PCAP:
+			dump.pcap = optarg;
+			break;
+		case OPT_HELP:
+		default:
+			show_usage(capture_option);
+			return -1;
+		}
+	}
+
+	if (!dump.pcap)
+		return EINVAL;
+
+	service = dabba_rpc_client_connect(server_id, server_type);
+
+	return service ? rpc_capture_dump(service, &dump) : EINVAL;
+}
+
+/**
+ * \brief Parse argument vector to prepare a capture reset query
+ * \param[in]           argc	        Argument counter
+ * \param[in]           argv	        Argument vector
+ * \return 0 on success, \c EINVAL on invalid input.
+ */
+
+static int cmd_capture_stop_all(int argc, const char **argv)
 {
 	enum capture_start_option {
-		OPT_CAPTURE_ID,
 		OPT_TCP,
 		OPT_LOCAL,
 		OPT_HELP
 	};
 
 	int ret;
-	Dabba__ThreadId id = DABBA__THREAD_ID__INIT;
+	Dabba__Dummy dummy = DABBA__DUMMY__INIT;
 	const char *server_id = DABBA_RPC_DEFAULT_TCP_SERVER_NAME;
 	ProtobufC_RPC_AddressType server_type = PROTOBUF_C_RPC_ADDRESS_TCP;
 	ProtobufCService *service;
 
 	static struct option capture_option[] = {
-		{"id", required_argument, NULL, OPT_CAPTURE_ID},
 		{"tcp", optional_argument, NULL, OPT_TCP},
 		{"local", optional_argument, NULL, OPT_LOCAL},
 		{"help", no_argument, NULL, OPT_HELP},
@@ -443,6 +1881,71 @@ static int cmd_capture_stop(int argc, const char **argv)
 	argv--;
 
 	/* parse capture options */
+	while ((ret =
+		getopt_long_only(argc, (char **)argv, "", capture_option,
+				 NULL)) != EOF) {
+		switch (ret) {
+		case OPT_TCP:
+			server_type = PROTOBUF_C_RPC_ADDRESS_TCP;
+			server_id = DABBA_RPC_DEFAULT_TCP_SERVER_NAME;
+
+			if (optarg)
+				server_id = optarg;
+			break;
+		case OPT_LOCAL:
+			server_type = PROTOBUF_C_RPC_ADDRESS_LOCAL;
+			server_id = DABBA_RPC_DEFAULT_LOCAL_SERVER_NAME;
+
+			if (optarg)
+				server_id = optarg;
+			break;
+		case OPT_HELP:
+		default:
+			show_usage(capture_option);
+			return -1;
+		}
+	}
+
+	service = dabba_rpc_client_connect(server_id, server_type);
+
+	/* Check error reporting */
+	return service ? rpc_capture_stop_all(service, &dummy) : EINVAL;
+}
+
+/**
+ * \brief Parse argument vector to prepare a capture list get query
+ * \param[in]           argc	        Argument counter
+ * \param[in]           argv	        Argument vector
+ * \return 0 on success, \c EINVAL on invalid input.
+ */
+static int cmd_capture_get(int argc, const char **argv)
+{
+	enum capture_option {
+		/* option */
+		OPT_CAPTURE_ID,
+		OPT_TCP,
+		OPT_LOCAL,
+		OPT_HELP
+	};
+
+	const struct option capture_option[] = {
+		{"id", required_argument, NULL, OPT_CAPTURE_ID},
+		{"tcp", optional_argument, NULL, OPT_TCP},
+		{"local", optional_argument, NULL, OPT_LOCAL},
+		{"help", no_argument, NULL, OPT_HELP},
+		{NULL, 0, NULL, 0},
+	};
+
+	int ret, rc = 0;
+	Dabba__ThreadIdList id_list = DABBA__THREAD_ID_LIST__INIT;
+	const char *server_id = DABBA_RPC_DEFAULT_TCP_SERVER_NAME;
+	ProtobufC_RPC_AddressType server_type = PROTOBUF_C_RPC_ADDRESS_TCP;
+	ProtobufCService *service;
+
+	/* HACK: getopt*() start to parse options at argv[1] */
+	argc++;
+	argv--;
+
 	while ((ret =
 		getopt_long_only(argc, (char **)argv, "", capture_option,
 				 NULL)) != EOF) {
@@ -462,43 +1965,60 @@ static int cmd_capture_stop(int argc, const char **argv)
 				server_id = optarg;
 			break;
 		case OPT_CAPTURE_ID:
-			id.id = strtoull(optarg, NULL, 10);
+			rc = capture_id_list_add(&id_list,
+						 strtoull(optarg, NULL, 10));
+
+			if (rc)
+				goto out;
 			break;
 		case OPT_HELP:
 		default:
 			show_usage(capture_option);
-			return -1;
+			rc = -1;
+			goto out;
 		}
 	}
 
 	service = dabba_rpc_client_connect(server_id, server_type);
 
+	if (service)
+		rc = rpc_capture_get(service, &id_list);
+	else
+		rc = EINVAL;
+
+ out:
+	capture_id_list_destroy(&id_list);
+
 	/* Check error reporting */
-	return service ? rpc_capture_stop(service, &id) : EINVAL;
+
+	return rc;
 }
 
 /**
- * \brief Parse argument vector to prepare a capture reset query
+ * \brief Parse argument vector to prepare a capture policy removal
  * \param[in]           argc	        Argument counter
  * \param[in]           argv	        Argument vector
  * \return 0 on success, \c EINVAL on invalid input.
  */
 
-static int cmd_capture_stop_all(int argc, const char **argv)
+static int cmd_capture_policy_remove(int argc, const char **argv)
 {
-	enum capture_start_option {
+	enum capture_policy_option {
+		OPT_CAPTURE_POLICY,
 		OPT_TCP,
 		OPT_LOCAL,
 		OPT_HELP
 	};
 
 	int ret;
-	Dabba__Dummy dummy = DABBA__DUMMY__INIT;
+	Dabba__CapturePolicy policy = DABBA__CAPTURE_POLICY__INIT;
+	Dabba__ErrorCode err = DABBA__ERROR_CODE__INIT;
 	const char *server_id = DABBA_RPC_DEFAULT_TCP_SERVER_NAME;
 	ProtobufC_RPC_AddressType server_type = PROTOBUF_C_RPC_ADDRESS_TCP;
 	ProtobufCService *service;
 
 	static struct option capture_option[] = {
+		{"policy", required_argument, NULL, OPT_CAPTURE_POLICY},
 		{"tcp", optional_argument, NULL, OPT_TCP},
 		{"local", optional_argument, NULL, OPT_LOCAL},
 		{"help", no_argument, NULL, OPT_HELP},
@@ -509,6 +2029,9 @@ static int cmd_capture_stop_all(int argc, const char **argv)
 	argc++;
 	argv--;
 
+	policy.name = "";
+	policy.status = &err;
+
 	/* parse capture options */
 	while ((ret =
 		getopt_long_only(argc, (char **)argv, "", capture_option,
@@ -528,6 +2051,9 @@ static int cmd_capture_stop_all(int argc, const char **argv)
 			if (optarg)
 				server_id = optarg;
 			break;
+		case OPT_CAPTURE_POLICY:
+			policy.name = optarg;
+			break;
 		case OPT_HELP:
 		default:
 			show_usage(capture_option);
@@ -538,44 +2064,106 @@ static int cmd_capture_stop_all(int argc, const char **argv)
 	service = dabba_rpc_client_connect(server_id, server_type);
 
 	/* Check error reporting */
-	return service ? rpc_capture_stop_all(service, &dummy) : EINVAL;
+	return service ? rpc_capture_policy_remove(service, &policy) : EINVAL;
 }
 
 /**
- * \brief Parse argument vector to prepare a capture list get query
+ * \brief Parse argument vector to prepare a capture policy list query
  * \param[in]           argc	        Argument counter
  * \param[in]           argv	        Argument vector
  * \return 0 on success, \c EINVAL on invalid input.
  */
-static int cmd_capture_get(int argc, const char **argv)
+
+static int cmd_capture_policy_get(int argc, const char **argv)
 {
-	enum capture_option {
-		/* option */
-		OPT_CAPTURE_ID,
+	enum capture_policy_option {
 		OPT_TCP,
 		OPT_LOCAL,
 		OPT_HELP
 	};
 
-	const struct option capture_option[] = {
-		{"id", required_argument, NULL, OPT_CAPTURE_ID},
+	int ret;
+	Dabba__Dummy dummy = DABBA__DUMMY__INIT;
+	const char *server_id = DABBA_RPC_DEFAULT_TCP_SERVER_NAME;
+	ProtobufC_RPC_AddressType server_type = PROTOBUF_C_RPC_ADDRESS_TCP;
+	ProtobufCService *service;
+
+	static struct option capture_option[] = {
 		{"tcp", optional_argument, NULL, OPT_TCP},
 		{"local", optional_argument, NULL, OPT_LOCAL},
 		{"help", no_argument, NULL, OPT_HELP},
 		{NULL, 0, NULL, 0},
 	};
 
-	int ret, rc = 0;
-	Dabba__ThreadIdList id_list = DABBA__THREAD_ID_LIST__INIT;
-	Dabba__ThreadId **idpp;
+	/* HACK: getopt*() start to parse options at argv[1] */
+	argc++;
+	argv--;
+
+	/* parse capture options */
+	while ((ret =
+		getopt_long_only(argc, (char **)argv, "", capture_option,
+				 NULL)) != EOF) {
+		switch (ret) {
+		case OPT_TCP:
+			server_type = PROTOBUF_C_RPC_ADDRESS_TCP;
+			server_id = DABBA_RPC_DEFAULT_TCP_SERVER_NAME;
+
+			if (optarg)
+				server_id = optarg;
+			break;
+		case OPT_LOCAL:
+			server_type = PROTOBUF_C_RPC_ADDRESS_LOCAL;
+			server_id = DABBA_RPC_DEFAULT_LOCAL_SERVER_NAME;
+
+			if (optarg)
+				server_id = optarg;
+			break;
+		case OPT_HELP:
+		default:
+			show_usage(capture_option);
+			return -1;
+		}
+	}
+
+	service = dabba_rpc_client_connect(server_id, server_type);
+
+	/* Check error reporting */
+	return service ? rpc_capture_policy_get(service, &dummy) : EINVAL;
+}
+
+/**
+ * \brief Parse argument vector to prepare a capture pool query
+ * \param[in]           argc	        Argument counter
+ * \param[in]           argv	        Argument vector
+ * \return 0 on success, \c EINVAL on invalid input.
+ */
+
+static int cmd_capture_pool_get(int argc, const char **argv)
+{
+	enum capture_pool_option {
+		OPT_TCP,
+		OPT_LOCAL,
+		OPT_HELP
+	};
+
+	int ret;
+	Dabba__Dummy dummy = DABBA__DUMMY__INIT;
 	const char *server_id = DABBA_RPC_DEFAULT_TCP_SERVER_NAME;
 	ProtobufC_RPC_AddressType server_type = PROTOBUF_C_RPC_ADDRESS_TCP;
 	ProtobufCService *service;
 
+	static struct option capture_option[] = {
+		{"tcp", optional_argument, NULL, OPT_TCP},
+		{"local", optional_argument, NULL, OPT_LOCAL},
+		{"help", no_argument, NULL, OPT_HELP},
+		{NULL, 0, NULL, 0},
+	};
+
 	/* HACK: getopt*() start to parse options at argv[1] */
 	argc++;
 	argv--;
 
+	/* parse capture options */
 	while ((ret =
 		getopt_long_only(argc, (char **)argv, "", capture_option,
 				 NULL)) != EOF) {
@@ -594,45 +2182,103 @@ static int cmd_capture_get(int argc, const char **argv)
 			if (optarg)
 				server_id = optarg;
 			break;
-		case OPT_CAPTURE_ID:
-			idpp =
-			    realloc(id_list.list,
-				    sizeof(*id_list.list) * (id_list.n_list +
-							     1));
+		case OPT_HELP:
+		default:
+			show_usage(capture_option);
+			return -1;
+		}
+	}
+
+	service = dabba_rpc_client_connect(server_id, server_type);
+
+	/* Check error reporting */
+	return service ? rpc_capture_pool_get(service, &dummy) : EINVAL;
+}
+
+/**
+ * \brief Parse argument vector to prepare a capture pool modification
+ * \param[in]           argc	        Argument counter
+ * \param[in]           argv	        Argument vector
+ * \return 0 on success, \c EINVAL on invalid input.
+ */
+
+static int cmd_capture_pool_modify(int argc, const char **argv)
+{
+	enum capture_pool_option {
+		OPT_CAPTURE_POOL_SIZE,
+		OPT_CAPTURE_FRAME_NUMBER,
+		OPT_CAPTURE_FRAME_SIZE,
+		OPT_TCP,
+		OPT_LOCAL,
+		OPT_HELP
+	};
+
+	int ret;
+	Dabba__CapturePool pool = DABBA__CAPTURE_POOL__INIT;
+	Dabba__ErrorCode err = DABBA__ERROR_CODE__INIT;
+	const char *server_id = DABBA_RPC_DEFAULT_TCP_SERVER_NAME;
+	ProtobufC_RPC_AddressType server_type = PROTOBUF_C_RPC_ADDRESS_TCP;
+	ProtobufCService *service;
+
+	static struct option capture_option[] = {
+		{"size", required_argument, NULL, OPT_CAPTURE_POOL_SIZE},
+		{"frame-number", required_argument, NULL,
+		 OPT_CAPTURE_FRAME_NUMBER},
+		{"frame-size", required_argument, NULL, OPT_CAPTURE_FRAME_SIZE},
+		{"tcp", optional_argument, NULL, OPT_TCP},
+		{"local", optional_argument, NULL, OPT_LOCAL},
+		{"help", no_argument, NULL, OPT_HELP},
+		{NULL, 0, NULL, 0},
+	};
 
-			if (!idpp)
-				return ENOMEM;
+	/* HACK: getopt*() start to parse options at argv[1] */
+	argc++;
+	argv--;
 
-			id_list.list = idpp;
+	pool.status = &err;
 
-			dabba__thread_id__init(id_list.list[id_list.n_list]);
+	/* parse capture options */
+	while ((ret =
+		getopt_long_only(argc, (char **)argv, "", capture_option,
+				 NULL)) != EOF) {
+		switch (ret) {
+		case OPT_TCP:
+			server_type = PROTOBUF_C_RPC_ADDRESS_TCP;
+			server_id = DABBA_RPC_DEFAULT_TCP_SERVER_NAME;
 
-			id_list.list[id_list.n_list]->id =
-			    strtoull(optarg, NULL, 10);
-			id_list.n_list++;
+			if (optarg)
+				server_id = optarg;
+			break;
+		case OPT_LOCAL:
+			server_type = PROTOBUF_C_RPC_ADDRESS_LOCAL;
+			server_id = DABBA_RPC_DEFAULT_LOCAL_SERVER_NAME;
 
+			if (optarg)
+				server_id = optarg;
+			break;
+		case OPT_CAPTURE_POOL_SIZE:
+			pool.has_size = 1;
+			pool.size = strtoull(optarg, NULL, 10);
+			break;
+		case OPT_CAPTURE_FRAME_NUMBER:
+			pool.has_frame_nr = 1;
+			pool.frame_nr = strtoull(optarg, NULL, 10);
+			break;
+		case OPT_CAPTURE_FRAME_SIZE:
+			pool.has_frame_size = 1;
+			pool.frame_size = strtoull(optarg, NULL, 10);
 			break;
 		case OPT_HELP:
 		default:
 			show_usage(capture_option);
-			rc = -1;
-			goto out;
+			return -1;
 		}
 	}
 
 	service = dabba_rpc_client_connect(server_id, server_type);
 
-	if (service)
-		rc = rpc_capture_get(service, &id_list);
-	else
-		rc = EINVAL;
-
- out:
-	free(id_list.list);
-
 	/* Check error reporting */
-
-	return rc;
+	return service ? rpc_capture_pool_modify(service, &pool) : EINVAL;
 }
 
 /**
@@ -652,7 +2298,14 @@ int cmd_capture(int argc, const char **argv)
 		{"start", cmd_capture_start},
 		{"stop", cmd_capture_stop},
 		{"stop-all", cmd_capture_stop_all},
+		{"modify", cmd_capture_modify},
+		{"resize", cmd_capture_resize},
+		{"dump", cmd_capture_dump},
 		{"get", cmd_capture_get},
+		{"policy-get", cmd_capture_policy_get},
+		{"policy-remove", cmd_capture_policy_remove},
+		{"pool-get", cmd_capture_pool_get},
+		{"pool-modify", cmd_capture_pool_modify},
 	};
 
 	return cmd_run_command(cmd, ARRAY_SIZE(cmd), argc, argv);
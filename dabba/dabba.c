@@ -77,6 +77,7 @@ Written by Emmanuel Roullit <emmanuel.roullit@gmail.com>
 #include <dabba/interface.h>
 #include <dabba/capture.h>
 #include <dabba/replay.h>
+#include <dabba/memory.h>
 
 /**
  * \internal
@@ -189,6 +190,7 @@ int main(int argc, const char **argv)
 		{"thread", cmd_thread},
 		{"capture", cmd_capture},
 		{"replay", cmd_replay},
+		{"memory", cmd_memory},
 		{"version", cmd_version},
 		{"help", cmd_help}
 	};
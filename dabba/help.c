@@ -83,7 +83,8 @@ static void list_common_cmds_help(void)
 		{"interface", "perform an interface related command"},
 		{"thread", "perform a thread related command"},
 		{"capture", "capture live traffic from an interface"},
-		{"replay", "replay traffic from a pcap file"}
+		{"replay", "replay traffic from a pcap file"},
+		{"memory", "limit the memory of captures and replays"}
 	};
 
 	for (i = 0; i < ARRAY_SIZE(common_cmds); i++) {
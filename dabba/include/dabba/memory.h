@@ -0,0 +1,7 @@
+
+#ifndef MEMORY_H
+#define	MEMORY_H
+
+int cmd_memory(int argc, const char **argv);
+
+#endif				/* MEMORY_H */
@@ -44,6 +44,18 @@ Apply new capabilities settings to a specific network interface.
 
 interface name to work on.
 
+=item --prefix <prefix>
+
+only work on the interfaces whose name starts with <prefix>.
+
+=item --offset <number>
+
+skip the first <number> selected interfaces.
+
+=item --limit <number>
+
+report at most <number> interfaces, use with --offset to page through long interface lists.
+
 =item --aui (true|false)
 
 Activate or shutdown the attachment unit interface if available.
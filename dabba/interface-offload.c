@@ -43,6 +43,18 @@ Apply new offload settings to a specific network interface.
 
 interface name to work on.
 
+=item --prefix <prefix>
+
+only work on the interfaces whose name starts with <prefix>.
+
+=item --offset <number>
+
+skip the first <number> selected interfaces.
+
+=item --limit <number>
+
+report at most <number> interfaces, use with --offset to page through long interface lists.
+
 =item --rx-csum (true|false)
 
 Activate or shutdown receive checksum offload.
@@ -191,6 +203,7 @@ static void interface_offload_list_print(const Dabba__InterfaceOffloadList *
 		printf("        ufo: %s\n", print_tf(offloadp->ufo));
 		printf("        gso: %s\n", print_tf(offloadp->gso));
 		printf("        gro: %s\n", print_tf(offloadp->gro));
+		printf("        lro: %s\n", print_tf(offloadp->lro));
 		printf("        rx-hash: %s\n", print_tf(offloadp->rxhash));
 	}
 
@@ -43,6 +43,18 @@ Apply new pause settings to a specific network interface.
 
 interface name to work on.
 
+=item --prefix <prefix>
+
+only work on the interfaces whose name starts with <prefix>.
+
+=item --offset <number>
+
+skip the first <number> selected interfaces.
+
+=item --limit <number>
+
+report at most <number> interfaces, use with --offset to page through long interface lists.
+
 =item --rx(true|false)
 
 Activate or shutdown receive pause.
@@ -39,6 +39,18 @@ The output is formatted in YAML.
 
 interface name to work on.
 
+=item --prefix <prefix>
+
+only work on the interfaces whose name starts with <prefix>.
+
+=item --offset <number>
+
+skip the first <number> selected interfaces.
+
+=item --limit <number>
+
+report at most <number> interfaces, use with --offset to page through long interface lists.
+
 =item --tcp[=<hostname>:<port>]
 
 Query a running instance of dabbad using a TCP socket (default: localhost:55994)
@@ -43,6 +43,18 @@ Apply new status to a specific network interface.
 
 interface name to work on.
 
+=item --prefix <prefix>
+
+only work on the interfaces whose name starts with <prefix>.
+
+=item --offset <number>
+
+skip the first <number> selected interfaces.
+
+=item --limit <number>
+
+report at most <number> interfaces, use with --offset to page through long interface lists.
+
 =item --promiscuous (true|false)
 
 Activate or shutdown promiscuous mode.
@@ -77,6 +89,10 @@ Output the status of all available network interfaces.
 
 Output the status of 'eth0'.
 
+=item dabba interface status get --prefix veth --offset 100 --limit 100
+
+Output the status of the second hundred interfaces whose name starts with 'veth'.
+
 =item dabba interface status modify --id eth0 --promiscuous true
 
 Set 'eth0' in promiscuous mode.
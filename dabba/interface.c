@@ -139,6 +139,9 @@ int rpc_interface_get(int argc, const char **argv,
 	enum interface_option {
 		/* option */
 		OPT_INTERFACE_ID,
+		OPT_INTERFACE_PREFIX,
+		OPT_INTERFACE_OFFSET,
+		OPT_INTERFACE_LIMIT,
 		OPT_TCP,
 		OPT_LOCAL,
 		OPT_HELP
@@ -146,6 +149,9 @@ int rpc_interface_get(int argc, const char **argv,
 
 	const struct option interface_option[] = {
 		{"id", required_argument, NULL, OPT_INTERFACE_ID},
+		{"prefix", required_argument, NULL, OPT_INTERFACE_PREFIX},
+		{"offset", required_argument, NULL, OPT_INTERFACE_OFFSET},
+		{"limit", required_argument, NULL, OPT_INTERFACE_LIMIT},
 		{"tcp", optional_argument, NULL, OPT_TCP},
 		{"local", optional_argument, NULL, OPT_LOCAL},
 		{"help", no_argument, NULL, OPT_HELP},
@@ -207,6 +213,17 @@ int rpc_interface_get(int argc, const char **argv,
 			id_list.list[id_list.n_list]->name = optarg;
 			id_list.n_list++;
 
+			break;
+		case OPT_INTERFACE_PREFIX:
+			id_list.prefix = optarg;
+			break;
+		case OPT_INTERFACE_OFFSET:
+			id_list.has_offset = 1;
+			id_list.offset = strtoul(optarg, NULL, 10);
+			break;
+		case OPT_INTERFACE_LIMIT:
+			id_list.has_limit = 1;
+			id_list.limit = strtoul(optarg, NULL, 10);
 			break;
 		case OPT_HELP:
 		default:
@@ -0,0 +1,376 @@
+/**
+ * \file memory.c
+ * \author written by Emmanuel Roullit emmanuel.roullit@gmail.com (C) 2013
+ * \date 2013
+ */
+
+
+/*
+
+=head1 NAME
+
+dabba-memory - Manage the memory budget of dabbad
+
+=head1 SYNOPSIS
+
+dabba memory <command> [<arguments>...] [--help]
+
+=head1 DESCRIPTION
+
+Give the user the possibility to limit the memory dabbad uses for capture
+packet mmap areas, capture in-memory packet buffers and replay packet mmap
+areas, and to see how much of it is in use.
+
+=head1 COMMANDS
+
+=over
+
+=item get
+
+Fetch and print the memory budget, its policy and the amount of bytes used
+by capture packet mmap areas (including the ones of the capture pool),
+capture in-memory packet buffers and replay packet mmap areas.
+The output is formatted in YAML.
+
+=item modify
+
+Change the memory budget or its policy. Captures and replays already running
+keep their memory.
+
+=back
+
+=head1 OPTIONS
+
+=over
+
+=item --budget <MiB>
+
+Limit the memory of captures and replays to <MiB> megabytes. 0 removes
+the limit. By default, the budget is half of the physical memory, or
+RLIMIT_MEMLOCK if dabbad cannot lock more memory than that.
+
+=item --policy <policy>
+
+Decide what happens to a capture or a replay whose packet mmap area does not
+fit in the budget: "reject" fails it with ENOBUFS, "shrink" gives it the
+largest packet mmap area which still fits. In-memory packet buffers and
+packet mmap area resizes are always rejected. The default policy is "reject".
+
+=item --tcp[=<hostname>:<port>]
+
+Query a running instance of dabbad using a TCP socket (default: localhost:55994)
+
+=item --local[=<path>]
+
+Query a running instance of dabbad using a Unix domain socket (default: /tmp/dabba)
+
+=item --help
+
+Prints the help message on the terminal
+
+=back
+
+=head1 EXAMPLES
+
+=over
+
+=item dabba memory get
+
+Output the memory budget and its usage
+
+=item dabba memory modify --budget 512 --policy shrink
+
+Limit captures and replays to 512 MiB and give smaller packet mmap areas to
+the ones which would not fit anymore.
+
+=back
+
+=head1 AUTHOR
+
+Written by Emmanuel Roullit <emmanuel.roullit@gmail.com>
+
+=head1 BUGS
+
+=over
+
+=item Please report bugs to <https://github.com/eroullit/dabba/issues>
+
+=item dabba project project page: <https://github.com/eroullit/dabba>
+
+=back
+
+=head1 COPYRIGHT
+
+=over
+
+=item Copyright (C) 2013 Emmanuel Roullit.
+
+=item License MIT: <www.opensource.org/licenses/MIT>
+
+=item This is free software: you are free to change and redistribute it.
+
+=item There is NO WARRANTY, to the extent permitted by law.
+
+=back
+
+=cut
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <errno.h>
+
+#include <libdabba/macros.h>
+#include <dabba/cli.h>
+#include <dabba/dabba.h>
+#include <dabba/help.h>
+#include <dabba/rpc.h>
+#include <dabba/memory.h>
+
+#define MEMORY_SIZE_UNIT (1024 * 1024)
+
+/**
+ * \internal
+ * \brief Print the memory budget and its usage to \c stdout
+ * \param[in]           result	        Pointer to memory budget
+ * \param[in,out]       closure_data	Pointer to protobuf closure data
+ */
+
+static void memory_print(const Dabba__Memory * result, void *closure_data)
+{
+	protobuf_c_boolean *status = (protobuf_c_boolean *) closure_data;
+
+	assert(closure_data);
+
+	rpc_header_print("memory");
+
+	if (result) {
+		printf("  ");
+		__rpc_error_code_print(result->status->code);
+		printf("    budget: %" PRIu64 "\n", result->budget);
+		printf("    policy: %s\n", result->shrink ? "shrink" : "reject");
+		printf("    ring: %" PRIu64 "\n", result->ring);
+		printf("    buffer: %" PRIu64 "\n", result->buffer);
+		printf("    replay: %" PRIu64 "\n", result->replay);
+	}
+
+	*status = 1;
+}
+
+/**
+ * \brief Invoke memory get remote procedure call
+ * \param[in]           service	        Pointer to protobuf service
+ * \param[in]           dummy 	        Pointer to unused dummy message
+ * \return always returns zero.
+ */
+
+static int rpc_memory_get(ProtobufCService * service,
+			  const Dabba__Dummy * dummy)
+{
+	protobuf_c_boolean is_done = 0;
+
+	assert(service);
+	assert(dummy);
+
+	dabba__dabba_service__memory_get(service, dummy, memory_print,
+					 &is_done);
+
+	dabba_rpc_call_is_done(&is_done);
+
+	return 0;
+}
+
+/**
+ * \brief Invoke memory modify remote procedure call
+ * \param[in]           service	        Pointer to protobuf service
+ * \param[in]           memory 	        Pointer to new memory budget settings
+ * \return always returns zero.
+ */
+
+static int rpc_memory_modify(ProtobufCService * service,
+			     const Dabba__Memory * memory)
+{
+	protobuf_c_boolean is_done = 0;
+
+	assert(service);
+	assert(memory);
+
+	dabba__dabba_service__memory_modify(service, memory,
+					    rpc_error_code_print, &is_done);
+
+	dabba_rpc_call_is_done(&is_done);
+
+	return 0;
+}
+
+/**
+ * \brief Parse argument vector to prepare a memory budget query
+ * \param[in]           argc	        Argument counter
+ * \param[in]           argv	        Argument vector
+ * \return 0 on success, \c EINVAL on invalid input.
+ */
+
+static int cmd_memory_get(int argc, const char **argv)
+{
+	enum memory_option {
+		OPT_TCP,
+		OPT_LOCAL,
+		OPT_HELP
+	};
+
+	int ret;
+	Dabba__Dummy dummy = DABBA__DUMMY__INIT;
+	const char *server_id = DABBA_RPC_DEFAULT_TCP_SERVER_NAME;
+	ProtobufC_RPC_AddressType server_type = PROTOBUF_C_RPC_ADDRESS_TCP;
+	ProtobufCService *service;
+
+	static struct option memory_option[] = {
+		{"tcp", optional_argument, NULL, OPT_TCP},
+		{"local", optional_argument, NULL, OPT_LOCAL},
+		{"help", no_argument, NULL, OPT_HELP},
+		{NULL, 0, NULL, 0},
+	};
+
+	/* HACK: getopt*() start to parse options at argv[1] */
+	argc++;
+	argv--;
+
+	/* parse memory options */
+	while ((ret =
+		getopt_long_only(argc, (char **)argv, "", memory_option,
+				 NULL)) != EOF) {
+		switch (ret) {
+		case OPT_TCP:
+			server_type = PROTOBUF_C_RPC_ADDRESS_TCP;
+			server_id = DABBA_RPC_DEFAULT_TCP_SERVER_NAME;
+
+			if (optarg)
+				server_id = optarg;
+			break;
+		case OPT_LOCAL:
+			server_type = PROTOBUF_C_RPC_ADDRESS_LOCAL;
+			server_id = DABBA_RPC_DEFAULT_LOCAL_SERVER_NAME;
+
+			if (optarg)
+				server_id = optarg;
+			break;
+		case OPT_HELP:
+		default:
+			show_usage(memory_option);
+			return -1;
+		}
+	}
+
+	service = dabba_rpc_client_connect(server_id, server_type);
+
+	/* Check error reporting */
+	return service ? rpc_memory_get(service, &dummy) : EINVAL;
+}
+
+/**
+ * \brief Parse argument vector to prepare a memory budget modification
+ * \param[in]           argc	        Argument counter
+ * \param[in]           argv	        Argument vector
+ * \return 0 on success, \c EINVAL on invalid input.
+ */
+
+static int cmd_memory_modify(int argc, const char **argv)
+{
+	enum memory_option {
+		OPT_MEMORY_BUDGET,
+		OPT_MEMORY_POLICY,
+		OPT_TCP,
+		OPT_LOCAL,
+		OPT_HELP
+	};
+
+	int ret;
+	Dabba__Memory memory = DABBA__MEMORY__INIT;
+	Dabba__ErrorCode err = DABBA__ERROR_CODE__INIT;
+	const char *server_id = DABBA_RPC_DEFAULT_TCP_SERVER_NAME;
+	ProtobufC_RPC_AddressType server_type = PROTOBUF_C_RPC_ADDRESS_TCP;
+	ProtobufCService *service;
+
+	static struct option memory_option[] = {
+		{"budget", required_argument, NULL, OPT_MEMORY_BUDGET},
+		{"policy", required_argument, NULL, OPT_MEMORY_POLICY},
+		{"tcp", optional_argument, NULL, OPT_TCP},
+		{"local", optional_argument, NULL, OPT_LOCAL},
+		{"help", no_argument, NULL, OPT_HELP},
+		{NULL, 0, NULL, 0},
+	};
+
+	/* HACK: getopt*() start to parse options at argv[1] */
+	argc++;
+	argv--;
+
+	memory.status = &err;
+
+	/* parse memory options */
+	while ((ret =
+		getopt_long_only(argc, (char **)argv, "", memory_option,
+				 NULL)) != EOF) {
+		switch (ret) {
+		case OPT_TCP:
+			server_type = PROTOBUF_C_RPC_ADDRESS_TCP;
+			server_id = DABBA_RPC_DEFAULT_TCP_SERVER_NAME;
+
+			if (optarg)
+				server_id = optarg;
+			break;
+		case OPT_LOCAL:
+			server_type = PROTOBUF_C_RPC_ADDRESS_LOCAL;
+			server_id = DABBA_RPC_DEFAULT_LOCAL_SERVER_NAME;
+
+			if (optarg)
+				server_id = optarg;
+			break;
+		case OPT_MEMORY_BUDGET:
+			memory.has_budget = 1;
+			memory.budget =
+			    strtoull(optarg, NULL, 10) * MEMORY_SIZE_UNIT;
+			break;
+		case OPT_MEMORY_POLICY:
+			if (strcmp(optarg, "reject") && strcmp(optarg, "shrink"))
+				return EINVAL;
+
+			memory.has_shrink = 1;
+			memory.shrink = !strcmp(optarg, "shrink");
+			break;
+		case OPT_HELP:
+		default:
+			show_usage(memory_option);
+			return -1;
+		}
+	}
+
+	service = dabba_rpc_client_connect(server_id, server_type);
+
+	/* Check error reporting */
+	return service ? rpc_memory_modify(service, &memory) : EINVAL;
+}
+
+/**
+ * \brief Parse which memory sub-command.
+ * \param[in]           argc	        Argument counter
+ * \param[in]           argv		Argument vector
+ * \return 0 on success, \c ENOSYS if the sub-command does not exist,
+ * else on failure.
+ *
+ * This function parses the memory sub-command string and the rest of the
+ * argument vector to the proper sub-command handler.
+ */
+
+int cmd_memory(int argc, const char **argv)
+{
+	static const struct cmd_struct cmd[] = {
+		{"get", cmd_memory_get},
+		{"modify", cmd_memory_modify},
+	};
+
+	return cmd_run_command(cmd, ARRAY_SIZE(cmd), argc, argv);
+}
@@ -62,6 +62,31 @@ Configure the packet mmap area to contain <number> of frames.
 This number must be a power of two. The default value is 32 frames.
 The lowest frame number value is 8.
 
+=item --numa-node <node>
+
+Allocate the packet mmap area on NUMA node <node> and only run the replay
+thread on the CPUs of this node. By default, the NUMA node of the interface
+is used on machines with several NUMA nodes. -1 disables the placement.
+
+=item --sched-policy <policy>
+
+Start the replay thread with scheduling policy <policy> (fifo, rr or other).
+
+=item --sched-prio <priority>
+
+Start the replay thread with scheduling priority <priority>. By default, the
+lowest priority of the scheduling policy is used.
+
+=item --cpu-affinity <cpu-list>
+
+Only run the replay thread on the CPUs of <cpu-list>, like 0-2,4. "auto" runs it
+next to the CPUs receiving the packets of the interface.
+
+=item --stack-prefault
+
+Touch the replay thread stack before its packet loop starts so that the first
+packets do not page fault.
+
 =item --id <thread-id>
 
 Reference a replay by its unique thread id.
@@ -142,6 +167,7 @@ Written by Emmanuel Roullit <emmanuel.roullit@gmail.com>
 
 #include <libdabba/macros.h>
 #include <libdabba/packet-mmap.h>
+#include <dabba/cli.h>
 #include <dabba/dabba.h>
 #include <dabba/help.h>
 #include <dabba/rpc.h>
@@ -291,6 +317,11 @@ static int cmd_replay_start(int argc, const char **argv)
 		OPT_REPLAY_FRAME_NUMBER,
 		OPT_REPLAY_FRAME_SIZE,
 		OPT_REPLAY_APPEND,
+		OPT_REPLAY_NUMA_NODE,
+		OPT_REPLAY_SCHED_POLICY,
+		OPT_REPLAY_SCHED_PRIORITY,
+		OPT_REPLAY_CPU_AFFINITY,
+		OPT_REPLAY_STACK_PREFAULT,
 		OPT_TCP,
 		OPT_LOCAL,
 		OPT_HELP
@@ -309,6 +340,15 @@ static int cmd_replay_start(int argc, const char **argv)
 		{"frame-number", required_argument, NULL,
 		 OPT_REPLAY_FRAME_NUMBER},
 		{"frame-size", required_argument, NULL, OPT_REPLAY_FRAME_SIZE},
+		{"numa-node", required_argument, NULL, OPT_REPLAY_NUMA_NODE},
+		{"sched-policy", required_argument, NULL,
+		 OPT_REPLAY_SCHED_POLICY},
+		{"sched-prio", required_argument, NULL,
+		 OPT_REPLAY_SCHED_PRIORITY},
+		{"cpu-affinity", required_argument, NULL,
+		 OPT_REPLAY_CPU_AFFINITY},
+		{"stack-prefault", no_argument, NULL,
+		 OPT_REPLAY_STACK_PREFAULT},
 		{"tcp", optional_argument, NULL, OPT_TCP},
 		{"local", optional_argument, NULL, OPT_LOCAL},
 		{"help", no_argument, NULL, OPT_HELP},
@@ -356,6 +396,24 @@ static int cmd_replay_start(int argc, const char **argv)
 		case OPT_REPLAY_FRAME_SIZE:
 			replay.frame_size = strtoull(optarg, NULL, 10);
 			break;
+		case OPT_REPLAY_NUMA_NODE:
+			replay.has_numa_node = 1;
+			replay.numa_node = strtol(optarg, NULL, 10);
+			break;
+		case OPT_REPLAY_SCHED_POLICY:
+			replay.has_sched_policy = 1;
+			replay.sched_policy = str2sched_policy(optarg);
+			break;
+		case OPT_REPLAY_SCHED_PRIORITY:
+			replay.has_sched_priority = 1;
+			replay.sched_priority = strtol(optarg, NULL, 10);
+			break;
+		case OPT_REPLAY_CPU_AFFINITY:
+			replay.cpu_set = optarg;
+			break;
+		case OPT_REPLAY_STACK_PREFAULT:
+			replay.has_stack_prefault = replay.stack_prefault = 1;
+			break;
 		case OPT_HELP:
 		default:
 			show_usage(replay_option);
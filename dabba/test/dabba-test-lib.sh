@@ -17,6 +17,15 @@ ETHTOOL_PATH="$(command -v ethtool)"
 taskset -h > /dev/null 2>&1 && test_set_prereq TASKSET
 "$ETHTOOL_PATH" -h > /dev/null 2>&1 && test_set_prereq ETHTOOL
 test -n "$TEST_DEV" && test_set_prereq TEST_DEV
+test -n "$TEST_LONG" && test_set_prereq EXPENSIVE
+
+ip link add dabbadummy type dummy > /dev/null 2>&1 &&
+ip link del dabbadummy > /dev/null 2>&1 &&
+test_set_prereq DUMMY
+
+ip link add dabbaveth0 type veth peer name dabbaveth1 > /dev/null 2>&1 &&
+ip link del dabbaveth0 > /dev/null 2>&1 &&
+test_set_prereq VETH
 
 mktemppid()
 {
@@ -82,4 +91,44 @@ ethtool_status_parse() {
     test "$status" = "on" && echo "True" || echo "False"
 }
 
+# This function prints the ip batch commands adding or deleting dummy interfaces
+# $1 'add' or 'del'
+# $2 interface name prefix, interfaces are numbered from 0
+# $3 number of interfaces
+dummy_batch()
+{
+    local cmd="$1"
+    local prefix="$2"
+    local nr="$3"
+
+    for i in `seq 0 $(($nr-1))`
+    do
+        if [ "$cmd" = "add" ]; then
+            echo "link add $prefix$i type dummy"
+        else
+            echo "link del $prefix$i"
+        fi
+    done
+}
+
+# This function waits for dabbad to apply the link notifications, until the
+# number of captures on interfaces starting with a prefix is the expected one
+# $1 interface name prefix
+# $2 expected number of captures
+wait_capture_nr()
+{
+    local prefix="$1"
+    local expected="$2"
+
+    for i in `seq 0 50`
+    do
+        dabba capture get > result &&
+        test "$(grep -c "interface: $prefix" result)" -eq "$expected" &&
+        return 0
+        sleep 0.1
+    done
+
+    return 1
+}
+
 # vim: ft=sh:tabstop=4:et
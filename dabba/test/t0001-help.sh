@@ -16,6 +16,7 @@ The most commonly used dabba commands are:
    thread      perform a thread related command
    capture     capture live traffic from an interface
    replay      replay traffic from a pcap file
+   memory      limit the memory of captures and replays
 
 See 'dabba help <command> [<subcommand>]' for more specific information.
 EOF
@@ -55,7 +55,7 @@ do
         test_might_fail '$ETHTOOL_PATH' --show-offload '$dev' > ethtool_output
     "
 
-    for feature in rx-csum tx-csum sg tso ufo gso gro rx-hash
+    for feature in rx-csum tx-csum sg tso ufo gso gro lro rx-hash
     do
         test_expect_success PYTHON_YAML "Check interface '$dev' $feature offload" "
             dictkeys2values interfaces $i offload '$feature' < parsed > 'output_$feature'
@@ -79,7 +79,7 @@ test_expect_success TEST_DEV,PYTHON_YAML "Parse interface offload YAML output" "
     yaml2dict result > parsed
 "
 
-for feature in rx-csum tx-csum sg tso ufo gso gro rx-hash
+for feature in rx-csum tx-csum sg tso ufo gso gro lro rx-hash
 do
     test_expect_success TEST_DEV,PYTHON_YAML "Check interface '$TEST_DEV' $feature feature" "
         dictkeys2values interfaces 0 offload '$feature' < parsed > 'output_$feature'
@@ -0,0 +1,98 @@
+#!/bin/sh
+#
+# Copyright (C) 2013	Emmanuel Roullit <emmanuel.roullit@gmail.com>
+#
+
+test_description='Test dabbad interface cache updates, statistics and lookup scaling'
+
+. ./dabba-test-lib.sh
+
+pidfile=$(mktemppid)
+dummy_nr=5000
+query_nr=200
+
+test_expect_success "Setup: Stop already running dabbad" "
+    test_might_fail killall dabbad
+"
+
+test_expect_success "Setup: Start dabbad" "
+    dabbad --daemonize --pidfile '$pidfile'
+"
+
+rx_packet_get()
+{
+    sed -n 's/.*rx: {byte: [0-9]*, packet: \([0-9]*\),.*/\1/p' "$1"
+}
+
+test_expect_success "Report fresh statistics of requested interfaces" "
+    dabba interface statistics get --id lo --id lo > before &&
+    test \$(grep -c -- '- name: lo' before) -eq 2 &&
+    ping -c 3 -i 0.2 localhost > /dev/null &&
+    dabba interface statistics get --id lo > after &&
+    test \$(rx_packet_get after) -gt \$(rx_packet_get before | head -n 1)
+"
+
+test_expect_success "Skip unknown interfaces in statistics requests" "
+    dabba interface statistics get --id lo --id dabbanosuchdev > result &&
+    grep -q -- '- name: lo' result &&
+    test_must_fail grep -q -- '- name: dabbanosuchdev' result
+"
+
+test_expect_success DUMMY "Report an interface created after dabbad started" "
+    ip link add dabbadummy type dummy &&
+    dabba interface status get --id dabbadummy > result &&
+    grep -q -- '- name: dabbadummy' result
+"
+
+test_expect_success DUMMY "Report a status change of the new interface" "
+    ip link set dabbadummy up &&
+    dabba interface status get --id dabbadummy > result &&
+    grep -q 'up: true' result
+"
+
+test_expect_success DUMMY "Forget a deleted interface" "
+    ip link del dabbadummy &&
+    dabba interface status get --id dabbadummy > result &&
+    test_must_fail grep -q -- '- name: dabbadummy' result
+"
+
+test_expect_success DUMMY,EXPENSIVE "Setup: Create $dummy_nr dummy interfaces" "
+    dummy_batch add dabbadummy $dummy_nr | ip -batch -
+"
+
+test_expect_success DUMMY,EXPENSIVE "Benchmark $query_nr status queries among $dummy_nr interfaces" "
+    start=\$(date +%s%N) &&
+    for i in \$(seq 1 $query_nr)
+    do
+        dabba interface status get --id dabbadummy\$((\$i % $dummy_nr)) > /dev/null || return 1
+    done &&
+    end=\$(date +%s%N) &&
+    echo \"status get: \$(((\$end - \$start) / $query_nr / 1000)) us per query\"
+"
+
+test_expect_success DUMMY,EXPENSIVE "Benchmark $query_nr statistics queries among $dummy_nr interfaces" "
+    start=\$(date +%s%N) &&
+    for i in \$(seq 1 $query_nr)
+    do
+        dabba interface statistics get --id dabbadummy\$((\$i % $dummy_nr)) > /dev/null || return 1
+    done &&
+    end=\$(date +%s%N) &&
+    echo \"statistics get: \$(((\$end - \$start) / $query_nr / 1000)) us per query\"
+"
+
+test_expect_success DUMMY,EXPENSIVE "Check the last created dummy interface is reported" "
+    dabba interface status get --id dabbadummy$(($dummy_nr-1)) > result &&
+    grep -q -- '- name: dabbadummy$(($dummy_nr-1))' result
+"
+
+test_expect_success DUMMY,EXPENSIVE "Cleanup: Delete the dummy interfaces" "
+    dummy_batch del dabbadummy $dummy_nr | ip -batch -
+"
+
+test_expect_success "Cleanup: Stop dabbad" "
+    kill $(cat "$pidfile")
+"
+
+test_done
+
+# vim: ft=sh:tabstop=4:et
@@ -0,0 +1,108 @@
+#!/bin/sh
+#
+# Copyright (C) 2013	Emmanuel Roullit <emmanuel.roullit@gmail.com>
+#
+
+test_description='Test dabba interface queries filtering, paging and scaling'
+
+. ./dabba-test-lib.sh
+
+pidfile=$(mktemppid)
+page_nr=20
+scale_nr=10000
+# Response time budget of a query over all the scale interfaces, in ms
+scale_budget=5000
+
+name_count()
+{
+    grep -c -- "- name: $1" "$2"
+}
+
+elapsed_ms()
+{
+    local start=$(date +%s%N)
+
+    "$@" > result || return 1
+    echo $((($(date +%s%N) - $start) / 1000000))
+}
+
+test_expect_success "Setup: Stop already running dabbad" "
+    test_might_fail killall dabbad
+"
+
+test_expect_success "Setup: Start dabbad" "
+    dabbad --daemonize --pidfile '$pidfile'
+"
+
+test_expect_success DUMMY "Setup: Create $page_nr dummy interfaces" "
+    dummy_batch add dabbapage $page_nr | ip -batch -
+"
+
+test_expect_success DUMMY "Select interfaces by name prefix" "
+    dabba interface status get --prefix dabbapage > result &&
+    test \$(name_count dabbapage result) -eq $page_nr &&
+    test_must_fail grep -q -- '- name: lo$' result
+"
+
+test_expect_success DUMMY "Apply the name prefix to requested interfaces" "
+    dabba interface driver get --prefix dabbapage --id lo --id dabbapage3 > result &&
+    grep -q -- '- name: dabbapage3$' result &&
+    test_must_fail grep -q -- '- name: lo$' result
+"
+
+test_expect_success DUMMY "Page through the selected interfaces" "
+    rm -f pages &&
+    for offset in 0 8 16 24
+    do
+        dabba interface settings get --prefix dabbapage --offset \$offset --limit 8 > result &&
+        grep -- '- name: dabbapage' result >> pages || return 1
+    done &&
+    test \$(wc -l < pages) -eq $page_nr &&
+    test \$(sort -u pages | wc -l) -eq $page_nr
+"
+
+test_expect_success DUMMY "Page through requested interfaces statistics" "
+    dabba interface statistics get --id lo --id dabbapage1 --id dabbapage2 --offset 1 --limit 1 > result &&
+    test \$(grep -c -- '- name: ' result) -eq 1 &&
+    grep -q -- '- name: dabbapage1$' result
+"
+
+test_expect_success DUMMY "Report nothing past the last page" "
+    dabba interface pause get --prefix dabbapage --offset $page_nr > result &&
+    test_must_fail grep -q -- '- name: ' result
+"
+
+test_expect_success DUMMY "Cleanup: Delete the paging dummy interfaces" "
+    dummy_batch del dabbapage $page_nr | ip -batch -
+"
+
+test_expect_success DUMMY,EXPENSIVE "Setup: Create $scale_nr dummy interfaces" "
+    dummy_batch add dabbascale $scale_nr | ip -batch -
+"
+
+for cmd in status settings offload statistics
+do
+    test_expect_success DUMMY,EXPENSIVE "Query the $cmd of $scale_nr interfaces within ${scale_budget}ms" "
+        ms=\$(elapsed_ms dabba interface $cmd get --prefix dabbascale) &&
+        echo \"$cmd get: \$ms ms\" &&
+        test \$(name_count dabbascale result) -eq $scale_nr &&
+        test \$ms -le $scale_budget
+    "
+done
+
+test_expect_success DUMMY,EXPENSIVE "Query a page among $scale_nr interfaces" "
+    dabba interface status get --prefix dabbascale --offset $(($scale_nr-1000)) --limit 1000 > result &&
+    test \$(name_count dabbascale result) -eq 1000
+"
+
+test_expect_success DUMMY,EXPENSIVE "Cleanup: Delete the scale dummy interfaces" "
+    dummy_batch del dabbascale $scale_nr | ip -batch -
+"
+
+test_expect_success "Cleanup: Stop dabbad" "
+    kill $(cat "$pidfile")
+"
+
+test_done
+
+# vim: ft=sh:tabstop=4:et
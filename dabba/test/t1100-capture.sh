@@ -133,10 +133,68 @@ do
         "
 done
 
+test_expect_success PYTHON_YAML "Only fetch the requested capture" "
+    dictkeys2values captures 4 id < parsed > expect_id &&
+    dabba capture get --id \$(cat expect_id) > result &&
+    yaml2dict result > parsed &&
+    check_capture_thread_nr 1 result &&
+    dictkeys2values captures 0 id < parsed > result_id &&
+    dictkeys2values captures 0 pcap < parsed > result_pcap &&
+    echo '$SHARNESS_TRASH_DIRECTORY/test4.pcap' > expect_pcap &&
+    test_cmp expect_id result_id &&
+    test_cmp expect_pcap result_pcap
+"
+
+test_expect_success PYTHON_YAML "Report the packets read by a capture" "
+    ping -c 3 -i 0.2 localhost > /dev/null &&
+    dabba capture get --id \$(cat expect_id) > result &&
+    yaml2dict result > parsed &&
+    dictkeys2values captures 0 packets < parsed > result_packets &&
+    test \$(cat result_packets) -gt 0
+"
+
+test_expect_success PYTHON_YAML "Report the ring residency of the read packets" "
+    dictkeys2values captures 0 'ring residency' samples < parsed > result_samples &&
+    dictkeys2values captures 0 'ring residency' p50 < parsed > result_p50 &&
+    dictkeys2values captures 0 'ring residency' max < parsed > result_max &&
+    test \$(cat result_samples) -gt 0 &&
+    test \$(cat result_p50) -le \$(cat result_max)
+"
+
+test_expect_success "Skip unknown capture ids" "
+    dabba capture get --id 1 > result &&
+    test_must_fail grep -q 'id:' result
+"
+
 test_expect_success "Stop all running captures" "
     dabba capture stop-all
 "
 
+test_expect_success "Start a capture sized by memory budget" "
+    dabba capture start --interface any --pcap budget.pcap --ring-size 4 --frame-size 1600 &&
+    dabba capture get > result
+"
+
+test_expect_success PYTHON_YAML "Check the packet mmap geometry computed from the budget" "
+    yaml2dict result > parsed &&
+    echo 4194304 > expect_packet_mmap_size &&
+    echo 8192 > expect_block_size &&
+    echo 512 > expect_block_number &&
+    echo 2560 > expect_frame_number &&
+    dictkeys2values captures 0 'packet mmap size' < parsed > result_packet_mmap_size &&
+    dictkeys2values captures 0 'block size' < parsed > result_block_size &&
+    dictkeys2values captures 0 'block number' < parsed > result_block_number &&
+    dictkeys2values captures 0 'frame number' < parsed > result_frame_number &&
+    test_cmp expect_packet_mmap_size result_packet_mmap_size &&
+    test_cmp expect_block_size result_block_size &&
+    test_cmp expect_block_number result_block_number &&
+    test_cmp expect_frame_number result_frame_number
+"
+
+test_expect_success "Stop the budget capture" "
+    dabba capture stop-all
+"
+
 test_expect_success "Start a new capture with an localhost ICMP-only filter" "
     dabba capture start --interface any --pcap result.pcap \
     --sock-filter '$SHARNESS_TEST_DIRECTORY/t1100/localhost-icmp.bpf'
@@ -188,6 +246,206 @@ test_expect_success "Expecting 80 packets to be captured" "
     test $(pktcnt result.pcap) = 80
 "
 
+test_expect_success "Stop the appending capture" "
+    dabba capture stop-all
+"
+
+test_expect_success "Start an in-memory buffer capture without pcap file" "
+    dabba capture start --interface any --buffer-size 4 --buffer-duration 60 \
+    --sock-filter '$SHARNESS_TEST_DIRECTORY/t1100/localhost-icmp.bpf' &&
+    dabba capture get > result
+"
+
+test_expect_success PYTHON_YAML "Query buffer capture YAML output" "
+    yaml2dict result > parsed &&
+    echo '$((4 * 1024 * 1024))' > expect_buffer_size &&
+    echo '60' > expect_buffer_duration &&
+    dictkeys2values captures 0 id < parsed > result_id &&
+    dictkeys2values captures 0 'buffer size' < parsed > result_buffer_size &&
+    dictkeys2values captures 0 'buffer duration' < parsed > result_buffer_duration
+"
+
+test_expect_success PYTHON_YAML "Check buffer capture settings" "
+    test_cmp expect_buffer_size result_buffer_size &&
+    test_cmp expect_buffer_duration result_buffer_duration
+"
+
+test_expect_success "Generate some traffic to buffer" "
+    ping -c 10 -i 0.2 -s 1500 localhost
+"
+
+test_expect_success PYTHON_YAML "Dump the in-memory buffer to a pcap file" "
+    dabba capture dump --id \$(cat result_id) --pcap dump.pcap
+"
+
+test_expect_success PYTHON_YAML "Expecting 40 packets in the dumped buffer" "
+    test \$(pktcnt dump.pcap) = 40
+"
+
+test_expect_success PYTHON_YAML "Dump fails on a capture without in-memory buffer" "
+    dabba capture start --interface any --pcap nobuffer.pcap &&
+    dabba capture get > result &&
+    yaml2dict result > parsed &&
+    dictkeys2values captures 1 id < parsed > nobuffer_id &&
+    dabba capture dump --id \$(cat nobuffer_id) --pcap nobuffer-dump.pcap > result_dump &&
+    grep -q 'rc: 22' result_dump
+"
+
+test_expect_success "Stop buffer captures" "
+    dabba capture stop-all
+"
+
+test_expect_success "Start a triggered capture which never triggers" "
+    dabba capture start --interface any --pcap untriggered.pcap --buffer-size 4 \
+    --sock-filter '$SHARNESS_TEST_DIRECTORY/t1100/localhost-icmp.bpf' \
+    --trigger '$SHARNESS_TEST_DIRECTORY/t1100/reject-all.bpf'
+"
+
+test_expect_success "Check trigger socket filter output against input file" "
+    awk -F',|{|}' '{\$1=\"\";print}' '$SHARNESS_TEST_DIRECTORY/t1100/reject-all.bpf' | \
+    xargs printf '- { code: %#x, jt: %#x, jf: %#x, k: %#x }\n' > expect_trigger_out &&
+    dabba capture get | sed -n '/trigger filter/,\$p' | grep -Eo '\- \{ code:[[:print:]]+$' > result_trigger_out &&
+    test_cmp expect_trigger_out result_trigger_out
+"
+
+test_expect_success "Generate some traffic which does not trigger" "
+    ping -c 10 -i 0.2 -s 1500 localhost
+"
+
+test_expect_success "Expecting no packets to be written without trigger" "
+    dabba capture stop-all &&
+    test \$(pktcnt untriggered.pcap) = 0
+"
+
+test_expect_success "Start a capture triggered by localhost ICMP packets" "
+    dabba capture start --interface any --pcap triggered.pcap --buffer-size 4 \
+    --buffer-duration 60 --trigger-window 60 \
+    --trigger '$SHARNESS_TEST_DIRECTORY/t1100/localhost-icmp.bpf'
+"
+
+test_expect_success "Generate some traffic which triggers" "
+    ping -c 10 -i 0.2 -s 1500 localhost
+"
+
+test_expect_success "Expecting the 40 ICMP packets to be written after trigger" "
+    dabba capture stop-all &&
+    test \$(pktcnt triggered.pcap) -ge 40
+"
+
+test_expect_success "Start a truncated capture triggered by localhost ICMP packets" "
+    dabba capture start --interface any --pcap triggered-short.pcap \
+    --buffer-size 4 --buffer-duration 60 --trigger-window 60 --snaplen 14 \
+    --trigger '$SHARNESS_TEST_DIRECTORY/t1100/localhost-icmp.bpf'
+"
+
+test_expect_success "Generate some traffic which triggers past the snaplen" "
+    ping -c 10 -i 0.2 -s 1500 localhost
+"
+
+test_expect_success "Expecting the trigger to match beyond the snaplen" "
+    dabba capture stop-all &&
+    test \$(pktcnt triggered-short.pcap) -ge 40
+"
+
+test_expect_success "Start a capture to modify at runtime" "
+    dabba capture start --interface any --pcap modify.pcap \
+    --sock-filter '$SHARNESS_TEST_DIRECTORY/t1100/localhost-icmp.bpf' &&
+    dabba capture get > result
+"
+
+test_expect_success PYTHON_YAML "Modify capture snaplen and sampling" "
+    yaml2dict result > parsed &&
+    dictkeys2values captures 0 id < parsed > result_id &&
+    dabba capture modify --id \$(cat result_id) --snaplen 64 --sampling 2 &&
+    dabba capture get > result &&
+    yaml2dict result > parsed &&
+    echo 64 > expect_snaplen &&
+    echo 2 > expect_sampling &&
+    dictkeys2values captures 0 snaplen < parsed > result_snaplen &&
+    dictkeys2values captures 0 sampling < parsed > result_sampling &&
+    test_cmp expect_snaplen result_snaplen &&
+    test_cmp expect_sampling result_sampling
+"
+
+test_expect_success PYTHON_YAML "Refuse snaplen and sampling over 32 bits" "
+    dabba capture modify --id \$(cat result_id) --snaplen 4294967296 > result &&
+    grep -q 'rc: 22' result &&
+    dabba capture modify --id \$(cat result_id) --sampling 4294967296 > result &&
+    grep -q 'rc: 22' result &&
+    dabba capture start --interface any --pcap wide.pcap --sampling 4294967296 > result &&
+    grep -q 'rc: 22' result &&
+    dabba capture get > result &&
+    yaml2dict result > parsed &&
+    dictkeys2values captures 0 snaplen < parsed > result_snaplen &&
+    dictkeys2values captures 0 sampling < parsed > result_sampling &&
+    test_cmp expect_snaplen result_snaplen &&
+    test_cmp expect_sampling result_sampling
+"
+
+test_expect_success PYTHON_YAML "Expecting one sampled packet out of two" "
+    ping -c 10 -i 0.2 -s 1500 localhost &&
+    test \$(pktcnt modify.pcap) = 20
+"
+
+test_expect_success PYTHON_YAML "Replace the socket filter of a running capture" "
+    dabba capture modify --id \$(cat result_id) \
+    --sock-filter '$SHARNESS_TEST_DIRECTORY/t1100/reject-all.bpf' &&
+    awk -F',|{|}' '{\$1=\"\";print}' '$SHARNESS_TEST_DIRECTORY/t1100/reject-all.bpf' | \
+    xargs printf '- { code: %#x, jt: %#x, jf: %#x, k: %#x }\n' > expect_sf_out &&
+    dabba capture get | grep -Eo '\- \{ code:[[:print:]]+$' > result_sf_out &&
+    test_cmp expect_sf_out result_sf_out
+"
+
+test_expect_success PYTHON_YAML "Expecting no more packets after filter replacement" "
+    ping -c 10 -i 0.2 -s 1500 localhost &&
+    test \$(pktcnt modify.pcap) = 20
+"
+
+test_expect_success "Start a capture to resize at runtime" "
+    dabba capture stop-all &&
+    dabba capture start --interface any --pcap resize.pcap --frame-number 8 \
+    --sock-filter '$SHARNESS_TEST_DIRECTORY/t1100/localhost-icmp.bpf' &&
+    dabba capture get > result
+"
+
+test_expect_success PYTHON_YAML "Grow the ring of a running capture" "
+    yaml2dict result > parsed &&
+    dictkeys2values captures 0 id < parsed > result_id &&
+    dabba capture resize --id \$(cat result_id) --frame-number 512 &&
+    dabba capture get > result &&
+    yaml2dict result > parsed &&
+    dictkeys2values captures 0 id < parsed > resized_id &&
+    dictkeys2values captures 0 'frame number' < parsed > result_frame_nr &&
+    test_cmp result_id resized_id &&
+    test \$(cat result_frame_nr) -ge 512
+"
+
+test_expect_success PYTHON_YAML "Expecting no packet lost nor written twice across ring resizes" "
+    ping -c 20 -i 0.2 -s 1500 localhost > /dev/null &
+    sleep 1 &&
+    dabba capture resize --id \$(cat result_id) --frame-number 64 > result_resize &&
+    grep -q 'rc: 0' result_resize &&
+    wait &&
+    test \$(pktcnt resize.pcap) -eq 80
+"
+
+test_expect_success PYTHON_YAML "Enable automatic ring growth" "
+    dabba capture resize --id \$(cat result_id) --grow-threshold 75 --ring-size-max 16 &&
+    dabba capture get > result &&
+    yaml2dict result > parsed &&
+    echo 75 > expect_grow_threshold &&
+    echo $((16 * 1024 * 1024)) > expect_ring_size_max &&
+    dictkeys2values captures 0 'grow threshold' < parsed > result_grow_threshold &&
+    dictkeys2values captures 0 'ring size max' < parsed > result_ring_size_max &&
+    test_cmp expect_grow_threshold result_grow_threshold &&
+    test_cmp expect_ring_size_max result_ring_size_max
+"
+
+test_expect_success PYTHON_YAML "Automatic ring growth needs a maximum ring size" "
+    dabba capture resize --id \$(cat result_id) --grow-threshold 75 > result_resize &&
+    grep -q 'rc: 22' result_resize
+"
+
 test_expect_success "Stop all running captures thread" "
     dabba capture stop-all &&
     dabba capture get > result
@@ -0,0 +1,79 @@
+#!/bin/sh
+#
+# Copyright (C) 2013	Emmanuel Roullit <emmanuel.roullit@gmail.com>
+#
+
+test_description='Test dabba capture start and stop of many captures at once'
+
+. ./dabba-test-lib.sh
+
+pidfile=$(mktemppid)
+batch_nr=8
+frame_nr=8
+
+test_expect_success "Setup: Stop already running dabbad" "
+    test_might_fail killall dabbad
+"
+
+test_expect_success "Setup: Start dabbad" "
+    dabbad --daemonize --pidfile '$pidfile'
+"
+
+test_expect_success "Start captures on several interfaces at once" "
+    dabba capture start --interface lo --interface any --pcap 'batch-%i.pcap' --frame-number $frame_nr > result &&
+    test \$(grep -c -- '- id: [0-9]' result) -eq 2 &&
+    test \$(grep -c 'rc: 0' result) -eq 2 &&
+    test -f batch-lo.pcap &&
+    test -f batch-any.pcap
+"
+
+test_expect_success "Stop several captures at once" "
+    grep -- '- id: [0-9]' result | sed 's/.*id: //' > ids &&
+    dabba capture stop \$(sed 's/^/--id /' ids) > result &&
+    test \$(grep -c 'rc: 0' result) -eq 2 &&
+    dabba capture get > after &&
+    test_must_fail grep -wq -f ids after
+"
+
+test_expect_success "Report the failure of a capture within a batch" "
+    dabba capture start --interface lo --interface lorem-ipsum --pcap 'fail-%i.pcap' --frame-number $frame_nr > result &&
+    test \$(grep -c 'rc: 0' result) -eq 1 &&
+    test \$(grep -c -- '- id: ~' result) -eq 1 &&
+    dabba capture stop-all
+"
+
+test_expect_success "Refuse to share a pcap file between several captures" "
+    test_expect_code 22 dabba capture start --interface lo --interface any --pcap shared.pcap --frame-number $frame_nr
+"
+
+test_expect_success DUMMY "Setup: Create $batch_nr dummy interfaces" "
+    dummy_batch add dabbabatch $batch_nr | ip -batch -
+"
+
+test_expect_success DUMMY "Start a capture on each interface matching a glob" "
+    dabba capture start --interface 'dabbabatch*' --pcap 'glob-%i.pcap' --frame-number $frame_nr > result &&
+    test \$(grep -c 'rc: 0' result) -eq $batch_nr &&
+    test \$(grep -c 'interface: dabbabatch' result) -eq $batch_nr &&
+    test \$(ls glob-dabbabatch*.pcap | wc -l) -eq $batch_nr
+"
+
+test_expect_success DUMMY "Stop the captures matching a glob" "
+    dabba capture stop \$(grep -- '- id: [0-9]' result | sed 's/.*id: /--id /') > result &&
+    test \$(grep -c 'rc: 0' result) -eq $batch_nr
+"
+
+test_expect_success "Refuse a glob matching no interface" "
+    test_expect_code 19 dabba capture start --interface 'lorem-ipsum*' --pcap 'none-%i.pcap'
+"
+
+test_expect_success DUMMY "Cleanup: Delete the dummy interfaces" "
+    dummy_batch del dabbabatch $batch_nr | ip -batch -
+"
+
+test_expect_success "Cleanup: Stop dabbad" "
+    kill $(cat "$pidfile")
+"
+
+test_done
+
+# vim: ft=sh:tabstop=4:et
@@ -0,0 +1,97 @@
+#!/bin/sh
+#
+# Copyright (C) 2013	Emmanuel Roullit <emmanuel.roullit@gmail.com>
+#
+
+test_description='Test dabba capture policies on appearing interfaces'
+
+. ./dabba-test-lib.sh
+
+pidfile=$(mktemppid)
+frame_nr=8
+
+# Print the CPU time in nanoseconds of the capture thread on an interface
+capture_cpu_time()
+{
+    local id=$(dabba capture get | awk '/- id:/ { id = $3 } $0 ~ "interface: '$1'$" { print id }')
+
+    test -n "$id" &&
+    dabba thread get settings | awk '/- id:/ { id = $3 } id == "'$id'" && /cpu time:/ { print $3 }'
+}
+
+test_expect_success "Setup: Stop already running dabbad" "
+    test_might_fail killall dabbad
+"
+
+test_expect_success "Setup: Start dabbad" "
+    dabbad --daemonize --pidfile '$pidfile'
+"
+
+test_expect_success "Refuse a policy sharing one pcap file between captures" "
+    dabba capture start --policy shared --interface 'dabbapol*' --pcap shared.pcap --frame-number $frame_nr > result &&
+    grep -q 'rc: 22' result
+"
+
+test_expect_success VETH "Add a capture policy" "
+    dabba capture start --policy dabbapol --interface 'dabbapol*' --pcap 'pol-%i.pcap' --frame-number $frame_nr > result &&
+    grep -q 'rc: 0' result &&
+    dabba capture policy-get > result &&
+    grep -q -- '- name: dabbapol$' result
+"
+
+test_expect_success VETH "Refuse a second policy with the same name" "
+    dabba capture start --policy dabbapol --interface 'dabbapol*' --pcap 'pol-%i.pcap' --frame-number $frame_nr > result &&
+    grep -q 'rc: 17' result
+"
+
+test_expect_success VETH "Start captures on appearing interfaces" "
+    ip link add dabbapol0 type veth peer name dabbapol1 &&
+    wait_capture_nr dabbapol 2 &&
+    test -f pol-dabbapol0.pcap &&
+    test -f pol-dabbapol1.pcap &&
+    dabba capture policy-get > result &&
+    grep -q 'capture number: 2' result
+"
+
+# The veth interfaces are down, their rings have a pending ENETDOWN error
+test_expect_success VETH "Keep captures on down interfaces idle" "
+    before=\$(capture_cpu_time dabbapol0) &&
+    sleep 1 &&
+    after=\$(capture_cpu_time dabbapol0) &&
+    test -n \"\$before\" && test -n \"\$after\" &&
+    test \$((after - before)) -lt 200000000
+"
+
+test_expect_success VETH "Stop captures on disappearing interfaces" "
+    ip link del dabbapol0 &&
+    wait_capture_nr dabbapol 0
+"
+
+test_expect_success VETH "Remove the capture policy" "
+    ip link add dabbapol2 type veth peer name dabbapol3 &&
+    wait_capture_nr dabbapol 2 &&
+    dabba capture policy-remove --policy dabbapol > result &&
+    grep -q 'rc: 0' result &&
+    wait_capture_nr dabbapol 0 &&
+    dabba capture policy-get > result &&
+    test_must_fail grep -q -- '- name: dabbapol' result
+"
+
+test_expect_success VETH "Leave new interfaces alone without policy" "
+    ip link add dabbapol4 type veth peer name dabbapol5 &&
+    sleep 0.5 &&
+    wait_capture_nr dabbapol 0
+"
+
+test_expect_success VETH "Cleanup: Delete the veth interfaces" "
+    ip link del dabbapol2 &&
+    ip link del dabbapol4
+"
+
+test_expect_success "Cleanup: Stop dabbad" "
+    kill $(cat "$pidfile")
+"
+
+test_done
+
+# vim: ft=sh:tabstop=4:et
@@ -0,0 +1,104 @@
+#!/bin/sh
+#
+# Copyright (C) 2013	Emmanuel Roullit <emmanuel.roullit@gmail.com>
+#
+
+test_description='Test dabba capture start on pre-mapped packet mmap areas'
+
+. ./dabba-test-lib.sh
+
+pidfile=$(mktemppid)
+pool_nr=2
+frame_nr=64
+
+# Wait for dabbad to refill the pool in the background
+wait_pool_ready()
+{
+    local expected=$1
+
+    for i in `seq 0 50`
+    do
+        dabba capture pool-get > result &&
+        grep -q "ready: $expected$" result &&
+        return 0
+        sleep 0.1
+    done
+
+    return 1
+}
+
+test_expect_success "Setup: Stop already running dabbad" "
+    test_might_fail killall dabbad
+"
+
+test_expect_success "Setup: Start dabbad" "
+    dabbad --daemonize --pidfile '$pidfile'
+"
+
+test_expect_success "The capture pool is empty by default" "
+    dabba capture pool-get > result &&
+    grep -q 'size: 0$' result &&
+    grep -q 'ready: 0$' result
+"
+
+test_expect_success "Refuse an invalid capture pool" "
+    dabba capture pool-modify --size 65 > result &&
+    grep -q 'rc: 22' result &&
+    dabba capture pool-modify --size $pool_nr --frame-size 1500 > result &&
+    grep -q 'rc: 22' result
+"
+
+test_expect_success "Fill the capture pool" "
+    dabba capture pool-modify --size $pool_nr --frame-number $frame_nr > result &&
+    grep -q 'rc: 0' result &&
+    wait_pool_ready $pool_nr &&
+    grep -q 'frame number: $frame_nr$' result
+"
+
+test_expect_success "Start a capture on a ready packet mmap area" "
+    dabba capture start --interface lo --pcap pool.pcap --frame-number $frame_nr &&
+    dabba capture pool-get > result &&
+    grep -q 'hit: 1$' result &&
+    grep -q 'miss: 0$' result &&
+    dabba capture get > result &&
+    grep -q 'interface: lo' result
+"
+
+test_expect_success "Capture traffic on a ready packet mmap area" "
+    ping -c 4 -i 0.2 localhost > /dev/null &&
+    dabba capture stop-all &&
+    test \$(stat -c %s pool.pcap) -gt 24
+"
+
+test_expect_success "Refill the capture pool in the background" "
+    wait_pool_ready $pool_nr
+"
+
+test_expect_success "Create the packet mmap area of other geometries" "
+    dabba capture start --interface lo --pcap miss.pcap --frame-number $(($frame_nr * 4)) &&
+    dabba capture pool-get > result &&
+    grep -q 'hit: 1$' result &&
+    grep -q 'miss: 1$' result &&
+    dabba capture stop-all
+"
+
+test_expect_success "Replace the ready packet mmap areas of another geometry" "
+    dabba capture pool-modify --frame-number $(($frame_nr * 2)) > result &&
+    grep -q 'rc: 0' result &&
+    wait_pool_ready $pool_nr &&
+    grep -q 'frame number: $(($frame_nr * 2))$' result
+"
+
+test_expect_success "Empty the capture pool" "
+    dabba capture pool-modify --size 0 > result &&
+    grep -q 'rc: 0' result &&
+    wait_pool_ready 0
+"
+
+test_expect_success "Cleanup: Stop dabbad" "
+    kill $(cat "$pidfile")
+"
+
+test_done
+
+# vim: ft=sh:tabstop=4:et
@@ -87,7 +87,8 @@ do
         dictkeys2values threads $i type < parsed > result_type &&
         dictkeys2values threads $i 'scheduling policy' < parsed > result_scheduling_policy &&
         dictkeys2values threads $i 'scheduling priority' < parsed > result_scheduling_priority &&
-        dictkeys2values threads $i 'cpu affinity' < parsed > result_cpu_affinity
+        dictkeys2values threads $i 'cpu affinity' < parsed > result_cpu_affinity &&
+        dictkeys2values threads $i 'numa node' < parsed > result_numa_node
     "
 
     test_expect_success PYTHON_YAML "Check thread number" "
@@ -113,6 +114,25 @@ do
     test_expect_success TASKSET,PYTHON_YAML "Check thread default CPU affinity" "
         test_cmp expect_cpu_affinity result_cpu_affinity
     "
+
+    # Loopback and the 'any' pseudo-interface are not attached to a NUMA node
+    test_expect_success PYTHON_YAML "Check thread is not placed on a NUMA node" "
+        echo '-1' > expect_numa_node &&
+        test_cmp expect_numa_node result_numa_node
+    "
+
+    test_expect_success PYTHON_YAML "Check thread kernel id and CPU usage" "
+        dictkeys2values threads $i tid < parsed > result_tid &&
+        dictkeys2values threads $i cpu < parsed > result_cpu &&
+        dictkeys2values threads $i 'cpu time' < parsed > result_cpu_time &&
+        dictkeys2values threads $i 'voluntary switches' < parsed > result_voluntary_switches &&
+        dictkeys2values threads $i 'involuntary switches' < parsed > result_involuntary_switches &&
+        test -d /proc/\$(cat '$pidfile')/task/\$(cat result_tid) &&
+        grep -wq -E '^[0-9]+' result_cpu &&
+        grep -wq -E '^[0-9]+' result_cpu_time &&
+        grep -wq -E '^[0-9]+' result_voluntary_switches &&
+        grep -wq -E '^[0-9]+' result_involuntary_switches
+    "
 done
 
 for policy in fifo rr other
@@ -195,6 +215,43 @@ do
         "
 done
 
+test_expect_success "Automatic CPU affinity fails on the 'any' pseudo-interface" "
+    dabba thread modify --cpu-affinity auto --id '$(cat result_id.0)' > result_auto &&
+    grep -q 'rc: 22' result_auto
+"
+
+rr_min_prio=$(get_default_sched_prio_min rr)
+
+test_expect_success "Start a capture with its scheduling and CPU affinity" "
+    dabba capture start --interface lo --pcap test2.pcap --frame-number 8 --sched-policy rr --sched-prio '$rr_min_prio' --cpu-affinity 0 --stack-prefault &&
+    dabba thread get settings > result
+"
+
+test_expect_success PYTHON_YAML "Parse thread YAML output" "
+    yaml2dict result > parsed
+"
+
+test_expect_success PYTHON_YAML "Query thread YAML output" "
+    echo 'rr' > expect_scheduling_policy &&
+    echo '$rr_min_prio' > expect_scheduling_priority &&
+    echo '0' > expect_cpu_affinity &&
+    dictkeys2values threads 2 'scheduling policy' < parsed > result_scheduling_policy &&
+    dictkeys2values threads 2 'scheduling priority' < parsed > result_scheduling_priority &&
+    dictkeys2values threads 2 'cpu affinity' < parsed > result_cpu_affinity
+"
+
+test_expect_success PYTHON_YAML "Check started capture thread scheduling policy" "
+    test_cmp expect_scheduling_policy result_scheduling_policy
+"
+
+test_expect_success PYTHON_YAML "Check started capture thread scheduling priority" "
+    test_cmp expect_scheduling_priority result_scheduling_priority
+"
+
+test_expect_success TASKSET,PYTHON_YAML "Check started capture thread CPU affinity" "
+    test_cmp expect_cpu_affinity result_cpu_affinity
+"
+
 test_expect_success "Stop all running captures" "
     dabba capture stop-all &&
     dabba thread get settings > after
@@ -0,0 +1,84 @@
+#!/bin/sh
+#
+# Copyright (C) 2013	Emmanuel Roullit <emmanuel.roullit@gmail.com>
+#
+
+test_description='Test dabbad RPC latency while captures are being started'
+
+. ./dabba-test-lib.sh
+
+pidfile=$(mktemppid)
+capture_nr=4
+query_nr=50
+ring_size=256
+
+# Print the average and highest latency in microseconds of repeated queries
+query_latency()
+{
+    local total=0 max=0 start end lat
+
+    for i in $(seq 1 $query_nr)
+    do
+        start=$(date +%s%N)
+        dabba capture get > /dev/null || return 1
+        end=$(date +%s%N)
+        lat=$((($end - $start) / 1000))
+        total=$(($total + $lat))
+        test $lat -gt $max && max=$lat
+    done
+
+    echo "average: $(($total / $query_nr)) us, max: $max us"
+}
+
+test_expect_success "Setup: Stop already running dabbad" "
+    test_might_fail killall dabbad
+"
+
+test_expect_success "Setup: Start dabbad" "
+    dabbad --daemonize --pidfile '$pidfile'
+"
+
+test_expect_success "Start concurrent captures" "
+    for i in \$(seq 1 $capture_nr)
+    do
+        dabba capture start --interface any --pcap test\$i.pcap > start\$i &
+    done &&
+    wait &&
+    dabba capture get > result &&
+    test \$(grep -c 'id: ' result) -eq $capture_nr
+"
+
+test_expect_success "Reject invalid captures without waiting for a worker" "
+    dabba capture start --interface any --frame-number 32 > result &&
+    grep -q 'rc: 22' result
+"
+
+test_expect_success "Stop concurrent captures" "
+    dabba capture stop-all &&
+    dabba capture get > result &&
+    test_must_fail grep -q 'id: ' result
+"
+
+test_expect_success EXPENSIVE "Benchmark query latency without capture start" "
+    query_latency > idle_latency &&
+    echo \"idle: \$(cat idle_latency)\"
+"
+
+test_expect_success EXPENSIVE "Benchmark query latency while $capture_nr captures of $ring_size MiB start" "
+    for i in \$(seq 1 $capture_nr)
+    do
+        dabba capture start --interface any --pcap big\$i.pcap --ring-size $ring_size > /dev/null &
+    done &&
+    query_latency > busy_latency &&
+    wait &&
+    echo \"busy: \$(cat busy_latency)\" &&
+    dabba capture stop-all
+"
+
+test_expect_success "Cleanup: Stop dabbad" "
+    kill $(cat "$pidfile")
+"
+
+test_done
+
+# vim: ft=sh:tabstop=4:et
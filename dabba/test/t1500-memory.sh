@@ -0,0 +1,105 @@
+#!/bin/sh
+#
+# Copyright (C) 2013	Emmanuel Roullit <emmanuel.roullit@gmail.com>
+#
+
+test_description='Test dabbad memory budget of captures and replays'
+
+. ./dabba-test-lib.sh
+
+pidfile=$(mktemppid)
+budget=1
+budget_bytes=$(($budget * 1024 * 1024))
+ring_size=4
+
+memory_value()
+{
+    sed -n "s/^ *$1: \([0-9]*\)$/\1/p" result
+}
+
+test_expect_success "Setup: Stop already running dabbad" "
+    test_might_fail killall dabbad
+"
+
+test_expect_success "Setup: Start dabbad" "
+    dabbad --daemonize --pidfile '$pidfile'
+"
+
+test_expect_success "Report a default budget and no memory in use" "
+    dabba memory get > result &&
+    test \$(memory_value budget) -gt 0 &&
+    grep -q 'policy: reject$' result &&
+    test \$(memory_value ring) -eq 0 &&
+    test \$(memory_value buffer) -eq 0 &&
+    test \$(memory_value replay) -eq 0
+"
+
+test_expect_success "Account the capture rings and buffers" "
+    dabba capture start --interface lo --pcap memory.pcap --buffer-size 1 &&
+    dabba capture get > capture &&
+    dabba memory get > result &&
+    test \$(memory_value ring) -eq \$(sed -n 's/^ *packet mmap size: //p' capture) &&
+    test \$(memory_value buffer) -eq 1048576
+"
+
+test_expect_success "Release the memory of stopped captures" "
+    dabba capture stop-all &&
+    dabba memory get > result &&
+    test \$(memory_value ring) -eq 0 &&
+    test \$(memory_value buffer) -eq 0
+"
+
+test_expect_success "Refuse an invalid budget policy" "
+    test_expect_code 22 dabba memory modify --policy lorem-ipsum
+"
+
+test_expect_success "Set a ${budget}MiB budget" "
+    dabba memory modify --budget $budget > result &&
+    grep -q 'rc: 0' result &&
+    dabba memory get > result &&
+    test \$(memory_value budget) -eq $budget_bytes
+"
+
+test_expect_success "Reject a capture ring larger than the budget" "
+    dabba capture start --interface lo --pcap memory.pcap --ring-size $ring_size > result &&
+    grep -q 'rc: 105' result
+"
+
+test_expect_success "Reject a capture buffer larger than the budget" "
+    dabba capture start --interface lo --pcap memory.pcap --buffer-size $ring_size > result &&
+    grep -q 'rc: 105' result
+"
+
+test_expect_success "Shrink a capture ring larger than the budget" "
+    dabba memory modify --policy shrink > result &&
+    grep -q 'rc: 0' result &&
+    dabba capture start --interface lo --pcap memory.pcap --ring-size $ring_size &&
+    dabba capture get > capture &&
+    size=\$(sed -n 's/^ *packet mmap size: //p' capture) &&
+    test \$size -gt 0 &&
+    test \$size -le $budget_bytes &&
+    dabba memory get > result &&
+    grep -q 'policy: shrink$' result &&
+    test \$(memory_value ring) -eq \$size
+"
+
+test_expect_success "Reject a resize beyond the budget" "
+    dabba capture resize --id \$(sed -n 's/^ *- id: //p' capture) --ring-size $ring_size > result &&
+    grep -q 'rc: 105' result &&
+    dabba capture stop-all
+"
+
+test_expect_success "Remove the budget" "
+    dabba memory modify --budget 0 --policy reject > result &&
+    grep -q 'rc: 0' result &&
+    dabba capture start --interface lo --pcap memory.pcap --ring-size $ring_size &&
+    dabba capture stop-all
+"
+
+test_expect_success "Cleanup: Stop dabbad" "
+    kill $(cat "$pidfile")
+"
+
+test_done
+
+# vim: ft=sh:tabstop=4:et
@@ -29,6 +29,13 @@ It also lists information about currently running threads.
 
 Fetch and print information about currently running threads.
 The output is formatted in YAML.
+Besides its settings, each thread reports its kernel thread id, the CPU
+it last ran on, its CPU time in nanoseconds and how many times it gave up
+its CPU (voluntary switches) or was preempted (involuntary switches).
+When the kernel keeps scheduler statistics, the time the thread waited
+for a CPU is reported in nanoseconds as well.
+Threads often preempted or waiting for a CPU may not drain their ring in
+time and drop packets.
 
 =item modify
 
@@ -78,6 +85,10 @@ Configure a numerical list of processors on which a specific thread
 is allowed to be scheduled on.
 CPU numbers can be separated by commas and may include ranges.
 For instance: 0,5,7,9-11.
+The special value "auto" runs the thread on the CPUs handling the receive
+queue interrupts of its interface, or on their SMT siblings. The CPUs
+used by receive packet steering are used when the interface has no
+dedicated interrupt.
 
 =item --id <thread-id>
 
@@ -210,6 +221,21 @@ static void thread_print(const Dabba__ThreadList * result, void *closure_data)
 		printf("      scheduling priority: %i\n",
 		       thread->sched_priority);
 		printf("      cpu affinity: %s\n", thread->cpu_set);
+		printf("      numa node: %i\n", thread->numa_node);
+
+		if (thread->has_tid) {
+			printf("      tid: %" PRIu64 "\n", thread->tid);
+			printf("      cpu: %i\n", thread->cpu);
+			printf("      cpu time: %" PRIu64 "\n", thread->cpu_time);
+			printf("      voluntary switches: %" PRIu64 "\n",
+			       thread->voluntary_switches);
+			printf("      involuntary switches: %" PRIu64 "\n",
+			       thread->involuntary_switches);
+		}
+
+		if (thread->has_wait_time)
+			printf("      wait time: %" PRIu64 "\n",
+			       thread->wait_time);
 		/* TODO map priority/policy protobuf enums to string */
 	}
 
@@ -0,0 +1,169 @@
+/**
+ * \file arena.c
+ * \author written by Emmanuel Roullit emmanuel.roullit@gmail.com (c) 2013
+ * \date 2013
+ */
+
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+
+#include <dabbad/arena.h>
+
+/**
+ * \internal
+ * \brief Alignment of the arena allocations
+ */
+
+#define ARENA_ALIGN 16
+
+/**
+ * \internal
+ * \brief Block of memory the arena allocations are carved from
+ */
+
+struct arena_chunk {
+	struct arena_chunk *next; /**< previously filled chunk */
+	size_t size;		/**< usable size of the chunk */
+	size_t used;		/**< amount of bytes already allocated */
+	uint8_t data[] __attribute__ ((aligned(ARENA_ALIGN))); /**< memory */
+};
+
+/**
+ * \internal
+ * \brief Add a new chunk to an arena
+ * \param[in,out]       arena	        Arena to grow
+ * \param[in]           size	        Minimum usable size of the chunk
+ * \return Pointer to the new chunk, \c NULL if memory could not be allocated
+ * \note Chunk sizes double up to \c ARENA_CHUNK_SIZE_MAX so that long
+ *       replies only need a few chunks.
+ */
+
+static struct arena_chunk *dabbad_arena_grow(struct arena *arena,
+					     const size_t size)
+{
+	struct arena_chunk *chunk;
+	size_t csize = ARENA_CHUNK_SIZE;
+
+	if (arena->chunk && arena->chunk->size < ARENA_CHUNK_SIZE_MAX)
+		csize = arena->chunk->size * 2;
+	else if (arena->chunk)
+		csize = ARENA_CHUNK_SIZE_MAX;
+
+	if (csize < size)
+		csize = size;
+
+	if (csize > SIZE_MAX - sizeof(*chunk))
+		return NULL;
+
+	chunk = malloc(sizeof(*chunk) + csize);
+
+	if (!chunk)
+		return NULL;
+
+	chunk->size = csize;
+	chunk->used = 0;
+	chunk->next = arena->chunk;
+	arena->chunk = chunk;
+
+	return chunk;
+}
+
+/**
+ * \brief Allocate zeroed memory from an arena
+ * \param[in,out]       arena	        Arena to allocate from
+ * \param[in]           size	        Amount of bytes to allocate
+ * \return Pointer to the allocated memory, \c NULL on failure
+ * \note The memory is only freed by \c dabbad_arena_release().
+ */
+
+void *dabbad_arena_alloc(struct arena *arena, const size_t size)
+{
+	struct arena_chunk *chunk;
+	size_t asize;
+	void *mem;
+
+	assert(arena);
+
+	if (size > SIZE_MAX - ARENA_ALIGN)
+		return NULL;
+
+	/* Zero sized allocations still get their own address */
+	asize = size ? (size + ARENA_ALIGN - 1) & ~(size_t) (ARENA_ALIGN - 1)
+	    : ARENA_ALIGN;
+	chunk = arena->chunk;
+
+	if (!chunk || chunk->size - chunk->used < asize)
+		chunk = dabbad_arena_grow(arena, asize);
+
+	if (!chunk)
+		return NULL;
+
+	mem = &chunk->data[chunk->used];
+	chunk->used += asize;
+
+	return memset(mem, 0, size);
+}
+
+/**
+ * \brief Allocate a zeroed array from an arena
+ * \param[in,out]       arena	        Arena to allocate from
+ * \param[in]           nmemb	        Amount of array elements
+ * \param[in]           size	        Size of an array element
+ * \return Pointer to the allocated array, \c NULL on failure
+ */
+
+void *dabbad_arena_array(struct arena *arena, const size_t nmemb,
+			 const size_t size)
+{
+	if (size && nmemb > SIZE_MAX / size)
+		return NULL;
+
+	return dabbad_arena_alloc(arena, nmemb * size);
+}
+
+/**
+ * \brief Duplicate a string into an arena
+ * \param[in,out]       arena	        Arena to allocate from
+ * \param[in]           str	        String to duplicate
+ * \param[in]           len	        Maximum amount of characters to copy
+ * \return Pointer to the null-terminated copy, \c NULL on failure
+ */
+
+char *dabbad_arena_strndup(struct arena *arena, const char *const str,
+			   const size_t len)
+{
+	char *dup;
+	size_t slen;
+
+	assert(str);
+
+	slen = strnlen(str, len);
+	dup = dabbad_arena_alloc(arena, slen + 1);
+
+	if (dup)
+		memcpy(dup, str, slen);
+
+	return dup;
+}
+
+/**
+ * \brief Free all the memory allocated from an arena
+ * \param[in,out]       arena	        Arena to release
+ * \note The arena is empty afterwards and can be reused.
+ */
+
+void dabbad_arena_release(struct arena *arena)
+{
+	struct arena_chunk *chunk;
+
+	assert(arena);
+
+	while (arena->chunk) {
+		chunk = arena->chunk;
+		arena->chunk = chunk->next;
+		free(chunk);
+	}
+}
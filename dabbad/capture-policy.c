@@ -0,0 +1,536 @@
+/**
+ * \file capture-policy.c
+ * \author written by Emmanuel Roullit emmanuel.roullit@gmail.com (c) 2013
+ * \date 2013
+ */
+
+
+/* HACK prevent libnl3 include clash between <net/if.h> and <linux/if.h> */
+#ifndef _LINUX_IF_H
+#define _LINUX_IF_H
+#endif				/* _LINUX_IF_H */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include <fnmatch.h>
+#include <syslog.h>
+#include <sys/queue.h>
+#include <netlink/cache.h>
+#include <netlink/route/link.h>
+
+#include <libdabba/macros.h>
+#include <dabbad/arena.h>
+#include <dabbad/interface.h>
+#include <dabbad/capture.h>
+#include <dabbad/capture-policy.h>
+#include <dabbad/worker.h>
+
+/**
+ * \internal
+ * \brief Capture policies in the order they were added
+ */
+
+static TAILQ_HEAD(capture_policy_head, capture_policy) capture_policy_head =
+TAILQ_HEAD_INITIALIZER(capture_policy_head);
+
+/**
+ * \internal
+ * \brief Get a capture policy from its name
+ * \param[in] name	policy name
+ * \return Pointer to the policy, \c NULL if none has this name
+ */
+
+static struct capture_policy *capture_policy_find(const char *const name)
+{
+	struct capture_policy *policy;
+
+	assert(name);
+
+	TAILQ_FOREACH(policy, &capture_policy_head, entry) {
+		if (!strcmp(policy->name, name))
+			return policy;
+	}
+
+	return NULL;
+}
+
+/**
+ * \internal
+ * \brief Get the capture a policy started on an interface
+ * \param[in] policy	capture policy
+ * \param[in] ifindex	interface index
+ * \return Pointer to the capture, \c NULL if none runs on the interface
+ */
+
+static struct packet_capture *capture_policy_capture(const struct
+						     capture_policy *policy,
+						     const int ifindex)
+{
+	struct packet_capture *pkt_capture;
+
+	for (pkt_capture = dabbad_capture_next(NULL); pkt_capture;
+	     pkt_capture = dabbad_capture_next(pkt_capture))
+		if (pkt_capture->policy == policy
+		    && pkt_capture->thread.ifindex == ifindex)
+			return pkt_capture;
+
+	return NULL;
+}
+
+/**
+ * \internal
+ * \brief Build the pcap file path of a capture started by a policy
+ * \param[in] pcap	pcap file path template
+ * \param[in] dev	interface the capture runs on
+ * \return Newly allocated path where each "%i" is replaced by the interface
+ * name, \c NULL if memory could not be allocated
+ */
+
+static char *capture_policy_pcap_path(const char *const pcap,
+				      const char *const dev)
+{
+	const char *p;
+	char *path, *out;
+	size_t len = strlen(pcap) + 1;
+
+	for (p = strstr(pcap, "%i"); p; p = strstr(p + 2, "%i"))
+		len += strlen(dev);
+
+	path = out = malloc(len);
+
+	if (!path)
+		return NULL;
+
+	for (p = pcap; *p; p++) {
+		if (p[0] == '%' && p[1] == 'i') {
+			out = stpcpy(out, dev);
+			p++;
+		} else
+			*out++ = *p;
+	}
+
+	*out = '\0';
+
+	return path;
+}
+
+/**
+ * \internal
+ * \brief Start the capture of a policy on an interface
+ * \param[in] policy	capture policy
+ * \param[in] dev	name of the interface to capture
+ *
+ * The capture is set up from the RPC dispatcher as soon as the interface
+ * appears so that its first packets are already captured. Failures are only
+ * logged, the interface may already be gone.
+ */
+
+static void capture_policy_capture_start(const struct capture_policy *policy,
+					 const char *const dev)
+{
+	Dabba__Capture capture = *policy->capturep;
+	struct packet_capture *pkt_capture;
+	char *pcap = NULL;
+	int rc = ENOMEM;
+
+	capture.interface = (char *)dev;
+
+	if (capture.pcap && strlen(capture.pcap)) {
+		pcap = capture_policy_pcap_path(capture.pcap, dev);
+
+		if (!pcap)
+			goto out;
+
+		capture.pcap = pcap;
+	}
+
+	rc = dabbad_capture_create(&capture, &pkt_capture);
+
+	if (!rc)
+		pkt_capture->policy = policy;
+
+ out:
+	if (rc)
+		syslog(LOG_ERR, "capture policy %s: capture on %s failed: %s",
+		       policy->name, dev, strerror(rc));
+	else
+		syslog(LOG_INFO, "capture policy %s: capture on %s started",
+		       policy->name, dev);
+
+	free(pcap);
+}
+
+/**
+ * \internal
+ * \brief Start or stop the capture of a policy on an interface
+ * \param[in] policy	capture policy
+ * \param[in] link	interface which changed
+ * \param[in] present	non-zero if the interface exists, 0 if it is gone
+ *
+ * A capture runs on each existing interface whose name matches the glob of
+ * the policy.
+ */
+
+static void capture_policy_link_apply(const struct capture_policy *policy,
+				      struct rtnl_link *link, const int present)
+{
+	struct packet_capture *pkt_capture;
+	const char *dev = rtnl_link_get_name(link);
+	int match;
+
+	match = present && dev
+	    && !fnmatch(policy->capturep->interface, dev, 0);
+	pkt_capture =
+	    capture_policy_capture(policy, rtnl_link_get_ifindex(link));
+
+	if (match && !pkt_capture)
+		capture_policy_capture_start(policy, dev);
+	else if (!match && pkt_capture)
+		dabbad_capture_destroy(pkt_capture);
+}
+
+/**
+ * \internal
+ * \brief Apply one or all capture policies to an existing interface
+ * \param[in] obj	existing interface
+ * \param[in] arg	capture policy to apply, \c NULL to apply all policies
+ */
+
+static void capture_policy_link_new(struct nl_object *obj, void *arg)
+{
+	struct capture_policy *policy = arg;
+
+	if (policy) {
+		capture_policy_link_apply(policy, (struct rtnl_link *)obj, 1);
+		return;
+	}
+
+	TAILQ_FOREACH(policy, &capture_policy_head, entry) {
+		capture_policy_link_apply(policy, (struct rtnl_link *)obj, 1);
+	}
+}
+
+/**
+ * \internal
+ * \brief Apply the capture policies to the whole interface cache
+ * \param[in] cache	interface cache dumped again
+ *
+ * The captures of the interfaces removed meanwhile are stopped, then the
+ * captures of the new interfaces are started.
+ */
+
+static void capture_policy_sync(struct nl_cache *cache)
+{
+	struct packet_capture *pkt_capture, *next;
+	struct rtnl_link *link;
+
+	for (pkt_capture = dabbad_capture_next(NULL); pkt_capture;
+	     pkt_capture = next) {
+		next = dabbad_capture_next(pkt_capture);
+
+		if (!pkt_capture->policy)
+			continue;
+
+		link = rtnl_link_get(cache, pkt_capture->thread.ifindex);
+
+		if (link)
+			capture_policy_link_apply(pkt_capture->policy, link, 1);
+		else
+			dabbad_capture_destroy(pkt_capture);
+
+		rtnl_link_put(link);
+	}
+
+	nl_cache_foreach(cache, capture_policy_link_new, NULL);
+}
+
+/**
+ * \internal
+ * \brief Apply the capture policies to a notified interface change
+ * \param[in] cache	managed interface cache
+ * \param[in] obj	interface which changed, \c NULL if the cache was
+ *			dumped again
+ * \param[in] action	change type, like \c NL_ACT_NEW
+ * \param[in] arg	unused argument
+ * \note Renamed interfaces are notified as changed, their capture stops
+ * when their new name does not match anymore.
+ */
+
+static void capture_policy_link_change(struct nl_cache *cache,
+				       struct nl_object *obj, int action,
+				       void *arg)
+{
+	struct capture_policy *policy;
+
+	(void)arg;
+
+	if (!obj) {
+		capture_policy_sync(cache);
+		return;
+	}
+
+	TAILQ_FOREACH(policy, &capture_policy_head, entry) {
+		capture_policy_link_apply(policy, (struct rtnl_link *)obj,
+					  action != NL_ACT_DEL);
+	}
+}
+
+/**
+ * \internal
+ * \brief Stop the captures of a policy and free it
+ * \param[in,out] policy	capture policy to remove
+ * \return 0 on success, else the return value of the first failed
+ * \c dabbad_capture_destroy(), the policy is kept in that case
+ */
+
+static int capture_policy_destroy(struct capture_policy *policy)
+{
+	struct packet_capture *pkt_capture, *next;
+	int rc;
+
+	assert(policy);
+
+	for (pkt_capture = dabbad_capture_next(NULL); pkt_capture;
+	     pkt_capture = next) {
+		next = dabbad_capture_next(pkt_capture);
+
+		if (pkt_capture->policy != policy)
+			continue;
+
+		rc = dabbad_capture_destroy(pkt_capture);
+
+		if (rc)
+			return rc;
+	}
+
+	TAILQ_REMOVE(&capture_policy_head, policy, entry);
+	protobuf_c_message_free_unpacked(&policy->capturep->base, NULL);
+	free(policy->name);
+	free(policy);
+
+	if (TAILQ_EMPTY(&capture_policy_head))
+		link_cache_mngr_notify(NULL, NULL);
+
+	return 0;
+}
+
+/**
+ * \brief Remove all capture policies and stop their captures
+ * \note Captures started by a request keep running.
+ */
+
+void dabbad_capture_policy_shutdown(void)
+{
+	while (!TAILQ_EMPTY(&capture_policy_head))
+		if (capture_policy_destroy(TAILQ_FIRST(&capture_policy_head)))
+			break;
+
+	link_cache_mngr_notify(NULL, NULL);
+}
+
+/**
+ * \internal
+ * \brief Capture policy message validator
+ * \param[in] policyp	capture policy message to check
+ * \return 0 if the message is invalid, 1 if it is valid.
+ *
+ * A valid capture policy message must fulfill these requirements:
+ *      - Policy name length longer than zero
+ *      - Valid capture settings, with an interface glob as interface name
+ *      - A PCAP file name containing "%i", unless the captures only keep
+ *        packets in an in-memory buffer
+ */
+
+static int capture_policy_is_valid(const Dabba__CapturePolicy * policyp)
+{
+	assert(policyp);
+
+	if (!policyp->name || strlen(policyp->name) == 0 || !policyp->capture)
+		return 0;
+
+	if (!dabbad_capture_settings_are_valid(policyp->capture))
+		return 0;
+
+	if (policyp->capture->pcap && strlen(policyp->capture->pcap)
+	    && !strstr(policyp->capture->pcap, "%i"))
+		return 0;
+
+	return 1;
+}
+
+/**
+ * \brief RPC to add a capture policy
+ * \param[in]           service	        Pointer to protobuf service structure
+ * \param[in]           policyp         Pointer to the capture policy to add
+ * \param[in]           closure         Pointer to protobuf closure function pointer
+ * \param[in]           closure_data	Pointer to protobuf closure data
+ * \return Returns 0 on success, \c EEXIST if a policy has the same name,
+ * \c ENOTSUP if interface changes are not tracked, else on failure via its
+ * closure function.
+ *
+ * A capture is started right away on each existing interface whose name
+ * matches the interface glob of the policy. Afterwards, the link
+ * notifications start a capture on each matching interface which appears
+ * and stop it when the interface disappears.
+ * The "%i" of the pcap file path are replaced by the interface name.
+ */
+
+void dabbad_capture_policy_add(Dabba__DabbaService_Service * service,
+			       const Dabba__CapturePolicy * policyp,
+			       Dabba__ErrorCode_Closure closure,
+			       void *closure_data)
+{
+	Dabba__ErrorCode err = DABBA__ERROR_CODE__INIT;
+	struct capture_policy *policy = NULL;
+	struct nl_sock *sock = NULL;
+	struct nl_cache *cache = NULL;
+	int rc = EINVAL;
+
+	assert(service);
+	assert(policyp);
+
+	if (!capture_policy_is_valid(policyp))
+		goto out;
+
+	rc = EEXIST;
+
+	if (capture_policy_find(policyp->name))
+		goto out;
+
+	rc = ENOTSUP;
+	cache = link_cache_alloc(&sock);
+
+	if (!link_cache_is_managed(cache))
+		goto out;
+
+	rc = ENOMEM;
+	policy = calloc(1, sizeof(*policy));
+
+	if (!policy)
+		goto out;
+
+	policy->name = strdup(policyp->name);
+	policy->capturep =
+	    (Dabba__Capture *) dabbad_worker_msg_dup(&policyp->capture->base);
+
+	if (!policy->name || !policy->capturep) {
+		if (policy->capturep)
+			protobuf_c_message_free_unpacked(&policy->capturep->
+							 base, NULL);
+		free(policy->name);
+		free(policy);
+		goto out;
+	}
+
+	TAILQ_INSERT_TAIL(&capture_policy_head, policy, entry);
+	link_cache_mngr_notify(capture_policy_link_change, NULL);
+	nl_cache_foreach(cache, capture_policy_link_new, policy);
+	rc = 0;
+
+ out:
+	link_cache_destroy(sock, cache);
+	err.code = rc;
+	closure(&err, closure_data);
+}
+
+/**
+ * \brief RPC to remove a capture policy
+ * \param[in]           service	        Pointer to protobuf service structure
+ * \param[in]           policyp         Pointer to the capture policy to remove
+ * \param[in]           closure         Pointer to protobuf closure function pointer
+ * \param[in]           closure_data	Pointer to protobuf closure data
+ * \return Returns 0 on success, else on failure via its closure function.
+ * \note Only the policy name is used, the captures of the policy are
+ * stopped.
+ */
+
+void dabbad_capture_policy_remove(Dabba__DabbaService_Service * service,
+				  const Dabba__CapturePolicy * policyp,
+				  Dabba__ErrorCode_Closure closure,
+				  void *closure_data)
+{
+	Dabba__ErrorCode err = DABBA__ERROR_CODE__INIT;
+	struct capture_policy *policy;
+
+	assert(service);
+	assert(policyp);
+
+	policy = capture_policy_find(policyp->name);
+	err.code = policy ? capture_policy_destroy(policy) : EINVAL;
+
+	closure(&err, closure_data);
+}
+
+/**
+ * \brief RPC to list the capture policies
+ * \param[in]           service	        Pointer to protobuf service structure
+ * \param[in]           dummyp          Pointer to unused dummy rpc message
+ * \param[in]           closure         Pointer to protobuf closure function pointer
+ * \param[in,out]       closure_data	Pointer to protobuf closure data
+ * \return Returns the capture policies and how many captures each one runs
+ * via its closure function.
+ */
+
+void dabbad_capture_policy_get(Dabba__DabbaService_Service * service,
+			       const Dabba__Dummy * dummyp,
+			       Dabba__CapturePolicyList_Closure closure,
+			       void *closure_data)
+{
+	Dabba__CapturePolicyList policy_list =
+	    DABBA__CAPTURE_POLICY_LIST__INIT;
+	Dabba__CapturePolicy *policyp;
+	struct arena arena = ARENA_INIT;
+	struct capture_policy *policy;
+	struct packet_capture *pkt_capture;
+	size_t a = 0;
+
+	assert(service);
+	assert(dummyp);
+
+	TAILQ_FOREACH(policy, &capture_policy_head, entry) {
+		a++;
+	}
+
+	if (!a)
+		goto out;
+
+	policy_list.list =
+	    dabbad_arena_array(&arena, a, sizeof(*policy_list.list));
+
+	if (!policy_list.list)
+		goto out;
+
+	TAILQ_FOREACH(policy, &capture_policy_head, entry) {
+		policyp = dabbad_arena_alloc(&arena, sizeof(*policyp));
+
+		if (!policyp)
+			break;
+
+		dabba__capture_policy__init(policyp);
+		policyp->status = dabbad_arena_alloc(&arena,
+						     sizeof(*policyp->status));
+
+		if (!policyp->status)
+			break;
+
+		dabba__error_code__init(policyp->status);
+
+		/* The policy settings are not duplicated */
+		policyp->name = policy->name;
+		policyp->capture = policy->capturep;
+		policyp->has_capture_nr = 1;
+
+		for (pkt_capture = dabbad_capture_next(NULL); pkt_capture;
+		     pkt_capture = dabbad_capture_next(pkt_capture))
+			if (pkt_capture->policy == policy)
+				policyp->capture_nr++;
+
+		policy_list.list[policy_list.n_list++] = policyp;
+	}
+
+ out:
+	closure(&policy_list, closure_data);
+	dabbad_arena_release(&arena);
+}
@@ -0,0 +1,365 @@
+/**
+ * \file capture-pool.c
+ * \author written by Emmanuel Roullit emmanuel.roullit@gmail.com (c) 2013
+ * \date 2013
+ */
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <assert.h>
+#include <syslog.h>
+#include <pthread.h>
+#include <sys/socket.h>
+
+#include <libdabba/macros.h>
+#include <libdabba/packet-mmap.h>
+#include <dabbad/capture.h>
+#include <dabbad/capture-pool.h>
+#include <dabbad/memory.h>
+#include <dabbad/worker.h>
+
+/**
+ * \internal
+ * \brief Capture rings mapped ahead of time, waiting for a capture to bind
+ * them
+ * \note Captures are set up by workers, the pool is shared under its lock.
+ */
+
+static struct capture_pool {
+	pthread_mutex_t lock;	/**< protects the whole pool */
+	size_t size;		/**< amount of rings to keep ready */
+	size_t frame_size;	/**< frame size of the pooled rings */
+	size_t frame_nr;	/**< frame number asked for the pooled rings */
+	struct tpacket_req layout; /**< layout of the pooled rings */
+	struct packet_mmap ring[CAPTURE_POOL_SIZE_MAX]; /**< ready rings */
+	size_t nr;		/**< amount of ready rings */
+	uint64_t hit;		/**< captures started on a ready ring */
+	uint64_t miss;		/**< captures which had to create their ring */
+	int refilling;		/**< non-zero while a refill job is queued */
+} capture_pool = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.frame_size = PACKET_MMAP_ETH_FRAME_LEN,
+	.frame_nr = CAPTURE_POOL_DEFAULT_FRAME_NR
+};
+
+/**
+ * \internal
+ * \brief Create an unbound capture ring
+ * \param[out] pkt_mmap	ring to create
+ * \param[in] layout	ring layout
+ * \return 0 on success, \c ENOBUFS if the ring does not fit in the memory
+ * budget, else on failure
+ * \note Without protocol, the socket receives no packet until it is bound.
+ */
+
+static int capture_pool_ring_create(struct packet_mmap *pkt_mmap,
+				    const struct tpacket_req *const layout)
+{
+	int sock, rc;
+
+	rc = dabbad_memory_reserve(MEMORY_RING,
+				   packet_mmap_layout_size(layout));
+
+	if (rc)
+		return rc;
+
+	sock = socket(PF_PACKET, SOCK_RAW, 0);
+
+	if (sock < 0) {
+		rc = errno;
+		goto out;
+	}
+
+	rc = ldab_packet_mmap_prepare(pkt_mmap, sock, PACKET_MMAP_RX, layout);
+
+	if (rc)
+		close(sock);
+
+ out:
+	if (rc)
+		dabbad_memory_release(MEMORY_RING,
+				      packet_mmap_layout_size(layout));
+
+	return rc;
+}
+
+/**
+ * \internal
+ * \brief Destroy a pooled capture ring and close its socket
+ * \param[in,out] pkt_mmap	ring to destroy
+ */
+
+static void capture_pool_ring_destroy(struct packet_mmap *pkt_mmap)
+{
+	int sock;
+
+	assert(pkt_mmap);
+
+	sock = pkt_mmap->pf_sock;
+	dabbad_memory_release(MEMORY_RING,
+			      packet_mmap_layout_size(&pkt_mmap->layout));
+	ldab_packet_mmap_destroy(pkt_mmap);
+	close(sock);
+}
+
+/**
+ * \internal
+ * \brief Create rings until the pool is full
+ * \param[in] job	refill job
+ * \note The pool can be reconfigured while a ring is created, rings which do
+ * not fit anymore are thrown away.
+ */
+
+static void capture_pool_refill_run(struct worker_job *job)
+{
+	struct packet_mmap pkt_mmap;
+	struct tpacket_req layout;
+	int rc = 0;
+
+	(void)job;
+
+	pthread_mutex_lock(&capture_pool.lock);
+
+	while (capture_pool.nr < capture_pool.size) {
+		layout = capture_pool.layout;
+		pthread_mutex_unlock(&capture_pool.lock);
+
+		rc = capture_pool_ring_create(&pkt_mmap, &layout);
+
+		pthread_mutex_lock(&capture_pool.lock);
+
+		if (rc)
+			break;
+
+		if (capture_pool.nr < capture_pool.size
+		    && !memcmp(&layout, &capture_pool.layout, sizeof(layout))) {
+			capture_pool.ring[capture_pool.nr++] = pkt_mmap;
+			continue;
+		}
+
+		pthread_mutex_unlock(&capture_pool.lock);
+		capture_pool_ring_destroy(&pkt_mmap);
+		pthread_mutex_lock(&capture_pool.lock);
+	}
+
+	capture_pool.refilling = 0;
+	pthread_mutex_unlock(&capture_pool.lock);
+
+	if (rc)
+		syslog(LOG_WARNING, "capture pool refill stopped: %s",
+		       strerror(rc));
+}
+
+/**
+ * \internal
+ * \brief Release a completed refill job
+ * \param[in] job	refill job
+ */
+
+static void capture_pool_refill_done(struct worker_job *job)
+{
+	free(job);
+}
+
+/**
+ * \internal
+ * \brief Refill the pool in the background unless it is full or being
+ * refilled
+ */
+
+static void capture_pool_refill(void)
+{
+	struct worker_job *job;
+
+	pthread_mutex_lock(&capture_pool.lock);
+
+	if (capture_pool.refilling || capture_pool.nr >= capture_pool.size) {
+		pthread_mutex_unlock(&capture_pool.lock);
+		return;
+	}
+
+	job = calloc(1, sizeof(*job));
+
+	if (job)
+		capture_pool.refilling = 1;
+
+	pthread_mutex_unlock(&capture_pool.lock);
+
+	if (!job)
+		return;
+
+	job->run = capture_pool_refill_run;
+	job->done = capture_pool_refill_done;
+	dabbad_worker_run(job);
+}
+
+/**
+ * \brief Take a ready ring fitting a capture from the pool
+ * \param[in]           capturep	capture settings
+ * \param[out]          pkt_mmap	unbound ring to bind with
+ *					\c ldab_packet_mmap_attach()
+ * \return 0 on success, \c ENOENT if no ready ring has the requested layout,
+ * \c EINVAL on invalid ring settings
+ * \note Taking a ring, or missing one, refills the pool in the background.
+ * The caller owns the ring socket.
+ */
+
+int dabbad_capture_pool_take(const Dabba__Capture * capturep,
+			     struct packet_mmap *pkt_mmap)
+{
+	struct tpacket_req layout;
+	int rc = ENOENT;
+
+	assert(capturep);
+	assert(pkt_mmap);
+
+	if (dabbad_capture_layout_get(capturep, &layout))
+		return EINVAL;
+
+	pthread_mutex_lock(&capture_pool.lock);
+
+	if (!capture_pool.size) {
+		pthread_mutex_unlock(&capture_pool.lock);
+		return ENOENT;
+	}
+
+	if (capture_pool.nr
+	    && !memcmp(&layout, &capture_pool.layout, sizeof(layout))) {
+		*pkt_mmap = capture_pool.ring[--capture_pool.nr];
+		capture_pool.hit++;
+		rc = 0;
+	} else
+		capture_pool.miss++;
+
+	pthread_mutex_unlock(&capture_pool.lock);
+
+	capture_pool_refill();
+
+	return rc;
+}
+
+/**
+ * \brief Destroy all the ready rings
+ * \note The worker threads must be stopped beforehand.
+ */
+
+void dabbad_capture_pool_shutdown(void)
+{
+	pthread_mutex_lock(&capture_pool.lock);
+
+	capture_pool.size = 0;
+
+	while (capture_pool.nr) {
+		capture_pool.nr--;
+		capture_pool_ring_destroy(&capture_pool.ring[capture_pool.nr]);
+	}
+
+	pthread_mutex_unlock(&capture_pool.lock);
+}
+
+/**
+ * \brief RPC to get the capture pool settings and counters
+ * \param[in]           service	        Pointer to protobuf service structure
+ * \param[in]           dummyp          Pointer to unused dummy rpc message
+ * \param[in]           closure         Pointer to protobuf closure function pointer
+ * \param[in,out]       closure_data	Pointer to protobuf closure data
+ * \return Returns the pool settings, its amount of ready rings and its hit
+ * and miss counters via its closure function.
+ */
+
+void dabbad_capture_pool_get(Dabba__DabbaService_Service * service,
+			     const Dabba__Dummy * dummyp,
+			     Dabba__CapturePool_Closure closure,
+			     void *closure_data)
+{
+	Dabba__CapturePool pool = DABBA__CAPTURE_POOL__INIT;
+	Dabba__ErrorCode err = DABBA__ERROR_CODE__INIT;
+
+	assert(service);
+	assert(dummyp);
+
+	pool.status = &err;
+	pool.has_size = pool.has_frame_size = pool.has_frame_nr = 1;
+	pool.has_ready = pool.has_hit = pool.has_miss = 1;
+
+	pthread_mutex_lock(&capture_pool.lock);
+
+	pool.size = capture_pool.size;
+	pool.frame_size = capture_pool.frame_size;
+	pool.frame_nr = capture_pool.frame_nr;
+	pool.ready = capture_pool.nr;
+	pool.hit = capture_pool.hit;
+	pool.miss = capture_pool.miss;
+
+	pthread_mutex_unlock(&capture_pool.lock);
+
+	closure(&pool, closure_data);
+}
+
+/**
+ * \brief RPC to resize the capture pool or change the layout of its rings
+ * \param[in]           service	        Pointer to protobuf service structure
+ * \param[in]           poolp           Pointer to the new pool settings
+ * \param[in]           closure         Pointer to protobuf closure function pointer
+ * \param[in,out]       closure_data	Pointer to protobuf closure data
+ * \return Returns 0 on success, \c EINVAL on invalid settings via its
+ * closure function.
+ * \note Unset settings are kept. Ready rings not fitting the new settings are
+ * destroyed, the missing ones are created in the background.
+ */
+
+void dabbad_capture_pool_modify(Dabba__DabbaService_Service * service,
+				const Dabba__CapturePool * poolp,
+				Dabba__ErrorCode_Closure closure,
+				void *closure_data)
+{
+	Dabba__ErrorCode err = DABBA__ERROR_CODE__INIT;
+	Dabba__Capture capture = DABBA__CAPTURE__INIT;
+	struct packet_mmap stale[CAPTURE_POOL_SIZE_MAX];
+	struct tpacket_req layout;
+	size_t size, keep, stale_nr = 0;
+	int rc = EINVAL;
+
+	assert(service);
+	assert(poolp);
+
+	pthread_mutex_lock(&capture_pool.lock);
+
+	size = poolp->has_size ? poolp->size : capture_pool.size;
+	capture.frame_size = poolp->has_frame_size ?
+	    poolp->frame_size : capture_pool.frame_size;
+	capture.frame_nr = poolp->has_frame_nr ?
+	    poolp->frame_nr : capture_pool.frame_nr;
+
+	if (size > CAPTURE_POOL_SIZE_MAX
+	    || dabbad_capture_layout_get(&capture, &layout)) {
+		pthread_mutex_unlock(&capture_pool.lock);
+		goto out;
+	}
+
+	/* Ready rings with another layout cannot be used anymore */
+	keep = memcmp(&layout, &capture_pool.layout, sizeof(layout)) ? 0 : size;
+
+	while (capture_pool.nr > keep)
+		stale[stale_nr++] = capture_pool.ring[--capture_pool.nr];
+
+	capture_pool.size = size;
+	capture_pool.frame_size = capture.frame_size;
+	capture_pool.frame_nr = capture.frame_nr;
+	capture_pool.layout = layout;
+
+	pthread_mutex_unlock(&capture_pool.lock);
+
+	while (stale_nr)
+		capture_pool_ring_destroy(&stale[--stale_nr]);
+
+	capture_pool_refill();
+	rc = 0;
+
+ out:
+	err.code = rc;
+	closure(&err, closure_data);
+}
@@ -18,304 +18,1552 @@
 #include <assert.h>
 #include <limits.h>
 #include <fcntl.h>
+#include <syslog.h>
 #include <sys/queue.h>
+#include <sys/param.h>
+#include <sys/eventfd.h>
 #include <net/if.h>
 #include <arpa/inet.h>
 #include <linux/if_ether.h>
+#include <linux/if_packet.h>
 
 #include <libdabba/macros.h>
 #include <libdabba/interface.h>
 #include <libdabba/packet-rx.h>
 #include <libdabba/pcap.h>
 #include <libdabba/sock-filter.h>
+#include <libdabba/numa.h>
+#include <dabbad/arena.h>
 #include <dabbad/interface.h>
 #include <dabbad/sock-filter.h>
 #include <dabbad/capture.h>
+#include <dabbad/capture-pool.h>
+#include <dabbad/memory.h>
 #include <dabbad/misc.h>
+#include <dabbad/worker.h>
+
+/**
+ * \brief Period in milliseconds of the ring occupancy checks
+ */
+
+#define DABBAD_CAPTURE_RESIZE_PERIOD 1000
+
+/**
+ * \internal
+ * \brief Pending periodic check of the capture rings
+ */
+
+static ProtobufCDispatchTimer *capture_resize_timer;
+
+/**
+ * \internal
+ * \brief Get a running capture from its thread id
+ * \param[in] id	capture thread id
+ * \return Pointer to the capture matching the thread id, \c NULL if none does
+ */
+
+static struct packet_capture *dabbad_capture_find(const pthread_t id)
+{
+	struct packet_thread *pkt_thread = dabbad_thread_data_get(id);
+
+	if (!pkt_thread || pkt_thread->type != CAPTURE_THREAD)
+		return NULL;
+
+	return container_of(pkt_thread, struct packet_capture, thread);
+}
+
+/**
+ * \brief Get the next running capture
+ * \param[in] pkt_capture	current capture, \c NULL to get the first one
+ * \return Pointer to the next capture, \c NULL if none
+ */
+
+struct packet_capture *dabbad_capture_next(struct packet_capture
+					   *pkt_capture)
+{
+	struct packet_thread *pkt_thread =
+	    pkt_capture ? dabbad_thread_type_next(&pkt_capture->thread,
+						  CAPTURE_THREAD) :
+	    dabbad_thread_type_first(CAPTURE_THREAD);
+
+	return pkt_thread ? container_of(pkt_thread, struct packet_capture,
+					 thread) : NULL;
+}
+
+/**
+ * \internal
+ * \brief Destroy a packet mmap ring and close its socket
+ * \param[in,out] pkt_mmap	Ring to destroy, ignored if it was never created
+ */
+
+static void dabbad_capture_ring_destroy(struct packet_mmap *pkt_mmap)
+{
+	int sock;
+
+	assert(pkt_mmap);
+
+	if (!pkt_mmap->buf)
+		return;
+
+	sock = pkt_mmap->pf_sock;
+	dabbad_memory_release(MEMORY_RING,
+			      packet_mmap_layout_size(&pkt_mmap->layout));
+	ldab_packet_mmap_destroy(pkt_mmap);
+	close(sock);
+}
+
+/**
+ * \internal
+ * \brief Destroy an in-memory packet buffer and release its memory
+ * \param[in,out] pkt_buf	Buffer to destroy, ignored if it was never created
+ */
+
+static void dabbad_capture_buffer_destroy(struct packet_buffer *pkt_buf)
+{
+	assert(pkt_buf);
+
+	if (pkt_buf->data)
+		dabbad_memory_release(MEMORY_BUFFER, pkt_buf->size);
+
+	ldab_packet_buffer_destroy(pkt_buf);
+}
+
+static int dabbad_capture_ring_reap(struct packet_capture *pkt_capture);
+
+/**
+ * \internal
+ * \brief Collect the ring switch the capture thread notified
+ * \param[in]       fd	                Ring switch eventfd
+ * \param[in]       events	        Events on the eventfd
+ * \param[in]       data	        Capture which switched rings
+ */
+
+static void dabbad_capture_resize_notified(int fd, unsigned events,
+					   void *data)
+{
+	uint64_t count;
+
+	(void)events;
+
+	if (read(fd, &count, sizeof(count)) < 0 && errno != EAGAIN)
+		return;
+
+	dabbad_capture_ring_reap(data);
+}
+
+/**
+ * \internal
+ * \brief Get notified of the ring switches of a capture
+ * \param[in,out] pkt_capture	Running capture
+ * \return 0 on success, \c errno from \c eventfd(2) on failure
+ * \note The eventfd is kept until the capture is released.
+ */
+
+static int dabbad_capture_resize_watch(struct packet_capture *pkt_capture)
+{
+	int fd;
+
+	assert(pkt_capture);
+
+	if (pkt_capture->rx.resize.fd > 0)
+		return 0;
+
+	fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+	if (fd < 0)
+		return errno;
+
+	protobuf_c_dispatch_watch_fd(protobuf_c_dispatch_default(), fd,
+				     PROTOBUF_C_EVENT_READABLE,
+				     dabbad_capture_resize_notified,
+				     pkt_capture);
+	pkt_capture->rx.resize.fd = fd;
+
+	return 0;
+}
+
+/**
+ * \internal
+ * \brief Make a running capture switch to a ring of another size
+ * \param[in,out] pkt_capture	Running capture
+ * \param[in] frame_nr		Minimum amount of frames in the new ring
+ * \param[in] ring_size		Maximum size of the new ring in bytes,
+ *				used instead of \c frame_nr when not zero
+ * \return 0 on success, else on failure
+ *
+ * The new ring is accounted against the memory budget on top of the current
+ * one until the switch is over.
+ * The new ring gets its own socket with the socket filter of the current
+ * one. The socket does not receive any packet until the capture thread binds
+ * it to the interface, drains its current ring and unmaps it. The capture
+ * thread notifies the switch, see \c dabbad_capture_ring_reap().
+ */
+
+static int dabbad_capture_ring_switch(struct packet_capture *pkt_capture,
+				      const size_t frame_nr,
+				      const size_t ring_size)
+{
+	struct packet_mmap next;
+	const size_t frame_size = pkt_capture->layout.tp_frame_size;
+	struct tpacket_req layout;
+	int sock, rc;
+
+	assert(pkt_capture);
+
+	if (ring_size)
+		rc = ldab_packet_mmap_budget_layout_get(&layout, frame_size,
+							ring_size);
+	else
+		rc = ldab_packet_mmap_layout_get(&layout, frame_size,
+						 frame_nr);
+
+	/* Both rings are mapped during the switch, resizes are never shrunk */
+	if (!rc)
+		rc = dabbad_memory_reserve(MEMORY_RING,
+					   packet_mmap_layout_size(&layout));
+
+	if (rc)
+		return rc;
+
+	/* Allocate the new ring on the NUMA node of the capture thread */
+	if (pkt_capture->thread.numa_node != NUMA_NODE_NONE)
+		ldab_numa_mempolicy_set(pkt_capture->thread.numa_node);
+
+	rc = dabbad_capture_resize_watch(pkt_capture);
+
+	if (rc)
+		goto release;
+
+	/* A null protocol keeps the socket away from the traffic until bound */
+	sock = socket(PF_PACKET, SOCK_RAW, 0);
+
+	if (sock < 0) {
+		rc = errno;
+		goto release;
+	}
+
+	if (pkt_capture->rx.sfp.len
+	    && ldab_sock_filter_attach(sock, &pkt_capture->rx.sfp)) {
+		rc = errno;
+		goto sock_close;
+	}
+
+	rc = ldab_packet_mmap_prepare(&next, sock, PACKET_MMAP_RX, &layout);
+
+	if (rc)
+		goto sock_close;
+
+	rc = ldab_packet_rx_resize_start(&pkt_capture->rx, &next);
+
+	if (!rc)
+		goto out;
+
+	ldab_packet_mmap_destroy(&next);
+ sock_close:
+	close(sock);
+ release:
+	dabbad_memory_release(MEMORY_RING, packet_mmap_layout_size(&layout));
+ out:
+	ldab_numa_mempolicy_set(NUMA_NODE_NONE);
+	return rc;
+}
+
+/**
+ * \internal
+ * \brief Complete the ring switch of a capture
+ * \param[in,out] pkt_capture	Running capture
+ * \return 0 if the capture switched rings, \c EAGAIN if the capture thread
+ * did not switch rings yet, \c EINVAL if no switch was requested, else the
+ * error which prevented the switch.
+ *
+ * The socket of the ring the capture thread unmapped is closed and its
+ * memory is given back to the budget. The pending resize request, if any,
+ * gets its reply.
+ * \note The capture thread rewrites its ring while it switches, the layout
+ * reported to the clients is only copied from it here once it is done.
+ */
+
+static int dabbad_capture_ring_reap(struct packet_capture *pkt_capture)
+{
+	Dabba__ErrorCode err = DABBA__ERROR_CODE__INIT;
+	struct packet_mmap prev;
+	int rc;
+
+	assert(pkt_capture);
+
+	rc = ldab_packet_rx_resize_finish(&pkt_capture->rx, &prev);
+
+	if (rc == EAGAIN || rc == EINVAL)
+		return rc;
+
+	close(prev.pf_sock);
+	dabbad_memory_release(MEMORY_RING,
+			      packet_mmap_layout_size(&prev.layout));
+
+	if (!rc)
+		pkt_capture->layout = pkt_capture->rx.pkt_mmap.layout;
+
+	if (pkt_capture->resize_closure) {
+		err.code = rc;
+		pkt_capture->resize_closure(&err,
+					    pkt_capture->resize_closure_data);
+		pkt_capture->resize_closure = NULL;
+	}
+
+	return rc;
+}
 
 /**
  * \internal
- * \brief Capture thread management list
+ * \brief Grow the ring of a capture when it gets too full
+ * \param[in,out] pkt_capture	Running capture
+ * \return 0 on success or if the ring does not need to grow, else on failure
+ *
+ * The ring size doubles when the occupancy high-water mark reaches
+ * \c grow_threshold percent of the ring, up to \c ring_size_max bytes.
  */
 
-static struct capture_queue {
-	TAILQ_HEAD(head, packet_capture) head;
-	size_t length;
-} capture_queue = {
-.head = TAILQ_HEAD_INITIALIZER(capture_queue.head),.length = 0};
+static int dabbad_capture_ring_grow(struct packet_capture *pkt_capture)
+{
+	const struct tpacket_req *cur = &pkt_capture->layout;
+	const uint64_t high_water =
+	    __atomic_load_n(&pkt_capture->rx.resize.high_water,
+			    __ATOMIC_RELAXED);
+	const uint64_t ring_size =
+	    (uint64_t) cur->tp_block_size * cur->tp_block_nr;
+	struct tpacket_req layout;
+	uint64_t budget;
+
+	assert(pkt_capture);
+
+	if (high_water * 100 <
+	    (uint64_t) cur->tp_frame_nr * pkt_capture->grow_threshold)
+		return 0;
+
+	budget = MIN(ring_size * 2, pkt_capture->ring_size_max);
+
+	if (ldab_packet_mmap_budget_layout_get(&layout, cur->tp_frame_size,
+					       budget)
+	    || layout.tp_frame_nr <= cur->tp_frame_nr)
+		return 0;
+
+	return dabbad_capture_ring_switch(pkt_capture, 0, budget);
+}
+
+static void dabbad_capture_resize_timer_arm(void);
+
+/**
+ * \internal
+ * \brief Periodic check of the capture rings
+ * \param[in] dispatch		Pointer to the protobuf dispatcher
+ * \param[in] func_data		Unused
+ *
+ * The rings of the captures with automatic growth enabled grow if needed,
+ * unless they are already switching rings.
+ * The check is rescheduled as long as there is something to watch.
+ */
+
+static void dabbad_capture_resize_timer_cb(ProtobufCDispatch * dispatch,
+					   void *func_data)
+{
+	struct packet_capture *pkt_capture;
+	int rearm = 0;
+
+	(void)dispatch;
+	(void)func_data;
+
+	capture_resize_timer = NULL;
+
+	for (pkt_capture = dabbad_capture_next(NULL); pkt_capture;
+	     pkt_capture = dabbad_capture_next(pkt_capture)) {
+		if (!pkt_capture->grow_threshold)
+			continue;
+
+		rearm = 1;
+
+		if (dabbad_capture_ring_reap(pkt_capture) != EAGAIN)
+			dabbad_capture_ring_grow(pkt_capture);
+	}
+
+	if (rearm)
+		dabbad_capture_resize_timer_arm();
+}
+
+/**
+ * \internal
+ * \brief Schedule the next periodic check of the capture rings
+ */
+
+static void dabbad_capture_resize_timer_arm(void)
+{
+	if (capture_resize_timer)
+		return;
+
+	capture_resize_timer =
+	    protobuf_c_dispatch_add_timer_millis(protobuf_c_dispatch_default(),
+						 DABBAD_CAPTURE_RESIZE_PERIOD,
+						 dabbad_capture_resize_timer_cb,
+						 NULL);
+}
+
+/**
+ * \internal
+ * \brief Capture buffer dump request run by a worker
+ */
+
+struct capture_dump_job {
+	struct worker_job job;	/**< worker job */
+	struct packet_capture *pkt_capture;	/**< capture whose buffer is written */
+	char *pcap;		/**< path of the PCAP file to write */
+	int released;		/**< 1 if the capture stopped during the dump */
+	Dabba__ErrorCode_Closure closure;	/**< RPC reply closure */
+	void *closure_data;	/**< RPC reply closure data */
+	int rc;			/**< capture dump status */
+};
+
+/**
+ * \internal
+ * \brief Free a released capture and its in-memory packet buffer
+ * \param[in] pkt_capture	Capture to free
+ */
+
+static void dabbad_capture_free(struct packet_capture *pkt_capture)
+{
+	assert(pkt_capture);
+
+	dabbad_capture_buffer_destroy(&pkt_capture->rx.buffer);
+	free(pkt_capture->pcap);
+	free(pkt_capture->interface);
+	free(pkt_capture);
+}
+
+/**
+ * \internal
+ * \brief Release all resources held by a stopped capture
+ * \param[in] pkt_capture	Capture to release
+ * \note The final socket statistics of the capture are logged.
+ * A resize request still waiting for the ring switch is canceled.
+ * A dump of the in-memory buffer still running keeps the buffer until it is
+ * over.
+ */
+
+static void dabbad_capture_release(struct packet_capture *pkt_capture)
+{
+	Dabba__ErrorCode err = DABBA__ERROR_CODE__INIT;
+
+	assert(pkt_capture);
+
+	dabbad_capture_ring_reap(pkt_capture);
+
+	if (pkt_capture->resize_closure) {
+		err.code = ECANCELED;
+		pkt_capture->resize_closure(&err,
+					    pkt_capture->resize_closure_data);
+	}
+
+	if (pkt_capture->rx.resize.fd > 0) {
+		protobuf_c_dispatch_watch_fd(protobuf_c_dispatch_default(),
+					     pkt_capture->rx.resize.fd, 0, NULL,
+					     NULL);
+		close(pkt_capture->rx.resize.fd);
+	}
+
+	syslog(LOG_INFO, "capture on %s stopped: %u packets, %u dropped",
+	       pkt_capture->interface, pkt_capture->rx.stats.tp_packets,
+	       pkt_capture->rx.stats.tp_drops);
+
+	ldab_sock_filter_detach(pkt_capture->rx.pkt_mmap.pf_sock);
+	dabbad_sfp_destroy(&pkt_capture->rx.sfp);
+	ldab_bpf_engine_destroy(&pkt_capture->rx.trigger.engine);
+	dabbad_sfp_destroy(&pkt_capture->rx.trigger.sfp);
+
+	if (pkt_capture->rx.pcap_fd > 0)
+		close(pkt_capture->rx.pcap_fd);
+
+	dabbad_capture_ring_destroy(&pkt_capture->rx.resize.next);
+	dabbad_capture_ring_destroy(&pkt_capture->rx.pkt_mmap);
+	ldab_packet_stop_destroy(&pkt_capture->rx.stop);
+
+	/* A worker still writing the buffer frees the capture once done */
+	if (pkt_capture->dump)
+		pkt_capture->dump->released = 1;
+	else
+		dabbad_capture_free(pkt_capture);
+}
+
+/**
+ * \brief Capture thread message validator
+ * \param[in] msg Capture thread message to check
+ * \return 0 if the message is invalid, 1 if it is valid.
+ * 
+ * A valid capture message must fulfill these requirements:
+ *      - Interface name length longer than zero, shorter than \c IFNAMESIZ
+ *      - PCAP file name length longer than zero, unless the capture only
+ *        keeps packets in an in-memory buffer
+ *      - A capture trigger needs both a PCAP file and an in-memory buffer
+ *      - Frame size must be a supported size
+ *      - Either a frame number or a ring size must be given
+ *      - Snapshot length and sampling rate must fit in 32 bits
+ */
+
+int dabbad_capture_settings_are_valid(const Dabba__Capture * capturep)
+{
+
+	assert(capturep);
+
+	/* Names are empty */
+	if (!capturep->interface || strlen(capturep->interface) == 0)
+		return 0;
+
+	if ((!capturep->pcap || strlen(capturep->pcap) == 0)
+	    && !capturep->buffer_size)
+		return 0;
+
+	if (capturep->trigger && capturep->trigger->n_filter
+	    && (!capturep->pcap || strlen(capturep->pcap) == 0
+		|| !capturep->buffer_size))
+		return 0;
+
+	if (!packet_mmap_frame_size_is_valid(capturep->frame_size))
+		return 0;
+
+	if (!capturep->frame_nr && !capturep->ring_size)
+		return 0;
+
+	if (capturep->snaplen > UINT32_MAX || capturep->sampling > UINT32_MAX)
+		return 0;
+
+	return 1;
+}
+
+/**
+ * \brief Compute the ring layout a capture asks for
+ * \param[in]           capturep	Pointer to the capture settings
+ * \param[out]          layout		Resulting ring layout
+ * \return 0 on success, \c EINVAL on invalid ring settings
+ */
+
+int dabbad_capture_layout_get(const Dabba__Capture * capturep,
+			      struct tpacket_req *layout)
+{
+	assert(capturep);
+	assert(layout);
+
+	if (capturep->ring_size)
+		return ldab_packet_mmap_budget_layout_get(layout,
+							  capturep->frame_size,
+							  capturep->ring_size);
+
+	return ldab_packet_mmap_layout_get(layout, capturep->frame_size,
+					   capturep->frame_nr);
+}
+
+/**
+ * \brief RPC to stop a running capture
+ * \param[in]           service	        Pointer to protobuf service structure
+ * \param[in]           idp             Pointer to the thread id to stop
+ * \param[in]           closure         Pointer to protobuf closure function pointer
+ * \param[in]           closure_data	Pointer to protobuf closure data
+ * \return Returns 0 on success, else on failure via its closure function.
+ */
+
+void dabbad_capture_stop(Dabba__DabbaService_Service * service,
+			 const Dabba__ThreadId * idp,
+			 Dabba__ErrorCode_Closure closure, void *closure_data)
+{
+	Dabba__ErrorCode err = DABBA__ERROR_CODE__INIT;
+	struct packet_capture *pkt_capture;
+	int rc;
+
+	assert(service);
+	assert(idp);
+
+	pkt_capture = dabbad_capture_find((pthread_t) idp->id);
+
+	if (!pkt_capture) {
+		rc = EINVAL;
+		goto out;
+	}
+
+	rc = dabbad_capture_destroy(pkt_capture);
+
+ out:
+	err.code = rc;
+	closure(&err, closure_data);
+}
+
+/**
+ * \brief Stop and release all running captures
+ * \return 0 on success, else the return value of the first failed
+ * \c dabbad_thread_stop()
+ * \note Each capture writes the packets left in its ring before stopping.
+ */
+
+int dabbad_capture_shutdown(void)
+{
+	struct packet_capture *pkt_capture, *tmp;
+	int rc = 0;
+
+	for (pkt_capture = dabbad_capture_next(NULL); pkt_capture;
+	     pkt_capture = tmp) {
+		tmp = dabbad_capture_next(pkt_capture);
+
+		rc = dabbad_capture_destroy(pkt_capture);
+
+		if (rc)
+			break;
+	}
+
+	return rc;
+}
+
+/**
+ * \brief RPC to stop all running captures
+ * \param[in]           service	        Pointer to protobuf service structure
+ * \param[in]           dummyp          Pointer to unused dummy rpc message
+ * \param[in]           closure         Pointer to protobuf closure function pointer
+ * \param[in]           closure_data	Pointer to protobuf closure data
+ * \return Returns 0 on success, else on failure via its closure function.
+ */
+
+void dabbad_capture_stop_all(Dabba__DabbaService_Service * service,
+			     const Dabba__Dummy * dummyp,
+			     Dabba__ErrorCode_Closure closure,
+			     void *closure_data)
+{
+	Dabba__ErrorCode err = DABBA__ERROR_CODE__INIT;
+
+	assert(service);
+	assert(dummyp);
+
+	err.code = dabbad_capture_shutdown();
+	closure(&err, closure_data);
+}
+
+/**
+ * \internal
+ * \brief Write the in-memory packet buffer of a capture from a worker
+ * \param[in,out]       job	        Capture dump job
+ */
+
+static void dabbad_capture_dump_run(struct worker_job *job)
+{
+	struct capture_dump_job *dump =
+	    container_of(job, struct capture_dump_job, job);
+	int fd;
+
+	fd = ldab_pcap_create(dump->pcap, LINKTYPE_EN10MB);
+
+	if (fd < 0) {
+		dump->rc = errno;
+		return;
+	}
+
+	dump->rc = ldab_packet_buffer_dump(&dump->pkt_capture->rx.buffer, fd);
+
+	ldab_pcap_close(fd);
+}
+
+/**
+ * \internal
+ * \brief Reply to the client of a capture buffer dump
+ * \param[in,out]       job	        Capture dump job
+ * \note The capture is freed here if it stopped during the dump.
+ */
+
+static void dabbad_capture_dump_done(struct worker_job *job)
+{
+	struct capture_dump_job *dump =
+	    container_of(job, struct capture_dump_job, job);
+	Dabba__ErrorCode err = DABBA__ERROR_CODE__INIT;
+
+	if (dump->released)
+		dabbad_capture_free(dump->pkt_capture);
+	else
+		dump->pkt_capture->dump = NULL;
+
+	err.code = dump->rc;
+	dump->closure(&err, dump->closure_data);
+	free(dump->pcap);
+	free(dump);
+}
+
+/**
+ * \brief RPC to write the in-memory packet buffer of a capture to a PCAP file
+ * \param[in]           service	        Pointer to protobuf service structure
+ * \param[in]           dumpp           Pointer to the capture dump request
+ * \param[in]           closure         Pointer to protobuf closure function pointer
+ * \param[in]           closure_data	Pointer to protobuf closure data
+ * \return Returns 0 on success, else on failure via its closure function.
+ * \note The capture keeps running while its buffer is written.
+ *
+ * The buffer is written by a worker so that other requests are still served
+ * meanwhile. Only one dump per capture runs at a time, \c EBUSY is returned
+ * while the buffer is being written.
+ */
+
+void dabbad_capture_dump(Dabba__DabbaService_Service * service,
+			 const Dabba__CaptureDump * dumpp,
+			 Dabba__ErrorCode_Closure closure, void *closure_data)
+{
+	Dabba__ErrorCode err = DABBA__ERROR_CODE__INIT;
+	struct packet_capture *pkt_capture;
+	struct capture_dump_job *dump;
+	int rc = ENOMEM;
+
+	assert(service);
+	assert(dumpp);
+
+	pkt_capture = dabbad_capture_find((pthread_t) dumpp->id->id);
+
+	if (!pkt_capture || !dumpp->pcap || strlen(dumpp->pcap) == 0
+	    || !packet_buffer_is_enabled(&pkt_capture->rx.buffer)) {
+		rc = EINVAL;
+		goto out;
+	}
+
+	if (pkt_capture->dump) {
+		rc = EBUSY;
+		goto out;
+	}
+
+	dump = calloc(1, sizeof(*dump));
+
+	if (!dump)
+		goto out;
+
+	dump->pcap = strdup(dumpp->pcap);
+
+	if (!dump->pcap) {
+		free(dump);
+		goto out;
+	}
+
+	dump->job.run = dabbad_capture_dump_run;
+	dump->job.done = dabbad_capture_dump_done;
+	dump->pkt_capture = pkt_capture;
+	dump->closure = closure;
+	dump->closure_data = closure_data;
+	pkt_capture->dump = dump;
+
+	dabbad_worker_run(&dump->job);
+	return;
+
+ out:
+	err.code = rc;
+	closure(&err, closure_data);
+}
+
+/**
+ * \brief RPC to modify the settings of a running capture
+ * \param[in]           service	        Pointer to protobuf service structure
+ * \param[in]           capturep        Pointer to the capture settings to modify
+ * \param[in]           closure         Pointer to protobuf closure function pointer
+ * \param[in,out]       closure_data	Pointer to protobuf closure data
+ * \return Returns 0 on success, else on failure via its closure function.
+ *
+ * Only the settings present in the message are modified:
+ *      - The socket filter is replaced, an empty filter removes it.
+ *        The kernel swaps the filters atomically, the old filter is only
+ *        freed once the new one is attached. \c EPERM is returned if the
+ *        socket filter is locked.
+ *      - The snapshot length and the sampling rate take effect on the next
+ *        received packet. \c EINVAL is returned if they do not fit in 32
+ *        bits.
+ *
+ * \c EBUSY is returned if the socket filter is modified while the capture
+ * switches to a resized ring.
+ *
+ * The packet mmap ring and the pcap file are kept, no packet is lost.
+ */
+
+void dabbad_capture_modify(Dabba__DabbaService_Service * service,
+			   const Dabba__Capture * capturep,
+			   Dabba__ErrorCode_Closure closure,
+			   void *closure_data)
+{
+	Dabba__ErrorCode err = DABBA__ERROR_CODE__INIT;
+	struct packet_capture *pkt_capture;
+	struct sock_fprog sfp = { 0 }, old_sfp;
+	int sock, rc = 0;
+
+	assert(service);
+	assert(capturep);
+
+	pkt_capture =
+	    capturep->id ? dabbad_capture_find((pthread_t) capturep->id->id) :
+	    NULL;
+
+	if (!pkt_capture || capturep->snaplen > UINT32_MAX
+	    || capturep->sampling > UINT32_MAX) {
+		rc = EINVAL;
+		goto out;
+	}
+
+	/* The socket filter must stay the same on both rings of a switch */
+	if (capturep->sfp && dabbad_capture_ring_reap(pkt_capture) == EAGAIN) {
+		rc = EBUSY;
+		goto out;
+	}
+
+	if (capturep->sfp) {
+		sock = pkt_capture->rx.pkt_mmap.pf_sock;
+
+		if (ldab_sock_filter_is_locked(sock)) {
+			rc = EPERM;
+			goto out;
+		}
+
+		if (capturep->sfp->n_filter) {
+			rc = dabbad_pbuf_sfp_2_sfp(capturep->sfp, &sfp);
+
+			if (rc)
+				goto out;
+
+			if (ldab_sock_filter_attach(sock, &sfp)) {
+				rc = errno;
+				dabbad_sfp_destroy(&sfp);
+				goto out;
+			}
+		} else if (pkt_capture->rx.sfp.len
+			   && ldab_sock_filter_detach(sock)) {
+			rc = errno;
+			goto out;
+		}
+
+		old_sfp = pkt_capture->rx.sfp;
+		pkt_capture->rx.sfp = sfp;
+		dabbad_sfp_destroy(&old_sfp);
+	}
+
+	if (capturep->has_snaplen)
+		__atomic_store_n(&pkt_capture->rx.snaplen, capturep->snaplen,
+				 __ATOMIC_RELAXED);
+
+	if (capturep->has_sampling)
+		__atomic_store_n(&pkt_capture->rx.sampling, capturep->sampling,
+				 __ATOMIC_RELAXED);
+
+ out:
+	err.code = rc;
+	closure(&err, closure_data);
+}
+
+/**
+ * \brief RPC to resize the packet mmap ring of a running capture
+ * \param[in]           service	        Pointer to protobuf service structure
+ * \param[in]           resizep         Pointer to the capture resize request
+ * \param[in]           closure         Pointer to protobuf closure function pointer
+ * \param[in,out]       closure_data	Pointer to protobuf closure data
+ * \return Returns 0 on success, else on failure via its closure function.
+ *
+ * A new ring of \c frame_nr frames, or fitting in \c ring_size bytes,
+ * replaces the current one without stopping the capture.
+ * The capture thread binds the new ring, drains the current one and unmaps
+ * it by itself. The reply is sent once the switch is over, without holding
+ * the RPC dispatcher meanwhile.
+ *
+ * A non-zero \c grow_threshold makes the ring double each time its occupancy
+ * high-water mark reaches \c grow_threshold percent of its frames,
+ * up to \c ring_size_max bytes. A zero \c grow_threshold disables it.
+ */
+
+void dabbad_capture_resize(Dabba__DabbaService_Service * service,
+			   const Dabba__CaptureResize * resizep,
+			   Dabba__ErrorCode_Closure closure,
+			   void *closure_data)
+{
+	Dabba__ErrorCode err = DABBA__ERROR_CODE__INIT;
+	struct packet_capture *pkt_capture;
+	int rc = 0;
+
+	assert(service);
+	assert(resizep);
+
+	pkt_capture = dabbad_capture_find((pthread_t) resizep->id->id);
+
+	if (!pkt_capture || resizep->grow_threshold > 100
+	    || (resizep->grow_threshold && !resizep->ring_size_max)
+	    || (!resizep->frame_nr && !resizep->ring_size
+		&& !resizep->has_grow_threshold)) {
+		rc = EINVAL;
+		goto out;
+	}
+
+	if (dabbad_capture_ring_reap(pkt_capture) == EAGAIN) {
+		rc = EBUSY;
+		goto out;
+	}
+
+	if (resizep->has_grow_threshold) {
+		pkt_capture->grow_threshold = resizep->grow_threshold;
+		pkt_capture->ring_size_max = resizep->ring_size_max;
+	}
+
+	if (resizep->frame_nr || resizep->ring_size)
+		rc = dabbad_capture_ring_switch(pkt_capture, resizep->frame_nr,
+						resizep->ring_size);
+
+	if (pkt_capture->grow_threshold)
+		dabbad_capture_resize_timer_arm();
+
+	/* Reply once the capture thread switched rings */
+	if (!rc && (resizep->frame_nr || resizep->ring_size)) {
+		pkt_capture->resize_closure = closure;
+		pkt_capture->resize_closure_data = closure_data;
+		return;
+	}
+
+ out:
+	err.code = rc;
+	closure(&err, closure_data);
+}
+
+/**
+ * \internal
+ * \brief Create the ring a capture asks for within the memory budget
+ * \param[in]           capturep	Pointer to the capture settings
+ * \param[in]           sock		Open PF_PACKET socket of the ring
+ * \param[out]          pkt_mmap	Ring to create
+ * \return 0 on success, \c ENOBUFS if the ring does not fit in the memory
+ * budget, else on failure
+ * \note The ring may be smaller than requested if the budget policy shrinks
+ * rings instead of rejecting them.
+ */
+
+static int dabbad_capture_ring_create(const Dabba__Capture * capturep,
+				      const int sock,
+				      struct packet_mmap *pkt_mmap)
+{
+	struct tpacket_req layout;
+	int rc;
+
+	rc = dabbad_capture_layout_get(capturep, &layout);
+
+	if (!rc)
+		rc = dabbad_memory_ring_reserve(MEMORY_RING, &layout);
+
+	if (rc)
+		return rc;
+
+	rc = ldab_packet_mmap_layout_create(pkt_mmap, capturep->interface, sock,
+					    PACKET_MMAP_RX, &layout);
+
+	if (rc)
+		dabbad_memory_release(MEMORY_RING,
+				      packet_mmap_layout_size(&layout));
+
+	return rc;
+}
+
+/**
+ * \internal
+ * \brief Create a capture ring and start its capture thread
+ * \param[in]           capturep	Pointer to the capture settings
+ * \param[out]          pkt_capturep	Pointer to the started capture
+ * \return 0 on success, else on failure
+ * \note Locking and faulting in large rings takes time, this runs in a
+ * worker. The started capture must be registered from the RPC dispatcher.
+ */
+
+static int dabbad_capture_setup(const Dabba__Capture * capturep,
+				struct packet_capture **pkt_capturep)
+{
+	struct packet_capture *pkt_capture;
+	struct packet_thread_settings settings;
+	int sock = -1, pooled = 0, rc;
+
+	assert(capturep);
+	assert(pkt_capturep);
+
+	pkt_capture = calloc(1, sizeof(*pkt_capture));
+
+	if (!pkt_capture) {
+		rc = ENOMEM;
+		goto out;
+	}
+
+	pkt_capture->thread.type = CAPTURE_THREAD;
+	pkt_capture->rx.pcap_fd = -1;
+	pkt_capture->interface = strdup(capturep->interface);
+
+	if (!pkt_capture->interface) {
+		free(pkt_capture);
+		rc = ENOMEM;
+		goto out;
+	}
+
+	rc = dabbad_thread_numa_prepare(&pkt_capture->thread,
+					capturep->interface,
+					capturep->has_numa_node,
+					capturep->numa_node);
+
+	if (rc)
+		goto pcap_close;
+
+	if (capturep->pcap && strlen(capturep->pcap)) {
+		if (capturep->append)
+			pkt_capture->rx.pcap_fd =
+			    ldab_pcap_open(capturep->pcap, O_RDWR | O_APPEND);
+		else
+			pkt_capture->rx.pcap_fd =
+			    ldab_pcap_create(capturep->pcap, LINKTYPE_EN10MB);
+
+		if (pkt_capture->rx.pcap_fd < 0) {
+			rc = errno;
+			goto pcap_close;
+		}
+
+		pkt_capture->pcap = realpath(capturep->pcap, NULL);
+	}
+
+	if (capturep->buffer_size) {
+		rc = dabbad_memory_reserve(MEMORY_BUFFER,
+					   capturep->buffer_size);
+
+		if (rc)
+			goto pcap_close;
+
+		rc = ldab_packet_buffer_create(&pkt_capture->rx.buffer,
+					       capturep->buffer_size,
+					       capturep->buffer_duration);
+
+		if (rc) {
+			dabbad_memory_release(MEMORY_BUFFER,
+					      capturep->buffer_size);
+			goto pcap_close;
+		}
+	}
+
+	if (capturep->trigger && capturep->trigger->n_filter) {
+		rc = dabbad_pbuf_sfp_2_sfp(capturep->trigger,
+					   &pkt_capture->rx.trigger.sfp);
+
+		if (rc)
+			goto buffer_destroy;
+
+		rc = ldab_bpf_engine_create(&pkt_capture->rx.trigger.engine,
+					    &pkt_capture->rx.trigger.sfp);
+
+		if (rc)
+			goto trigger_destroy;
+
+		pkt_capture->rx.trigger.window = capturep->trigger_window;
+	}
+
+	pkt_capture->rx.snaplen = capturep->snaplen;
+	pkt_capture->rx.sampling = capturep->sampling;
+
+	/* Pooled rings are mapped ahead of time without NUMA placement */
+	if (pkt_capture->thread.numa_node == NUMA_NODE_NONE)
+		pooled = !dabbad_capture_pool_take(capturep,
+						   &pkt_capture->rx.pkt_mmap);
+
+	if (pooled)
+		sock = pkt_capture->rx.pkt_mmap.pf_sock;
+	else
+		sock = socket(PF_PACKET, SOCK_RAW, htons(ETH_P_ALL));
+
+	if (sock < 0) {
+		rc = errno;
+		goto trigger_destroy;
+	}
+
+	/* The filter is attached before the ring is bound to the interface */
+	if (capturep->sfp && capturep->sfp->n_filter) {
+		rc = dabbad_pbuf_sfp_2_sfp(capturep->sfp, &pkt_capture->rx.sfp);
+
+		if (rc)
+			goto sfp_destroy;
+
+		rc = ldab_sock_filter_attach(sock, &pkt_capture->rx.sfp);
+
+		if (rc)
+			goto sfp_destroy;
+	}
+
+	if (pooled)
+		rc = ldab_packet_mmap_attach(&pkt_capture->rx.pkt_mmap,
+					     capturep->interface);
+	else
+		rc = dabbad_capture_ring_create(capturep, sock,
+						&pkt_capture->rx.pkt_mmap);
+
+	if (rc)
+		goto sfp_destroy;
+
+	pkt_capture->thread.ifindex = pkt_capture->rx.pkt_mmap.ifindex;
+	pkt_capture->layout = pkt_capture->rx.pkt_mmap.layout;
+	settings.has_sched_policy = capturep->has_sched_policy;
+	settings.sched_policy = capturep->sched_policy;
+	settings.has_sched_priority = capturep->has_sched_priority;
+	settings.sched_priority = capturep->sched_priority;
+	settings.cpu_set = capturep->cpu_set;
+	settings.stack_prefault = capturep->stack_prefault;
+
+	rc = ldab_packet_stop_init(&pkt_capture->rx.stop);
+
+	if (!rc) {
+		pkt_capture->thread.stop = &pkt_capture->rx.stop;
+		rc = dabbad_thread_start(&pkt_capture->thread, &settings,
+					 ldab_packet_rx, pkt_capture);
+	}
+
+	if (!rc) {
+		*pkt_capturep = pkt_capture;
+		goto out;
+	}
+
+	ldab_packet_stop_destroy(&pkt_capture->rx.stop);
+ sfp_destroy:
+	/* Pooled rings are already mapped before they are bound */
+	if (pkt_capture->rx.pkt_mmap.buf) {
+		dabbad_capture_ring_destroy(&pkt_capture->rx.pkt_mmap);
+		sock = -1;
+	}
+
+	dabbad_sfp_destroy(&pkt_capture->rx.sfp);
+ trigger_destroy:
+	ldab_bpf_engine_destroy(&pkt_capture->rx.trigger.engine);
+	dabbad_sfp_destroy(&pkt_capture->rx.trigger.sfp);
+ buffer_destroy:
+	dabbad_capture_buffer_destroy(&pkt_capture->rx.buffer);
+ pcap_close:
+	if (pkt_capture->rx.pcap_fd > 0)
+		close(pkt_capture->rx.pcap_fd);
+	free(pkt_capture->pcap);
+	free(pkt_capture->interface);
+	free(pkt_capture);
+
+	if (sock >= 0)
+		close(sock);
+ out:
+	ldab_numa_mempolicy_set(NUMA_NODE_NONE);
+	return rc;
+}
 
 /**
- * \internal
- * \brief Get the amount of capture in the capture list
- * \return Thread list length
+ * \brief Start and register a new capture right away
+ * \param[in]           capturep	Pointer to the capture settings
+ * \param[out]          pkt_capturep	Pointer to the started capture
+ * \return 0 on success, \c EINVAL on invalid settings, else on failure
+ * \note Unlike \c dabbad_capture_start(), the RPC dispatcher is blocked
+ * until the capture runs.
  */
 
-static size_t dabbad_capture_length_get(void)
+int dabbad_capture_create(const Dabba__Capture * capturep,
+			  struct packet_capture **pkt_capturep)
 {
-	return capture_queue.length;
+	int rc;
+
+	assert(capturep);
+	assert(pkt_capturep);
+
+	if (!dabbad_capture_settings_are_valid(capturep))
+		return EINVAL;
+
+	rc = dabbad_capture_setup(capturep, pkt_capturep);
+
+	if (!rc)
+		dabbad_thread_register(&(*pkt_capturep)->thread);
+
+	return rc;
 }
 
 /**
- * \internal
- * \brief Insert a new capture to the capture list tail
+ * \brief Stop a running capture and release it
+ * \param[in,out]       pkt_capture	Capture to stop
+ * \return 0 on success, else the return value of \c dabbad_thread_stop()
+ * \note The capture is only released once its thread is stopped.
  */
 
-static void dabbad_capture_insert(struct packet_capture *const node)
+int dabbad_capture_destroy(struct packet_capture *pkt_capture)
 {
-	assert(node);
-	TAILQ_INSERT_TAIL(&capture_queue.head, node, entry);
-	capture_queue.length++;
+	int rc;
+
+	assert(pkt_capture);
+
+	rc = dabbad_thread_stop(&pkt_capture->thread);
+
+	if (!rc)
+		dabbad_capture_release(pkt_capture);
+
+	return rc;
 }
 
 /**
  * \internal
- * \brief Remove existing capture entry from the capture list
+ * \brief Capture start request run by a worker
  */
 
-static void dabbad_capture_remove(struct packet_capture *const node)
-{
-	assert(node);
-	assert(capture_queue.length > 0);
-	TAILQ_REMOVE(&capture_queue.head, node, entry);
-	capture_queue.length--;
-}
+struct capture_start_job {
+	struct worker_job job;	/**< worker job */
+	Dabba__Capture *capturep;	/**< copy of the requested capture */
+	struct packet_capture *pkt_capture;	/**< started capture */
+	Dabba__ErrorCode_Closure closure;	/**< RPC reply closure */
+	void *closure_data;	/**< RPC reply closure data */
+	int rc;			/**< capture start status */
+};
 
 /**
  * \internal
- * \brief Returns capture matching thread id present in the capture list
- * \return Pointer to the capture matching the capture id
+ * \brief Start a requested capture from a worker
+ * \param[in,out]       job	        Capture start job
  */
 
-static struct packet_capture *dabbad_capture_find(const pthread_t id)
+static void dabbad_capture_start_run(struct worker_job *job)
 {
-	struct packet_capture *node;
+	struct capture_start_job *start =
+	    container_of(job, struct capture_start_job, job);
 
-	TAILQ_FOREACH(node, &capture_queue.head, entry)
-	    if (node->thread.id == id)
-		break;
-
-	return node;
+	start->rc = dabbad_capture_setup(start->capturep, &start->pkt_capture);
 }
 
 /**
  * \internal
- * \brief Capture thread message validator
- * \param[in] msg Capture thread message to check
- * \return 0 if the message is invalid, 1 if it is valid.
- * 
- * A valid capture message must fulfill these requirements:
- *      - Interface name length longer than zero, shorter than \c IFNAMESIZ
- *      - PCAP file name length longer than zero
- *      - Frame size must be a supported size
- *      - The memory page order must be greater than zero
+ * \brief Register a started capture and reply to its client
+ * \param[in,out]       job	        Capture start job
  */
 
-static int capture_settings_are_valid(const Dabba__Capture * capturep)
+static void dabbad_capture_start_done(struct worker_job *job)
 {
+	struct capture_start_job *start =
+	    container_of(job, struct capture_start_job, job);
 
-	assert(capturep);
-
-	/* Names are empty */
-	if (!capturep->interface || strlen(capturep->interface) == 0)
-		return 0;
-
-	if (!capturep->pcap || strlen(capturep->pcap) == 0)
-		return 0;
-
-	if (!packet_mmap_frame_size_is_valid(capturep->frame_size))
-		return 0;
-
-	if (!capturep->frame_nr)
-		return 0;
+	if (!start->rc)
+		dabbad_thread_register(&start->pkt_capture->thread);
 
-	return 1;
+	start->capturep->status->code = start->rc;
+	start->closure(start->capturep->status, start->closure_data);
+	protobuf_c_message_free_unpacked(&start->capturep->base, NULL);
+	free(start);
 }
 
 /**
- * \brief RPC to stop a running capture
+ * \brief RPC to start a new capture
  * \param[in]           service	        Pointer to protobuf service structure
- * \param[in]           idp             Pointer to the thread id to stop
+ * \param[in]           capturep        Pointer to new capture thread settings
  * \param[in]           closure         Pointer to protobuf closure function pointer
- * \param[in]           closure_data	Pointer to protobuf closure data
+ * \param[in,out]       closure_data	Pointer to protobuf closure data
  * \return Returns 0 on success, else on failure via its closure function.
+ *
+ * The packet mmap ring is allocated on the NUMA node of the interface and the
+ * capture thread runs on the CPUs of this node, unless another node is
+ * requested. See \c dabbad_thread_numa_prepare().
+ * The requested scheduling and CPU affinity are applied when the capture
+ * thread is created. See \c dabbad_thread_start().
+ *
+ * The capture is set up by a worker so that other requests are still served
+ * meanwhile. Its client gets the reply once the capture is registered.
  */
 
-void dabbad_capture_stop(Dabba__DabbaService_Service * service,
-			 const Dabba__ThreadId * idp,
-			 Dabba__ErrorCode_Closure closure, void *closure_data)
+void dabbad_capture_start(Dabba__DabbaService_Service * service,
+			  const Dabba__Capture * capturep,
+			  Dabba__ErrorCode_Closure closure, void *closure_data)
 {
-	Dabba__ErrorCode err = DABBA__ERROR_CODE__INIT;
-	struct packet_capture *pkt_capture;
-	int rc;
+	struct capture_start_job *start;
+	int rc = ENOMEM;
 
 	assert(service);
-	assert(idp);
-
-	pkt_capture = dabbad_capture_find((pthread_t) idp->id);
+	assert(capturep);
 
-	if (!pkt_capture) {
+	if (!dabbad_capture_settings_are_valid(capturep)) {
 		rc = EINVAL;
 		goto out;
 	}
 
-	rc = dabbad_thread_stop(&pkt_capture->thread);
+	start = calloc(1, sizeof(*start));
 
-	if (!rc) {
-		dabbad_capture_remove(pkt_capture);
-		ldab_sock_filter_detach(pkt_capture->rx.pkt_mmap.pf_sock);
-		dabbad_sfp_destroy(&pkt_capture->rx.sfp);
-		close(pkt_capture->rx.pcap_fd);
-		ldab_packet_mmap_destroy(&pkt_capture->rx.pkt_mmap);
-		free(pkt_capture);
+	if (!start)
+		goto out;
+
+	start->capturep =
+	    (Dabba__Capture *) dabbad_worker_msg_dup(&capturep->base);
+
+	if (!start->capturep) {
+		free(start);
+		goto out;
 	}
 
+	start->job.run = dabbad_capture_start_run;
+	start->job.done = dabbad_capture_start_done;
+	start->closure = closure;
+	start->closure_data = closure_data;
+
+	dabbad_worker_run(&start->job);
+	return;
+
  out:
-	err.code = rc;
-	closure(&err, closure_data);
+	capturep->status->code = rc;
+	closure(capturep->status, closure_data);
 }
 
 /**
- * \brief RPC to stop all running captures
- * \param[in]           service	        Pointer to protobuf service structure
- * \param[in]           dummyp          Pointer to unused dummy rpc message
- * \param[in]           closure         Pointer to protobuf closure function pointer
- * \param[in]           closure_data	Pointer to protobuf closure data
- * \return Returns 0 on success, else on failure via its closure function.
+ * \internal
+ * \brief Reply entry of a capture started or stopped by a batch
  */
 
-void dabbad_capture_stop_all(Dabba__DabbaService_Service * service,
-			     const Dabba__Dummy * dummyp,
-			     Dabba__ErrorCode_Closure closure,
-			     void *closure_data)
+struct capture_batch_item {
+	struct packet_capture *pkt_capture;	/**< started capture */
+	Dabba__ThreadResult result;	/**< reply of the capture */
+	Dabba__ErrorCode status;	/**< start or stop status */
+	Dabba__ThreadId id;	/**< id of the capture thread */
+};
+
+/**
+ * \internal
+ * \brief Capture batch start request run by a worker
+ */
+
+struct capture_batch_job {
+	struct worker_job job;	/**< worker job */
+	Dabba__CaptureList *capture_listp;	/**< copy of the requested captures */
+	struct capture_batch_item *item;	/**< reply entry of each capture */
+	Dabba__ThreadResultList result_list;	/**< reply to the client */
+	Dabba__ThreadResultList_Closure closure;	/**< RPC reply closure */
+	void *closure_data;	/**< RPC reply closure data */
+};
+
+/**
+ * \internal
+ * \brief Allocate the reply entries of a capture batch
+ * \param[in]           nr	        Amount of captures in the batch
+ * \param[out]          result_list	Reply to point to the entries
+ * \return Pointer to the reply entries, \c NULL if memory could not be
+ * allocated
+ * \note The entries and the reply list are freed with \c free().
+ */
+
+static struct capture_batch_item *capture_batch_new(const size_t nr,
+						    Dabba__ThreadResultList *
+						    result_list)
 {
-	Dabba__ErrorCode err = DABBA__ERROR_CODE__INIT;
-	struct packet_capture *pkt_capture, *tmp;
-	int rc = 0;
+	struct capture_batch_item *item;
+	size_t a;
 
-	assert(service);
-	assert(dummyp);
+	assert(result_list);
 
-	for (pkt_capture = TAILQ_FIRST(&capture_queue.head); pkt_capture;
-	     pkt_capture = tmp) {
-		tmp = TAILQ_NEXT(pkt_capture, entry);
+	item = calloc(nr, sizeof(*item));
+	result_list->list = calloc(nr, sizeof(*result_list->list));
 
-		rc = dabbad_thread_stop(&pkt_capture->thread);
+	if (!item || !result_list->list) {
+		free(result_list->list);
+		free(item);
+		result_list->list = NULL;
+		return NULL;
+	}
 
-		if (rc)
-			break;
+	for (a = 0; a < nr; a++) {
+		dabba__thread_result__init(&item[a].result);
+		dabba__error_code__init(&item[a].status);
+		dabba__thread_id__init(&item[a].id);
+		item[a].result.status = &item[a].status;
+		result_list->list[a] = &item[a].result;
+	}
 
-		dabbad_capture_remove(pkt_capture);
-		ldab_sock_filter_detach(pkt_capture->rx.pkt_mmap.pf_sock);
-		dabbad_sfp_destroy(&pkt_capture->rx.sfp);
-		close(pkt_capture->rx.pcap_fd);
-		ldab_packet_mmap_destroy(&pkt_capture->rx.pkt_mmap);
-		free(pkt_capture);
+	result_list->n_list = nr;
+
+	return item;
+}
+
+/**
+ * \internal
+ * \brief Start one capture of a batch
+ * \param[in,out]       arg	        Capture batch job
+ * \param[in]           idx	        Index of the capture to start
+ * \note Runs from several threads at once, see \c dabbad_worker_parallel().
+ */
+
+static void dabbad_capture_batch_setup(void *arg, const size_t idx)
+{
+	struct capture_batch_job *batch = arg;
+	const Dabba__Capture *capturep = batch->capture_listp->list[idx];
+	struct capture_batch_item *item = &batch->item[idx];
+
+	if (!dabbad_capture_settings_are_valid(capturep))
+		item->status.code = EINVAL;
+	else
+		item->status.code =
+		    dabbad_capture_setup(capturep, &item->pkt_capture);
+}
+
+/**
+ * \internal
+ * \brief Start the captures of a batch from a worker
+ * \param[in,out]       job	        Capture batch job
+ * \note Sockets and rings of the captures are created in parallel.
+ */
+
+static void dabbad_capture_start_batch_run(struct worker_job *job)
+{
+	struct capture_batch_job *batch =
+	    container_of(job, struct capture_batch_job, job);
+
+	dabbad_worker_parallel_split(dabbad_capture_batch_setup, batch,
+				     batch->capture_listp->n_list, 1);
+}
+
+/**
+ * \internal
+ * \brief Register the started captures of a batch and reply to its client
+ * \param[in,out]       job	        Capture batch job
+ */
+
+static void dabbad_capture_start_batch_done(struct worker_job *job)
+{
+	struct capture_batch_job *batch =
+	    container_of(job, struct capture_batch_job, job);
+	struct capture_batch_item *item;
+	size_t a;
+
+	for (a = 0; a < batch->result_list.n_list; a++) {
+		item = &batch->item[a];
+
+		if (item->status.code)
+			continue;
+
+		dabbad_thread_register(&item->pkt_capture->thread);
+		item->id.id = (uint64_t) item->pkt_capture->thread.id;
+		item->result.id = &item->id;
 	}
 
-	err.code = rc;
-	closure(&err, closure_data);
+	batch->closure(&batch->result_list, batch->closure_data);
+	protobuf_c_message_free_unpacked(&batch->capture_listp->base, NULL);
+	free(batch->result_list.list);
+	free(batch->item);
+	free(batch);
 }
 
 /**
- * \brief RPC to start a new capture
+ * \brief RPC to start several captures at once
  * \param[in]           service	        Pointer to protobuf service structure
- * \param[in]           capturep        Pointer to new capture thread settings
+ * \param[in]           capture_listp	Pointer to the new capture settings
  * \param[in]           closure         Pointer to protobuf closure function pointer
  * \param[in,out]       closure_data	Pointer to protobuf closure data
- * \return Returns 0 on success, else on failure via its closure function.
+ * \return Returns the start status and the thread id of each capture, in
+ * request order, via its closure function. An empty list is returned if
+ * the batch could not be processed at all.
+ *
+ * The captures are set up by a worker like \c dabbad_capture_start() does.
+ * Their sockets and rings are created in parallel so that starting a capture
+ * on each of many interfaces only costs one round-trip.
  */
 
-void dabbad_capture_start(Dabba__DabbaService_Service * service,
-			  const Dabba__Capture * capturep,
-			  Dabba__ErrorCode_Closure closure, void *closure_data)
+void dabbad_capture_start_batch(Dabba__DabbaService_Service * service,
+				const Dabba__CaptureList * capture_listp,
+				Dabba__ThreadResultList_Closure closure,
+				void *closure_data)
 {
-	struct packet_capture *pkt_capture;
-	int sock, rc;
+	Dabba__ThreadResultList result_list = DABBA__THREAD_RESULT_LIST__INIT;
+	struct capture_batch_job *batch;
 
 	assert(service);
-	assert(capturep);
+	assert(capture_listp);
 
-	if (!capture_settings_are_valid(capturep)) {
-		rc = EINVAL;
+	if (!capture_listp->n_list)
 		goto out;
-	}
 
-	sock = socket(PF_PACKET, SOCK_RAW, htons(ETH_P_ALL));
+	batch = calloc(1, sizeof(*batch));
 
-	if (sock < 0) {
-		rc = errno;
+	if (!batch)
 		goto out;
-	}
-
-	pkt_capture = calloc(1, sizeof(*pkt_capture));
 
-	if (!pkt_capture) {
-		free(pkt_capture);
-		close(sock);
-		rc = ENOMEM;
+	dabba__thread_result_list__init(&batch->result_list);
+	batch->item = capture_batch_new(capture_listp->n_list,
+					&batch->result_list);
+	batch->capture_listp =
+	    (Dabba__CaptureList *) dabbad_worker_msg_dup(&capture_listp->base);
+
+	if (!batch->item || !batch->capture_listp) {
+		if (batch->capture_listp)
+			protobuf_c_message_free_unpacked(&batch->
+							 capture_listp->base,
+							 NULL);
+		free(batch->result_list.list);
+		free(batch->item);
+		free(batch);
 		goto out;
 	}
 
-	pkt_capture->thread.type = CAPTURE_THREAD;
+	batch->job.run = dabbad_capture_start_batch_run;
+	batch->job.done = dabbad_capture_start_batch_done;
+	batch->closure = closure;
+	batch->closure_data = closure_data;
 
-	if (capturep->append)
-		pkt_capture->rx.pcap_fd =
-		    ldab_pcap_open(capturep->pcap, O_RDWR | O_APPEND);
-	else
-		pkt_capture->rx.pcap_fd =
-		    ldab_pcap_create(capturep->pcap, LINKTYPE_EN10MB);
+	dabbad_worker_run(&batch->job);
+	return;
 
-	if (pkt_capture->rx.pcap_fd < 0) {
-		rc = errno;
-		free(pkt_capture);
-		close(sock);
-		goto out;
-	}
+ out:
+	closure(&result_list, closure_data);
+}
 
-	if (capturep->sfp && capturep->sfp->n_filter) {
-		rc = dabbad_pbuf_sfp_2_sfp(capturep->sfp, &pkt_capture->rx.sfp);
+/**
+ * \brief RPC to stop several running captures at once
+ * \param[in]           service	        Pointer to protobuf service structure
+ * \param[in]           id_listp        Pointer to the thread ids to stop
+ * \param[in]           closure         Pointer to protobuf closure function pointer
+ * \param[in,out]       closure_data	Pointer to protobuf closure data
+ * \return Returns the stop status of each capture, in request order, via its
+ * closure function. An empty list is returned if the batch could not be
+ * processed at all.
+ *
+ * All the captures are asked to stop before the first one is waited for, so
+ * that they write the packets left in their ring at the same time.
+ */
 
-		if (rc) {
-			free(pkt_capture);
-			close(sock);
-			goto out;
-		}
+void dabbad_capture_stop_batch(Dabba__DabbaService_Service * service,
+			       const Dabba__ThreadIdList * id_listp,
+			       Dabba__ThreadResultList_Closure closure,
+			       void *closure_data)
+{
+	Dabba__ThreadResultList result_list = DABBA__THREAD_RESULT_LIST__INIT;
+	struct capture_batch_item *item = NULL;
+	struct packet_capture *pkt_capture;
+	size_t a;
 
-		rc = ldab_sock_filter_attach(sock, &pkt_capture->rx.sfp);
+	assert(service);
+	assert(id_listp);
 
-		if (rc) {
-			dabbad_sfp_destroy(&pkt_capture->rx.sfp);
-			free(pkt_capture);
-			close(sock);
-			goto out;
-		}
-	}
+	if (!id_listp->n_list)
+		goto out;
 
-	rc = ldab_packet_mmap_create(&pkt_capture->rx.pkt_mmap,
-				    capturep->interface, sock, PACKET_MMAP_RX,
-				    capturep->frame_size, capturep->frame_nr);
+	item = capture_batch_new(id_listp->n_list, &result_list);
 
-	if (rc) {
-		dabbad_sfp_destroy(&pkt_capture->rx.sfp);
-		free(pkt_capture);
-		close(sock);
+	if (!item)
 		goto out;
+
+	for (a = 0; a < id_listp->n_list; a++) {
+		item[a].id.id = id_listp->list[a]->id;
+		item[a].result.id = &item[a].id;
+		pkt_capture =
+		    dabbad_capture_find((pthread_t) id_listp->list[a]->id);
+
+		if (!pkt_capture)
+			item[a].status.code = EINVAL;
+		else
+			item[a].status.code =
+			    ldab_packet_stop_request(pkt_capture->thread.stop);
 	}
 
-	rc = dabbad_thread_start(&pkt_capture->thread, ldab_packet_rx,
-				 pkt_capture);
+	for (a = 0; a < id_listp->n_list; a++) {
+		if (item[a].status.code)
+			continue;
 
-	if (rc) {
-		ldab_packet_mmap_destroy(&pkt_capture->rx.pkt_mmap);
-		dabbad_sfp_destroy(&pkt_capture->rx.sfp);
-		free(pkt_capture);
-		close(sock);
-	} else
-		dabbad_capture_insert(pkt_capture);
+		/* The same capture may be requested twice */
+		pkt_capture = dabbad_capture_find((pthread_t) item[a].id.id);
+
+		if (!pkt_capture) {
+			item[a].status.code = EINVAL;
+			continue;
+		}
+
+		item[a].status.code = dabbad_capture_destroy(pkt_capture);
+	}
 
  out:
-	capturep->status->code = rc;
-	closure(capturep->status, closure_data);
+	closure(&result_list, closure_data);
+	free(result_list.list);
+	free(item);
 }
 
 /**
@@ -325,6 +1573,8 @@ void dabbad_capture_start(Dabba__DabbaService_Service * service,
  * \param[in]           closure         Pointer to protobuf closure function pointer
  * \param[in,out]       closure_data	Pointer to protobuf closure data
  * \return Returns 0 on success, else on failure via its closure function.
+ * \note The ring residency percentiles are upper bounds in microseconds of
+ * the time sampled frames waited in the ring before being read.
  */
 
 void dabbad_capture_get(Dabba__DabbaService_Service * service,
@@ -333,16 +1583,22 @@ void dabbad_capture_get(Dabba__DabbaService_Service * service,
 {
 	Dabba__CaptureList capture_list = DABBA__CAPTURE_LIST__INIT;
 	Dabba__CaptureList *capturep = NULL;
+	Dabba__Capture *capture;
+	struct arena arena = ARENA_INIT;
 	struct packet_capture *pkt_capture;
-	size_t a = dabbad_capture_length_get();
+	struct packet_thread **sel = NULL;
+	struct packet_rx_counters counters;
+	struct histogram residency;
+	size_t a;
 
 	assert(service);
 	assert(id_listp);
 
-	if (a == 0)
+	if (dabbad_thread_select(CAPTURE_THREAD, id_listp, &sel, &a) || a == 0)
 		goto out;
 
-	capture_list.list = calloc(a, sizeof(*capture_list.list));
+	capture_list.list =
+	    dabbad_arena_array(&arena, a, sizeof(*capture_list.list));
 
 	if (!capture_list.list)
 		goto out;
@@ -350,80 +1606,127 @@ void dabbad_capture_get(Dabba__DabbaService_Service * service,
 	capture_list.n_list = a;
 
 	for (a = 0; a < capture_list.n_list; a++) {
-		capture_list.list[a] = malloc(sizeof(*capture_list.list[a]));
+		capture = dabbad_arena_alloc(&arena, sizeof(*capture));
 
-		if (!capture_list.list[a])
+		if (!capture)
 			goto out;
 
-		dabba__capture__init(capture_list.list[a]);
+		dabba__capture__init(capture);
 
-		capture_list.list[a]->id =
-		    malloc(sizeof(*capture_list.list[a]->id));
-		capture_list.list[a]->status =
-		    malloc(sizeof(*capture_list.list[a]->status));
-		capture_list.list[a]->sfp =
-		    malloc(sizeof(*capture_list.list[a]->sfp));
+		capture->id = dabbad_arena_alloc(&arena, sizeof(*capture->id));
+		capture->status =
+		    dabbad_arena_alloc(&arena, sizeof(*capture->status));
+		capture->sfp = dabbad_arena_alloc(&arena, sizeof(*capture->sfp));
+		capture->trigger =
+		    dabbad_arena_alloc(&arena, sizeof(*capture->trigger));
 
-		capture_list.list[a]->pcap =
-		    calloc(NAME_MAX, sizeof(*capture_list.list[a]->pcap));
-		capture_list.list[a]->interface =
-		    calloc(IFNAMSIZ, sizeof(*capture_list.list[a]->interface));
-
-		if (!capture_list.list[a]->id || !capture_list.list[a]->status
-		    || !capture_list.list[a]->sfp || !capture_list.list[a]->pcap
-		    || !capture_list.list[a]->interface)
+		if (!capture->id || !capture->status || !capture->sfp
+		    || !capture->trigger)
 			goto out;
 
-		dabba__thread_id__init(capture_list.list[a]->id);
-		dabba__error_code__init(capture_list.list[a]->status);
-		dabba__sock_fprog__init(capture_list.list[a]->sfp);
-	}
+		dabba__thread_id__init(capture->id);
+		dabba__error_code__init(capture->status);
+		dabba__sock_fprog__init(capture->sfp);
+		dabba__sock_fprog__init(capture->trigger);
 
-	a = 0;
+		capture_list.list[a] = capture;
+	}
 
-	TAILQ_FOREACH(pkt_capture, &capture_queue.head, entry) {
+	for (a = 0; a < capture_list.n_list; a++) {
+		pkt_capture =
+		    container_of(sel[a], struct packet_capture, thread);
 		capture_list.list[a]->has_frame_nr =
 		    capture_list.list[a]->has_frame_size = 1;
 		capture_list.list[a]->frame_nr =
-		    pkt_capture->rx.pkt_mmap.layout.tp_frame_nr;
+		    pkt_capture->layout.tp_frame_nr;
 		capture_list.list[a]->frame_size =
-		    pkt_capture->rx.pkt_mmap.layout.tp_frame_size;
+		    pkt_capture->layout.tp_frame_size;
+		capture_list.list[a]->has_block_nr =
+		    capture_list.list[a]->has_block_size = 1;
+		capture_list.list[a]->block_nr =
+		    pkt_capture->layout.tp_block_nr;
+		capture_list.list[a]->block_size =
+		    pkt_capture->layout.tp_block_size;
+		capture_list.list[a]->has_frame_high_water = 1;
+		capture_list.list[a]->frame_high_water =
+		    __atomic_load_n(&pkt_capture->rx.resize.high_water,
+				    __ATOMIC_RELAXED);
+
+		if (pkt_capture->grow_threshold) {
+			capture_list.list[a]->has_grow_threshold =
+			    capture_list.list[a]->has_ring_size_max = 1;
+			capture_list.list[a]->grow_threshold =
+			    pkt_capture->grow_threshold;
+			capture_list.list[a]->ring_size_max =
+			    pkt_capture->ring_size_max;
+		}
 		capture_list.list[a]->id->id =
 		    (uint64_t) pkt_capture->thread.id;
 
 		/* TODO report capture health: disk full, link down etc... */
 		capture_list.list[a]->status->code = 0;
 
-		fd_to_path(pkt_capture->rx.pcap_fd, capture_list.list[a]->pcap,
-			   NAME_MAX * sizeof(*capture_list.list[a]->pcap));
-
-		ldab_ifindex_to_devname(pkt_capture->rx.pkt_mmap.ifindex,
-				       capture_list.list[a]->interface,
-				       IFNAMSIZ);
+		/* The strings belong to the capture, they are not duplicated */
+		capture_list.list[a]->pcap =
+		    pkt_capture->pcap ? pkt_capture->pcap : "";
+		capture_list.list[a]->interface = pkt_capture->interface;
+
+		ldab_packet_rx_counters_get(&pkt_capture->rx, &counters);
+		capture_list.list[a]->has_packet_count =
+		    capture_list.list[a]->has_byte_count =
+		    capture_list.list[a]->has_kept_count = 1;
+		capture_list.list[a]->packet_count = counters.packets;
+		capture_list.list[a]->byte_count = counters.bytes;
+		capture_list.list[a]->kept_count = counters.kept;
+
+		ldab_histogram_get(&pkt_capture->rx.residency, &residency);
+		capture = capture_list.list[a];
+		capture->has_residency_count = capture->has_residency_p50 =
+		    capture->has_residency_p90 = capture->has_residency_p99 =
+		    capture->has_residency_max = 1;
+		capture->residency_count = ldab_histogram_count(&residency);
+		capture->residency_p50 =
+		    ldab_histogram_percentile(&residency, 50);
+		capture->residency_p90 =
+		    ldab_histogram_percentile(&residency, 90);
+		capture->residency_p99 =
+		    ldab_histogram_percentile(&residency, 99);
+		capture->residency_max =
+		    ldab_histogram_percentile(&residency, 100);
+
+		capture_list.list[a]->has_snaplen =
+		    capture_list.list[a]->has_sampling = 1;
+		capture_list.list[a]->snaplen =
+		    __atomic_load_n(&pkt_capture->rx.snaplen, __ATOMIC_RELAXED);
+		capture_list.list[a]->sampling =
+		    __atomic_load_n(&pkt_capture->rx.sampling, __ATOMIC_RELAXED);
+
+		if (packet_buffer_is_enabled(&pkt_capture->rx.buffer)) {
+			capture_list.list[a]->has_buffer_size =
+			    capture_list.list[a]->has_buffer_duration = 1;
+			capture_list.list[a]->buffer_size =
+			    pkt_capture->rx.buffer.size;
+			capture_list.list[a]->buffer_duration =
+			    pkt_capture->rx.buffer.duration;
+		}
 
-		dabbad_sfp_2_pbuf_sfp(&pkt_capture->rx.sfp,
+		dabbad_sfp_2_pbuf_sfp(&arena, &pkt_capture->rx.sfp,
 				      capture_list.list[a]->sfp);
 
-		a++;
+		if (pkt_capture->rx.trigger.sfp.len) {
+			dabbad_sfp_2_pbuf_sfp(&arena,
+					      &pkt_capture->rx.trigger.sfp,
+					      capture_list.list[a]->trigger);
+			capture_list.list[a]->has_trigger_window = 1;
+			capture_list.list[a]->trigger_window =
+			    pkt_capture->rx.trigger.window;
+		}
 	}
 
 	capturep = &capture_list;
 
  out:
 	closure(capturep, closure_data);
-
-	for (a = 0; a < capture_list.n_list; a++) {
-		if (capture_list.list[a]) {
-			dabbad_pbuf_sfp_destroy(capture_list.list[a]->sfp);
-			free(capture_list.list[a]->sfp);
-			free(capture_list.list[a]->id);
-			free(capture_list.list[a]->status);
-			free(capture_list.list[a]->pcap);
-			free(capture_list.list[a]->interface);
-		}
-
-		free(capture_list.list[a]);
-	}
-
-	free(capture_list.list);
+	dabbad_arena_release(&arena);
+	free(sel);
 }
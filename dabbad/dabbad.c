@@ -113,8 +113,15 @@ Written by Emmanuel Roullit <emmanuel.roullit@gmail.com>
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <signal.h>
+#include <syslog.h>
 
 #include <dabbad/rpc.h>
+#include <dabbad/capture.h>
+#include <dabbad/capture-policy.h>
+#include <dabbad/capture-pool.h>
+#include <dabbad/memory.h>
+#include <dabbad/replay.h>
+#include <dabbad/worker.h>
 #include <dabbad/misc.h>
 #include <dabbad/help.h>
 
@@ -137,10 +144,19 @@ static void atexit_cleanup(void)
 	dabbad_rpc_server_stop(conf.server);
 }
 
+/**
+ * \brief Termination signal handler
+ * \param[in]       arg	        Received signal
+ *
+ * The RPC message polling stops and \c main() stops the running captures and
+ * replays in order, so that they write the packets they hold, before
+ * cleaning up.
+ */
+
 static void exit_cleanup(int arg)
 {
-	atexit_cleanup();
-	exit(arg);
+	(void)arg;
+	dabbad_rpc_msg_poll_stop();
 }
 
 /**
@@ -219,10 +235,8 @@ int main(int argc, char **argv)
 		}
 	}
 
-	signal(SIGTERM, exit_cleanup);
-	signal(SIGINT, exit_cleanup);
-	signal(SIGQUIT, exit_cleanup);
 	core_enable();
+	dabbad_memory_init();
 
 	if (!rc) {
 		conf.server =
@@ -232,6 +246,12 @@ int main(int argc, char **argv)
 			rc = EINVAL;
 	}
 
+	if (!rc) {
+		signal(SIGTERM, exit_cleanup);
+		signal(SIGINT, exit_cleanup);
+		signal(SIGQUIT, exit_cleanup);
+	}
+
 	if (!rc && daemonize)
 		if (daemon(-1, 0))
 			rc = errno;
@@ -239,5 +259,21 @@ int main(int argc, char **argv)
 	if (!rc && conf.pidfile)
 		rc = create_pidfile(conf.pidfile);
 
-	return rc ? rc : dabbad_rpc_msg_poll();
+	if (rc)
+		return rc;
+
+	/* Threads do not survive daemon(3), workers are started afterwards */
+	if (dabbad_worker_pool_start(WORKER_POOL_SIZE))
+		syslog(LOG_WARNING, "slow RPCs are run without worker threads");
+
+	rc = dabbad_rpc_msg_poll();
+
+	dabbad_worker_pool_stop();
+	dabbad_capture_policy_shutdown();
+	dabbad_capture_pool_shutdown();
+	dabbad_capture_shutdown();
+	dabbad_replay_shutdown();
+	atexit_cleanup();
+
+	return rc;
 }
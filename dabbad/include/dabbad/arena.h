@@ -0,0 +1,48 @@
+/**
+ * \file arena.h
+ * \author written by Emmanuel Roullit emmanuel.roullit@gmail.com (c) 2013
+ * \date 2013
+ */
+
+
+#ifndef ARENA_H
+#define	ARENA_H
+
+#include <stddef.h>
+
+/**
+ * \brief Size of the first memory chunk of an arena
+ */
+
+#define ARENA_CHUNK_SIZE 4096
+
+/**
+ * \brief Largest size a growing arena chunk can reach
+ */
+
+#define ARENA_CHUNK_SIZE_MAX (1024 * 1024)
+
+struct arena_chunk;
+
+/**
+ * \brief Memory arena releasing all its allocations at once
+ */
+
+struct arena {
+	struct arena_chunk *chunk; /**< chunk currently allocated from */
+};
+
+/**
+ * \brief Static initializer of an empty arena
+ */
+
+#define ARENA_INIT { NULL }
+
+void *dabbad_arena_alloc(struct arena *arena, const size_t size);
+void *dabbad_arena_array(struct arena *arena, const size_t nmemb,
+			 const size_t size);
+char *dabbad_arena_strndup(struct arena *arena, const char *const str,
+			   const size_t len);
+void dabbad_arena_release(struct arena *arena);
+
+#endif				/* ARENA_H */
@@ -0,0 +1,41 @@
+/**
+ * \file capture-policy.h
+ * \author written by Emmanuel Roullit emmanuel.roullit@gmail.com (c) 2013
+ * \date 2013
+ */
+
+
+#ifndef CAPTURE_POLICY_H
+#define	CAPTURE_POLICY_H
+
+#include <sys/queue.h>
+#include <libdabba-rpc/rpc.h>
+
+/**
+ * \brief Capture started on each interface matching a name glob
+ */
+
+struct capture_policy {
+	char *name; /**< unique name of the policy */
+	Dabba__Capture *capturep; /**< capture settings, its interface is the glob */
+	 TAILQ_ENTRY(capture_policy) entry; /**< policy list entry */
+};
+
+void dabbad_capture_policy_shutdown(void);
+
+void dabbad_capture_policy_get(Dabba__DabbaService_Service * service,
+			       const Dabba__Dummy * dummyp,
+			       Dabba__CapturePolicyList_Closure closure,
+			       void *closure_data);
+
+void dabbad_capture_policy_add(Dabba__DabbaService_Service * service,
+			       const Dabba__CapturePolicy * policyp,
+			       Dabba__ErrorCode_Closure closure,
+			       void *closure_data);
+
+void dabbad_capture_policy_remove(Dabba__DabbaService_Service * service,
+				  const Dabba__CapturePolicy * policyp,
+				  Dabba__ErrorCode_Closure closure,
+				  void *closure_data);
+
+#endif				/* CAPTURE_POLICY_H */
@@ -0,0 +1,40 @@
+/**
+ * \file capture-pool.h
+ * \author written by Emmanuel Roullit emmanuel.roullit@gmail.com (c) 2013
+ * \date 2013
+ */
+
+
+#ifndef CAPTURE_POOL_H
+#define	CAPTURE_POOL_H
+
+#include <libdabba/packet-mmap.h>
+#include <libdabba-rpc/rpc.h>
+
+/**
+ * \brief Largest amount of capture rings the pool can keep ready
+ */
+
+#define CAPTURE_POOL_SIZE_MAX 64
+
+/**
+ * \brief Amount of frames of the pooled rings until configured otherwise
+ */
+
+#define CAPTURE_POOL_DEFAULT_FRAME_NR 32
+
+int dabbad_capture_pool_take(const Dabba__Capture * capturep,
+			     struct packet_mmap *pkt_mmap);
+void dabbad_capture_pool_shutdown(void);
+
+void dabbad_capture_pool_get(Dabba__DabbaService_Service * service,
+			     const Dabba__Dummy * dummyp,
+			     Dabba__CapturePool_Closure closure,
+			     void *closure_data);
+
+void dabbad_capture_pool_modify(Dabba__DabbaService_Service * service,
+				const Dabba__CapturePool * poolp,
+				Dabba__ErrorCode_Closure closure,
+				void *closure_data);
+
+#endif				/* CAPTURE_POOL_H */
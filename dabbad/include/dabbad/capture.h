@@ -12,6 +12,8 @@
 #include <libdabba/packet-rx.h>
 #include <libdabba-rpc/rpc.h>
 
+struct capture_policy;
+
 /**
  * \brief Structure representing a capture thread
  */
@@ -19,10 +21,27 @@
 struct packet_capture {
 	struct packet_rx rx; /**< packet capture structure */
 	struct packet_thread thread; /**< thread structure */
-	 TAILQ_ENTRY(packet_capture) entry;/**< capture entry */
+	struct tpacket_req layout; /**< layout of the ring in use, only updated by the RPC dispatcher */
+	uint32_t grow_threshold; /**< ring occupancy percentage growing the ring, 0 if disabled */
+	uint64_t ring_size_max; /**< largest ring size in bytes the ring can grow to */
+	char *pcap; /**< absolute path of the pcap file, \c NULL if none */
+	char *interface; /**< name of the captured interface */
+	const struct capture_policy *policy; /**< policy which started the capture, \c NULL if none */
+	Dabba__ErrorCode_Closure resize_closure; /**< reply of the resize request waiting for a ring switch, \c NULL if none */
+	void *resize_closure_data; /**< data of the pending resize reply */
+	struct capture_dump_job *dump; /**< buffer dump running on a worker, \c NULL if none */
 };
 
 struct packet_thread *dabbad_capture_thread_data_get(const pthread_t thread_id);
+struct packet_capture *dabbad_capture_next(struct packet_capture
+					   *pkt_capture);
+int dabbad_capture_settings_are_valid(const Dabba__Capture * capturep);
+int dabbad_capture_layout_get(const Dabba__Capture * capturep,
+			      struct tpacket_req *layout);
+int dabbad_capture_create(const Dabba__Capture * capturep,
+			  struct packet_capture **pkt_capturep);
+int dabbad_capture_destroy(struct packet_capture *pkt_capture);
+int dabbad_capture_shutdown(void);
 
 void dabbad_capture_stop(Dabba__DabbaService_Service * service,
 			 const Dabba__ThreadId * idp,
@@ -41,4 +60,28 @@ void dabbad_capture_stop_all(Dabba__DabbaService_Service * service,
 			     Dabba__ErrorCode_Closure closure,
 			     void *closure_data);
 
+void dabbad_capture_dump(Dabba__DabbaService_Service * service,
+			 const Dabba__CaptureDump * dumpp,
+			 Dabba__ErrorCode_Closure closure, void *closure_data);
+
+void dabbad_capture_modify(Dabba__DabbaService_Service * service,
+			   const Dabba__Capture * capturep,
+			   Dabba__ErrorCode_Closure closure,
+			   void *closure_data);
+
+void dabbad_capture_resize(Dabba__DabbaService_Service * service,
+			   const Dabba__CaptureResize * resizep,
+			   Dabba__ErrorCode_Closure closure,
+			   void *closure_data);
+
+void dabbad_capture_start_batch(Dabba__DabbaService_Service * service,
+				const Dabba__CaptureList * capture_listp,
+				Dabba__ThreadResultList_Closure closure,
+				void *closure_data);
+
+void dabbad_capture_stop_batch(Dabba__DabbaService_Service * service,
+			       const Dabba__ThreadIdList * id_listp,
+			       Dabba__ThreadResultList_Closure closure,
+			       void *closure_data);
+
 #endif				/* CAPTURE_H */
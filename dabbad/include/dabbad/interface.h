@@ -2,12 +2,43 @@
 #ifndef INTERFACE_H
 #define	INTERFACE_H
 
+#include <stddef.h>
+#include <libdabba-rpc/rpc.h>
+
+struct arena;
 struct nl_cache;
+struct nl_object;
 struct nl_sock;
 struct rtnl_link;
 
+/**
+ * \brief Interface list reply under construction
+ */
+
+struct interface_reply {
+	void *list;		/**< protobuf interface list message to fill */
+	size_t size;		/**< amount of messages the list can hold */
+	struct arena *arena;	/**< arena the reply is allocated from */
+};
+
+/**
+ * \brief Function notified of an interface change
+ */
+
+typedef void (*link_change_fn) (struct nl_cache * cache,
+				struct nl_object * obj, int action, void *arg);
+
+int link_cache_mngr_start(void);
+void link_cache_mngr_stop(void);
+void link_cache_mngr_notify(link_change_fn change, void *arg);
+int link_cache_is_managed(const struct nl_cache *cache);
 struct nl_cache *link_cache_alloc(struct nl_sock **sock);
 void link_cache_destroy(struct nl_sock *sock, struct nl_cache *cache);
 void link_destroy(struct rtnl_link *link);
+size_t link_cache_reply_size(struct nl_cache *cache,
+			     const Dabba__InterfaceIdList * id_list);
+void link_cache_foreach(struct nl_cache *cache,
+			const Dabba__InterfaceIdList * id_list,
+			void (*cb) (struct nl_object *, void *), void *arg);
 
 #endif				/* INTERFACE_H */
@@ -0,0 +1,41 @@
+/**
+ * \file memory.h
+ * \author written by Emmanuel Roullit emmanuel.roullit@gmail.com (c) 2013
+ * \date 2013
+ */
+
+
+#ifndef MEMORY_H
+#define	MEMORY_H
+
+#include <stdint.h>
+#include <linux/if_packet.h>
+#include <libdabba-rpc/rpc.h>
+
+/**
+ * \brief Kinds of memory accounted against the daemon memory budget
+ */
+
+enum memory_type {
+	MEMORY_RING,		/**< capture packet mmap rings */
+	MEMORY_BUFFER,		/**< capture in-memory packet buffers */
+	MEMORY_REPLAY,		/**< replay packet mmap rings */
+	MEMORY_TYPE_NR
+};
+
+void dabbad_memory_init(void);
+int dabbad_memory_reserve(const enum memory_type type, const uint64_t size);
+int dabbad_memory_ring_reserve(const enum memory_type type,
+			       struct tpacket_req *layout);
+void dabbad_memory_release(const enum memory_type type, const uint64_t size);
+
+void dabbad_memory_get(Dabba__DabbaService_Service * service,
+		       const Dabba__Dummy * dummyp,
+		       Dabba__Memory_Closure closure, void *closure_data);
+
+void dabbad_memory_modify(Dabba__DabbaService_Service * service,
+			  const Dabba__Memory * memoryp,
+			  Dabba__ErrorCode_Closure closure,
+			  void *closure_data);
+
+#endif				/* MEMORY_H */
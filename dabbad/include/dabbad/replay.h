@@ -19,10 +19,12 @@
 struct packet_replay {
 	struct packet_tx tx; /**< packet replay structure */
 	struct packet_thread thread; /**< thread structure */
-	 TAILQ_ENTRY(packet_replay) entry;/**< replay entry */
+	char *pcap; /**< absolute path of the replayed pcap file */
+	char *interface; /**< name of the interface the packets are sent on */
 };
 
 struct packet_thread *dabbad_replay_thread_data_get(const pthread_t thread_id);
+int dabbad_replay_shutdown(void);
 
 void dabbad_replay_stop(Dabba__DabbaService_Service * service,
 			const Dabba__ThreadId * idp,
@@ -9,5 +9,6 @@ ProtobufC_RPC_Server *dabbad_rpc_server_start(const char *const name,
 					      type);
 void dabbad_rpc_server_stop(ProtobufC_RPC_Server * server);
 int dabbad_rpc_msg_poll(void);
+void dabbad_rpc_msg_poll_stop(void);
 
 #endif				/* DABBAD_RPC_H */
@@ -9,18 +9,60 @@
 #define	DABBAD_THREAD_H
 
 #include <assert.h>
+#include <stdint.h>
 #include <sched.h>
+#include <sys/types.h>
 #include <pthread.h>
 #include <sys/queue.h>
+#include <libdabba/numa.h>
+#include <libdabba/packet-stop.h>
 #include <libdabba-rpc/rpc.h>
 
+/**
+ * \brief CPU affinity following the CPUs which receive the thread packets
+ */
+
+#define THREAD_CPU_AFFINITY_AUTO "auto"
+
+/**
+ * \brief Amount of stack touched by a thread before running its function
+ */
+
+#define THREAD_STACK_PREFAULT_SIZE (256 * 1024)
+
+/**
+ * \brief Longest time in seconds a stopping thread has to finish its work
+ */
+
+#define THREAD_STOP_TIMEOUT 2
+
+/**
+ * \brief Amount of hash buckets indexing the thread registry by thread id
+ */
+
+#define THREAD_REGISTRY_BUCKETS 256
+
 /**
  * \brief Supported thread types
  */
 
 enum packet_thread_type {
 	CAPTURE_THREAD,
-	REPLAY_THREAD
+	REPLAY_THREAD,
+	ANY_THREAD /**< only used to look for threads of all types */
+};
+
+/**
+ * \brief Settings applied to a thread when it is created
+ */
+
+struct packet_thread_settings {
+	int has_sched_policy;
+	int sched_policy;
+	int has_sched_priority;
+	int sched_priority;
+	const char *cpu_set; /**< CPU list or "auto", \c NULL for the default */
+	int stack_prefault; /**< non-zero to touch the stack before running */
 };
 
 /**
@@ -29,8 +71,29 @@ enum packet_thread_type {
 
 struct packet_thread {
 	pthread_t id;
+	pid_t tid; /**< kernel thread id, 0 until the thread runs */
 	enum packet_thread_type type;
-	 TAILQ_ENTRY(packet_thread) entry;
+	int numa_node; /**< NUMA node the thread runs on, \c NUMA_NODE_NONE if any */
+	int ifindex; /**< index of the interface the thread works on */
+	int stack_prefault; /**< non-zero to touch the stack before running */
+	void *(*func) (void *arg); /**< function run by the thread */
+	void *arg; /**< argument of the thread function */
+	struct packet_stop *stop; /**< stop request polled by the thread */
+	 TAILQ_ENTRY(packet_thread) entry; /**< registry entry */
+	 LIST_ENTRY(packet_thread) bucket; /**< registry hash bucket entry */
+};
+
+/**
+ * \brief CPU usage and scheduling statistics of a running thread
+ */
+
+struct packet_thread_usage {
+	uint64_t cpu_time; /**< CPU time used by the thread in nanoseconds */
+	uint64_t voluntary_switches; /**< times the thread gave up its CPU */
+	uint64_t involuntary_switches; /**< times the thread was preempted */
+	int cpu; /**< CPU the thread last ran on */
+	int has_wait_time; /**< non-zero if the kernel reports the wait time */
+	uint64_t wait_time; /**< time spent waiting for a CPU in nanoseconds */
 };
 
 struct packet_thread *dabbad_thread_type_first(const enum packet_thread_type
@@ -39,6 +102,10 @@ struct packet_thread *dabbad_thread_type_next(struct packet_thread *pkt_thread,
 					      const enum packet_thread_type
 					      type);
 struct packet_thread *dabbad_thread_data_get(const pthread_t thread_id);
+size_t dabbad_thread_length_get(const enum packet_thread_type type);
+int dabbad_thread_select(const enum packet_thread_type type,
+			 const Dabba__ThreadIdList * id_listp,
+			 struct packet_thread ***selp, size_t * nr);
 int dabbad_thread_sched_param_set(struct packet_thread *pkt_thread,
 				  const int16_t sched_prio,
 				  const int16_t sched_policy);
@@ -48,7 +115,14 @@ int dabbad_thread_sched_affinity_set(struct packet_thread *pkt_thread,
 				     cpu_set_t * run_on);
 int dabbad_thread_sched_affinity_get(struct packet_thread *pkt_thread,
 				     cpu_set_t * run_on);
+int dabbad_thread_usage_get(struct packet_thread *pkt_thread,
+			    struct packet_thread_usage *usage);
+int dabbad_thread_numa_prepare(struct packet_thread *pkt_thread,
+			       const char *const dev, const int has_node,
+			       const int node);
+void dabbad_thread_register(struct packet_thread *const node);
 int dabbad_thread_start(struct packet_thread *pkt_thread,
+			const struct packet_thread_settings *settings,
 			void *(*func) (void *arg), void *arg);
 int dabbad_thread_stop(struct packet_thread *pkt_thread);
 
@@ -0,0 +1,54 @@
+/**
+ * \file worker.h
+ * \author written by Emmanuel Roullit emmanuel.roullit@gmail.com (c) 2013
+ * \date 2013
+ */
+
+
+#ifndef WORKER_H
+#define	WORKER_H
+
+#include <stddef.h>
+#include <sys/queue.h>
+#include <libdabba-rpc/rpc.h>
+
+/**
+ * \brief Amount of items each thread of a parallel query gets at least
+ */
+
+#define WORKER_PARALLEL_MIN 64
+
+/**
+ * \brief Largest amount of threads running a parallel query
+ */
+
+#define WORKER_PARALLEL_MAX 8
+
+/**
+ * \brief Amount of worker threads running slow RPC handlers
+ * \note Parallel queries are helped by the workers, so that a full parallel
+ * query can run next to the calling thread.
+ */
+
+#define WORKER_POOL_SIZE (WORKER_PARALLEL_MAX - 1)
+
+/**
+ * \brief Slow RPC work run outside of the RPC dispatcher
+ */
+
+struct worker_job {
+	void (*run) (struct worker_job * job); /**< slow work, run by a worker */
+	void (*done) (struct worker_job * job); /**< completion, run by the dispatcher */
+	 TAILQ_ENTRY(worker_job) entry; /**< job queue entry */
+};
+
+int dabbad_worker_pool_start(const size_t nr);
+void dabbad_worker_pool_stop(void);
+void dabbad_worker_run(struct worker_job *job);
+ProtobufCMessage *dabbad_worker_msg_dup(const ProtobufCMessage * msg);
+void dabbad_worker_parallel_split(void (*fn) (void *arg, const size_t idx),
+				  void *arg, const size_t nr, const size_t min);
+void dabbad_worker_parallel(void (*fn) (void *arg, const size_t idx),
+			    void *arg, const size_t nr);
+
+#endif				/* WORKER_H */
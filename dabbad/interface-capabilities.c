@@ -16,175 +16,80 @@
 #include <netlink/cache.h>
 #include <netlink/route/link.h>
 #include <libdabba/interface.h>
+#include <dabbad/arena.h>
 #include <dabbad/interface.h>
 #include <dabbad/interface-capabilities.h>
+#include <dabbad/worker.h>
 
 /**
  * \internal
- * \brief Get the capabilities of a network interface
- * \param[in]           obj	        Pointer to interface netlink structure
- * \param[in]           arg             Pointer to interface capabilities protobuf message
- * \note Might silently skip an interface if memory could not be allocated.
+ * \brief Allocate interface option capabilities from an arena
+ * \param[in,out]       arena	        Arena to allocate from
+ * \return Pointer to the new message, \c NULL if memory could not be allocated
  */
 
-static void __interface_capabilities_get(struct nl_object *obj, void *arg)
+static Dabba__InterfaceOptionCapabilites
+    *interface_option_capabilities_new(struct arena *arena)
 {
-	struct rtnl_link *link = (struct rtnl_link *)obj;
-	Dabba__InterfaceCapabilitiesList *capabilities_list = arg;
-	Dabba__InterfaceCapabilities *capabilitiesp, **listpp;
-	size_t lsize =
-	    sizeof(*capabilities_list->list) * (capabilities_list->n_list + 1);
-	struct ethtool_cmd capabilities;
+	Dabba__InterfaceOptionCapabilites *opt;
 
-	listpp = realloc(capabilities_list->list, lsize);
+	opt = dabbad_arena_alloc(arena, sizeof(*opt));
 
-	if (!listpp)
-		return;
+	if (opt)
+		dabba__interface_option_capabilites__init(opt);
 
-	capabilities_list->list = listpp;
-	capabilities_list->list[capabilities_list->n_list] =
-	    malloc(sizeof(*capabilities_list->list[capabilities_list->n_list]));
-	capabilitiesp = capabilities_list->list[capabilities_list->n_list];
+	return opt;
+}
 
-	if (!capabilitiesp)
-		return;
+/**
+ * \internal
+ * \brief Allocate interface speed capabilities from an arena
+ * \param[in,out]       arena	        Arena to allocate from
+ * \return Pointer to the new message, \c NULL if memory could not be allocated
+ * \note The duplex capabilities of every speed are allocated as well.
+ */
 
-	dabba__interface_capabilities__init(capabilitiesp);
+static Dabba__InterfaceSpeedCapabilites
+    *interface_speed_capabilities_new(struct arena *arena)
+{
+	Dabba__InterfaceSpeedCapabilites *speed;
+	Dabba__InterfaceDuplexCapabilites *duplex;
+	size_t a, nr = 4;
 
-	capabilitiesp->id = malloc(sizeof(*capabilitiesp->id));
-	capabilitiesp->status = malloc(sizeof(*capabilitiesp->status));
-	capabilitiesp->supported_opt =
-	    malloc(sizeof(*capabilitiesp->supported_opt));
-	capabilitiesp->supported_speed =
-	    malloc(sizeof(*capabilitiesp->supported_speed));
-	capabilitiesp->advertising_opt =
-	    malloc(sizeof(*capabilitiesp->advertising_opt));
-	capabilitiesp->advertising_speed =
-	    malloc(sizeof(*capabilitiesp->advertising_speed));
-	capabilitiesp->lp_advertising_opt =
-	    malloc(sizeof(*capabilitiesp->lp_advertising_opt));
-	capabilitiesp->lp_advertising_speed =
-	    malloc(sizeof(*capabilitiesp->lp_advertising_speed));
+	speed = dabbad_arena_alloc(arena, sizeof(*speed));
+	duplex = dabbad_arena_array(arena, nr, sizeof(*duplex));
 
-	if (!capabilitiesp->id || !capabilitiesp->status
-	    || !capabilitiesp->supported_opt || !capabilitiesp->supported_speed
-	    || !capabilitiesp->advertising_opt
-	    || !capabilitiesp->advertising_speed
-	    || !capabilitiesp->lp_advertising_opt
-	    || !capabilitiesp->lp_advertising_speed) {
-		free(capabilitiesp->id);
-		free(capabilitiesp->status);
-		free(capabilitiesp->supported_opt);
-		free(capabilitiesp->supported_speed);
-		free(capabilitiesp->advertising_opt);
-		free(capabilitiesp->advertising_speed);
-		free(capabilitiesp->lp_advertising_opt);
-		free(capabilitiesp->lp_advertising_speed);
-		free(capabilitiesp);
-		return;
-	}
+	if (!speed || !duplex)
+		return NULL;
 
-	dabba__interface_id__init(capabilitiesp->id);
-	dabba__error_code__init(capabilitiesp->status);
-	dabba__interface_speed_capabilites__init
-	    (capabilitiesp->supported_speed);
-	dabba__interface_option_capabilites__init(capabilitiesp->supported_opt);
-	dabba__interface_speed_capabilites__init
-	    (capabilitiesp->advertising_speed);
-	dabba__interface_option_capabilites__init
-	    (capabilitiesp->advertising_opt);
-	dabba__interface_speed_capabilites__init
-	    (capabilitiesp->lp_advertising_speed);
-	dabba__interface_option_capabilites__init
-	    (capabilitiesp->lp_advertising_opt);
-
-	capabilitiesp->supported_speed->ethernet =
-	    malloc(sizeof(*capabilitiesp->supported_speed->ethernet));
-	capabilitiesp->supported_speed->fast_ethernet =
-	    malloc(sizeof(*capabilitiesp->supported_speed->fast_ethernet));
-	capabilitiesp->supported_speed->gbps_ethernet =
-	    malloc(sizeof(*capabilitiesp->supported_speed->gbps_ethernet));
-	capabilitiesp->supported_speed->_10gbps_ethernet =
-	    malloc(sizeof(*capabilitiesp->supported_speed->_10gbps_ethernet));
-	capabilitiesp->advertising_speed->ethernet =
-	    malloc(sizeof(*capabilitiesp->advertising_speed->ethernet));
-	capabilitiesp->advertising_speed->fast_ethernet =
-	    malloc(sizeof(*capabilitiesp->advertising_speed->fast_ethernet));
-	capabilitiesp->advertising_speed->gbps_ethernet =
-	    malloc(sizeof(*capabilitiesp->advertising_speed->gbps_ethernet));
-	capabilitiesp->advertising_speed->_10gbps_ethernet =
-	    malloc(sizeof(*capabilitiesp->advertising_speed->_10gbps_ethernet));
-	capabilitiesp->lp_advertising_speed->ethernet =
-	    malloc(sizeof(*capabilitiesp->lp_advertising_speed->ethernet));
-	capabilitiesp->lp_advertising_speed->fast_ethernet =
-	    malloc(sizeof(*capabilitiesp->lp_advertising_speed->fast_ethernet));
-	capabilitiesp->lp_advertising_speed->gbps_ethernet =
-	    malloc(sizeof(*capabilitiesp->lp_advertising_speed->gbps_ethernet));
-	capabilitiesp->lp_advertising_speed->_10gbps_ethernet =
-	    malloc(sizeof
-		   (*capabilitiesp->lp_advertising_speed->_10gbps_ethernet));
-
-	if (!capabilitiesp->supported_speed->ethernet
-	    || !capabilitiesp->supported_speed->fast_ethernet
-	    || !capabilitiesp->supported_speed->gbps_ethernet
-	    || !capabilitiesp->supported_speed->_10gbps_ethernet
-	    || !capabilitiesp->advertising_speed->ethernet
-	    || !capabilitiesp->advertising_speed->fast_ethernet
-	    || !capabilitiesp->advertising_speed->gbps_ethernet
-	    || !capabilitiesp->advertising_speed->_10gbps_ethernet
-	    || !capabilitiesp->lp_advertising_speed->ethernet
-	    || !capabilitiesp->lp_advertising_speed->fast_ethernet
-	    || !capabilitiesp->lp_advertising_speed->gbps_ethernet
-	    || !capabilitiesp->lp_advertising_speed->_10gbps_ethernet) {
-		free(capabilitiesp->supported_speed->ethernet);
-		free(capabilitiesp->supported_speed->fast_ethernet);
-		free(capabilitiesp->supported_speed->gbps_ethernet);
-		free(capabilitiesp->supported_speed->_10gbps_ethernet);
-		free(capabilitiesp->advertising_speed->ethernet);
-		free(capabilitiesp->advertising_speed->fast_ethernet);
-		free(capabilitiesp->advertising_speed->gbps_ethernet);
-		free(capabilitiesp->advertising_speed->_10gbps_ethernet);
-		free(capabilitiesp->lp_advertising_speed->ethernet);
-		free(capabilitiesp->lp_advertising_speed->fast_ethernet);
-		free(capabilitiesp->lp_advertising_speed->gbps_ethernet);
-		free(capabilitiesp->lp_advertising_speed->_10gbps_ethernet);
-		free(capabilitiesp->id);
-		free(capabilitiesp->status);
-		free(capabilitiesp->supported_opt);
-		free(capabilitiesp->supported_speed);
-		free(capabilitiesp->advertising_opt);
-		free(capabilitiesp->advertising_speed);
-		free(capabilitiesp->lp_advertising_opt);
-		free(capabilitiesp->lp_advertising_speed);
-		free(capabilitiesp);
-	}
+	dabba__interface_speed_capabilites__init(speed);
 
-	dabba__interface_duplex_capabilites__init
-	    (capabilitiesp->supported_speed->ethernet);
-	dabba__interface_duplex_capabilites__init
-	    (capabilitiesp->supported_speed->fast_ethernet);
-	dabba__interface_duplex_capabilites__init
-	    (capabilitiesp->supported_speed->gbps_ethernet);
-	dabba__interface_duplex_capabilites__init
-	    (capabilitiesp->supported_speed->_10gbps_ethernet);
-	dabba__interface_duplex_capabilites__init
-	    (capabilitiesp->advertising_speed->ethernet);
-	dabba__interface_duplex_capabilites__init
-	    (capabilitiesp->advertising_speed->fast_ethernet);
-	dabba__interface_duplex_capabilites__init
-	    (capabilitiesp->advertising_speed->gbps_ethernet);
-	dabba__interface_duplex_capabilites__init
-	    (capabilitiesp->advertising_speed->_10gbps_ethernet);
-	dabba__interface_duplex_capabilites__init
-	    (capabilitiesp->lp_advertising_speed->ethernet);
-	dabba__interface_duplex_capabilites__init
-	    (capabilitiesp->lp_advertising_speed->fast_ethernet);
-	dabba__interface_duplex_capabilites__init
-	    (capabilitiesp->lp_advertising_speed->gbps_ethernet);
-	dabba__interface_duplex_capabilites__init
-	    (capabilitiesp->lp_advertising_speed->_10gbps_ethernet);
+	for (a = 0; a < nr; a++)
+		dabba__interface_duplex_capabilites__init(&duplex[a]);
+
+	speed->ethernet = &duplex[0];
+	speed->fast_ethernet = &duplex[1];
+	speed->gbps_ethernet = &duplex[2];
+	speed->_10gbps_ethernet = &duplex[3];
+
+	return speed;
+}
+
+/**
+ * \internal
+ * \brief Query the capabilities of a listed network interface
+ * \param[in,out]       arg	        Pointer to interface capabilities list
+ * \param[in]           idx	        Index of the interface in the list
+ * \note Runs concurrently with the queries of the other listed interfaces.
+ */
+
+static void interface_capabilities_query(void *arg, const size_t idx)
+{
+	Dabba__InterfaceCapabilitiesList *capabilities_list = arg;
+	Dabba__InterfaceCapabilities *capabilitiesp =
+	    capabilities_list->list[idx];
+	struct ethtool_cmd capabilities;
 
-	capabilitiesp->id->name = rtnl_link_get_name(link);
 	capabilitiesp->status->code =
 	    ldab_dev_settings_get(capabilitiesp->id->name, &capabilities);
 
@@ -292,8 +197,67 @@ static void __interface_capabilities_get(struct nl_object *obj, void *arg)
 	    (capabilities.lp_advertising & ADVERTISED_Autoneg);
 	capabilitiesp->lp_advertising_opt->pause =
 	    (capabilities.lp_advertising & ADVERTISED_Pause);
+}
+
+/**
+ * \internal
+ * \brief Add the capabilities of a network interface to a list reply
+ * \param[in]           obj	        Pointer to interface netlink structure
+ * \param[in]           arg             Pointer to interface capabilities list reply
+ * \note Might silently skip an interface if memory could not be allocated.
+ * \note The capabilities are queried afterwards by
+ *       \c interface_capabilities_query().
+ */
+
+static void __interface_capabilities_get(struct nl_object *obj, void *arg)
+{
+	struct rtnl_link *link = (struct rtnl_link *)obj;
+	struct interface_reply *reply = arg;
+	Dabba__InterfaceCapabilitiesList *capabilities_list = reply->list;
+	Dabba__InterfaceCapabilities *capabilitiesp;
+
+	if (capabilities_list->n_list >= reply->size)
+		return;
+
+	capabilitiesp =
+	    dabbad_arena_alloc(reply->arena, sizeof(*capabilitiesp));
+
+	if (!capabilitiesp)
+		return;
+
+	dabba__interface_capabilities__init(capabilitiesp);
+
+	capabilitiesp->id =
+	    dabbad_arena_alloc(reply->arena, sizeof(*capabilitiesp->id));
+	capabilitiesp->status =
+	    dabbad_arena_alloc(reply->arena, sizeof(*capabilitiesp->status));
+	capabilitiesp->supported_opt =
+	    interface_option_capabilities_new(reply->arena);
+	capabilitiesp->advertising_opt =
+	    interface_option_capabilities_new(reply->arena);
+	capabilitiesp->lp_advertising_opt =
+	    interface_option_capabilities_new(reply->arena);
+	capabilitiesp->supported_speed =
+	    interface_speed_capabilities_new(reply->arena);
+	capabilitiesp->advertising_speed =
+	    interface_speed_capabilities_new(reply->arena);
+	capabilitiesp->lp_advertising_speed =
+	    interface_speed_capabilities_new(reply->arena);
 
-	capabilities_list->n_list++;
+	if (!capabilitiesp->id || !capabilitiesp->status
+	    || !capabilitiesp->supported_opt || !capabilitiesp->supported_speed
+	    || !capabilitiesp->advertising_opt
+	    || !capabilitiesp->advertising_speed
+	    || !capabilitiesp->lp_advertising_opt
+	    || !capabilitiesp->lp_advertising_speed)
+		return;
+
+	dabba__interface_id__init(capabilitiesp->id);
+	dabba__error_code__init(capabilitiesp->status);
+
+	capabilitiesp->id->name = rtnl_link_get_name(link);
+
+	capabilities_list->list[capabilities_list->n_list++] = capabilitiesp;
 }
 
 /**
@@ -311,69 +275,38 @@ void dabbad_interface_capabilities_get(Dabba__DabbaService_Service * service,
 				       closure, void *closure_data)
 {
 	Dabba__InterfaceCapabilitiesList capabilities_list =
-	    DABBA__INTERFACE_PAUSE_LIST__INIT;
+	    DABBA__INTERFACE_CAPABILITIES_LIST__INIT;
 	Dabba__InterfaceCapabilitiesList *capabilities_listp = NULL;
+	struct arena arena = ARENA_INIT;
+	struct interface_reply reply = { &capabilities_list, 0, &arena };
 	struct nl_sock *sock = NULL;
 	struct nl_cache *cache;
-	struct rtnl_link *link;
-	size_t a;
 
 	assert(service);
 	assert(closure_data);
 
 	cache = link_cache_alloc(&sock);
-	link = rtnl_link_alloc();
 
-	if (!link || !cache)
+	if (!cache)
 		goto out;
 
-	if (id_list->n_list) {
-		for (a = 0; a < id_list->n_list; a++) {
-			rtnl_link_set_name(link, id_list->list[a]->name);
-			nl_cache_foreach_filter(cache, OBJ_CAST(link),
-						__interface_capabilities_get,
-						&capabilities_list);
-		}
-	} else
-		nl_cache_foreach(cache, __interface_capabilities_get,
-				 &capabilities_list);
+	reply.size = link_cache_reply_size(cache, id_list);
+	capabilities_list.list = dabbad_arena_array(&arena, reply.size,
+						    sizeof(*capabilities_list.
+							   list));
 
+	if (!capabilities_list.list)
+		goto out;
+
+	link_cache_foreach(cache, id_list, __interface_capabilities_get,
+			   &reply);
+	dabbad_worker_parallel(interface_capabilities_query, &capabilities_list,
+			       capabilities_list.n_list);
 	capabilities_listp = &capabilities_list;
 
  out:
 	closure(capabilities_listp, closure_data);
-	for (a = 0; a < capabilities_list.n_list; a++) {
-		free(capabilities_list.list[a]->supported_speed->ethernet);
-		free(capabilities_list.list[a]->supported_speed->fast_ethernet);
-		free(capabilities_list.list[a]->supported_speed->gbps_ethernet);
-		free(capabilities_list.list[a]->
-		     supported_speed->_10gbps_ethernet);
-		free(capabilities_list.list[a]->advertising_speed->ethernet);
-		free(capabilities_list.list[a]->
-		     advertising_speed->fast_ethernet);
-		free(capabilities_list.list[a]->
-		     advertising_speed->gbps_ethernet);
-		free(capabilities_list.list[a]->
-		     advertising_speed->_10gbps_ethernet);
-		free(capabilities_list.list[a]->lp_advertising_speed->ethernet);
-		free(capabilities_list.list[a]->
-		     lp_advertising_speed->fast_ethernet);
-		free(capabilities_list.list[a]->
-		     lp_advertising_speed->gbps_ethernet);
-		free(capabilities_list.list[a]->
-		     lp_advertising_speed->_10gbps_ethernet);
-		free(capabilities_list.list[a]->supported_opt);
-		free(capabilities_list.list[a]->supported_speed);
-		free(capabilities_list.list[a]->advertising_opt);
-		free(capabilities_list.list[a]->advertising_speed);
-		free(capabilities_list.list[a]->lp_advertising_opt);
-		free(capabilities_list.list[a]->lp_advertising_speed);
-		free(capabilities_list.list[a]->status);
-		free(capabilities_list.list[a]->id);
-		free(capabilities_list.list[a]);
-	}
-	free(capabilities_list.list);
-	link_destroy(link);
+	dabbad_arena_release(&arena);
 	link_cache_destroy(sock, cache);
 }
 
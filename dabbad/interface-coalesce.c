@@ -16,55 +16,25 @@
 #include <netlink/cache.h>
 #include <netlink/route/link.h>
 #include <libdabba/interface.h>
+#include <dabbad/arena.h>
 #include <dabbad/interface.h>
 #include <dabbad/interface-coalesce.h>
+#include <dabbad/worker.h>
 
 /**
  * \internal
- * \brief Get the coalesce settings of a network interface
- * \param[in]           obj	        Pointer to interface netlink structure
- * \param[in]           arg             Pointer to interface coalesce protobuf message
- * \note Might silently skip an interface if memory could not be allocated.
+ * \brief Query the coalescing settings of a listed network interface
+ * \param[in,out]       arg	        Pointer to interface coalesce list
+ * \param[in]           idx	        Index of the interface in the list
+ * \note Runs concurrently with the queries of the other listed interfaces.
  */
 
-static void __interface_coalesce_get(struct nl_object *obj, void *arg)
+static void interface_coalesce_query(void *arg, const size_t idx)
 {
-	struct rtnl_link *link = (struct rtnl_link *)obj;
 	Dabba__InterfaceCoalesceList *coalesce_list = arg;
-	Dabba__InterfaceCoalesce *coalescep, **listpp;
-	size_t lsize =
-	    sizeof(*coalesce_list->list) * (coalesce_list->n_list + 1);
+	Dabba__InterfaceCoalesce *coalescep = coalesce_list->list[idx];
 	struct ethtool_coalesce coalesce;
 
-	listpp = realloc(coalesce_list->list, lsize);
-
-	if (!listpp)
-		return;
-
-	coalesce_list->list = listpp;
-	coalesce_list->list[coalesce_list->n_list] =
-	    malloc(sizeof(*coalesce_list->list[coalesce_list->n_list]));
-	coalescep = coalesce_list->list[coalesce_list->n_list];
-
-	if (!coalescep)
-		return;
-
-	dabba__interface_coalesce__init(coalescep);
-
-	coalescep->id = malloc(sizeof(*coalescep->id));
-	coalescep->status = malloc(sizeof(*coalescep->status));
-
-	if (!coalescep->id || !coalescep->status) {
-		free(coalescep->status);
-		free(coalescep->id);
-		free(coalescep);
-		return;
-	}
-
-	dabba__interface_id__init(coalescep->id);
-	dabba__error_code__init(coalescep->status);
-
-	coalescep->id->name = rtnl_link_get_name(link);
 	coalescep->status->code =
 	    ldab_dev_coalesce_get(coalescep->id->name, &coalesce);
 
@@ -119,8 +89,49 @@ static void __interface_coalesce_get(struct nl_object *obj, void *arg)
 	    coalesce.tx_max_coalesced_frames_high;
 	coalescep->tx_max_coalesced_frames_low =
 	    coalesce.tx_max_coalesced_frames_low;
+}
 
-	coalesce_list->n_list++;
+/**
+ * \internal
+ * \brief Add the coalesce settings of a network interface to a list reply
+ * \param[in]           obj	        Pointer to interface netlink structure
+ * \param[in]           arg             Pointer to interface coalesce list reply
+ * \note Might silently skip an interface if memory could not be allocated.
+ * \note The coalescing settings are queried afterwards by
+ *       \c interface_coalesce_query().
+ */
+
+static void __interface_coalesce_get(struct nl_object *obj, void *arg)
+{
+	struct rtnl_link *link = (struct rtnl_link *)obj;
+	struct interface_reply *reply = arg;
+	Dabba__InterfaceCoalesceList *coalesce_list = reply->list;
+	Dabba__InterfaceCoalesce *coalescep;
+
+	if (coalesce_list->n_list >= reply->size)
+		return;
+
+	coalescep = dabbad_arena_alloc(reply->arena, sizeof(*coalescep));
+
+	if (!coalescep)
+		return;
+
+	dabba__interface_coalesce__init(coalescep);
+
+	coalescep->id =
+	    dabbad_arena_alloc(reply->arena, sizeof(*coalescep->id));
+	coalescep->status =
+	    dabbad_arena_alloc(reply->arena, sizeof(*coalescep->status));
+
+	if (!coalescep->id || !coalescep->status)
+		return;
+
+	dabba__interface_id__init(coalescep->id);
+	dabba__error_code__init(coalescep->status);
+
+	coalescep->id->name = rtnl_link_get_name(link);
+
+	coalesce_list->list[coalesce_list->n_list++] = coalescep;
 }
 
 /**
@@ -138,44 +149,36 @@ void dabbad_interface_coalesce_get(Dabba__DabbaService_Service * service,
 				   closure, void *closure_data)
 {
 	Dabba__InterfaceCoalesceList coalesce_list =
-	    DABBA__INTERFACE_PAUSE_LIST__INIT;
+	    DABBA__INTERFACE_COALESCE_LIST__INIT;
 	Dabba__InterfaceCoalesceList *coalesce_listp = NULL;
+	struct arena arena = ARENA_INIT;
+	struct interface_reply reply = { &coalesce_list, 0, &arena };
 	struct nl_sock *sock = NULL;
 	struct nl_cache *cache;
-	struct rtnl_link *link;
-	size_t a;
 
 	assert(service);
 	assert(closure_data);
 
 	cache = link_cache_alloc(&sock);
-	link = rtnl_link_alloc();
 
-	if (!link || !cache)
+	if (!cache)
 		goto out;
 
-	if (id_list->n_list) {
-		for (a = 0; a < id_list->n_list; a++) {
-			rtnl_link_set_name(link, id_list->list[a]->name);
-			nl_cache_foreach_filter(cache, OBJ_CAST(link),
-						__interface_coalesce_get,
-						&coalesce_list);
-		}
-	} else
-		nl_cache_foreach(cache, __interface_coalesce_get,
-				 &coalesce_list);
+	reply.size = link_cache_reply_size(cache, id_list);
+	coalesce_list.list =
+	    dabbad_arena_array(&arena, reply.size, sizeof(*coalesce_list.list));
 
+	if (!coalesce_list.list)
+		goto out;
+
+	link_cache_foreach(cache, id_list, __interface_coalesce_get, &reply);
+	dabbad_worker_parallel(interface_coalesce_query, &coalesce_list,
+			       coalesce_list.n_list);
 	coalesce_listp = &coalesce_list;
 
  out:
 	closure(coalesce_listp, closure_data);
-	for (a = 0; a < coalesce_list.n_list; a++) {
-		free(coalesce_list.list[a]->status);
-		free(coalesce_list.list[a]->id);
-		free(coalesce_list.list[a]);
-	}
-	free(coalesce_list.list);
-	link_destroy(link);
+	dabbad_arena_release(&arena);
 	link_cache_destroy(sock, cache);
 }
 
@@ -14,65 +14,87 @@
 #include <linux/ethtool.h>
 #include <netlink/cache.h>
 #include <netlink/route/link.h>
+#include <libdabba/macros.h>
 #include <libdabba/interface.h>
+#include <dabbad/arena.h>
 #include <dabbad/interface.h>
 #include <dabbad/interface-driver.h>
+#include <dabbad/worker.h>
 
 /**
  * \internal
- * \brief Get the driver settings of a network interface
+ * \brief Query the driver settings of a listed network interface
+ * \param[in,out]       arg	        Pointer to interface driver list
+ * \param[in]           idx	        Index of the interface in the list
+ * \note Runs concurrently with the queries of the other listed interfaces.
+ */
+
+static void interface_driver_query(void *arg, const size_t idx)
+{
+	Dabba__InterfaceDriverList *driver_list = arg;
+	Dabba__InterfaceDriver *driverp = driver_list->list[idx];
+	struct ethtool_drvinfo *drvinfo =
+	    container_of(driverp->name, struct ethtool_drvinfo, driver);
+
+	driverp->status->code = ldab_dev_driver_get(driverp->id->name, drvinfo);
+
+	drvinfo->driver[sizeof(drvinfo->driver) - 1] = '\0';
+	drvinfo->version[sizeof(drvinfo->version) - 1] = '\0';
+	drvinfo->fw_version[sizeof(drvinfo->fw_version) - 1] = '\0';
+	drvinfo->bus_info[sizeof(drvinfo->bus_info) - 1] = '\0';
+}
+
+/**
+ * \internal
+ * \brief Add the driver settings of a network interface to a list reply
  * \param[in]           obj	        Pointer to interface netlink structure
- * \param[in]           arg             Pointer to interface driver protobuf message
+ * \param[in]           arg             Pointer to interface driver list reply
  * \note Might silently skip an interface if memory could not be allocated.
+ * \note The settings are queried afterwards by \c interface_driver_query().
  */
 
 static void __interface_driver_get(struct nl_object *obj, void *arg)
 {
 	struct rtnl_link *link = (struct rtnl_link *)obj;
-	Dabba__InterfaceDriverList *driver_list = arg;
-	Dabba__InterfaceDriver *driverp, **listpp;
-	struct ethtool_drvinfo drvinfo;
-	size_t lsize = sizeof(*driver_list->list) * (driver_list->n_list + 1);
-
-	listpp = realloc(driver_list->list, lsize);
+	struct interface_reply *reply = arg;
+	Dabba__InterfaceDriverList *driver_list = reply->list;
+	Dabba__InterfaceDriver *driverp;
+	struct ethtool_drvinfo *drvinfo;
 
-	if (!listpp)
+	if (driver_list->n_list >= reply->size)
 		return;
 
-	driver_list->list = listpp;
-	driver_list->list[driver_list->n_list] =
-	    malloc(sizeof(*driver_list->list[driver_list->n_list]));
-	driverp = driver_list->list[driver_list->n_list];
+	driverp = dabbad_arena_alloc(reply->arena, sizeof(*driverp));
 
 	if (!driverp)
 		return;
 
 	dabba__interface_driver__init(driverp);
 
-	driverp->id = malloc(sizeof(*driverp->id));
-	driverp->status = malloc(sizeof(*driverp->status));
+	driverp->id = dabbad_arena_alloc(reply->arena, sizeof(*driverp->id));
+	driverp->status =
+	    dabbad_arena_alloc(reply->arena, sizeof(*driverp->status));
 
-	if (!driverp->id || !driverp->status) {
-		free(driverp->id);
-		free(driverp->status);
-		free(driverp);
+	if (!driverp->id || !driverp->status)
 		return;
-	}
 
 	dabba__interface_id__init(driverp->id);
 	dabba__error_code__init(driverp->status);
 
-	driverp->id->name = rtnl_link_get_name(link);
+	drvinfo = dabbad_arena_alloc(reply->arena, sizeof(*drvinfo));
 
-	driverp->status->code = ldab_dev_driver_get(driverp->id->name, &drvinfo);
+	if (!drvinfo)
+		return;
 
-	driverp->name = strndup(drvinfo.driver, sizeof(drvinfo.driver));
-	driverp->version = strndup(drvinfo.version, sizeof(drvinfo.version));
-	driverp->fw_version =
-	    strndup(drvinfo.fw_version, sizeof(drvinfo.fw_version));
-	driverp->bus_info = strndup(drvinfo.bus_info, sizeof(drvinfo.bus_info));
+	driverp->id->name = rtnl_link_get_name(link);
+
+	/* The strings are filled by the driver query */
+	driverp->name = drvinfo->driver;
+	driverp->version = drvinfo->version;
+	driverp->fw_version = drvinfo->fw_version;
+	driverp->bus_info = drvinfo->bus_info;
 
-	driver_list->n_list++;
+	driver_list->list[driver_list->n_list++] = driverp;
 }
 
 /**
@@ -92,44 +114,33 @@ void dabbad_interface_driver_get(Dabba__DabbaService_Service * service,
 	Dabba__InterfaceDriverList driver_list =
 	    DABBA__INTERFACE_DRIVER_LIST__INIT;
 	Dabba__InterfaceDriverList *driver_listp = NULL;
+	struct arena arena = ARENA_INIT;
+	struct interface_reply reply = { &driver_list, 0, &arena };
 	struct nl_sock *sock = NULL;
 	struct nl_cache *cache;
-	struct rtnl_link *link;
-	size_t a;
 
 	assert(service);
 	assert(closure_data);
 
 	cache = link_cache_alloc(&sock);
-	link = rtnl_link_alloc();
 
-	if (!link || !cache)
+	if (!cache)
 		goto out;
 
-	if (id_list->n_list) {
-		for (a = 0; a < id_list->n_list; a++) {
-			rtnl_link_set_name(link, id_list->list[a]->name);
-			nl_cache_foreach_filter(cache, OBJ_CAST(link),
-						__interface_driver_get,
-						&driver_list);
-		}
-	} else
-		nl_cache_foreach(cache, __interface_driver_get, &driver_list);
+	reply.size = link_cache_reply_size(cache, id_list);
+	driver_list.list =
+	    dabbad_arena_array(&arena, reply.size, sizeof(*driver_list.list));
+
+	if (!driver_list.list)
+		goto out;
 
+	link_cache_foreach(cache, id_list, __interface_driver_get, &reply);
+	dabbad_worker_parallel(interface_driver_query, &driver_list,
+			       driver_list.n_list);
 	driver_listp = &driver_list;
 
  out:
 	closure(driver_listp, closure_data);
-	for (a = 0; a < driver_list.n_list; a++) {
-		free(driver_list.list[a]->id);
-		free(driver_list.list[a]->status);
-		free(driver_list.list[a]->name);
-		free(driver_list.list[a]->version);
-		free(driver_list.list[a]->fw_version);
-		free(driver_list.list[a]->bus_info);
-		free(driver_list.list[a]);
-	}
-	free(driver_list.list);
-	link_destroy(link);
+	dabbad_arena_release(&arena);
 	link_cache_destroy(sock, cache);
 }
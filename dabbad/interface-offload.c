@@ -15,49 +15,72 @@
 #include <netlink/cache.h>
 #include <netlink/route/link.h>
 #include <libdabba/interface.h>
+#include <dabbad/arena.h>
 #include <dabbad/interface.h>
 #include <dabbad/interface-offload.h>
+#include <dabbad/worker.h>
 
 /**
  * \internal
- * \brief Get the offload settings of a network interface
+ * \brief Query the offload settings of a listed network interface
+ * \param[in,out]       arg	        Pointer to interface offload list
+ * \param[in]           idx	        Index of the interface in the list
+ * \note Runs concurrently with the queries of the other listed interfaces.
+ */
+
+static void interface_offload_query(void *arg, const size_t idx)
+{
+	Dabba__InterfaceOffloadList *offload_list = arg;
+	Dabba__InterfaceOffload *offloadp = offload_list->list[idx];
+	struct dev_offload offload;
+
+	offloadp->status->code =
+	    ldab_dev_offload_get(offloadp->id->name, &offload);
+
+	offloadp->rx_csum = offload.rx_csum;
+	offloadp->tx_csum = offload.tx_csum;
+	offloadp->sg = offload.sg;
+	offloadp->tso = offload.tso;
+	offloadp->ufo = offload.ufo;
+	offloadp->gso = offload.gso;
+	offloadp->gro = offload.gro;
+	offloadp->lro = offload.lro;
+	offloadp->rxhash = offload.rxhash;
+}
+
+/**
+ * \internal
+ * \brief Add the offload settings of a network interface to a list reply
  * \param[in]           obj	        Pointer to interface netlink structure
- * \param[in]           arg             Pointer to interface offload protobuf message
+ * \param[in]           arg             Pointer to interface offload list reply
  * \note Might silently skip an interface if memory could not be allocated.
+ * \note The offload settings are queried afterwards by
+ *       \c interface_offload_query().
  */
 
 static void __interface_offload_get(struct nl_object *obj, void *arg)
 {
 	struct rtnl_link *link = (struct rtnl_link *)obj;
-	Dabba__InterfaceOffloadList *offload_list = arg;
-	Dabba__InterfaceOffload *offloadp, **listpp;
-	size_t lsize = sizeof(*offload_list->list) * (offload_list->n_list + 1);
-	int rc;
-
-	listpp = realloc(offload_list->list, lsize);
+	struct interface_reply *reply = arg;
+	Dabba__InterfaceOffloadList *offload_list = reply->list;
+	Dabba__InterfaceOffload *offloadp;
 
-	if (!listpp)
+	if (offload_list->n_list >= reply->size)
 		return;
 
-	offload_list->list = listpp;
-	offload_list->list[offload_list->n_list] =
-	    malloc(sizeof(*offload_list->list[offload_list->n_list]));
-	offloadp = offload_list->list[offload_list->n_list];
+	offloadp = dabbad_arena_alloc(reply->arena, sizeof(*offloadp));
 
 	if (!offloadp)
 		return;
 
 	dabba__interface_offload__init(offloadp);
 
-	offloadp->id = malloc(sizeof(*offloadp->id));
-	offloadp->status = malloc(sizeof(*offloadp->status));
+	offloadp->id = dabbad_arena_alloc(reply->arena, sizeof(*offloadp->id));
+	offloadp->status =
+	    dabbad_arena_alloc(reply->arena, sizeof(*offloadp->status));
 
-	if (!offloadp->id || !offloadp->status) {
-		free(offloadp->status);
-		free(offloadp->id);
-		free(offloadp);
+	if (!offloadp->id || !offloadp->status)
 		return;
-	}
 
 	dabba__interface_id__init(offloadp->id);
 	dabba__error_code__init(offloadp->status);
@@ -66,24 +89,9 @@ static void __interface_offload_get(struct nl_object *obj, void *arg)
 
 	offloadp->has_rx_csum = offloadp->has_tx_csum = offloadp->has_sg = 1;
 	offloadp->has_tso = offloadp->has_ufo = offloadp->has_gso = 1;
-	offloadp->has_gro = offloadp->has_lro = offloadp->rxhash = 1;
-
-	/* FIXME find a way to report error separately */
-	rc = ldab_dev_rx_csum_offload_get(offloadp->id->name,
-					 &offloadp->rx_csum);
-	rc = ldab_dev_tx_csum_offload_get(offloadp->id->name,
-					 &offloadp->tx_csum);
-	rc = ldab_dev_scatter_gather_get(offloadp->id->name, &offloadp->sg);
-	rc = ldab_dev_tcp_seg_offload_get(offloadp->id->name, &offloadp->tso);
-	rc = ldab_dev_udp_frag_offload_get(offloadp->id->name, &offloadp->ufo);
-	rc = ldab_dev_generic_seg_offload_get(offloadp->id->name,
-					     &offloadp->gso);
-	rc = ldab_dev_generic_rcv_offload_get(offloadp->id->name,
-					     &offloadp->gro);
-
-	offloadp->status->code = rc;
+	offloadp->has_gro = offloadp->has_lro = offloadp->has_rxhash = 1;
 
-	offload_list->n_list++;
+	offload_list->list[offload_list->n_list++] = offloadp;
 }
 
 /**
@@ -100,44 +108,37 @@ void dabbad_interface_offload_get(Dabba__DabbaService_Service * service,
 				  Dabba__InterfaceOffloadList_Closure
 				  closure, void *closure_data)
 {
-	Dabba__InterfaceOffloadList pause_list =
-	    DABBA__INTERFACE_PAUSE_LIST__INIT;
-	Dabba__InterfaceOffloadList *pause_listp = NULL;
+	Dabba__InterfaceOffloadList offload_list =
+	    DABBA__INTERFACE_OFFLOAD_LIST__INIT;
+	Dabba__InterfaceOffloadList *offload_listp = NULL;
+	struct arena arena = ARENA_INIT;
+	struct interface_reply reply = { &offload_list, 0, &arena };
 	struct nl_sock *sock = NULL;
 	struct nl_cache *cache;
-	struct rtnl_link *link;
-	size_t a;
 
 	assert(service);
 	assert(closure_data);
 
 	cache = link_cache_alloc(&sock);
-	link = rtnl_link_alloc();
 
-	if (!link || !cache)
+	if (!cache)
 		goto out;
 
-	if (id_list->n_list) {
-		for (a = 0; a < id_list->n_list; a++) {
-			rtnl_link_set_name(link, id_list->list[a]->name);
-			nl_cache_foreach_filter(cache, OBJ_CAST(link),
-						__interface_offload_get,
-						&pause_list);
-		}
-	} else
-		nl_cache_foreach(cache, __interface_offload_get, &pause_list);
+	reply.size = link_cache_reply_size(cache, id_list);
+	offload_list.list =
+	    dabbad_arena_array(&arena, reply.size, sizeof(*offload_list.list));
+
+	if (!offload_list.list)
+		goto out;
 
-	pause_listp = &pause_list;
+	link_cache_foreach(cache, id_list, __interface_offload_get, &reply);
+	dabbad_worker_parallel(interface_offload_query, &offload_list,
+			       offload_list.n_list);
+	offload_listp = &offload_list;
 
  out:
-	closure(pause_listp, closure_data);
-	for (a = 0; a < pause_list.n_list; a++) {
-		free(pause_list.list[a]->status);
-		free(pause_list.list[a]->id);
-		free(pause_list.list[a]);
-	}
-	free(pause_list.list);
-	link_destroy(link);
+	closure(offload_listp, closure_data);
+	dabbad_arena_release(&arena);
 	link_cache_destroy(sock, cache);
 }
 
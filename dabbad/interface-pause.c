@@ -16,62 +16,73 @@
 #include <netlink/cache.h>
 #include <netlink/route/link.h>
 #include <libdabba/interface.h>
+#include <dabbad/arena.h>
 #include <dabbad/interface.h>
 #include <dabbad/interface-pause.h>
+#include <dabbad/worker.h>
 
 /**
  * \internal
- * \brief Get the pause settings of a network interface
+ * \brief Query the pause settings of a listed network interface
+ * \param[in,out]       arg	        Pointer to interface pause list
+ * \param[in]           idx	        Index of the interface in the list
+ * \note Runs concurrently with the queries of the other listed interfaces.
+ */
+
+static void interface_pause_query(void *arg, const size_t idx)
+{
+	Dabba__InterfacePauseList *pause_list = arg;
+	Dabba__InterfacePause *pausep = pause_list->list[idx];
+	struct ethtool_pauseparam pause;
+
+	pausep->status->code = ldab_dev_pause_get(pausep->id->name, &pause);
+
+	pausep->has_autoneg = pausep->has_rx_pause = pausep->has_tx_pause = 1;
+	pausep->autoneg = pause.autoneg;
+	pausep->rx_pause = pause.rx_pause;
+	pausep->tx_pause = pause.tx_pause;
+}
+
+/**
+ * \internal
+ * \brief Add the pause settings of a network interface to a list reply
  * \param[in]           obj	        Pointer to interface netlink structure
- * \param[in]           arg             Pointer to interface pause protobuf message
+ * \param[in]           arg             Pointer to interface pause list reply
  * \note Might silently skip an interface if memory could not be allocated.
+ * \note The pause settings are queried afterwards by
+ *       \c interface_pause_query().
  */
 
 static void __interface_pause_get(struct nl_object *obj, void *arg)
 {
 	struct rtnl_link *link = (struct rtnl_link *)obj;
-	Dabba__InterfacePauseList *pause_list = arg;
-	Dabba__InterfacePause *pausep, **listpp;
-	size_t lsize = sizeof(*pause_list->list) * (pause_list->n_list + 1);
-	struct ethtool_pauseparam pause;
+	struct interface_reply *reply = arg;
+	Dabba__InterfacePauseList *pause_list = reply->list;
+	Dabba__InterfacePause *pausep;
 
-	listpp = realloc(pause_list->list, lsize);
-
-	if (!listpp)
+	if (pause_list->n_list >= reply->size)
 		return;
 
-	pause_list->list = listpp;
-	pause_list->list[pause_list->n_list] =
-	    malloc(sizeof(*pause_list->list[pause_list->n_list]));
-	pausep = pause_list->list[pause_list->n_list];
+	pausep = dabbad_arena_alloc(reply->arena, sizeof(*pausep));
 
 	if (!pausep)
 		return;
 
 	dabba__interface_pause__init(pausep);
 
-	pausep->id = malloc(sizeof(*pausep->id));
-	pausep->status = malloc(sizeof(*pausep->status));
+	pausep->id = dabbad_arena_alloc(reply->arena, sizeof(*pausep->id));
+	pausep->status =
+	    dabbad_arena_alloc(reply->arena, sizeof(*pausep->status));
 
-	if (!pausep->id || !pausep->status) {
-		free(pausep->id);
-		free(pausep->status);
-		free(pausep);
+	if (!pausep->id || !pausep->status)
 		return;
-	}
 
 	dabba__interface_id__init(pausep->id);
 	dabba__error_code__init(pausep->status);
 
 	pausep->id->name = rtnl_link_get_name(link);
-	pausep->status->code = ldab_dev_pause_get(pausep->id->name, &pause);
 
-	pausep->has_autoneg = pausep->has_rx_pause = pausep->has_tx_pause = 1;
-	pausep->autoneg = pause.autoneg;
-	pausep->rx_pause = pause.rx_pause;
-	pausep->tx_pause = pause.tx_pause;
-
-	pause_list->n_list++;
+	pause_list->list[pause_list->n_list++] = pausep;
 }
 
 /**
@@ -91,41 +102,34 @@ void dabbad_interface_pause_get(Dabba__DabbaService_Service * service,
 	Dabba__InterfacePauseList pause_list =
 	    DABBA__INTERFACE_PAUSE_LIST__INIT;
 	Dabba__InterfacePauseList *pause_listp = NULL;
+	struct arena arena = ARENA_INIT;
+	struct interface_reply reply = { &pause_list, 0, &arena };
 	struct nl_sock *sock = NULL;
 	struct nl_cache *cache;
-	struct rtnl_link *link;
-	size_t a;
 
 	assert(service);
 	assert(closure_data);
 
 	cache = link_cache_alloc(&sock);
-	link = rtnl_link_alloc();
 
-	if (!link || !cache)
+	if (!cache)
 		goto out;
 
-	if (id_list->n_list) {
-		for (a = 0; a < id_list->n_list; a++) {
-			rtnl_link_set_name(link, id_list->list[a]->name);
-			nl_cache_foreach_filter(cache, OBJ_CAST(link),
-						__interface_pause_get,
-						&pause_list);
-		}
-	} else
-		nl_cache_foreach(cache, __interface_pause_get, &pause_list);
+	reply.size = link_cache_reply_size(cache, id_list);
+	pause_list.list =
+	    dabbad_arena_array(&arena, reply.size, sizeof(*pause_list.list));
+
+	if (!pause_list.list)
+		goto out;
 
+	link_cache_foreach(cache, id_list, __interface_pause_get, &reply);
+	dabbad_worker_parallel(interface_pause_query, &pause_list,
+			       pause_list.n_list);
 	pause_listp = &pause_list;
 
  out:
 	closure(pause_listp, closure_data);
-	for (a = 0; a < pause_list.n_list; a++) {
-		free(pause_list.list[a]->status);
-		free(pause_list.list[a]->id);
-		free(pause_list.list[a]);
-	}
-	free(pause_list.list);
-	link_destroy(link);
+	dabbad_arena_release(&arena);
 	link_cache_destroy(sock, cache);
 }
 
@@ -16,50 +16,68 @@
 #include <netlink/cache.h>
 #include <netlink/route/link.h>
 #include <libdabba/interface.h>
+#include <dabbad/arena.h>
 #include <dabbad/interface.h>
 #include <dabbad/interface-settings.h>
+#include <dabbad/worker.h>
 
 /**
  * \internal
- * \brief Get the network interface settings
+ * \brief Query the settings of a listed network interface
+ * \param[in,out]       arg	        Pointer to interface settings list
+ * \param[in]           idx	        Index of the interface in the list
+ * \note Runs concurrently with the queries of the other listed interfaces.
+ */
+
+static void interface_settings_query(void *arg, const size_t idx)
+{
+	Dabba__InterfaceSettingsList *settings_list = arg;
+	Dabba__InterfaceSettings *settingsp = settings_list->list[idx];
+	struct ethtool_cmd settings;
+
+	settingsp->status->code =
+	    ldab_dev_settings_get(settingsp->id->name, &settings);
+
+	settingsp->speed = ethtool_cmd_speed(&settings);
+	settingsp->duplex = settings.duplex;
+	settingsp->autoneg = settings.autoneg == AUTONEG_ENABLE;
+	settingsp->maxrxpkt = settings.maxrxpkt;
+	settingsp->maxtxpkt = settings.maxtxpkt;
+}
+
+/**
+ * \internal
+ * \brief Add the settings of a network interface to a list reply
  * \param[in]           obj	        Pointer to interface netlink structure
- * \param[in]           arg             Pointer to interface settings protobuf message
+ * \param[in]           arg             Pointer to interface settings list reply
  * \note Might silently skip an interface if memory could not be allocated.
+ * \note The settings are queried afterwards by \c interface_settings_query().
  */
 
 static void __interface_settings_get(struct nl_object *obj, void *arg)
 {
 	struct rtnl_link *link = (struct rtnl_link *)obj;
-	Dabba__InterfaceSettingsList *settings_list = arg;
-	Dabba__InterfaceSettings *settingsp, **listpp;
-	size_t lsize =
-	    sizeof(*settings_list->list) * (settings_list->n_list + 1);
-	struct ethtool_cmd settings;
+	struct interface_reply *reply = arg;
+	Dabba__InterfaceSettingsList *settings_list = reply->list;
+	Dabba__InterfaceSettings *settingsp;
 
-	listpp = realloc(settings_list->list, lsize);
-
-	if (!listpp)
+	if (settings_list->n_list >= reply->size)
 		return;
 
-	settings_list->list = listpp;
-	settings_list->list[settings_list->n_list] =
-	    malloc(sizeof(*settings_list->list[settings_list->n_list]));
-	settingsp = settings_list->list[settings_list->n_list];
+	settingsp = dabbad_arena_alloc(reply->arena, sizeof(*settingsp));
 
 	if (!settingsp)
 		return;
 
 	dabba__interface_settings__init(settingsp);
 
-	settingsp->id = malloc(sizeof(*settingsp->id));
-	settingsp->status = malloc(sizeof(*settingsp->status));
+	settingsp->id =
+	    dabbad_arena_alloc(reply->arena, sizeof(*settingsp->id));
+	settingsp->status =
+	    dabbad_arena_alloc(reply->arena, sizeof(*settingsp->status));
 
-	if (!settingsp->id || !settingsp->status) {
-		free(settingsp->id);
-		free(settingsp->status);
-		free(settingsp);
+	if (!settingsp->id || !settingsp->status)
 		return;
-	}
 
 	dabba__interface_id__init(settingsp->id);
 	dabba__error_code__init(settingsp->status);
@@ -70,18 +88,10 @@ static void __interface_settings_get(struct nl_object *obj, void *arg)
 	settingsp->has_tx_qlen = settingsp->has_port = 1;
 	settingsp->has_maxrxpkt = settingsp->has_maxtxpkt = 1;
 
-	settingsp->status->code =
-	    ldab_dev_settings_get(settingsp->id->name, &settings);
 	settingsp->mtu = rtnl_link_get_mtu(link);
 	settingsp->tx_qlen = rtnl_link_get_txqlen(link);
 
-	settingsp->speed = ethtool_cmd_speed(&settings);
-	settingsp->duplex = settings.duplex;
-	settingsp->autoneg = settings.autoneg == AUTONEG_ENABLE;
-	settingsp->maxrxpkt = settings.maxrxpkt;
-	settingsp->maxtxpkt = settings.maxtxpkt;
-
-	settings_list->n_list++;
+	settings_list->list[settings_list->n_list++] = settingsp;
 }
 
 /**
@@ -98,44 +108,37 @@ void dabbad_interface_settings_get(Dabba__DabbaService_Service * service,
 				   Dabba__InterfaceSettingsList_Closure
 				   closure, void *closure_data)
 {
-	Dabba__InterfaceSettingsList pause_list =
-	    DABBA__INTERFACE_PAUSE_LIST__INIT;
-	Dabba__InterfaceSettingsList *pause_listp = NULL;
+	Dabba__InterfaceSettingsList settings_list =
+	    DABBA__INTERFACE_SETTINGS_LIST__INIT;
+	Dabba__InterfaceSettingsList *settings_listp = NULL;
+	struct arena arena = ARENA_INIT;
+	struct interface_reply reply = { &settings_list, 0, &arena };
 	struct nl_sock *sock = NULL;
 	struct nl_cache *cache;
-	struct rtnl_link *link;
-	size_t a;
 
 	assert(service);
 	assert(closure_data);
 
 	cache = link_cache_alloc(&sock);
-	link = rtnl_link_alloc();
 
-	if (!link || !cache)
+	if (!cache)
 		goto out;
 
-	if (id_list->n_list) {
-		for (a = 0; a < id_list->n_list; a++) {
-			rtnl_link_set_name(link, id_list->list[a]->name);
-			nl_cache_foreach_filter(cache, OBJ_CAST(link),
-						__interface_settings_get,
-						&pause_list);
-		}
-	} else
-		nl_cache_foreach(cache, __interface_settings_get, &pause_list);
+	reply.size = link_cache_reply_size(cache, id_list);
+	settings_list.list =
+	    dabbad_arena_array(&arena, reply.size, sizeof(*settings_list.list));
+
+	if (!settings_list.list)
+		goto out;
 
-	pause_listp = &pause_list;
+	link_cache_foreach(cache, id_list, __interface_settings_get, &reply);
+	dabbad_worker_parallel(interface_settings_query, &settings_list,
+			       settings_list.n_list);
+	settings_listp = &settings_list;
 
  out:
-	closure(pause_listp, closure_data);
-	for (a = 0; a < pause_list.n_list; a++) {
-		free(pause_list.list[a]->status);
-		free(pause_list.list[a]->id);
-		free(pause_list.list[a]);
-	}
-	free(pause_list.list);
-	link_destroy(link);
+	closure(settings_listp, closure_data);
+	dabbad_arena_release(&arena);
 	link_cache_destroy(sock, cache);
 }
 
@@ -12,55 +12,98 @@
 
 #include <assert.h>
 #include <errno.h>
+#include <string.h>
+#include <linux/if_link.h>
+#include <linux/rtnetlink.h>
+#include <netlink/netlink.h>
+#include <netlink/msg.h>
+#include <netlink/attr.h>
+#include <netlink/handlers.h>
 #include <netlink/cache.h>
 #include <netlink/route/link.h>
+#include <dabbad/arena.h>
 #include <dabbad/interface.h>
 #include <dabbad/interface-statistics.h>
 
 /**
  * \internal
- * \brief Get the statistics of a network interface
- * \param[in]           obj	        Pointer to interface netlink structure
- * \param[in]           arg             Pointer to interface statistics protobuf message
- * \note Might silently skip an interface if memory could not be allocated.
+ * \brief Amount of statistics requests sent in a single netlink message batch
+ * \note Replies are queued in the socket receive buffer until they are read,
+ * keep the batch small enough to never overrun it.
  */
 
-static void __interface_statistics_get(struct nl_object *obj, void *arg)
-{
-	struct rtnl_link *link = (struct rtnl_link *)obj;
-	Dabba__InterfaceStatisticsList *statistics_list = arg;
-	Dabba__InterfaceStatistics *statisticsp, **listpp;
-	size_t lsize =
-	    sizeof(*statistics_list->list) * (statistics_list->n_list + 1);
+#define STATS_BATCH_NR 16
 
-	listpp = realloc(statistics_list->list, lsize);
+/**
+ * \internal
+ * \brief Pending batch of interface statistics requests
+ */
 
-	if (!listpp)
-		return;
+struct interface_stats_batch {
+	struct interface_reply *reply;	/**< statistics list reply */
+	const Dabba__InterfaceIdList *id_list;	/**< requested interfaces */
+	unsigned int seq;	/**< sequence number of the first interface */
+	size_t pending;		/**< requests waiting for a reply */
+	int err;		/**< first error reported by the kernel */
+};
+
+/**
+ * \internal
+ * \brief Append a new interface statistics message to a list reply
+ * \param[in,out]       reply	        Pointer to interface statistics list reply
+ * \return Pointer to the new message, \c NULL if memory could not be allocated
+ */
+
+static Dabba__InterfaceStatistics
+    *interface_statistics_add(struct interface_reply *reply)
+{
+	Dabba__InterfaceStatisticsList *statistics_list = reply->list;
+	Dabba__InterfaceStatistics *statisticsp;
+
+	if (statistics_list->n_list >= reply->size)
+		return NULL;
 
-	statistics_list->list = listpp;
-	statistics_list->list[statistics_list->n_list] =
-	    malloc(sizeof(*statistics_list->list[statistics_list->n_list]));
-	statisticsp = statistics_list->list[statistics_list->n_list];
+	statisticsp = dabbad_arena_alloc(reply->arena, sizeof(*statisticsp));
 
 	if (!statisticsp)
-		return;
+		return NULL;
 
 	dabba__interface_statistics__init(statisticsp);
 
-	statisticsp->id = malloc(sizeof(*statisticsp->id));
-	statisticsp->status = malloc(sizeof(*statisticsp->status));
+	statisticsp->id =
+	    dabbad_arena_alloc(reply->arena, sizeof(*statisticsp->id));
+	statisticsp->status =
+	    dabbad_arena_alloc(reply->arena, sizeof(*statisticsp->status));
 
-	if (!statisticsp->id || !statisticsp->status) {
-		free(statisticsp->status);
-		free(statisticsp->id);
-		free(statisticsp);
-		return;
-	}
+	if (!statisticsp->id || !statisticsp->status)
+		return NULL;
 
 	dabba__interface_id__init(statisticsp->id);
 	dabba__error_code__init(statisticsp->status);
 
+	statistics_list->list[statistics_list->n_list++] = statisticsp;
+
+	return statisticsp;
+}
+
+/**
+ * \internal
+ * \brief Get the statistics of a network interface
+ * \param[in]           obj	        Pointer to interface netlink structure
+ * \param[in]           arg             Pointer to interface statistics list reply
+ * \note Might silently skip an interface if memory could not be allocated.
+ */
+
+static void __interface_statistics_get(struct nl_object *obj, void *arg)
+{
+	struct rtnl_link *link = (struct rtnl_link *)obj;
+	Dabba__InterfaceStatistics *statisticsp;
+
+	statisticsp = interface_statistics_add(arg);
+
+	if (!statisticsp)
+		return;
+
 	statisticsp->id->name = rtnl_link_get_name(link);
 	statisticsp->rx_byte = rtnl_link_get_stat(link, RTNL_LINK_RX_BYTES);
 	statisticsp->rx_packet = rtnl_link_get_stat(link, RTNL_LINK_RX_PACKETS);
@@ -99,8 +142,246 @@ static void __interface_statistics_get(struct nl_object *obj, void *arg)
 	    rtnl_link_get_stat(link, RTNL_LINK_TX_WIN_ERR);
 	statisticsp->tx_error_aborted =
 	    rtnl_link_get_stat(link, RTNL_LINK_TX_ABORT_ERR);
+}
+
+/**
+ * \internal
+ * \brief Add a requested network interface to the selected interface list
+ * \param[in]           obj	        Pointer to interface netlink structure
+ * \param[in]           arg             Pointer to selected interface id list reply
+ * \note Might silently skip an interface if memory could not be allocated.
+ */
+
+static void interface_stats_select(struct nl_object *obj, void *arg)
+{
+	struct interface_reply *select = arg;
+	Dabba__InterfaceIdList *selected = select->list;
+	Dabba__InterfaceId *id;
+
+	if (selected->n_list >= select->size)
+		return;
+
+	id = dabbad_arena_alloc(select->arena, sizeof(*id));
+
+	if (!id)
+		return;
 
-	statistics_list->n_list++;
+	dabba__interface_id__init(id);
+	id->name = rtnl_link_get_name((struct rtnl_link *)obj);
+	selected->list[selected->n_list++] = id;
+}
+
+/**
+ * \internal
+ * \brief Get the statistics of a network interface from a stats reply
+ * \param[in]           msg	        Pointer to \c RTM_NEWSTATS netlink message
+ * \param[in]           arg             Pointer to the pending request batch
+ * \return \c NL_OK when the reply was processed, \c NL_SKIP otherwise
+ * \note Might silently skip an interface if memory could not be allocated.
+ */
+
+static int interface_stats_batch_valid(struct nl_msg *msg, void *arg)
+{
+	struct interface_stats_batch *batch = arg;
+	struct nlmsghdr *hdr = nlmsg_hdr(msg);
+	struct nlattr *tb[IFLA_STATS_MAX + 1];
+	struct rtnl_link_stats64 stats;
+	Dabba__InterfaceStatistics *statisticsp;
+	const size_t a = hdr->nlmsg_seq - batch->seq;
+
+	if (hdr->nlmsg_type != RTM_NEWSTATS || a >= batch->id_list->n_list)
+		return NL_SKIP;
+
+	batch->pending--;
+
+	if (nlmsg_parse(hdr, sizeof(struct if_stats_msg), tb, IFLA_STATS_MAX,
+			NULL) || !tb[IFLA_STATS_LINK_64]
+	    || nla_len(tb[IFLA_STATS_LINK_64]) < (int)sizeof(stats))
+		return NL_SKIP;
+
+	memcpy(&stats, nla_data(tb[IFLA_STATS_LINK_64]), sizeof(stats));
+
+	statisticsp = interface_statistics_add(batch->reply);
+
+	if (!statisticsp)
+		return NL_SKIP;
+
+	statisticsp->id->name = batch->id_list->list[a]->name;
+	statisticsp->rx_byte = stats.rx_bytes;
+	statisticsp->rx_packet = stats.rx_packets;
+	statisticsp->rx_error = stats.rx_errors;
+	statisticsp->rx_dropped = stats.rx_dropped;
+	statisticsp->rx_compressed = stats.rx_compressed;
+	statisticsp->rx_error_fifo = stats.rx_fifo_errors;
+	statisticsp->rx_error_frame = stats.rx_frame_errors;
+	statisticsp->rx_error_crc = stats.rx_crc_errors;
+	statisticsp->rx_error_length = stats.rx_length_errors;
+	statisticsp->rx_error_missed = stats.rx_missed_errors;
+	statisticsp->rx_error_over = stats.rx_over_errors;
+
+	statisticsp->tx_byte = stats.tx_bytes;
+	statisticsp->tx_packet = stats.tx_packets;
+	statisticsp->tx_error = stats.tx_errors;
+	statisticsp->tx_dropped = stats.tx_dropped;
+	statisticsp->tx_compressed = stats.tx_compressed;
+	statisticsp->tx_error_fifo = stats.tx_fifo_errors;
+	statisticsp->tx_error_carrier = stats.tx_carrier_errors;
+	statisticsp->tx_error_heartbeat = stats.tx_heartbeat_errors;
+	statisticsp->tx_error_window = stats.tx_window_errors;
+	statisticsp->tx_error_aborted = stats.tx_aborted_errors;
+
+	return NL_OK;
+}
+
+/**
+ * \internal
+ * \brief Account a stats request the kernel rejected
+ * \param[in]           nla	        Unused netlink peer address
+ * \param[in]           nlerr           Pointer to the netlink error message
+ * \param[in]           arg             Pointer to the pending request batch
+ * \return \c NL_SKIP to keep on reading the batch replies
+ * \note An interface removed since its lookup is silently skipped.
+ */
+
+static int interface_stats_batch_error(struct sockaddr_nl *nla,
+				       struct nlmsgerr *nlerr, void *arg)
+{
+	struct interface_stats_batch *batch = arg;
+	const size_t a = nlerr->msg.nlmsg_seq - batch->seq;
+
+	(void)nla;
+
+	if (a >= batch->id_list->n_list)
+		return NL_SKIP;
+
+	batch->pending--;
+
+	if (nlerr->error != -ENODEV && !batch->err)
+		batch->err = -nlerr->error;
+
+	return NL_SKIP;
+}
+
+/**
+ * \internal
+ * \brief Accept the out of order sequence numbers of a request batch
+ * \param[in]           msg	        Unused netlink message
+ * \param[in]           arg             Unused callback data
+ * \return \c NL_OK
+ */
+
+static int interface_stats_batch_seq_check(struct nl_msg *msg, void *arg)
+{
+	(void)msg;
+	(void)arg;
+
+	return NL_OK;
+}
+
+/**
+ * \internal
+ * \brief Fetch the 64 bits statistics of requested network interfaces
+ * \param[in]           cache	        Interface cache to resolve names
+ * \param[in]           id_list         Pointer to the requested interface id list
+ * \param[out]          reply	        Pointer to interface statistics list reply
+ * \return 0 on success, else on failure
+ *
+ * Each requested interface gets its own \c RTM_GETSTATS request filtered on
+ * \c IFLA_STATS_LINK_64. Requests are sent by batches in a single message
+ * and their replies are matched back to the requested interfaces by their
+ * sequence number. Unknown interfaces are skipped.
+ * The batch runs on its own socket: replies left behind by a failed batch
+ * are thrown away with it instead of being read by the next request on the
+ * shared cache socket.
+ */
+
+static int interface_stats_batch_fetch(struct nl_cache *cache,
+				       const Dabba__InterfaceIdList * id_list,
+				       struct interface_reply *reply)
+{
+	struct {
+		struct nlmsghdr hdr;
+		struct if_stats_msg ifsm;
+	} req[STATS_BATCH_NR];
+	struct interface_stats_batch batch;
+	struct nl_sock *sock;
+	struct nl_cb *cb;
+	size_t a, start, nr;
+	int ifindex, rc = 0;
+
+	sock = nl_socket_alloc();
+
+	if (!sock)
+		return ENOMEM;
+
+	if (nl_connect(sock, NETLINK_ROUTE)) {
+		nl_socket_free(sock);
+		return EIO;
+	}
+
+	cb = nl_cb_alloc(NL_CB_DEFAULT);
+
+	if (!cb) {
+		nl_socket_free(sock);
+		return ENOMEM;
+	}
+
+	memset(&batch, 0, sizeof(batch));
+	batch.reply = reply;
+	batch.id_list = id_list;
+	batch.seq = nl_socket_use_seq(sock);
+
+	nl_cb_set(cb, NL_CB_VALID, NL_CB_CUSTOM, interface_stats_batch_valid,
+		  &batch);
+	nl_cb_set(cb, NL_CB_SEQ_CHECK, NL_CB_CUSTOM,
+		  interface_stats_batch_seq_check, NULL);
+	nl_cb_err(cb, NL_CB_CUSTOM, interface_stats_batch_error, &batch);
+
+	for (start = 0; !rc && start < id_list->n_list;
+	     start += STATS_BATCH_NR) {
+		for (a = start, nr = 0;
+		     a < id_list->n_list && a < start + STATS_BATCH_NR; a++) {
+			ifindex =
+			    rtnl_link_name2i(cache, id_list->list[a]->name);
+
+			if (!ifindex)
+				continue;
+
+			memset(&req[nr], 0, sizeof(req[nr]));
+			req[nr].hdr.nlmsg_len = NLMSG_LENGTH(sizeof(req[nr].ifsm));
+			req[nr].hdr.nlmsg_type = RTM_GETSTATS;
+			req[nr].hdr.nlmsg_flags = NLM_F_REQUEST;
+			req[nr].hdr.nlmsg_seq = batch.seq + a;
+			req[nr].ifsm.family = AF_UNSPEC;
+			req[nr].ifsm.ifindex = ifindex;
+			req[nr].ifsm.filter_mask =
+			    IFLA_STATS_FILTER_BIT(IFLA_STATS_LINK_64);
+			nr++;
+		}
+
+		if (!nr)
+			continue;
+
+		if (nl_sendto(sock, req, nr * sizeof(*req)) < 0) {
+			rc = EIO;
+			break;
+		}
+
+		batch.pending = nr;
+
+		while (batch.pending)
+			if (nl_recvmsgs(sock, cb) < 0) {
+				rc = EIO;
+				break;
+			}
+
+		rc = rc ? rc : batch.err;
+	}
+
+	nl_cb_put(cb);
+	nl_socket_free(sock);
+
+	return rc;
 }
 
 /**
@@ -110,6 +391,11 @@ static void __interface_statistics_get(struct nl_object *obj, void *arg)
  * \param[in]           closure         Pointer to protobuf closure function pointer
  * \param[in,out]       closure_data	Pointer to protobuf closure data
  * \note Might silently skip an interface if memory could not be allocated.
+ *
+ * The kernel does not notify statistics updates: the statistics of requested
+ * interfaces are fetched in batches of \c RTM_GETSTATS requests and the
+ * managed cache is refilled when all interfaces are requested.
+ * Kernels without \c RTM_GETSTATS get the requested interfaces one by one.
  */
 
 void dabbad_interface_statistics_get(Dabba__DabbaService_Service * service,
@@ -120,41 +406,77 @@ void dabbad_interface_statistics_get(Dabba__DabbaService_Service * service,
 	Dabba__InterfaceStatisticsList statistics_list =
 	    DABBA__INTERFACE_STATISTICS_LIST__INIT;
 	Dabba__InterfaceStatisticsList *statistics_listp = NULL;
+	struct arena arena = ARENA_INIT;
+	struct interface_reply reply = { &statistics_list, 0, &arena };
+	Dabba__InterfaceIdList selected = DABBA__INTERFACE_ID_LIST__INIT;
+	struct interface_reply select = { &selected, 0, &arena };
 	struct nl_sock *sock = NULL;
-	struct nl_cache *cache;
+	struct nl_cache *cache, *fresh = NULL;
 	struct rtnl_link *link;
+	const char *name;
 	size_t a;
 
 	assert(service);
 	assert(closure_data);
 
 	cache = link_cache_alloc(&sock);
-	link = rtnl_link_alloc();
 
-	if (!link || !cache)
+	if (!cache)
+		goto out;
+
+	if (!id_list->n_list && link_cache_is_managed(cache)
+	    && nl_cache_refill(sock, cache))
+		goto out;
+
+	reply.size = select.size = link_cache_reply_size(cache, id_list);
+	statistics_list.list = dabbad_arena_array(&arena, reply.size,
+						  sizeof(*statistics_list.list));
+	selected.list =
+	    dabbad_arena_array(&arena, select.size, sizeof(*selected.list));
+
+	if (!statistics_list.list || !selected.list)
 		goto out;
 
 	if (id_list->n_list) {
-		for (a = 0; a < id_list->n_list; a++) {
-			rtnl_link_set_name(link, id_list->list[a]->name);
-			nl_cache_foreach_filter(cache, OBJ_CAST(link),
-						__interface_statistics_get,
-						&statistics_list);
+		link_cache_foreach(cache, id_list, interface_stats_select,
+				   &select);
+
+		if (!interface_stats_batch_fetch(cache, &selected, &reply)) {
+			statistics_listp = &statistics_list;
+			goto out;
+		}
+
+		/* Kernels without RTM_GETSTATS get the interfaces one by one */
+		statistics_list.n_list = 0;
+
+		if (nl_cache_alloc_name("route/link", &fresh))
+			goto out;
+
+		for (a = 0; a < selected.n_list; a++) {
+			name = selected.list[a]->name;
+
+			if (!link_cache_is_managed(cache))
+				link = rtnl_link_get_by_name(cache, name);
+			else if (rtnl_link_get_kernel(sock, 0, name, &link))
+				link = NULL;
+
+			if (!link)
+				continue;
+
+			nl_cache_add(fresh, OBJ_CAST(link));
+			rtnl_link_put(link);
 		}
+
+		nl_cache_foreach(fresh, __interface_statistics_get, &reply);
 	} else
-		nl_cache_foreach(cache, __interface_statistics_get,
-				 &statistics_list);
+		link_cache_foreach(cache, id_list, __interface_statistics_get,
+				   &reply);
 
 	statistics_listp = &statistics_list;
 
  out:
 	closure(statistics_listp, closure_data);
-	for (a = 0; a < statistics_list.n_list; a++) {
-		free(statistics_list.list[a]->status);
-		free(statistics_list.list[a]->id);
-		free(statistics_list.list[a]);
-	}
-	free(statistics_list.list);
-	link_destroy(link);
+	dabbad_arena_release(&arena);
+	nl_cache_free(fresh);
 	link_cache_destroy(sock, cache);
 }
@@ -16,50 +16,61 @@
 #include <netlink/cache.h>
 #include <netlink/route/link.h>
 #include <libdabba/interface.h>
+#include <dabbad/arena.h>
 #include <dabbad/interface.h>
 #include <dabbad/interface-status.h>
+#include <dabbad/worker.h>
 
 /**
- * \brief Get the status of a list of requested network interfaces
- * \param[in]           service	        Pointer to protobuf service structure
- * \param[in]           id_list         Pointer to the requested interface id list
- * \param[in]           closure         Pointer to protobuf closure function pointer
- * \param[in,out]       closure_data	Pointer to protobuf closure data
+ * \internal
+ * \brief Query the link state of a listed network interface
+ * \param[in,out]       arg	        Pointer to interface status list
+ * \param[in]           idx	        Index of the interface in the list
+ * \note Runs concurrently with the queries of the other listed interfaces.
+ */
+
+static void interface_status_query(void *arg, const size_t idx)
+{
+	Dabba__InterfaceStatusList *status_list = arg;
+	Dabba__InterfaceStatus *statusp = status_list->list[idx];
+
+	statusp->status->code =
+	    ldab_dev_link_get(statusp->id->name, &statusp->connectivity);
+}
+
+/**
+ * \internal
+ * \brief Add the status of a network interface to a list reply
+ * \param[in]           obj	        Pointer to interface netlink structure
+ * \param[in]           arg             Pointer to interface status list reply
  * \note Might silently skip an interface if memory could not be allocated.
+ * \note The link state is queried afterwards by \c interface_status_query().
  */
 
 static void __interface_status_get(struct nl_object *obj, void *arg)
 {
 	struct rtnl_link *link = (struct rtnl_link *)obj;
-	Dabba__InterfaceStatusList *status_list = arg;
-	Dabba__InterfaceStatus *statusp, **listpp;
-	size_t lsize = sizeof(*status_list->list) * (status_list->n_list + 1);
+	struct interface_reply *reply = arg;
+	Dabba__InterfaceStatusList *status_list = reply->list;
+	Dabba__InterfaceStatus *statusp;
 	uint16_t flags;
 
-	listpp = realloc(status_list->list, lsize);
-
-	if (!listpp)
+	if (status_list->n_list >= reply->size)
 		return;
 
-	status_list->list = listpp;
-	status_list->list[status_list->n_list] =
-	    malloc(sizeof(*status_list->list[status_list->n_list]));
-	statusp = status_list->list[status_list->n_list];
+	statusp = dabbad_arena_alloc(reply->arena, sizeof(*statusp));
 
 	if (!statusp)
 		return;
 
 	dabba__interface_status__init(statusp);
 
-	statusp->id = malloc(sizeof(*statusp->id));
-	statusp->status = malloc(sizeof(*statusp->status));
+	statusp->id = dabbad_arena_alloc(reply->arena, sizeof(*statusp->id));
+	statusp->status =
+	    dabbad_arena_alloc(reply->arena, sizeof(*statusp->status));
 
-	if (!statusp->id || !statusp->status) {
-		free(statusp->status);
-		free(statusp->id);
-		free(statusp);
+	if (!statusp->id || !statusp->status)
 		return;
-	}
 
 	dabba__interface_id__init(statusp->id);
 	dabba__error_code__init(statusp->status);
@@ -70,15 +81,12 @@ static void __interface_status_get(struct nl_object *obj, void *arg)
 	statusp->id->name = rtnl_link_get_name(link);
 	flags = rtnl_link_get_flags(link);
 
-	statusp->status->code =
-	    ldab_dev_link_get(statusp->id->name, &statusp->connectivity);
-
 	statusp->loopback = (flags & IFF_LOOPBACK) == IFF_LOOPBACK;
 	statusp->up = (flags & IFF_UP) == IFF_UP;
 	statusp->running = (flags & IFF_RUNNING) == IFF_RUNNING;
 	statusp->promiscuous = (flags & IFF_PROMISC) == IFF_PROMISC;
 
-	status_list->n_list++;
+	status_list->list[status_list->n_list++] = statusp;
 }
 
 /**
@@ -98,41 +106,34 @@ void dabbad_interface_status_get(Dabba__DabbaService_Service * service,
 	Dabba__InterfaceStatusList status_list =
 	    DABBA__INTERFACE_STATUS_LIST__INIT;
 	Dabba__InterfaceStatusList *status_listp = NULL;
+	struct arena arena = ARENA_INIT;
+	struct interface_reply reply = { &status_list, 0, &arena };
 	struct nl_sock *sock = NULL;
 	struct nl_cache *cache;
-	struct rtnl_link *link;
-	size_t a;
 
 	assert(service);
 	assert(closure_data);
 
 	cache = link_cache_alloc(&sock);
-	link = rtnl_link_alloc();
 
-	if (!link || !cache)
+	if (!cache)
 		goto out;
 
-	if (id_list->n_list) {
-		for (a = 0; a < id_list->n_list; a++) {
-			rtnl_link_set_name(link, id_list->list[a]->name);
-			nl_cache_foreach_filter(cache, OBJ_CAST(link),
-						__interface_status_get,
-						&status_list);
-		}
-	} else
-		nl_cache_foreach(cache, __interface_status_get, &status_list);
+	reply.size = link_cache_reply_size(cache, id_list);
+	status_list.list =
+	    dabbad_arena_array(&arena, reply.size, sizeof(*status_list.list));
 
+	if (!status_list.list)
+		goto out;
+
+	link_cache_foreach(cache, id_list, __interface_status_get, &reply);
+	dabbad_worker_parallel(interface_status_query, &status_list,
+			       status_list.n_list);
 	status_listp = &status_list;
 
  out:
 	closure(status_listp, closure_data);
-	for (a = 0; a < status_list.n_list; a++) {
-		free(status_list.list[a]->status);
-		free(status_list.list[a]->id);
-		free(status_list.list[a]);
-	}
-	free(status_list.list);
-	link_destroy(link);
+	dabbad_arena_release(&arena);
 	link_cache_destroy(sock, cache);
 }
 
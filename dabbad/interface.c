@@ -12,17 +12,185 @@
 
 #include <assert.h>
 #include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
 #include <netlink/cache.h>
 #include <netlink/route/link.h>
 #include <libdabba/macros.h>
 #include <libdabba/interface.h>
+#include <libdabba-rpc/rpc.h>
 #include <dabbad/interface.h>
 
+/**
+ * \internal
+ * \brief Long-lived interface cache kept up to date by link notifications
+ */
+
+static struct link_cache_mngr {
+	struct nl_cache_mngr *mngr;	/**< netlink cache manager */
+	struct nl_cache *cache;	/**< managed interface cache */
+	struct nl_sock *sock;	/**< socket to query and modify interfaces */
+} link_mngr;
+
+/**
+ * \internal
+ * \brief Function notified of the interface changes, \c NULL if none
+ */
+
+static struct link_notifier {
+	link_change_fn change;	/**< function to notify */
+	void *arg;		/**< argument passed to the function */
+} link_notifier;
+
+/**
+ * \internal
+ * \brief Forward an interface change applied to the managed cache
+ * \param[in]       cache	        Managed interface cache
+ * \param[in]       obj	                Interface which changed
+ * \param[in]       action	        Change type, like \c NL_ACT_NEW
+ * \param[in]       data	        Unused callback data
+ */
+
+static void link_cache_mngr_change(struct nl_cache *cache,
+				   struct nl_object *obj, int action,
+				   void *data)
+{
+	(void)data;
+
+	if (link_notifier.change)
+		link_notifier.change(cache, obj, action, link_notifier.arg);
+}
+
+/**
+ * \internal
+ * \brief Apply pending link notifications to the managed interface cache
+ * \param[in]       fd	                Cache manager netlink socket
+ * \param[in]       events	        Events on the netlink socket
+ * \param[in]       data	        Unused callback data
+ * \note Notifications are lost when the socket buffer overruns, the whole
+ * cache is dumped again in that case and the notified function is called
+ * without interface.
+ */
+
+static void link_cache_mngr_data_ready(int fd, unsigned events, void *data)
+{
+	(void)fd;
+	(void)events;
+	(void)data;
+
+	if (nl_cache_mngr_data_ready(link_mngr.mngr) >= 0)
+		return;
+
+	nl_cache_refill(link_mngr.sock, link_mngr.cache);
+
+	if (link_notifier.change)
+		link_notifier.change(link_mngr.cache, NULL, NL_ACT_UNSPEC,
+				     link_notifier.arg);
+}
+
+/**
+ * \brief Stop tracking interface changes
+ * \see link_cache_mngr_start()
+ */
+
+void link_cache_mngr_stop(void)
+{
+	if (link_mngr.mngr) {
+		protobuf_c_dispatch_watch_fd(protobuf_c_dispatch_default(),
+					     nl_cache_mngr_get_fd(link_mngr.mngr),
+					     0, NULL, NULL);
+		nl_cache_mngr_free(link_mngr.mngr);
+	}
+
+	if (link_mngr.sock)
+		nl_socket_free(link_mngr.sock);
+
+	memset(&link_mngr, 0, sizeof(link_mngr));
+}
+
+/**
+ * \brief Start tracking interface changes from the RPC dispatcher
+ * \return 0 on success, \c ENOMEM or \c EIO on failure
+ *
+ * The interface cache is dumped once and then kept up to date by the
+ * \c RTNLGRP_LINK notifications processed from the RPC dispatcher.
+ * As long as it runs, \c link_cache_alloc() returns this cache instead of
+ * dumping all interfaces again.
+ */
+
+int link_cache_mngr_start(void)
+{
+	int rc = ENOMEM;
+
+	assert(!link_mngr.mngr);
+
+	link_mngr.sock = nl_socket_alloc();
+
+	if (!link_mngr.sock)
+		goto err;
+
+	rc = EIO;
+
+	if (nl_connect(link_mngr.sock, NETLINK_ROUTE))
+		goto err;
+
+	if (nl_cache_mngr_alloc(NULL, NETLINK_ROUTE, 0, &link_mngr.mngr))
+		goto err;
+
+	if (nl_cache_mngr_add(link_mngr.mngr, "route/link",
+			      link_cache_mngr_change, NULL, &link_mngr.cache))
+		goto err;
+
+	protobuf_c_dispatch_watch_fd(protobuf_c_dispatch_default(),
+				     nl_cache_mngr_get_fd(link_mngr.mngr),
+				     PROTOBUF_C_EVENT_READABLE,
+				     link_cache_mngr_data_ready, NULL);
+
+	return 0;
+
+ err:
+	link_cache_mngr_stop();
+	return rc;
+}
+
+/**
+ * \brief Set the function notified of the interface changes
+ * \param[in]       change	        Function to notify, \c NULL to stop
+ * \param[in]       arg	                Argument passed to the function
+ *
+ * The function is called from the RPC dispatcher once a link notification
+ * is applied to the managed cache. It gets a \c NULL interface when the
+ * cache had to be dumped again after lost notifications.
+ * \note Only one function can be notified at a time.
+ */
+
+void link_cache_mngr_notify(link_change_fn change, void *arg)
+{
+	link_notifier.change = change;
+	link_notifier.arg = arg;
+}
+
+/**
+ * \brief Tell if an interface cache is the one kept by the cache manager
+ * \param[in]       cache	        Interface cache
+ * \return 1 if the cache is managed, 0 if it is a private dump
+ * \note Interface statistics are not notified, a managed cache must be
+ * refilled to report fresh counters.
+ */
+
+int link_cache_is_managed(const struct nl_cache *cache)
+{
+	return cache && cache == link_mngr.cache;
+}
+
 /**
  * \brief Allocate the current interface cache from netlink
  * \param[in,out]       sock	        Double pointer to a netlink socket
  * \return Returns newly allocated netlink cache on success, NULL on failure.
  * \note use \c link_cache_destroy() to free allocated memory
+ * \note The managed cache and its socket are returned when the cache manager
+ * runs.
  * \see link_cache_destroy()
  */
 
@@ -32,6 +200,11 @@ struct nl_cache *link_cache_alloc(struct nl_sock **sock)
 
 	assert(sock);
 
+	if (link_mngr.cache) {
+		*sock = link_mngr.sock;
+		return link_mngr.cache;
+	}
+
 	*sock = nl_socket_alloc();
 
 	if (!sock || nl_connect(*sock, NETLINK_ROUTE)
@@ -51,6 +224,9 @@ struct nl_cache *link_cache_alloc(struct nl_sock **sock)
 
 void link_cache_destroy(struct nl_sock *sock, struct nl_cache *cache)
 {
+	if (link_cache_is_managed(cache))
+		return;
+
 	nl_cache_free(cache);
 	nl_socket_free(sock);
 }
@@ -60,3 +236,213 @@ void link_destroy(struct rtnl_link *link)
 	if (link)
 		nl_object_free(OBJ_CAST(link));
 }
+
+/**
+ * \internal
+ * \brief Interface selection of a list request
+ */
+
+struct link_filter {
+	const char *prefix;	/**< name prefix, \c NULL to select all */
+	size_t prefix_len;	/**< length of the name prefix */
+	size_t skip;		/**< selected interfaces left to skip */
+	size_t left;		/**< selected interfaces left to report */
+	void (*cb) (struct nl_object *, void *); /**< report callback */
+	void *arg;		/**< report callback argument */
+};
+
+/**
+ * \internal
+ * \brief Report an interface if it is part of the requested page
+ * \param[in]           obj	        Pointer to interface netlink structure
+ * \param[in,out]       arg	        Pointer to the interface selection
+ */
+
+static void link_filter_apply(struct nl_object *obj, void *arg)
+{
+	struct link_filter *filter = arg;
+	const char *name = rtnl_link_get_name((struct rtnl_link *)obj);
+
+	if (!filter->left)
+		return;
+
+	if (filter->prefix
+	    && (!name || strncmp(name, filter->prefix, filter->prefix_len)))
+		return;
+
+	if (filter->skip) {
+		filter->skip--;
+		return;
+	}
+
+	filter->left--;
+	filter->cb(obj, filter->arg);
+}
+
+/**
+ * \internal
+ * \brief Cached interfaces collected for an ordered walk
+ */
+
+struct link_array {
+	struct rtnl_link **link;	/**< collected interfaces */
+	size_t nr;		/**< amount of collected interfaces */
+	size_t size;		/**< capacity of the interface array */
+};
+
+/**
+ * \internal
+ * \brief Collect a cached interface
+ * \param[in]           obj	        Pointer to interface netlink structure
+ * \param[in,out]       arg	        Pointer to the interface array
+ */
+
+static void link_array_add(struct nl_object *obj, void *arg)
+{
+	struct link_array *array = arg;
+
+	if (array->nr >= array->size)
+		return;
+
+	nl_object_get(obj);
+	array->link[array->nr++] = (struct rtnl_link *)obj;
+}
+
+/**
+ * \internal
+ * \brief Compare two interfaces by index
+ * \param[in]           a	        Pointer to the first interface pointer
+ * \param[in]           b	        Pointer to the second interface pointer
+ * \return Negative, null or positive value as for \c qsort(3)
+ */
+
+static int link_index_cmp(const void *a, const void *b)
+{
+	const int ia = rtnl_link_get_ifindex(*(struct rtnl_link * const *)a);
+	const int ib = rtnl_link_get_ifindex(*(struct rtnl_link * const *)b);
+
+	return (ia > ib) - (ia < ib);
+}
+
+/**
+ * \internal
+ * \brief Walk all cached interfaces by increasing index
+ * \param[in]           cache	        Interface cache
+ * \param[in,out]       filter	        Pointer to the interface selection
+ * \note Falls back to the cache order if the interfaces cannot be sorted.
+ */
+
+static void link_cache_walk(struct nl_cache *cache, struct link_filter *filter)
+{
+	struct link_array array = {.link = NULL };
+	int cnr = nl_cache_nitems(cache);
+	size_t a;
+
+	if (cnr > 0)
+		array.link = calloc(cnr, sizeof(*array.link));
+
+	if (!array.link) {
+		nl_cache_foreach(cache, link_filter_apply, filter);
+		return;
+	}
+
+	array.size = cnr;
+	nl_cache_foreach(cache, link_array_add, &array);
+	qsort(array.link, array.nr, sizeof(*array.link), link_index_cmp);
+
+	for (a = 0; a < array.nr; a++) {
+		link_filter_apply(OBJ_CAST(array.link[a]), filter);
+		rtnl_link_put(array.link[a]);
+	}
+
+	free(array.link);
+}
+
+/**
+ * \brief Get the amount of interfaces a list reply can report
+ * \param[in]           cache	        Interface cache
+ * \param[in]           id_list         Pointer to the requested interface id list
+ * \return Amount of requested interfaces, or of cached interfaces when none
+ * are requested, within the requested page
+ * \note Used to allocate interface list replies at once.
+ */
+
+size_t link_cache_reply_size(struct nl_cache *cache,
+			     const Dabba__InterfaceIdList * id_list)
+{
+	size_t nr;
+	int cnr;
+
+	assert(cache);
+	assert(id_list);
+
+	if (id_list->n_list)
+		nr = id_list->n_list;
+	else {
+		cnr = nl_cache_nitems(cache);
+		nr = cnr > 0 ? (size_t)cnr : 0;
+	}
+
+	if (id_list->has_offset)
+		nr = id_list->offset < nr ? nr - id_list->offset : 0;
+
+	if (id_list->has_limit && id_list->limit && id_list->limit < nr)
+		nr = id_list->limit;
+
+	return nr;
+}
+
+/**
+ * \brief Call a function on requested interfaces of a cache
+ * \param[in]           cache	        Interface cache
+ * \param[in]           id_list         Pointer to the requested interface id list
+ * \param[in]           cb	        Function to call on each interface
+ * \param[in]           arg	        Argument passed to the function
+ * \note All cached interfaces are passed when none are requested, unknown
+ * interfaces are skipped.
+ *
+ * Only the interfaces whose name starts with the requested prefix are
+ * selected. The first \c offset selected interfaces are skipped and at most
+ * \c limit interfaces are passed, a null limit meaning no limit. Cached
+ * interfaces are walked by increasing index so that successive pages do not
+ * overlap even if the cache order changes between requests.
+ */
+
+void link_cache_foreach(struct nl_cache *cache,
+			const Dabba__InterfaceIdList * id_list,
+			void (*cb) (struct nl_object *, void *), void *arg)
+{
+	struct link_filter filter = {.cb = cb,.arg = arg,.left = SIZE_MAX };
+	struct rtnl_link *link;
+	size_t a;
+
+	assert(cache);
+	assert(id_list);
+	assert(cb);
+
+	if (id_list->prefix && *id_list->prefix) {
+		filter.prefix = id_list->prefix;
+		filter.prefix_len = strlen(id_list->prefix);
+	}
+
+	if (id_list->has_offset)
+		filter.skip = id_list->offset;
+
+	if (id_list->has_limit && id_list->limit)
+		filter.left = id_list->limit;
+
+	if (!id_list->n_list) {
+		link_cache_walk(cache, &filter);
+		return;
+	}
+
+	for (a = 0; a < id_list->n_list && filter.left; a++) {
+		link = rtnl_link_get_by_name(cache, id_list->list[a]->name);
+
+		if (!link)
+			continue;
+
+		link_filter_apply(OBJ_CAST(link), &filter);
+		rtnl_link_put(link);
+	}
+}
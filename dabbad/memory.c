@@ -0,0 +1,266 @@
+/**
+ * \file memory.c
+ * \author written by Emmanuel Roullit emmanuel.roullit@gmail.com (c) 2013
+ * \date 2013
+ */
+
+
+#include <stdio.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <assert.h>
+#include <pthread.h>
+#include <sys/param.h>
+#include <sys/resource.h>
+#include <linux/capability.h>
+
+#include <libdabba/packet-mmap.h>
+#include <dabbad/memory.h>
+
+/**
+ * \internal
+ * \brief Memory held by the captures and replays and its budget
+ * \note Captures and replays are set up by workers, the accounting is shared
+ * under its lock.
+ */
+
+static struct memory_budget {
+	pthread_mutex_t lock;	/**< protects the accounting */
+	uint64_t budget;	/**< largest amount of memory, 0 if unlimited */
+	int shrink;		/**< downsize rings instead of rejecting them */
+	uint64_t used[MEMORY_TYPE_NR]; /**< memory in use per kind */
+} memory_budget = {
+	.lock = PTHREAD_MUTEX_INITIALIZER
+};
+
+/**
+ * \internal
+ * \brief Check if the daemon may lock memory beyond \c RLIMIT_MEMLOCK
+ * \return 1 if \c CAP_IPC_LOCK is in the effective capabilities, 0 otherwise
+ */
+
+static int memory_lock_is_capable(void)
+{
+	unsigned long long cap;
+	char line[128];
+	FILE *status;
+	int rc = 0;
+
+	status = fopen("/proc/self/status", "r");
+
+	if (!status)
+		return 0;
+
+	while (fgets(line, sizeof(line), status)) {
+		if (sscanf(line, "CapEff: %llx", &cap) == 1) {
+			rc = !!(cap & (1ULL << CAP_IPC_LOCK));
+			break;
+		}
+	}
+
+	fclose(status);
+
+	return rc;
+}
+
+/**
+ * \internal
+ * \brief Get the amount of memory left in the budget
+ * \return the amount of bytes which can still be reserved
+ * \note The lock must be held.
+ */
+
+static uint64_t memory_left(void)
+{
+	uint64_t used = 0;
+	size_t a;
+
+	if (!memory_budget.budget)
+		return UINT64_MAX;
+
+	for (a = 0; a < MEMORY_TYPE_NR; a++)
+		used += memory_budget.used[a];
+
+	return memory_budget.budget - MIN(used, memory_budget.budget);
+}
+
+/**
+ * \brief Set the default memory budget
+ *
+ * Packet mmap rings are locked in memory: the budget is half of the physical
+ * memory, and \c RLIMIT_MEMLOCK if the daemon is not allowed to exceed it.
+ */
+
+void dabbad_memory_init(void)
+{
+	struct rlimit rlim;
+	uint64_t budget;
+
+	budget = (uint64_t) sysconf(_SC_PHYS_PAGES) * sysconf(_SC_PAGESIZE);
+	budget /= 2;
+
+	if (!memory_lock_is_capable() && !getrlimit(RLIMIT_MEMLOCK, &rlim)
+	    && rlim.rlim_cur != RLIM_INFINITY)
+		budget = MIN(budget, rlim.rlim_cur);
+
+	pthread_mutex_lock(&memory_budget.lock);
+	memory_budget.budget = budget;
+	pthread_mutex_unlock(&memory_budget.lock);
+}
+
+/**
+ * \brief Account memory against the budget
+ * \param[in] type	kind of memory
+ * \param[in] size	amount of bytes to reserve
+ * \return 0 on success, \c ENOBUFS if the memory does not fit in the budget
+ */
+
+int dabbad_memory_reserve(const enum memory_type type, const uint64_t size)
+{
+	int rc = ENOBUFS;
+
+	assert(type < MEMORY_TYPE_NR);
+
+	pthread_mutex_lock(&memory_budget.lock);
+
+	if (size <= memory_left()) {
+		memory_budget.used[type] += size;
+		rc = 0;
+	}
+
+	pthread_mutex_unlock(&memory_budget.lock);
+
+	return rc;
+}
+
+/**
+ * \brief Account a packet mmap ring against the budget
+ * \param[in] type		kind of memory
+ * \param[in,out] layout	ring layout, downsized to fit in the budget
+ *				if the budget policy allows it
+ * \return 0 on success, \c ENOBUFS if the ring does not fit in the budget
+ */
+
+int dabbad_memory_ring_reserve(const enum memory_type type,
+			       struct tpacket_req *layout)
+{
+	struct tpacket_req shrunk;
+	uint64_t left, size;
+	int rc = ENOBUFS;
+
+	assert(type < MEMORY_TYPE_NR);
+	assert(layout);
+
+	pthread_mutex_lock(&memory_budget.lock);
+
+	left = memory_left();
+	size = packet_mmap_layout_size(layout);
+
+	/* A ring with less blocks of the same frame size may still fit */
+	if (size > left && memory_budget.shrink
+	    && !ldab_packet_mmap_budget_layout_get(&shrunk,
+						   layout->tp_frame_size,
+						   MIN(left, SIZE_MAX))) {
+		*layout = shrunk;
+		size = packet_mmap_layout_size(layout);
+	}
+
+	if (size <= left) {
+		memory_budget.used[type] += size;
+		rc = 0;
+	}
+
+	pthread_mutex_unlock(&memory_budget.lock);
+
+	return rc;
+}
+
+/**
+ * \brief Give memory back to the budget
+ * \param[in] type	kind of memory
+ * \param[in] size	amount of reserved bytes to release
+ */
+
+void dabbad_memory_release(const enum memory_type type, const uint64_t size)
+{
+	assert(type < MEMORY_TYPE_NR);
+
+	pthread_mutex_lock(&memory_budget.lock);
+
+	assert(memory_budget.used[type] >= size);
+	memory_budget.used[type] -= size;
+
+	pthread_mutex_unlock(&memory_budget.lock);
+}
+
+/**
+ * \brief RPC to get the memory budget and its usage
+ * \param[in]           service	        Pointer to protobuf service structure
+ * \param[in]           dummyp          Pointer to unused dummy rpc message
+ * \param[in]           closure         Pointer to protobuf closure function pointer
+ * \param[in,out]       closure_data	Pointer to protobuf closure data
+ * \return Returns the budget, its policy and the memory used by the capture
+ * rings, capture buffers and replay rings via its closure function.
+ */
+
+void dabbad_memory_get(Dabba__DabbaService_Service * service,
+		       const Dabba__Dummy * dummyp,
+		       Dabba__Memory_Closure closure, void *closure_data)
+{
+	Dabba__Memory memory = DABBA__MEMORY__INIT;
+	Dabba__ErrorCode err = DABBA__ERROR_CODE__INIT;
+
+	assert(service);
+	assert(dummyp);
+
+	memory.status = &err;
+	memory.has_budget = memory.has_shrink = 1;
+	memory.has_ring = memory.has_buffer = memory.has_replay = 1;
+
+	pthread_mutex_lock(&memory_budget.lock);
+
+	memory.budget = memory_budget.budget;
+	memory.shrink = memory_budget.shrink;
+	memory.ring = memory_budget.used[MEMORY_RING];
+	memory.buffer = memory_budget.used[MEMORY_BUFFER];
+	memory.replay = memory_budget.used[MEMORY_REPLAY];
+
+	pthread_mutex_unlock(&memory_budget.lock);
+
+	closure(&memory, closure_data);
+}
+
+/**
+ * \brief RPC to change the memory budget or its policy
+ * \param[in]           service	        Pointer to protobuf service structure
+ * \param[in]           memoryp         Pointer to the new budget settings
+ * \param[in]           closure         Pointer to protobuf closure function pointer
+ * \param[in,out]       closure_data	Pointer to protobuf closure data
+ * \return Returns 0 via its closure function.
+ * \note Unset settings are kept and a zero budget disables the accounting
+ * limit. Memory already in use is never taken back.
+ */
+
+void dabbad_memory_modify(Dabba__DabbaService_Service * service,
+			  const Dabba__Memory * memoryp,
+			  Dabba__ErrorCode_Closure closure,
+			  void *closure_data)
+{
+	Dabba__ErrorCode err = DABBA__ERROR_CODE__INIT;
+
+	assert(service);
+	assert(memoryp);
+
+	pthread_mutex_lock(&memory_budget.lock);
+
+	if (memoryp->has_budget)
+		memory_budget.budget = memoryp->budget;
+
+	if (memoryp->has_shrink)
+		memory_budget.shrink = memoryp->shrink;
+
+	pthread_mutex_unlock(&memory_budget.lock);
+
+	closure(&err, closure_data);
+}
@@ -27,72 +27,48 @@
 #include <libdabba/interface.h>
 #include <libdabba/packet-tx.h>
 #include <libdabba/pcap.h>
+#include <libdabba/numa.h>
+#include <dabbad/arena.h>
 #include <dabbad/interface.h>
 #include <dabbad/replay.h>
+#include <dabbad/memory.h>
 #include <dabbad/misc.h>
+#include <dabbad/worker.h>
 
 /**
  * \internal
- * \brief Replay thread management list
+ * \brief Get a running replay from its thread id
+ * \param[in] id	replay thread id
+ * \return Pointer to the replay matching the thread id, \c NULL if none does
  */
 
-static struct replay_queue {
-	TAILQ_HEAD(head, packet_replay) head;
-	size_t length;
-} replay_queue = {
-.head = TAILQ_HEAD_INITIALIZER(replay_queue.head),.length = 0};
-
-/**
- * \internal
- * \brief Get the amount of replay thread in the replay list
- * \return Thread list length
- */
-
-static size_t dabbad_replay_length_get(void)
-{
-	return replay_queue.length;
-}
-
-/**
- * \internal
- * \brief Insert a new replay to the replay list tail
- */
-
-static void dabbad_replay_insert(struct packet_replay *const node)
+static struct packet_replay *dabbad_replay_find(const pthread_t id)
 {
-	assert(node);
-	TAILQ_INSERT_TAIL(&replay_queue.head, node, entry);
-	replay_queue.length++;
-}
+	struct packet_thread *pkt_thread = dabbad_thread_data_get(id);
 
-/**
- * \internal
- * \brief Remove existing replay entry from the replay list
- */
+	if (!pkt_thread || pkt_thread->type != REPLAY_THREAD)
+		return NULL;
 
-static void dabbad_replay_remove(struct packet_replay *const node)
-{
-	assert(node);
-	assert(replay_queue.length > 0);
-	TAILQ_REMOVE(&replay_queue.head, node, entry);
-	replay_queue.length--;
+	return container_of(pkt_thread, struct packet_replay, thread);
 }
 
 /**
  * \internal
- * \brief Returns replay matching thread id present in the replay list
- * \return Pointer to the replay matching the replay id
+ * \brief Get the next running replay
+ * \param[in] pkt_replay	current replay, \c NULL to get the first one
+ * \return Pointer to the next replay, \c NULL if none
  */
 
-static struct packet_replay *dabbad_replay_find(const pthread_t id)
+static struct packet_replay *dabbad_replay_next(struct packet_replay
+						*pkt_replay)
 {
-	struct packet_replay *node;
-
-	TAILQ_FOREACH(node, &replay_queue.head, entry)
-	    if (node->thread.id == id)
-		break;
+	struct packet_thread *pkt_thread =
+	    pkt_replay ? dabbad_thread_type_next(&pkt_replay->thread,
+						 REPLAY_THREAD) :
+	    dabbad_thread_type_first(REPLAY_THREAD);
 
-	return node;
+	return pkt_thread ? container_of(pkt_thread, struct packet_replay,
+					 thread) : NULL;
 }
 
 /**
@@ -129,6 +105,56 @@ static int replay_settings_are_valid(const Dabba__Replay * replayp)
 	return 1;
 }
 
+/**
+ * \internal
+ * \brief Release all resources held by a stopped replay
+ * \param[in] pkt_replay	Replay to release
+ */
+
+static void dabbad_replay_release(struct packet_replay *pkt_replay)
+{
+	struct packet_mmap *pkt_mmap;
+
+	assert(pkt_replay);
+
+	pkt_mmap = &pkt_replay->tx.pkt_mmap;
+	close(pkt_replay->tx.pcap_fd);
+	dabbad_memory_release(MEMORY_REPLAY,
+			      packet_mmap_layout_size(&pkt_mmap->layout));
+	ldab_packet_mmap_destroy(pkt_mmap);
+	ldab_packet_stop_destroy(&pkt_replay->tx.stop);
+	free(pkt_replay->pcap);
+	free(pkt_replay->interface);
+	free(pkt_replay);
+}
+
+/**
+ * \brief Stop and release all running replays
+ * \return 0 on success, else the return value of the first failed
+ * \c dabbad_thread_stop()
+ * \note Each replay sends the frames already queued before stopping.
+ */
+
+int dabbad_replay_shutdown(void)
+{
+	struct packet_replay *pkt_replay, *tmp;
+	int rc = 0;
+
+	for (pkt_replay = dabbad_replay_next(NULL); pkt_replay;
+	     pkt_replay = tmp) {
+		tmp = dabbad_replay_next(pkt_replay);
+
+		rc = dabbad_thread_stop(&pkt_replay->thread);
+
+		if (rc)
+			break;
+
+		dabbad_replay_release(pkt_replay);
+	}
+
+	return rc;
+}
+
 /**
  * \brief RPC to stop a running replay
  * \param[in]           service	        Pointer to protobuf service structure
@@ -158,12 +184,8 @@ void dabbad_replay_stop(Dabba__DabbaService_Service * service,
 
 	rc = dabbad_thread_stop(&pkt_replay->thread);
 
-	if (!rc) {
-		dabbad_replay_remove(pkt_replay);
-		close(pkt_replay->tx.pcap_fd);
-		ldab_packet_mmap_destroy(&pkt_replay->tx.pkt_mmap);
-		free(pkt_replay);
-	}
+	if (!rc)
+		dabbad_replay_release(pkt_replay);
 
  out:
 	err.code = rc;
@@ -185,54 +207,34 @@ void dabbad_replay_stop_all(Dabba__DabbaService_Service * service,
 			    void *closure_data)
 {
 	Dabba__ErrorCode err = DABBA__ERROR_CODE__INIT;
-	struct packet_replay *pkt_replay, *tmp;
-	int rc = 0;
 
 	assert(service);
 	assert(dummyp);
 
-	for (pkt_replay = TAILQ_FIRST(&replay_queue.head); pkt_replay;
-	     pkt_replay = tmp) {
-		tmp = TAILQ_NEXT(pkt_replay, entry);
-
-		rc = dabbad_thread_stop(&pkt_replay->thread);
-
-		if (rc)
-			break;
-
-		dabbad_replay_remove(pkt_replay);
-		close(pkt_replay->tx.pcap_fd);
-		ldab_packet_mmap_destroy(&pkt_replay->tx.pkt_mmap);
-		free(pkt_replay);
-	}
-
-	err.code = rc;
+	err.code = dabbad_replay_shutdown();
 	closure(&err, closure_data);
 }
 
 /**
- * \brief RPC to start a new replay
- * \param[in]           service	        Pointer to protobuf service structure
- * \param[in]           replayp        Pointer to new replay thread settings
- * \param[in]           closure         Pointer to protobuf closure function pointer
- * \param[in,out]       closure_data	Pointer to protobuf closure data
- * \return Returns 0 on success, else on failure via its closure function.
+ * \internal
+ * \brief Create a replay ring and start its replay thread
+ * \param[in]           replayp	        Pointer to the replay settings
+ * \param[out]          pkt_replayp	Pointer to the started replay
+ * \return 0 on success, else on failure
+ * \note This runs in a worker. The started replay must be registered from
+ * the RPC dispatcher.
  */
 
-void dabbad_replay_start(Dabba__DabbaService_Service * service,
-			 const Dabba__Replay * replayp,
-			 Dabba__ErrorCode_Closure closure, void *closure_data)
+static int dabbad_replay_setup(const Dabba__Replay * replayp,
+			       struct packet_replay **pkt_replayp)
 {
 	struct packet_replay *pkt_replay;
+	struct packet_thread_settings settings;
+	struct tpacket_req layout;
 	int sock, rc;
 
-	assert(service);
 	assert(replayp);
-
-	if (!replay_settings_are_valid(replayp)) {
-		rc = EINVAL;
-		goto out;
-	}
+	assert(pkt_replayp);
 
 	sock = socket(PF_PACKET, SOCK_RAW, htons(ETH_P_ALL));
 
@@ -251,6 +253,18 @@ void dabbad_replay_start(Dabba__DabbaService_Service * service,
 	}
 
 	pkt_replay->thread.type = REPLAY_THREAD;
+
+	rc = dabbad_thread_numa_prepare(&pkt_replay->thread,
+					replayp->interface,
+					replayp->has_numa_node,
+					replayp->numa_node);
+
+	if (rc) {
+		free(pkt_replay);
+		close(sock);
+		goto out;
+	}
+
 	pkt_replay->tx.pcap_fd = ldab_pcap_open(replayp->pcap, O_RDONLY);
 
 	if (pkt_replay->tx.pcap_fd < 0) {
@@ -260,25 +274,169 @@ void dabbad_replay_start(Dabba__DabbaService_Service * service,
 		goto out;
 	}
 
-	rc = ldab_packet_mmap_create(&pkt_replay->tx.pkt_mmap,
-				    replayp->interface, sock, PACKET_MMAP_TX,
-				    replayp->frame_size, replayp->frame_nr);
+	rc = ldab_packet_mmap_layout_get(&layout, replayp->frame_size,
+					 replayp->frame_nr);
+
+	if (!rc)
+		rc = dabbad_memory_ring_reserve(MEMORY_REPLAY, &layout);
 
 	if (rc) {
+		close(pkt_replay->tx.pcap_fd);
+		free(pkt_replay);
+		close(sock);
+		goto out;
+	}
+
+	rc = ldab_packet_mmap_layout_create(&pkt_replay->tx.pkt_mmap,
+					    replayp->interface, sock,
+					    PACKET_MMAP_TX, &layout);
+
+	if (rc) {
+		dabbad_memory_release(MEMORY_REPLAY,
+				      packet_mmap_layout_size(&layout));
+		close(pkt_replay->tx.pcap_fd);
 		free(pkt_replay);
 		close(sock);
 		goto out;
 	}
 
-	rc = dabbad_thread_start(&pkt_replay->thread, ldab_packet_tx,
-				 pkt_replay);
+	pkt_replay->thread.ifindex = pkt_replay->tx.pkt_mmap.ifindex;
+	settings.has_sched_policy = replayp->has_sched_policy;
+	settings.sched_policy = replayp->sched_policy;
+	settings.has_sched_priority = replayp->has_sched_priority;
+	settings.sched_priority = replayp->sched_priority;
+	settings.cpu_set = replayp->cpu_set;
+	settings.stack_prefault = replayp->stack_prefault;
+
+	pkt_replay->pcap = realpath(replayp->pcap, NULL);
+	pkt_replay->interface = strdup(replayp->interface);
+
+	rc = pkt_replay->interface ? ldab_packet_stop_init(&pkt_replay->tx.stop)
+	    : ENOMEM;
+
+	if (!rc) {
+		pkt_replay->thread.stop = &pkt_replay->tx.stop;
+		rc = dabbad_thread_start(&pkt_replay->thread, &settings,
+					 ldab_packet_tx, pkt_replay);
+
+		if (rc)
+			ldab_packet_stop_destroy(&pkt_replay->tx.stop);
+	}
 
 	if (rc) {
+		dabbad_memory_release(MEMORY_REPLAY,
+				      packet_mmap_layout_size(&layout));
 		ldab_packet_mmap_destroy(&pkt_replay->tx.pkt_mmap);
+		close(pkt_replay->tx.pcap_fd);
+		free(pkt_replay->pcap);
+		free(pkt_replay->interface);
 		free(pkt_replay);
 		close(sock);
 	} else
-		dabbad_replay_insert(pkt_replay);
+		*pkt_replayp = pkt_replay;
+
+ out:
+	ldab_numa_mempolicy_set(NUMA_NODE_NONE);
+	return rc;
+}
+
+/**
+ * \internal
+ * \brief Replay start request run by a worker
+ */
+
+struct replay_start_job {
+	struct worker_job job;	/**< worker job */
+	Dabba__Replay *replayp;	/**< copy of the requested replay */
+	struct packet_replay *pkt_replay;	/**< started replay */
+	Dabba__ErrorCode_Closure closure;	/**< RPC reply closure */
+	void *closure_data;	/**< RPC reply closure data */
+	int rc;			/**< replay start status */
+};
+
+/**
+ * \internal
+ * \brief Start a requested replay from a worker
+ * \param[in,out]       job	        Replay start job
+ */
+
+static void dabbad_replay_start_run(struct worker_job *job)
+{
+	struct replay_start_job *start =
+	    container_of(job, struct replay_start_job, job);
+
+	start->rc = dabbad_replay_setup(start->replayp, &start->pkt_replay);
+}
+
+/**
+ * \internal
+ * \brief Register a started replay and reply to its client
+ * \param[in,out]       job	        Replay start job
+ */
+
+static void dabbad_replay_start_done(struct worker_job *job)
+{
+	struct replay_start_job *start =
+	    container_of(job, struct replay_start_job, job);
+
+	if (!start->rc)
+		dabbad_thread_register(&start->pkt_replay->thread);
+
+	start->replayp->status->code = start->rc;
+	start->closure(start->replayp->status, start->closure_data);
+	protobuf_c_message_free_unpacked(&start->replayp->base, NULL);
+	free(start);
+}
+
+/**
+ * \brief RPC to start a new replay
+ * \param[in]           service	        Pointer to protobuf service structure
+ * \param[in]           replayp        Pointer to new replay thread settings
+ * \param[in]           closure         Pointer to protobuf closure function pointer
+ * \param[in,out]       closure_data	Pointer to protobuf closure data
+ * \return Returns 0 on success, else on failure via its closure function.
+ *
+ * Like captures, replays are placed on the NUMA node of their interface and
+ * start with their requested scheduling and CPU affinity.
+ *
+ * The replay is set up by a worker, its client gets the reply once the replay
+ * is registered.
+ */
+
+void dabbad_replay_start(Dabba__DabbaService_Service * service,
+			 const Dabba__Replay * replayp,
+			 Dabba__ErrorCode_Closure closure, void *closure_data)
+{
+	struct replay_start_job *start;
+	int rc = ENOMEM;
+
+	assert(service);
+	assert(replayp);
+
+	if (!replay_settings_are_valid(replayp)) {
+		rc = EINVAL;
+		goto out;
+	}
+
+	start = calloc(1, sizeof(*start));
+
+	if (!start)
+		goto out;
+
+	start->replayp = (Dabba__Replay *) dabbad_worker_msg_dup(&replayp->base);
+
+	if (!start->replayp) {
+		free(start);
+		goto out;
+	}
+
+	start->job.run = dabbad_replay_start_run;
+	start->job.done = dabbad_replay_start_done;
+	start->closure = closure;
+	start->closure_data = closure_data;
+
+	dabbad_worker_run(&start->job);
+	return;
 
  out:
 	replayp->status->code = rc;
@@ -300,16 +458,20 @@ void dabbad_replay_get(Dabba__DabbaService_Service * service,
 {
 	Dabba__ReplayList replay_list = DABBA__REPLAY_LIST__INIT;
 	Dabba__ReplayList *replayp = NULL;
+	Dabba__Replay *replay;
+	struct arena arena = ARENA_INIT;
 	struct packet_replay *pkt_replay;
-	size_t a = dabbad_replay_length_get();
+	struct packet_thread **sel = NULL;
+	size_t a;
 
 	assert(service);
 	assert(id_listp);
 
-	if (a == 0)
+	if (dabbad_thread_select(REPLAY_THREAD, id_listp, &sel, &a) || a == 0)
 		goto out;
 
-	replay_list.list = calloc(a, sizeof(*replay_list.list));
+	replay_list.list =
+	    dabbad_arena_array(&arena, a, sizeof(*replay_list.list));
 
 	if (!replay_list.list)
 		goto out;
@@ -317,35 +479,28 @@ void dabbad_replay_get(Dabba__DabbaService_Service * service,
 	replay_list.n_list = a;
 
 	for (a = 0; a < replay_list.n_list; a++) {
-		replay_list.list[a] = malloc(sizeof(*replay_list.list[a]));
+		replay = dabbad_arena_alloc(&arena, sizeof(*replay));
 
-		if (!replay_list.list[a])
+		if (!replay)
 			goto out;
 
-		dabba__replay__init(replay_list.list[a]);
+		dabba__replay__init(replay);
 
-		replay_list.list[a]->id =
-		    malloc(sizeof(*replay_list.list[a]->id));
-		replay_list.list[a]->status =
-		    malloc(sizeof(*replay_list.list[a]->status));
-
-		replay_list.list[a]->pcap =
-		    calloc(NAME_MAX, sizeof(*replay_list.list[a]->pcap));
-		replay_list.list[a]->interface =
-		    calloc(IFNAMSIZ, sizeof(*replay_list.list[a]->interface));
+		replay->id = dabbad_arena_alloc(&arena, sizeof(*replay->id));
+		replay->status =
+		    dabbad_arena_alloc(&arena, sizeof(*replay->status));
 
-		if (!replay_list.list[a]->id || !replay_list.list[a]->status
-		    || !replay_list.list[a]->pcap
-		    || !replay_list.list[a]->interface)
+		if (!replay->id || !replay->status)
 			goto out;
 
-		dabba__thread_id__init(replay_list.list[a]->id);
-		dabba__error_code__init(replay_list.list[a]->status);
-	}
+		dabba__thread_id__init(replay->id);
+		dabba__error_code__init(replay->status);
 
-	a = 0;
+		replay_list.list[a] = replay;
+	}
 
-	TAILQ_FOREACH(pkt_replay, &replay_queue.head, entry) {
+	for (a = 0; a < replay_list.n_list; a++) {
+		pkt_replay = container_of(sel[a], struct packet_replay, thread);
 		replay_list.list[a]->has_frame_nr =
 		    replay_list.list[a]->has_frame_size = 1;
 		replay_list.list[a]->frame_nr =
@@ -357,31 +512,16 @@ void dabbad_replay_get(Dabba__DabbaService_Service * service,
 		/* TODO report replay health: disk full, link down etc... */
 		replay_list.list[a]->status->code = 0;
 
-		fd_to_path(pkt_replay->tx.pcap_fd, replay_list.list[a]->pcap,
-			   NAME_MAX * sizeof(*replay_list.list[a]->pcap));
-
-		ldab_ifindex_to_devname(pkt_replay->tx.pkt_mmap.ifindex,
-				       replay_list.list[a]->interface,
-				       IFNAMSIZ);
-
-		a++;
+		/* The strings belong to the replay, they are not duplicated */
+		replay_list.list[a]->pcap =
+		    pkt_replay->pcap ? pkt_replay->pcap : "";
+		replay_list.list[a]->interface = pkt_replay->interface;
 	}
 
 	replayp = &replay_list;
 
  out:
 	closure(replayp, closure_data);
-
-	for (a = 0; a < replay_list.n_list; a++) {
-		if (replay_list.list[a]) {
-			free(replay_list.list[a]->id);
-			free(replay_list.list[a]->status);
-			free(replay_list.list[a]->pcap);
-			free(replay_list.list[a]->interface);
-		}
-
-		free(replay_list.list[a]);
-	}
-
-	free(replay_list.list);
+	dabbad_arena_release(&arena);
+	free(sel);
 }
@@ -9,6 +9,7 @@
 #include <sys/stat.h>
 #include <errno.h>
 
+#include <libdabba/packet-stop.h>
 #include <libdabba-rpc/rpc.h>
 #include <dabbad/interface.h>
 #include <dabbad/interface-status.h>
@@ -21,6 +22,9 @@
 #include <dabbad/interface-statistics.h>
 #include <dabbad/thread.h>
 #include <dabbad/capture.h>
+#include <dabbad/capture-policy.h>
+#include <dabbad/capture-pool.h>
+#include <dabbad/memory.h>
 #include <dabbad/replay.h>
 
 /**
@@ -30,6 +34,13 @@
 static Dabba__DabbaService_Service dabba_service =
 DABBA__DABBA_SERVICE__INIT(dabbad_);
 
+/**
+ * \internal
+ * \brief Stop request of the RPC message polling
+ */
+
+static struct packet_stop msg_poll_stop = {.fd = -1,.requested = 0 };
+
 /**
  * \brief Destroy a new dabbad RPC server instance
  * \param[in]       server	        Pointer to the server context
@@ -39,6 +50,9 @@ void dabbad_rpc_server_stop(ProtobufC_RPC_Server * server)
 {
 	if (server)
 		protobuf_c_rpc_server_destroy(server, 0);
+
+	link_cache_mngr_stop();
+	ldab_packet_stop_destroy(&msg_poll_stop);
 }
 
 /**
@@ -46,6 +60,10 @@ void dabbad_rpc_server_stop(ProtobufC_RPC_Server * server)
  * \param[in]       name	        String to RPC server address
  * \param[in]       type	        Tell if the RPC server listens to Unix or TCP sockets
  * \return Pointer to RPC server context on success, \c NULL on failure
+ * \note The server must be started before \c dabbad_rpc_msg_poll_stop() is
+ * called.
+ * \note Interface queries fall back to a netlink dump per request when the
+ * interface cache manager cannot be started.
  */
 
 ProtobufC_RPC_Server *dabbad_rpc_server_start(const char *const name,
@@ -60,10 +78,16 @@ ProtobufC_RPC_Server *dabbad_rpc_server_start(const char *const name,
 	assert(type == PROTOBUF_C_RPC_ADDRESS_LOCAL
 	       || type == PROTOBUF_C_RPC_ADDRESS_TCP);
 
+	if (ldab_packet_stop_init(&msg_poll_stop))
+		return NULL;
+
 	server = protobuf_c_rpc_server_new(type, name,
 					   (ProtobufCService *) & dabba_service,
 					   NULL);
 
+	if (server)
+		link_cache_mngr_start();
+
 	if (server && type == PROTOBUF_C_RPC_ADDRESS_LOCAL) {
 		rc = chmod(name, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP);
 
@@ -76,15 +100,51 @@ ProtobufC_RPC_Server *dabbad_rpc_server_start(const char *const name,
 	return server;
 }
 
+/**
+ * \internal
+ * \brief Wake up the RPC message polling when it has to stop
+ * \param[in]       fd	                Stop request eventfd
+ * \param[in]       events	        Events on the eventfd
+ * \param[in]       data	        Unused callback data
+ * \note Leaving the file readable makes the dispatcher return again until
+ * the polling stops.
+ */
+
+static void dabbad_rpc_msg_poll_wakeup(int fd, unsigned events, void *data)
+{
+	(void)fd;
+	(void)events;
+	(void)data;
+}
+
+/**
+ * \brief Ask the RPC message polling to stop
+ * \note This function is async-signal-safe, signal handlers can call it.
+ */
+
+void dabbad_rpc_msg_poll_stop(void)
+{
+	ldab_packet_stop_request(&msg_poll_stop);
+}
+
 /**
  * \brief Poll server for new RPC queries to process
- * \note This function polls for new RPC queries endlessly
+ * \return 0 once \c dabbad_rpc_msg_poll_stop() was called
  */
 
 int dabbad_rpc_msg_poll(void)
 {
-	for (;;)
-		protobuf_c_dispatch_run(protobuf_c_dispatch_default());
+	ProtobufCDispatch *dispatch = protobuf_c_dispatch_default();
+
+	protobuf_c_dispatch_watch_fd(dispatch, msg_poll_stop.fd,
+				     PROTOBUF_C_EVENT_READABLE,
+				     dabbad_rpc_msg_poll_wakeup, NULL);
+
+	while (!packet_stop_is_requested(&msg_poll_stop))
+		protobuf_c_dispatch_run(dispatch);
+
+	protobuf_c_dispatch_watch_fd(dispatch, msg_poll_stop.fd, 0, NULL,
+				     NULL);
 
 	return 0;
 }
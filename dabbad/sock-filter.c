@@ -13,6 +13,8 @@
 
 #include <libdabba/sock-filter.h>
 #include <libdabba-rpc/rpc.h>
+#include <dabbad/arena.h>
+#include <dabbad/sock-filter.h>
 
 /**
  * \brief Free and clear a native socket filter
@@ -23,30 +25,10 @@ void dabbad_sfp_destroy(struct sock_fprog *const sfp)
 {
 	assert(sfp);
 	free(sfp->filter);
+	sfp->filter = NULL;
 	sfp->len = 0;
 }
 
-/**
- * \brief Free and clear a protobuf socket filter
- * \param[in] pbuf_sfp	protobuf socket filter to free and clear
- */
-
-void dabbad_pbuf_sfp_destroy(Dabba__SockFprog * pbuf_sfp)
-{
-	size_t a;
-
-	assert(pbuf_sfp);
-
-	if (pbuf_sfp->n_filter)
-		assert(pbuf_sfp->filter);
-
-	for (a = 0; a < pbuf_sfp->n_filter; a++)
-		free(pbuf_sfp->filter[a]);
-
-	free(pbuf_sfp->filter);
-	dabba__sock_fprog__init(pbuf_sfp);
-}
-
 /**
  * \brief Convert a protobuf socket filter to a native socket filter
  * \param[in]  pbuf_sf	protobuf socket filter to convert
@@ -54,6 +36,8 @@ void dabbad_pbuf_sfp_destroy(Dabba__SockFprog * pbuf_sfp)
  * \return \c ENOMEM if the system is out-of-memory
  *         \c EINVAL if the produced socket filter is invalid
  *         0 on success.
+ * \note The socket filter is optimized with \c ldab_sock_filter_optimize()
+ *       before being returned.
  * \note if the function is successful, \c sfp must be freed with
  *       \c dabbad_sfp_destroy() afterwards.
  * \see dabbad_sfp_destroy
@@ -63,6 +47,7 @@ int dabbad_pbuf_sfp_2_sfp(const Dabba__SockFprog * const pbuf_sf,
 			  struct sock_fprog *const sfp)
 {
 	size_t a;
+	int rc;
 
 	assert(pbuf_sf);
 	assert(sfp);
@@ -86,50 +71,53 @@ int dabbad_pbuf_sfp_2_sfp(const Dabba__SockFprog * const pbuf_sf,
 		return EINVAL;
 	}
 
-	return 0;
+	rc = ldab_sock_filter_optimize(sfp);
+
+	if (rc)
+		dabbad_sfp_destroy(sfp);
+
+	return rc;
 }
 
 /**
  * \brief Convert a native socket filter to a protobuf socket filter
+ * \param[in,out] arena	arena the protobuf socket filter is allocated from
  * \param[in]  sfp	native socket filter to convert
  * \param[out] pbuf_sfp	resulting protobuf socket filter
  * \return \c ENOMEM if the system is out-of-memory, 0 on success.
- * \note if the function is successful, \c pbuf_sfp must be freed with
- *       \c dabbad_pbuf_sfp_destroy() afterwards.
- * \see dabbad_pbuf_sfp_destroy
+ * \note The protobuf socket filter is freed along with the arena.
  */
 
-int dabbad_sfp_2_pbuf_sfp(const struct sock_fprog *const sfp,
+int dabbad_sfp_2_pbuf_sfp(struct arena *arena,
+			  const struct sock_fprog *const sfp,
 			  Dabba__SockFprog * const pbuf_sfp)
 {
 	Dabba__SockFilter *sf;
+	size_t a;
 
+	assert(arena);
 	assert(sfp);
 	assert(pbuf_sfp);
 
-	pbuf_sfp->filter = calloc(sfp->len, sizeof(*pbuf_sfp->filter));
+	pbuf_sfp->filter =
+	    dabbad_arena_array(arena, sfp->len, sizeof(*pbuf_sfp->filter));
+	sf = dabbad_arena_array(arena, sfp->len, sizeof(*sf));
 
-	if (!pbuf_sfp->filter)
+	if (!pbuf_sfp->filter || !sf)
 		return ENOMEM;
 
-	for (pbuf_sfp->n_filter = 0; pbuf_sfp->n_filter < sfp->len;
-	     pbuf_sfp->n_filter++) {
-		sf = malloc(sizeof(*sf));
-
-		if (!sf) {
-			dabbad_pbuf_sfp_destroy(pbuf_sfp);
-			return ENOMEM;
-		}
+	for (a = 0; a < sfp->len; a++) {
+		dabba__sock_filter__init(&sf[a]);
 
-		dabba__sock_filter__init(sf);
+		sf[a].code = sfp->filter[a].code;
+		sf[a].jt = sfp->filter[a].jt;
+		sf[a].jf = sfp->filter[a].jf;
+		sf[a].k = sfp->filter[a].k;
 
-		sf->code = sfp->filter[pbuf_sfp->n_filter].code;
-		sf->jt = sfp->filter[pbuf_sfp->n_filter].jt;
-		sf->jf = sfp->filter[pbuf_sfp->n_filter].jf;
-		sf->k = sfp->filter[pbuf_sfp->n_filter].k;
-
-		pbuf_sfp->filter[pbuf_sfp->n_filter] = sf;
+		pbuf_sfp->filter[a] = &sf[a];
 	}
 
+	pbuf_sfp->n_filter = sfp->len;
+
 	return 0;
 }
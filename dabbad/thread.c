@@ -14,74 +14,206 @@
 #include <string.h>
 #include <errno.h>
 #include <assert.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/syscall.h>
+#include <sys/param.h>
 
+#include <net/if.h>
+
+#include <dabbad/arena.h>
 #include <dabbad/thread.h>
 #include <libdabba/macros.h>
+#include <libdabba/interface.h>
+#include <libdabba/irq.h>
 
 /**
  * \internal
- * \brief Packet thread management list
+ * \brief Packet thread registry
+ *
+ * Threads are kept in their start order in \c head and indexed by their
+ * thread id in \c bucket.
  */
 
-static struct packet_thread_queue {
+static struct packet_thread_registry {
 	TAILQ_HEAD(head, packet_thread) head;
-	size_t length;
-} packet_thread_queue = {
-.head = TAILQ_HEAD_INITIALIZER(packet_thread_queue.head),.length = 0};
+	LIST_HEAD(bucket, packet_thread) bucket[THREAD_REGISTRY_BUCKETS];
+	size_t length[ANY_THREAD + 1];
+} packet_thread_registry = {
+.head = TAILQ_HEAD_INITIALIZER(packet_thread_registry.head)};
 
 /**
  * \internal
- * \brief Get the amount of thread in the thread list
- * \return Thread list length
+ * \brief Get the registry hash bucket of a thread id
+ * \param[in] id	thread id
+ * \return Pointer to the hash bucket of the thread id
  */
 
-static size_t dabbad_thread_length_get(void)
+static struct bucket *dabbad_thread_bucket_get(const pthread_t id)
 {
-	return packet_thread_queue.length;
+	const uint64_t hash = (uint64_t) id * 0x9e3779b97f4a7c15ULL;
+
+	return &packet_thread_registry.bucket[hash >> 32 &
+					       (THREAD_REGISTRY_BUCKETS - 1)];
 }
 
 /**
- * \internal
- * \brief Insert a new thread to the thread list tail
+ * \brief Get the amount of registered threads of a type
+ * \param[in] type	thread type to count, \c ANY_THREAD for all threads
+ * \return Amount of registered threads of the type
+ */
+
+size_t dabbad_thread_length_get(const enum packet_thread_type type)
+{
+	assert(type <= ANY_THREAD);
+
+	return packet_thread_registry.length[type];
+}
+
+/**
+ * \brief Register a new thread
+ * \param[in] node thread started by \c dabbad_thread_start()
+ * \note The registry belongs to the RPC dispatcher, a thread started by a
+ * worker is registered when its job completes.
  */
 
-static void dabbad_thread_insert(struct packet_thread *const node)
+void dabbad_thread_register(struct packet_thread *const node)
 {
 	assert(node);
-	TAILQ_INSERT_TAIL(&packet_thread_queue.head, node, entry);
-	packet_thread_queue.length++;
+	assert(node->type < ANY_THREAD);
+
+	TAILQ_INSERT_TAIL(&packet_thread_registry.head, node, entry);
+	LIST_INSERT_HEAD(dabbad_thread_bucket_get(node->id), node, bucket);
+	packet_thread_registry.length[node->type]++;
+	packet_thread_registry.length[ANY_THREAD]++;
 }
 
 /**
  * \internal
- * \brief Remove existing thread entry from the thread list
+ * \brief Remove a thread from the registry
  */
 
 static void dabbad_thread_remove(struct packet_thread *const node)
 {
 	assert(node);
-	assert(packet_thread_queue.length > 0);
-	TAILQ_REMOVE(&packet_thread_queue.head, node, entry);
-	packet_thread_queue.length--;
+	assert(packet_thread_registry.length[node->type] > 0);
+
+	TAILQ_REMOVE(&packet_thread_registry.head, node, entry);
+	LIST_REMOVE(node, bucket);
+	packet_thread_registry.length[node->type]--;
+	packet_thread_registry.length[ANY_THREAD]--;
 }
 
 /**
- * \internal
- * \brief Returns thread matching thread id present in the thread list
- * \return Pointer to the thread matching the thread id
+ * \brief Get a registered thread from its thread id
+ * \param[in] id	thread id to look for
+ * \return Pointer to the thread matching the thread id, \c NULL if none does
  */
 
-static struct packet_thread *dabbad_thread_find(const pthread_t id)
+struct packet_thread *dabbad_thread_data_get(const pthread_t id)
 {
 	struct packet_thread *node;
 
-	TAILQ_FOREACH(node, &packet_thread_queue.head, entry)
-	    if (node->id == id)
+	LIST_FOREACH(node, dabbad_thread_bucket_get(id), bucket)
+	    if (pthread_equal(node->id, id))
 		break;
 
 	return node;
 }
 
+/**
+ * \brief Get the first registered thread of a type
+ * \param[in] type	thread type to look for, \c ANY_THREAD for all threads
+ * \return Pointer to the oldest thread of the type, \c NULL if none
+ */
+
+struct packet_thread *dabbad_thread_type_first(const enum packet_thread_type
+					       type)
+{
+	struct packet_thread *node = TAILQ_FIRST(&packet_thread_registry.head);
+
+	if (node && type != ANY_THREAD && node->type != type)
+		node = dabbad_thread_type_next(node, type);
+
+	return node;
+}
+
+/**
+ * \brief Get the next registered thread of a type
+ * \param[in] pkt_thread	current thread
+ * \param[in] type		thread type to look for, \c ANY_THREAD for all
+ *				threads
+ * \return Pointer to the next thread of the type, \c NULL if none
+ */
+
+struct packet_thread *dabbad_thread_type_next(struct packet_thread *pkt_thread,
+					      const enum packet_thread_type
+					      type)
+{
+	assert(pkt_thread);
+
+	do
+		pkt_thread = TAILQ_NEXT(pkt_thread, entry);
+	while (pkt_thread && type != ANY_THREAD && pkt_thread->type != type);
+
+	return pkt_thread;
+}
+
+/**
+ * \brief Select the registered threads of a type requested by an id list
+ * \param[in] type		thread type to select, \c ANY_THREAD for all
+ *				threads
+ * \param[in] id_listp		requested thread ids, all threads of the type
+ *				are selected when the list is empty
+ * \param[out] selp		allocated array of the selected threads, to free
+ * \param[out] nr		amount of selected threads
+ * \return 0 on success, \c ENOMEM if the array could not be allocated
+ * \note Unknown ids and threads of another type are skipped.
+ */
+
+int dabbad_thread_select(const enum packet_thread_type type,
+			 const Dabba__ThreadIdList * id_listp,
+			 struct packet_thread ***selp, size_t * nr)
+{
+	struct packet_thread *node, **sel;
+	size_t a, len = dabbad_thread_length_get(type);
+
+	assert(id_listp);
+	assert(selp);
+	assert(nr);
+
+	*selp = NULL;
+	*nr = 0;
+
+	if (id_listp->n_list)
+		len = MIN(len, id_listp->n_list);
+
+	if (!len)
+		return 0;
+
+	sel = calloc(len, sizeof(*sel));
+
+	if (!sel)
+		return ENOMEM;
+
+	if (!id_listp->n_list)
+		for (node = dabbad_thread_type_first(type); node;
+		     node = dabbad_thread_type_next(node, type))
+			sel[(*nr)++] = node;
+
+	for (a = 0; a < id_listp->n_list && *nr < len; a++) {
+		node = dabbad_thread_data_get((pthread_t) id_listp->list[a]->id);
+
+		if (node && (type == ANY_THREAD || node->type == type))
+			sel[(*nr)++] = node;
+	}
+
+	*selp = sel;
+
+	return 0;
+}
+
 /**
  * \brief Set the thread scheduling policy and priority
  * \param[in] pkt_thread thread to modify
@@ -161,6 +293,181 @@ int dabbad_thread_sched_affinity_get(struct packet_thread *pkt_thread,
 	return pthread_getaffinity_np(pkt_thread->id, sizeof(*run_on), run_on);
 }
 
+/**
+ * \internal
+ * \brief Open a file of the procfs directory of a thread
+ * \param[in] tid	kernel thread id
+ * \param[in] name	name of the file to open
+ * \return the opened file on success, \c NULL on failure
+ */
+
+static FILE *dabbad_thread_proc_open(const pid_t tid, const char *const name)
+{
+	char path[64];
+
+	snprintf(path, sizeof(path), PROC_ROOT "/self/task/%d/%s", (int)tid,
+		 name);
+
+	return fopen(path, "r");
+}
+
+/**
+ * \internal
+ * \brief Get the context switch counters of a thread
+ * \param[in] tid	kernel thread id
+ * \param[out] usage	thread usage to fill
+ * \return 0 on success, \c ENOENT if a counter is missing, else on failure
+ */
+
+static int dabbad_thread_switches_get(const pid_t tid,
+				      struct packet_thread_usage *usage)
+{
+	unsigned long long value;
+	char line[128];
+	FILE *status;
+	int found = 0;
+
+	status = dabbad_thread_proc_open(tid, "status");
+
+	if (!status)
+		return errno;
+
+	while (fgets(line, sizeof(line), status)) {
+		if (sscanf(line, "voluntary_ctxt_switches: %llu", &value) == 1) {
+			usage->voluntary_switches = value;
+			found++;
+		} else if (sscanf(line, "nonvoluntary_ctxt_switches: %llu",
+				  &value) == 1) {
+			usage->involuntary_switches = value;
+			found++;
+		}
+	}
+
+	fclose(status);
+
+	return found == 2 ? 0 : ENOENT;
+}
+
+/**
+ * \internal
+ * \brief Get the CPU a thread last ran on
+ * \param[in] tid	kernel thread id
+ * \param[out] usage	thread usage to fill
+ * \return 0 on success, \c EINVAL if the stat file cannot be parsed, else on
+ * failure
+ * \note The CPU is the 39th field of the stat file. The thread name, second
+ * field, may contain spaces and is skipped up to its closing parenthesis.
+ */
+
+static int dabbad_thread_cpu_get(const pid_t tid,
+				 struct packet_thread_usage *usage)
+{
+	char line[1024], *field, *save;
+	FILE *stat;
+	int a, rc = EINVAL;
+
+	stat = dabbad_thread_proc_open(tid, "stat");
+
+	if (!stat)
+		return errno;
+
+	field = fgets(line, sizeof(line), stat) ? strrchr(line, ')') : NULL;
+
+	for (a = 3, field = field ? strtok_r(field + 1, " ", &save) : NULL;
+	     field; a++, field = strtok_r(NULL, " ", &save)) {
+		if (a == 39) {
+			usage->cpu = atoi(field);
+			rc = 0;
+			break;
+		}
+	}
+
+	fclose(stat);
+
+	return rc;
+}
+
+/**
+ * \internal
+ * \brief Get the time a thread spent waiting for a CPU
+ * \param[in] tid	kernel thread id
+ * \param[out] usage	thread usage to fill
+ * \return 0 on success, else on failure
+ * \note The kernel only reports it with scheduler statistics support.
+ */
+
+static int dabbad_thread_wait_time_get(const pid_t tid,
+				       struct packet_thread_usage *usage)
+{
+	unsigned long long run, wait;
+	FILE *schedstat;
+	int rc = EINVAL;
+
+	schedstat = dabbad_thread_proc_open(tid, "schedstat");
+
+	if (!schedstat)
+		return errno;
+
+	if (fscanf(schedstat, "%llu %llu", &run, &wait) == 2) {
+		usage->wait_time = wait;
+		usage->has_wait_time = 1;
+		rc = 0;
+	}
+
+	fclose(schedstat);
+
+	return rc;
+}
+
+/**
+ * \brief Get the CPU usage and scheduling statistics of a running thread
+ * \param[in] pkt_thread thread to get information from
+ * \param[out] usage thread CPU usage and scheduling statistics
+ * \return 0 on success, \c ESRCH if the thread does not run yet, else on
+ * failure
+ * \note A thread preempted or migrated to other CPUs may not drain its ring
+ * fast enough. The wait time is only available if the kernel keeps scheduler
+ * statistics.
+ */
+
+int dabbad_thread_usage_get(struct packet_thread *pkt_thread,
+			    struct packet_thread_usage *usage)
+{
+	struct timespec cpu_time;
+	clockid_t clock;
+	pid_t tid;
+	int rc;
+
+	assert(pkt_thread);
+	assert(usage);
+
+	memset(usage, 0, sizeof(*usage));
+	tid = __atomic_load_n(&pkt_thread->tid, __ATOMIC_RELAXED);
+
+	if (!tid)
+		return ESRCH;
+
+	rc = pthread_getcpuclockid(pkt_thread->id, &clock);
+
+	if (!rc && clock_gettime(clock, &cpu_time))
+		rc = errno;
+
+	if (rc)
+		return rc;
+
+	usage->cpu_time = cpu_time.tv_sec * 1000000000ULL + cpu_time.tv_nsec;
+
+	rc = dabbad_thread_switches_get(tid, usage);
+
+	if (!rc)
+		rc = dabbad_thread_cpu_get(tid, usage);
+
+	if (!rc)
+		dabbad_thread_wait_time_get(tid, usage);
+
+	return rc;
+}
+
 /**
  * \brief Print a CPU number list from a CPU set.
  * \param[in]           cpu	        Pointer to a CPU set
@@ -289,28 +596,261 @@ static int str2cpu_affinity(char *str, cpu_set_t * mask)
 	return 0;
 }
 
+/**
+ * \internal
+ * \brief Get the CPUs close to the ones receiving the packets of a thread
+ * \param[in] pkt_thread	thread to get information from
+ * \param[out] run_on		CPUs handling the interface receive queues and
+ *				their SMT siblings
+ * \return 0 on success, \c EINVAL if the thread works on all interfaces,
+ * \c ENOENT if the receiving CPUs could not be found
+ *
+ * Running next to the CPU receiving the packets keeps the packet data in a
+ * shared cache.
+ */
+
+static int dabbad_thread_auto_affinity_get(const struct packet_thread
+					   *pkt_thread, cpu_set_t * run_on)
+{
+	char dev[IFNAMSIZ] = { 0 };
+	cpu_set_t rx_cpus;
+	int rc;
+
+	assert(pkt_thread);
+	assert(run_on);
+
+	if (!pkt_thread->ifindex)
+		return EINVAL;
+
+	rc = ldab_ifindex_to_devname(pkt_thread->ifindex, dev, sizeof(dev));
+
+	if (!rc)
+		rc = ldab_dev_rx_cpus_get(PROC_ROOT, SYSFS_ROOT, dev, &rx_cpus);
+
+	if (!rc)
+		rc = ldab_cpu_siblings_get(SYSFS_ROOT, &rx_cpus, run_on);
+
+	return rc;
+}
+
+/**
+ * \brief Choose the NUMA node of a new thread and allocate its memory there
+ * \param[in,out] pkt_thread	thread to place
+ * \param[in] dev		interface the thread works on
+ * \param[in] has_node		non-zero if a NUMA node was requested
+ * \param[in] node		requested NUMA node, \c NUMA_NODE_NONE disables
+ *				the placement
+ * \return 0 on success, \c errno from \c set_mempolicy(2) on failure
+ *
+ * Without request, the NUMA node of the interface is used on machines with
+ * several NUMA nodes. Until the memory policy is reset, the memory allocated
+ * by the calling thread, like packet mmap rings, prefers the chosen node.
+ * The thread is bound to the CPUs of its node by \c dabbad_thread_start().
+ */
+
+int dabbad_thread_numa_prepare(struct packet_thread *pkt_thread,
+			       const char *const dev, const int has_node,
+			       const int node)
+{
+	int count, rc;
+
+	assert(pkt_thread);
+	assert(dev);
+
+	pkt_thread->numa_node = NUMA_NODE_NONE;
+
+	if (has_node)
+		pkt_thread->numa_node = node < 0 ? NUMA_NODE_NONE : node;
+	else if (!ldab_numa_node_count_get(SYSFS_ROOT, &count) && count > 1)
+		ldab_numa_dev_node_get(SYSFS_ROOT, dev, &pkt_thread->numa_node);
+
+	if (pkt_thread->numa_node == NUMA_NODE_NONE)
+		return 0;
+
+	rc = ldab_numa_mempolicy_set(pkt_thread->numa_node);
+
+	/* Kernels without NUMA support only have one node anyway */
+	return rc == ENOSYS ? 0 : rc;
+}
+
+/**
+ * \internal
+ * \brief Touch the stack pages a thread is about to use
+ * \param[in] size amount of stack to touch
+ *
+ * Faulting the pages in before the packet loop starts keeps page faults out
+ * of the first packets.
+ */
+
+static void __attribute__ ((noinline)) dabbad_thread_stack_prefault(const
+								     size_t
+								     size)
+{
+	uint8_t stack[size];
+	volatile uint8_t *p = stack;
+	const size_t page = sysconf(_SC_PAGESIZE);
+	size_t a;
+
+	for (a = 0; a < size; a += page)
+		p[a] = 0;
+}
+
+/**
+ * \internal
+ * \brief Entry point of the threads started by \c dabbad_thread_start()
+ * \param[in] arg thread information
+ * \return return value of the thread function
+ */
+
+static void *dabbad_thread_run(void *arg)
+{
+	struct packet_thread *pkt_thread = arg;
+
+	assert(pkt_thread);
+
+	__atomic_store_n(&pkt_thread->tid, (pid_t) syscall(SYS_gettid),
+			 __ATOMIC_RELAXED);
+
+	if (pkt_thread->stack_prefault)
+		dabbad_thread_stack_prefault(THREAD_STACK_PREFAULT_SIZE);
+
+	return pkt_thread->func(pkt_thread->arg);
+}
+
+/**
+ * \internal
+ * \brief Set the CPU affinity a new thread starts with
+ * \param[in] pkt_thread thread information
+ * \param[in] cpu_set requested CPU list, "auto" or \c NULL
+ * \param[out] attr thread attributes to fill
+ * \return 0 on success, else on failure
+ * \note Without request, a thread placed on a NUMA node runs on the CPUs of
+ * this node.
+ */
+
+static int dabbad_thread_attr_affinity_set(const struct packet_thread
+					   *pkt_thread,
+					   const char *const cpu_set,
+					   pthread_attr_t * attr)
+{
+	cpu_set_t run_on;
+	int rc = 0;
+
+	assert(pkt_thread);
+	assert(attr);
+
+	CPU_ZERO(&run_on);
+
+	if (cpu_set && strcmp(cpu_set, THREAD_CPU_AFFINITY_AUTO) == 0)
+		rc = dabbad_thread_auto_affinity_get(pkt_thread, &run_on);
+	else if (cpu_set)
+		rc = ldab_cpu_list_parse(cpu_set, &run_on);
+	else if (pkt_thread->numa_node != NUMA_NODE_NONE)
+		ldab_numa_node_cpus_get(SYSFS_ROOT, pkt_thread->numa_node,
+					&run_on);
+
+	if (!rc && CPU_COUNT(&run_on))
+		rc = pthread_attr_setaffinity_np(attr, sizeof(run_on), &run_on);
+
+	return rc;
+}
+
+/**
+ * \internal
+ * \brief Set the scheduling policy and priority a new thread starts with
+ * \param[in] settings requested thread settings
+ * \param[out] attr thread attributes to fill
+ * \return 0 on success, else on failure
+ * \note A policy without priority uses the lowest priority of the policy.
+ */
+
+static int dabbad_thread_attr_sched_set(const struct packet_thread_settings
+					*settings, pthread_attr_t * attr)
+{
+	struct sched_param sp = { 0 };
+	int policy = SCHED_OTHER, rc;
+
+	assert(settings);
+	assert(attr);
+
+	if (!settings->has_sched_policy && !settings->has_sched_priority)
+		return 0;
+
+	if (settings->has_sched_policy)
+		policy = settings->sched_policy;
+
+	sp.sched_priority = sched_get_priority_min(policy);
+
+	if (settings->has_sched_priority)
+		sp.sched_priority = settings->sched_priority;
+
+	rc = pthread_attr_setinheritsched(attr, PTHREAD_EXPLICIT_SCHED);
+
+	if (!rc)
+		rc = pthread_attr_setschedpolicy(attr, policy);
+
+	if (!rc)
+		rc = pthread_attr_setschedparam(attr, &sp);
+
+	return rc;
+}
+
 /**
  * \brief Start a new thread
  * \param[in] pkt_thread thread information
+ * \param[in] settings scheduling, affinity and stack settings of the thread
  * \param[in] func function to start as a thread
- * \return return value of \c pthread_create(3) or \¢ pthread_detach(3)
+ * \param[in] arg argument of the function
+ * \return 0 on success, \c EINVAL on invalid settings, else return value of
+ * \c pthread_create(3)
+ *
+ * The settings are part of the thread attributes so that the thread runs
+ * with them from its first instruction. Without CPU list, a thread placed on
+ * a NUMA node only runs on the CPUs of this node.
+ * The thread is joinable: \c pkt_thread->stop must be set so that
+ * \c dabbad_thread_stop() can ask it to return.
+ * The started thread must then be registered by \c dabbad_thread_register().
  */
 
 int dabbad_thread_start(struct packet_thread *pkt_thread,
+			const struct packet_thread_settings *settings,
 			void *(*func) (void *arg), void *arg)
 {
+	pthread_attr_t attr;
+	size_t stack_size;
 	int rc;
 
 	assert(pkt_thread);
+	assert(settings);
 	assert(func);
 
-	rc = pthread_create(&pkt_thread->id, NULL, func, arg);
+	pkt_thread->func = func;
+	pkt_thread->arg = arg;
+	pkt_thread->stack_prefault = settings->stack_prefault;
+	pkt_thread->tid = 0;
+
+	rc = pthread_attr_init(&attr);
+
+	if (rc)
+		return rc;
+
+	rc = dabbad_thread_attr_affinity_set(pkt_thread, settings->cpu_set,
+					     &attr);
 
 	if (!rc)
-		rc = pthread_detach(pkt_thread->id);
+		rc = dabbad_thread_attr_sched_set(settings, &attr);
+
+	if (!rc && settings->stack_prefault
+	    && !pthread_attr_getstacksize(&attr, &stack_size)
+	    && stack_size < 2 * THREAD_STACK_PREFAULT_SIZE)
+		rc = pthread_attr_setstacksize(&attr,
+					       2 * THREAD_STACK_PREFAULT_SIZE);
 
 	if (!rc)
-		dabbad_thread_insert(pkt_thread);
+		rc = pthread_create(&pkt_thread->id, &attr, dabbad_thread_run,
+				    pkt_thread);
+
+	pthread_attr_destroy(&attr);
 
 	return rc;
 }
@@ -318,24 +858,43 @@ int dabbad_thread_start(struct packet_thread *pkt_thread,
 /**
  * \brief Stop a running thread
  * \param[in] pkt_thread running thread to stop
- * \return return value of \c pthread_cancel(3) or \c EINVAL if thread could not be found
+ * \return 0 on success, \c EINVAL if thread could not be found, else return
+ * value of \c pthread_cancel(3) or \c pthread_join(3)
+ *
+ * The thread is asked to stop through its stop request so that it finishes
+ * the packets it holds. A thread which does not return within
+ * \c THREAD_STOP_TIMEOUT seconds is cancelled.
  */
 
 int dabbad_thread_stop(struct packet_thread *pkt_thread)
 {
 	struct packet_thread *node;
+	struct timespec deadline;
 	int rc;
 
 	assert(pkt_thread);
 
-	TAILQ_FOREACH(node, &packet_thread_queue.head, entry)
-	    if (pthread_equal(pkt_thread->id, node->id))
-		break;
+	node = dabbad_thread_data_get(pkt_thread->id);
 
 	if (!node)
 		return EINVAL;
 
-	rc = pthread_cancel(node->id);
+	assert(node->stop);
+
+	rc = ldab_packet_stop_request(node->stop);
+
+	if (!rc) {
+		clock_gettime(CLOCK_REALTIME, &deadline);
+		deadline.tv_sec += THREAD_STOP_TIMEOUT;
+		rc = pthread_timedjoin_np(node->id, NULL, &deadline);
+	}
+
+	if (rc) {
+		rc = pthread_cancel(node->id);
+
+		if (!rc)
+			rc = pthread_join(node->id, NULL);
+	}
 
 	if (!rc)
 		dabbad_thread_remove(node);
@@ -352,6 +911,8 @@ int dabbad_thread_stop(struct packet_thread *pkt_thread)
  * \note This RPC only modifies the requested interface status
  * \note The thread settings are applied by best-effort,
  *       if a modification fails no further modifications are applied
+ * \note The "auto" CPU affinity runs the thread on the CPUs handling the
+ *       receive queues of its interface or on their SMT siblings.
  */
 
 void dabbad_thread_modify(Dabba__DabbaService_Service * service,
@@ -366,7 +927,7 @@ void dabbad_thread_modify(Dabba__DabbaService_Service * service,
 	assert(service);
 	assert(thread);
 
-	pkt_thread = dabbad_thread_find(thread->id->id);
+	pkt_thread = dabbad_thread_data_get(thread->id->id);
 
 	if (pkt_thread) {
 		dabbad_thread_sched_param_get(pkt_thread, &sched_prio,
@@ -379,7 +940,11 @@ void dabbad_thread_modify(Dabba__DabbaService_Service * service,
 		if (thread->has_sched_priority)
 			sched_prio = thread->sched_priority;
 
-		if (thread->cpu_set)
+		if (thread->cpu_set
+		    && strcmp(thread->cpu_set, THREAD_CPU_AFFINITY_AUTO) == 0)
+			rc = dabbad_thread_auto_affinity_get(pkt_thread,
+							     &run_on);
+		else if (thread->cpu_set)
 			str2cpu_affinity(thread->cpu_set, &run_on);
 
 		if (!rc)
@@ -403,6 +968,8 @@ void dabbad_thread_modify(Dabba__DabbaService_Service * service,
  * \param[in]           id_list         Pointer to the requested thread id list
  * \param[in]           closure         Pointer to protobuf closure function pointer
  * \param[in,out]       closure_data	Pointer to protobuf closure data
+ * \note The kernel thread id, CPU time, context switches, current CPU and
+ *       CPU wait time are only set for threads which already run.
  */
 
 void dabbad_thread_get(Dabba__DabbaService_Service * service,
@@ -412,18 +979,21 @@ void dabbad_thread_get(Dabba__DabbaService_Service * service,
 	Dabba__ThreadList settings_list = DABBA__THREAD_LIST__INIT;
 	Dabba__ThreadList *settings_listp = NULL;
 	Dabba__Thread *settingsp;
-	struct packet_thread *pkt_thread;
-	size_t a = dabbad_thread_length_get(), cs_len = 128;
+	struct arena arena = ARENA_INIT;
+	struct packet_thread *pkt_thread, **sel = NULL;
+	struct packet_thread_usage usage;
+	size_t a, cs_len = 128;
 	cpu_set_t run_on;
 	int rc = 0;
 
 	assert(service);
 	assert(id_listp);
 
-	if (a == 0)
+	if (dabbad_thread_select(ANY_THREAD, id_listp, &sel, &a) || a == 0)
 		goto out;
 
-	settings_list.list = calloc(a, sizeof(*settings_list.list));
+	settings_list.list =
+	    dabbad_arena_array(&arena, a, sizeof(*settings_list.list));
 
 	if (!settings_list.list)
 		goto out;
@@ -431,31 +1001,32 @@ void dabbad_thread_get(Dabba__DabbaService_Service * service,
 	settings_list.n_list = a;
 
 	for (a = 0; a < settings_list.n_list; a++) {
-		settings_list.list[a] = malloc(sizeof(*settings_list.list[a]));
+		settingsp = dabbad_arena_alloc(&arena, sizeof(*settingsp));
 
-		if (!settings_list.list[a])
+		if (!settingsp)
 			goto out;
 
-		dabba__thread__init(settings_list.list[a]);
+		dabba__thread__init(settingsp);
 
-		settings_list.list[a]->id =
-		    malloc(sizeof(*settings_list.list[a]->id));
-		settings_list.list[a]->status =
-		    malloc(sizeof(*settings_list.list[a]->status));
-		settings_list.list[a]->cpu_set =
-		    calloc(cs_len, sizeof(*settings_list.list[a]->cpu_set));
+		settingsp->id =
+		    dabbad_arena_alloc(&arena, sizeof(*settingsp->id));
+		settingsp->status =
+		    dabbad_arena_alloc(&arena, sizeof(*settingsp->status));
+		settingsp->cpu_set = dabbad_arena_array(&arena, cs_len,
+							sizeof(*settingsp->
+							       cpu_set));
 
-		if (!settings_list.list[a]->id || !settings_list.list[a]->status
-		    || !settings_list.list[a]->cpu_set)
+		if (!settingsp->id || !settingsp->status || !settingsp->cpu_set)
 			goto out;
 
-		dabba__thread_id__init(settings_list.list[a]->id);
-		dabba__error_code__init(settings_list.list[a]->status);
-	}
+		dabba__thread_id__init(settingsp->id);
+		dabba__error_code__init(settingsp->status);
 
-	a = 0;
+		settings_list.list[a] = settingsp;
+	}
 
-	TAILQ_FOREACH(pkt_thread, &packet_thread_queue.head, entry) {
+	for (a = 0; a < settings_list.n_list; a++) {
+		pkt_thread = sel[a];
 		settingsp = settings_list.list[a];
 		settingsp->has_sched_policy = settingsp->has_sched_priority = 1;
 		settingsp->has_type = 1;
@@ -472,25 +1043,30 @@ void dabbad_thread_get(Dabba__DabbaService_Service * service,
 
 		settingsp->status->code = rc;
 		settingsp->type = pkt_thread->type;
-		a++;
+		settingsp->has_numa_node = 1;
+		settingsp->numa_node = pkt_thread->numa_node;
+
+		if (dabbad_thread_usage_get(pkt_thread, &usage))
+			continue;
+
+		settingsp->has_tid = settingsp->has_cpu_time = 1;
+		settingsp->has_voluntary_switches = 1;
+		settingsp->has_involuntary_switches = settingsp->has_cpu = 1;
+		settingsp->tid = pkt_thread->tid;
+		settingsp->cpu_time = usage.cpu_time;
+		settingsp->voluntary_switches = usage.voluntary_switches;
+		settingsp->involuntary_switches = usage.involuntary_switches;
+		settingsp->cpu = usage.cpu;
+		settingsp->has_wait_time = usage.has_wait_time;
+		settingsp->wait_time = usage.wait_time;
 	}
 
 	settings_listp = &settings_list;
 
  out:
 	closure(settings_listp, closure_data);
-
-	for (a = 0; a < settings_list.n_list; a++) {
-		if (settings_list.list[a]) {
-			free(settings_list.list[a]->id);
-			free(settings_list.list[a]->status);
-			free(settings_list.list[a]->cpu_set);
-		}
-
-		free(settings_list.list[a]);
-	}
-
-	free(settings_list.list);
+	dabbad_arena_release(&arena);
+	free(sel);
 }
 
 /**
@@ -509,13 +1085,16 @@ void dabbad_thread_capabilities_get(Dabba__DabbaService_Service * service,
 	Dabba__ThreadCapabilitiesList capabilities_list =
 	    DABBA__THREAD_CAPABILITIES_LIST__INIT;
 	Dabba__ThreadCapabilitiesList *capabilitiesp = NULL;
+	Dabba__ThreadCapabilities *capabilities;
+	struct arena arena = ARENA_INIT;
 	int policy[] = { SCHED_FIFO, SCHED_RR, SCHED_OTHER };
 	size_t a, psize = ARRAY_SIZE(policy);
 
 	assert(service);
 	assert(dummy);
 
-	capabilities_list.list = calloc(psize, sizeof(*capabilities_list.list));
+	capabilities_list.list =
+	    dabbad_arena_array(&arena, psize, sizeof(*capabilities_list.list));
 
 	if (!capabilities_list.list)
 		goto out;
@@ -523,21 +1102,22 @@ void dabbad_thread_capabilities_get(Dabba__DabbaService_Service * service,
 	capabilities_list.n_list = psize;
 
 	for (a = 0; a < capabilities_list.n_list; a++) {
-		capabilities_list.list[a] =
-		    malloc(sizeof(*capabilities_list.list[a]));
+		capabilities = dabbad_arena_alloc(&arena, sizeof(*capabilities));
 
-		if (!capabilities_list.list[a])
+		if (!capabilities)
 			goto out;
 
-		dabba__thread_capabilities__init(capabilities_list.list[a]);
+		dabba__thread_capabilities__init(capabilities);
 
-		capabilities_list.list[a]->status =
-		    malloc(sizeof(*capabilities_list.list[a]->status));
+		capabilities->status =
+		    dabbad_arena_alloc(&arena, sizeof(*capabilities->status));
 
-		if (!capabilities_list.list[a]->status)
+		if (!capabilities->status)
 			goto out;
 
-		dabba__error_code__init(capabilities_list.list[a]->status);
+		dabba__error_code__init(capabilities->status);
+
+		capabilities_list.list[a] = capabilities;
 	}
 
 	for (a = 0; a < psize; a++) {
@@ -561,13 +1141,5 @@ void dabbad_thread_capabilities_get(Dabba__DabbaService_Service * service,
 
  out:
 	closure(capabilitiesp, closure_data);
-
-	for (a = 0; a < psize; a++) {
-		if (capabilities_list.list[a])
-			free(capabilities_list.list[a]->status);
-
-		free(capabilities_list.list[a]);
-	}
-
-	free(capabilities_list.list);
+	dabbad_arena_release(&arena);
 }
@@ -0,0 +1,490 @@
+/**
+ * \file worker.c
+ * \author written by Emmanuel Roullit emmanuel.roullit@gmail.com (c) 2013
+ * \date 2013
+ */
+
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <assert.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+
+#include <libdabba/macros.h>
+#include <dabbad/worker.h>
+
+/**
+ * \internal
+ * \brief Worker threads and the jobs they exchange with the RPC dispatcher
+ */
+
+static struct worker_pool {
+	pthread_mutex_t lock;	/**< protects the job queues */
+	pthread_cond_t cond;	/**< signals queued jobs to the workers */
+	 TAILQ_HEAD(worker_todo, worker_job) todo; /**< jobs to run */
+	 TAILQ_HEAD(worker_done, worker_job) done; /**< jobs to complete */
+	pthread_t thread[WORKER_POOL_SIZE]; /**< worker threads */
+	size_t nr;		/**< amount of running worker threads */
+	int fd;			/**< eventfd waking up the dispatcher */
+	int stopping;		/**< workers must leave once the queue is empty */
+} worker_pool = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.cond = PTHREAD_COND_INITIALIZER,
+	.todo = TAILQ_HEAD_INITIALIZER(worker_pool.todo),
+	.done = TAILQ_HEAD_INITIALIZER(worker_pool.done),
+	.fd = -1
+};
+
+/**
+ * \internal
+ * \brief Complete the jobs run by the workers
+ * \note Completions run in the RPC dispatcher so they can safely reply to
+ * their client and update the daemon state.
+ */
+
+static void dabbad_worker_complete(void)
+{
+	struct worker_done done = TAILQ_HEAD_INITIALIZER(done);
+	struct worker_job *job;
+
+	pthread_mutex_lock(&worker_pool.lock);
+	TAILQ_CONCAT(&done, &worker_pool.done, entry);
+	pthread_mutex_unlock(&worker_pool.lock);
+
+	while ((job = TAILQ_FIRST(&done)) != NULL) {
+		TAILQ_REMOVE(&done, job, entry);
+		job->done(job);
+	}
+}
+
+/**
+ * \internal
+ * \brief Complete the jobs whose completion was notified
+ * \param[in]       fd	                Completion eventfd
+ * \param[in]       events	        Events on the eventfd
+ * \param[in]       data	        Unused callback data
+ */
+
+static void dabbad_worker_notified(int fd, unsigned events, void *data)
+{
+	uint64_t count;
+
+	(void)events;
+	(void)data;
+
+	if (read(fd, &count, sizeof(count)) < 0 && errno != EAGAIN)
+		return;
+
+	dabbad_worker_complete();
+}
+
+/**
+ * \internal
+ * \brief Run queued jobs until the pool stops
+ * \param[in]       arg	                Unused thread argument
+ * \return Always \c NULL
+ */
+
+static void *dabbad_worker_thread(void *arg)
+{
+	const uint64_t one = 1;
+	struct worker_job *job;
+
+	(void)arg;
+
+	pthread_mutex_lock(&worker_pool.lock);
+
+	for (;;) {
+		while (!worker_pool.stopping && TAILQ_EMPTY(&worker_pool.todo))
+			pthread_cond_wait(&worker_pool.cond, &worker_pool.lock);
+
+		job = TAILQ_FIRST(&worker_pool.todo);
+
+		if (!job)
+			break;
+
+		TAILQ_REMOVE(&worker_pool.todo, job, entry);
+		pthread_mutex_unlock(&worker_pool.lock);
+
+		job->run(job);
+
+		pthread_mutex_lock(&worker_pool.lock);
+		TAILQ_INSERT_TAIL(&worker_pool.done, job, entry);
+
+		if (write(worker_pool.fd, &one, sizeof(one)) < 0)
+			assert(errno == EAGAIN);
+	}
+
+	pthread_mutex_unlock(&worker_pool.lock);
+
+	return NULL;
+}
+
+/**
+ * \brief Stop the worker threads
+ * \note Queued jobs are run and completed before the workers leave.
+ * \see dabbad_worker_pool_start()
+ */
+
+void dabbad_worker_pool_stop(void)
+{
+	size_t a;
+
+	pthread_mutex_lock(&worker_pool.lock);
+	worker_pool.stopping = 1;
+	pthread_cond_broadcast(&worker_pool.cond);
+	pthread_mutex_unlock(&worker_pool.lock);
+
+	for (a = 0; a < worker_pool.nr; a++)
+		pthread_join(worker_pool.thread[a], NULL);
+
+	worker_pool.nr = 0;
+	dabbad_worker_complete();
+
+	if (worker_pool.fd >= 0) {
+		protobuf_c_dispatch_watch_fd(protobuf_c_dispatch_default(),
+					     worker_pool.fd, 0, NULL, NULL);
+		close(worker_pool.fd);
+		worker_pool.fd = -1;
+	}
+}
+
+/**
+ * \brief Start worker threads for the slow RPC handlers
+ * \param[in]       nr	                Amount of worker threads to start
+ * \return 0 on success, else on failure
+ *
+ * The workers notify the jobs they ran to the RPC dispatcher through an
+ * eventfd, so that fast queries are still served while slow ones run.
+ */
+
+int dabbad_worker_pool_start(const size_t nr)
+{
+	int rc = 0;
+
+	assert(nr <= WORKER_POOL_SIZE);
+	assert(!worker_pool.nr);
+
+	worker_pool.fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+	if (worker_pool.fd < 0)
+		return errno;
+
+	worker_pool.stopping = 0;
+
+	for (; !rc && worker_pool.nr < nr; worker_pool.nr++)
+		rc = pthread_create(&worker_pool.thread[worker_pool.nr], NULL,
+				    dabbad_worker_thread, NULL);
+
+	if (rc) {
+		worker_pool.nr--;
+		dabbad_worker_pool_stop();
+		return rc;
+	}
+
+	protobuf_c_dispatch_watch_fd(protobuf_c_dispatch_default(),
+				     worker_pool.fd, PROTOBUF_C_EVENT_READABLE,
+				     dabbad_worker_notified, NULL);
+
+	return 0;
+}
+
+/**
+ * \brief Run a job in a worker thread
+ * \param[in]       job	                Job to run
+ *
+ * The job completion is called from the RPC dispatcher once the job ran.
+ * Without running workers, the job is run and completed right away.
+ */
+
+void dabbad_worker_run(struct worker_job *job)
+{
+	assert(job);
+	assert(job->run);
+	assert(job->done);
+
+	pthread_mutex_lock(&worker_pool.lock);
+
+	if (worker_pool.nr && !worker_pool.stopping) {
+		TAILQ_INSERT_TAIL(&worker_pool.todo, job, entry);
+		pthread_cond_signal(&worker_pool.cond);
+		pthread_mutex_unlock(&worker_pool.lock);
+		return;
+	}
+
+	pthread_mutex_unlock(&worker_pool.lock);
+
+	job->run(job);
+	job->done(job);
+}
+
+/**
+ * \brief Duplicate an RPC message
+ * \param[in]       msg	                Message to duplicate
+ * \return Pointer to the duplicated message on success, \c NULL on failure
+ * \note RPC requests are released when their handler returns, a job must
+ * work on its own copy.
+ * \note Use \c protobuf_c_message_free_unpacked() to release the copy.
+ */
+
+ProtobufCMessage *dabbad_worker_msg_dup(const ProtobufCMessage * msg)
+{
+	ProtobufCMessage *dup;
+	uint8_t *buf;
+	size_t len;
+
+	assert(msg);
+
+	len = protobuf_c_message_get_packed_size(msg);
+	buf = malloc(len ? len : 1);
+
+	if (!buf)
+		return NULL;
+
+	protobuf_c_message_pack(msg, buf);
+	dup = protobuf_c_message_unpack(msg->descriptor, NULL, len, buf);
+	free(buf);
+
+	return dup;
+}
+
+/**
+ * \internal
+ * \brief Items shared by the threads of a parallel query
+ * \note The query is released by the last of its calling thread and helper
+ * job completions.
+ */
+
+struct worker_parallel {
+	void (*fn) (void *arg, const size_t idx); /**< per item work */
+	void *arg;		/**< argument passed to the work */
+	size_t nr;		/**< amount of items */
+	size_t next;		/**< next item to process */
+	pthread_mutex_t lock;	/**< protects the helper accounting */
+	pthread_cond_t cond;	/**< signals helpers leaving the query */
+	size_t running;		/**< amount of helpers processing items */
+	size_t ref;		/**< amount of references on the query */
+	int closed;		/**< helpers must not join the query anymore */
+};
+
+/**
+ * \internal
+ * \brief Worker job helping a parallel query
+ */
+
+struct worker_parallel_job {
+	struct worker_job job;	/**< job run by a worker */
+	struct worker_parallel *par; /**< helped parallel query */
+};
+
+/**
+ * \internal
+ * \brief Process the items of a parallel query until none are left
+ * \param[in]       par	                Pointer to the parallel query
+ */
+
+static void dabbad_worker_parallel_process(struct worker_parallel *par)
+{
+	size_t idx;
+
+	while ((idx = __atomic_fetch_add(&par->next, 1, __ATOMIC_RELAXED)) <
+	       par->nr)
+		par->fn(par->arg, idx);
+}
+
+/**
+ * \internal
+ * \brief Drop a reference on a parallel query
+ * \param[in]       par	                Pointer to the parallel query
+ */
+
+static void dabbad_worker_parallel_put(struct worker_parallel *par)
+{
+	size_t ref;
+
+	pthread_mutex_lock(&par->lock);
+	ref = --par->ref;
+	pthread_mutex_unlock(&par->lock);
+
+	if (ref)
+		return;
+
+	pthread_cond_destroy(&par->cond);
+	pthread_mutex_destroy(&par->lock);
+	free(par);
+}
+
+/**
+ * \internal
+ * \brief Help a parallel query from a worker thread
+ * \param[in]       job	                Helper job
+ * \note Helpers starting after the query was closed leave right away so
+ * that the calling thread never waits for a busy worker.
+ */
+
+static void dabbad_worker_parallel_run(struct worker_job *job)
+{
+	struct worker_parallel *par =
+	    container_of(job, struct worker_parallel_job, job)->par;
+
+	pthread_mutex_lock(&par->lock);
+
+	if (par->closed) {
+		pthread_mutex_unlock(&par->lock);
+		return;
+	}
+
+	par->running++;
+	pthread_mutex_unlock(&par->lock);
+
+	dabbad_worker_parallel_process(par);
+
+	pthread_mutex_lock(&par->lock);
+
+	if (!--par->running)
+		pthread_cond_signal(&par->cond);
+
+	pthread_mutex_unlock(&par->lock);
+}
+
+/**
+ * \internal
+ * \brief Release a parallel query helper job
+ * \param[in]       job	                Helper job
+ */
+
+static void dabbad_worker_parallel_done(struct worker_job *job)
+{
+	struct worker_parallel_job *helper =
+	    container_of(job, struct worker_parallel_job, job);
+
+	dabbad_worker_parallel_put(helper->par);
+	free(helper);
+}
+
+/**
+ * \internal
+ * \brief Queue helper jobs for a parallel query
+ * \param[in]       par	                Pointer to the parallel query
+ * \param[in]       nr	                Amount of helpers wanted
+ *
+ * Helpers are only queued to running workers, they are never run inline.
+ */
+
+static void dabbad_worker_parallel_help(struct worker_parallel *par,
+					size_t nr)
+{
+	struct worker_parallel_job *helper;
+
+	pthread_mutex_lock(&worker_pool.lock);
+
+	if (worker_pool.stopping)
+		nr = 0;
+
+	if (nr > worker_pool.nr)
+		nr = worker_pool.nr;
+
+	for (; nr; nr--) {
+		helper = calloc(1, sizeof(*helper));
+
+		if (!helper)
+			break;
+
+		helper->job.run = dabbad_worker_parallel_run;
+		helper->job.done = dabbad_worker_parallel_done;
+		helper->par = par;
+
+		pthread_mutex_lock(&par->lock);
+		par->ref++;
+		pthread_mutex_unlock(&par->lock);
+
+		TAILQ_INSERT_TAIL(&worker_pool.todo, &helper->job, entry);
+		pthread_cond_signal(&worker_pool.cond);
+	}
+
+	pthread_mutex_unlock(&worker_pool.lock);
+}
+
+/**
+ * \brief Run a function on many items from several threads
+ * \param[in]       fn	                Function to run on each item
+ * \param[in]       arg	                Argument passed to the function
+ * \param[in]       nr	                Amount of items
+ * \param[in]       min	                Amount of items each thread gets at
+ *					least
+ *
+ * Blocking per item work, like interface ioctls, is spread over the worker
+ * pool and the calling thread, which returns once all the items are
+ * processed. Workers keep their per-thread state, like interface ioctl
+ * sockets, from one query to the next. Lists shorter than twice \c min, or
+ * queries issued while no workers run, are processed by the calling thread
+ * alone.
+ * \note The function must not allocate from a shared arena.
+ */
+
+void dabbad_worker_parallel_split(void (*fn) (void *arg, const size_t idx),
+				  void *arg, const size_t nr, const size_t min)
+{
+	struct worker_parallel *par;
+	size_t thread_nr;
+	long cpu_nr = sysconf(_SC_NPROCESSORS_ONLN);
+
+	assert(fn);
+	assert(min);
+
+	thread_nr = nr / min;
+
+	if (thread_nr > WORKER_PARALLEL_MAX)
+		thread_nr = WORKER_PARALLEL_MAX;
+
+	if (cpu_nr > 0 && thread_nr > (size_t)cpu_nr)
+		thread_nr = cpu_nr;
+
+	par = thread_nr > 1 ? calloc(1, sizeof(*par)) : NULL;
+
+	if (!par) {
+		struct worker_parallel seq = {.fn = fn,.arg = arg,.nr = nr };
+
+		dabbad_worker_parallel_process(&seq);
+		return;
+	}
+
+	par->fn = fn;
+	par->arg = arg;
+	par->nr = nr;
+	par->ref = 1;
+	pthread_mutex_init(&par->lock, NULL);
+	pthread_cond_init(&par->cond, NULL);
+
+	/* The calling thread is one of the query threads */
+	dabbad_worker_parallel_help(par, thread_nr - 1);
+	dabbad_worker_parallel_process(par);
+
+	pthread_mutex_lock(&par->lock);
+	par->closed = 1;
+
+	while (par->running)
+		pthread_cond_wait(&par->cond, &par->lock);
+
+	pthread_mutex_unlock(&par->lock);
+
+	dabbad_worker_parallel_put(par);
+}
+
+/**
+ * \brief Run a function on many items from several threads
+ * \param[in]       fn	                Function to run on each item
+ * \param[in]       arg	                Argument passed to the function
+ * \param[in]       nr	                Amount of items
+ * \note Each thread gets at least \c WORKER_PARALLEL_MIN items.
+ * See \c dabbad_worker_parallel_split().
+ */
+
+void dabbad_worker_parallel(void (*fn) (void *arg, const size_t idx),
+			    void *arg, const size_t nr)
+{
+	dabbad_worker_parallel_split(fn, arg, nr, WORKER_PARALLEL_MIN);
+}
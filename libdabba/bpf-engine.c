@@ -0,0 +1,551 @@
+/**
+ * \file bpf-engine.c
+ * \author written by Emmanuel Roullit emmanuel.roullit@gmail.com (c) 2013
+ * \date 2013
+ *
+ * Classic BPF programs are decoded once into a dense operation index with
+ * absolute jump targets and pre-computed load bounds. The interpreter then
+ * dispatches each instruction with a computed goto instead of a \c switch,
+ * which saves the range check and gives each operation its own indirect branch.
+ */
+
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include <libdabba/macros.h>
+#include <libdabba/sock-filter.h>
+#include <libdabba/bpf-engine.h>
+
+/**
+ * \internal
+ * \brief Decoded operations
+ * \note The order must match the label table of \c ldab_bpf_engine_run()
+ */
+
+enum bpf_engine_op {
+	BPF_ENGINE_RET_K,
+	BPF_ENGINE_RET_A,
+	BPF_ENGINE_LD_W_ABS,
+	BPF_ENGINE_LD_H_ABS,
+	BPF_ENGINE_LD_B_ABS,
+	BPF_ENGINE_LD_W_IND,
+	BPF_ENGINE_LD_H_IND,
+	BPF_ENGINE_LD_B_IND,
+	BPF_ENGINE_LD_W_LEN,
+	BPF_ENGINE_LDX_W_LEN,
+	BPF_ENGINE_LDX_MSH,
+	BPF_ENGINE_LD_IMM,
+	BPF_ENGINE_LDX_IMM,
+	BPF_ENGINE_LD_MEM,
+	BPF_ENGINE_LDX_MEM,
+	BPF_ENGINE_ST,
+	BPF_ENGINE_STX,
+	BPF_ENGINE_JA,
+	BPF_ENGINE_JGT_K,
+	BPF_ENGINE_JGE_K,
+	BPF_ENGINE_JEQ_K,
+	BPF_ENGINE_JSET_K,
+	BPF_ENGINE_JGT_X,
+	BPF_ENGINE_JGE_X,
+	BPF_ENGINE_JEQ_X,
+	BPF_ENGINE_JSET_X,
+	BPF_ENGINE_ADD_X,
+	BPF_ENGINE_SUB_X,
+	BPF_ENGINE_MUL_X,
+	BPF_ENGINE_DIV_X,
+	BPF_ENGINE_AND_X,
+	BPF_ENGINE_OR_X,
+	BPF_ENGINE_LSH_X,
+	BPF_ENGINE_RSH_X,
+	BPF_ENGINE_ADD_K,
+	BPF_ENGINE_SUB_K,
+	BPF_ENGINE_MUL_K,
+	BPF_ENGINE_DIV_K,
+	BPF_ENGINE_AND_K,
+	BPF_ENGINE_OR_K,
+	BPF_ENGINE_LSH_K,
+	BPF_ENGINE_RSH_K,
+	BPF_ENGINE_NEG,
+	BPF_ENGINE_TAX,
+	BPF_ENGINE_TXA,
+	BPF_ENGINE_OP_NR
+};
+
+/**
+ * \internal
+ * \brief Classic BPF opcode to decoded operation mapping
+ */
+
+static const struct bpf_engine_opcode {
+	uint16_t code;
+	uint16_t op;
+} bpf_engine_opcode[] = {
+	{BPF_RET | BPF_K, BPF_ENGINE_RET_K},
+	{BPF_RET | BPF_A, BPF_ENGINE_RET_A},
+	{BPF_LD | BPF_W | BPF_ABS, BPF_ENGINE_LD_W_ABS},
+	{BPF_LD | BPF_H | BPF_ABS, BPF_ENGINE_LD_H_ABS},
+	{BPF_LD | BPF_B | BPF_ABS, BPF_ENGINE_LD_B_ABS},
+	{BPF_LD | BPF_W | BPF_IND, BPF_ENGINE_LD_W_IND},
+	{BPF_LD | BPF_H | BPF_IND, BPF_ENGINE_LD_H_IND},
+	{BPF_LD | BPF_B | BPF_IND, BPF_ENGINE_LD_B_IND},
+	{BPF_LD | BPF_W | BPF_LEN, BPF_ENGINE_LD_W_LEN},
+	{BPF_LDX | BPF_W | BPF_LEN, BPF_ENGINE_LDX_W_LEN},
+	{BPF_LDX | BPF_MSH | BPF_B, BPF_ENGINE_LDX_MSH},
+	{BPF_LD | BPF_IMM, BPF_ENGINE_LD_IMM},
+	{BPF_LDX | BPF_IMM, BPF_ENGINE_LDX_IMM},
+	{BPF_LD | BPF_MEM, BPF_ENGINE_LD_MEM},
+	{BPF_LDX | BPF_MEM, BPF_ENGINE_LDX_MEM},
+	{BPF_ST, BPF_ENGINE_ST},
+	{BPF_STX, BPF_ENGINE_STX},
+	{BPF_JMP | BPF_JA, BPF_ENGINE_JA},
+	{BPF_JMP | BPF_JGT | BPF_K, BPF_ENGINE_JGT_K},
+	{BPF_JMP | BPF_JGE | BPF_K, BPF_ENGINE_JGE_K},
+	{BPF_JMP | BPF_JEQ | BPF_K, BPF_ENGINE_JEQ_K},
+	{BPF_JMP | BPF_JSET | BPF_K, BPF_ENGINE_JSET_K},
+	{BPF_JMP | BPF_JGT | BPF_X, BPF_ENGINE_JGT_X},
+	{BPF_JMP | BPF_JGE | BPF_X, BPF_ENGINE_JGE_X},
+	{BPF_JMP | BPF_JEQ | BPF_X, BPF_ENGINE_JEQ_X},
+	{BPF_JMP | BPF_JSET | BPF_X, BPF_ENGINE_JSET_X},
+	{BPF_ALU | BPF_ADD | BPF_X, BPF_ENGINE_ADD_X},
+	{BPF_ALU | BPF_SUB | BPF_X, BPF_ENGINE_SUB_X},
+	{BPF_ALU | BPF_MUL | BPF_X, BPF_ENGINE_MUL_X},
+	{BPF_ALU | BPF_DIV | BPF_X, BPF_ENGINE_DIV_X},
+	{BPF_ALU | BPF_AND | BPF_X, BPF_ENGINE_AND_X},
+	{BPF_ALU | BPF_OR | BPF_X, BPF_ENGINE_OR_X},
+	{BPF_ALU | BPF_LSH | BPF_X, BPF_ENGINE_LSH_X},
+	{BPF_ALU | BPF_RSH | BPF_X, BPF_ENGINE_RSH_X},
+	{BPF_ALU | BPF_ADD | BPF_K, BPF_ENGINE_ADD_K},
+	{BPF_ALU | BPF_SUB | BPF_K, BPF_ENGINE_SUB_K},
+	{BPF_ALU | BPF_MUL | BPF_K, BPF_ENGINE_MUL_K},
+	{BPF_ALU | BPF_DIV | BPF_K, BPF_ENGINE_DIV_K},
+	{BPF_ALU | BPF_AND | BPF_K, BPF_ENGINE_AND_K},
+	{BPF_ALU | BPF_OR | BPF_K, BPF_ENGINE_OR_K},
+	{BPF_ALU | BPF_LSH | BPF_K, BPF_ENGINE_LSH_K},
+	{BPF_ALU | BPF_RSH | BPF_K, BPF_ENGINE_RSH_K},
+	{BPF_ALU | BPF_NEG, BPF_ENGINE_NEG},
+	{BPF_MISC | BPF_TAX, BPF_ENGINE_TAX},
+	{BPF_MISC | BPF_TXA, BPF_ENGINE_TXA}
+};
+
+/**
+ * \internal
+ * \brief Decode a single classic BPF instruction
+ * \param[in] sf	Classic BPF instruction to decode
+ * \param[in] pc	Index of the instruction in the program
+ * \param[in] len	Number of instructions in the program
+ * \param[out] insn	Decoded instruction
+ * \return 0 on success, \c EINVAL if the opcode is not supported or if a
+ *         jump does not land strictly forward inside the program
+ * \note Jump offsets are compared against the remaining length so that a
+ *       wrapping 32-bit offset cannot decode into a backward jump.
+ */
+
+static int bpf_engine_insn_decode(const struct sock_filter *const sf,
+				  const uint32_t pc, const uint32_t len,
+				  struct bpf_engine_insn *const insn)
+{
+	size_t a;
+	uint32_t size = 0;
+	const uint32_t left = len - pc - 1;
+
+	for (a = 0; a < ARRAY_SIZE(bpf_engine_opcode); a++)
+		if (bpf_engine_opcode[a].code == sf->code)
+			break;
+
+	if (a == ARRAY_SIZE(bpf_engine_opcode))
+		return EINVAL;
+
+	insn->op = bpf_engine_opcode[a].op;
+	insn->k = sf->k;
+	insn->jt = pc + 1 + sf->jt;
+	insn->jf = pc + 1 + sf->jf;
+
+	switch (insn->op) {
+	case BPF_ENGINE_JA:
+		if (sf->k >= left)
+			return EINVAL;
+		insn->jt = pc + 1 + sf->k;
+		break;
+	case BPF_ENGINE_JGT_K:
+	case BPF_ENGINE_JGE_K:
+	case BPF_ENGINE_JEQ_K:
+	case BPF_ENGINE_JSET_K:
+	case BPF_ENGINE_JGT_X:
+	case BPF_ENGINE_JGE_X:
+	case BPF_ENGINE_JEQ_X:
+	case BPF_ENGINE_JSET_X:
+		if (sf->jt >= left || sf->jf >= left)
+			return EINVAL;
+
+		/* Both branches lead to the same place */
+		if (insn->jt == insn->jf)
+			insn->op = BPF_ENGINE_JA;
+		break;
+	case BPF_ENGINE_LD_W_ABS:
+		size = sizeof(uint32_t);
+		break;
+	case BPF_ENGINE_LD_H_ABS:
+		size = sizeof(uint16_t);
+		break;
+	case BPF_ENGINE_LD_B_ABS:
+	case BPF_ENGINE_LDX_MSH:
+		size = sizeof(uint8_t);
+		break;
+	case BPF_ENGINE_LSH_K:
+	case BPF_ENGINE_RSH_K:
+		/* Shifting 32 bits or more always clears the accumulator */
+		if (sf->k >= 32) {
+			insn->op = BPF_ENGINE_LD_IMM;
+			insn->k = 0;
+		}
+		break;
+	default:
+		break;
+	}
+
+	if (size) {
+		/* Out-of-range absolute loads, e.g. ancillary data, always fail */
+		if (sf->k > UINT32_MAX - size) {
+			insn->op = BPF_ENGINE_RET_K;
+			insn->k = 0;
+		} else
+			insn->jt = sf->k + size;
+	}
+
+	return 0;
+}
+
+/**
+ * \brief Decode a classic BPF program for the userspace engine
+ * \param[out] engine	BPF engine to create
+ * \param[in] sfp	Classic BPF program to decode
+ * \return 0 on success, \c EINVAL if the program is invalid or unsupported,
+ *         \c ENOMEM if the system is out-of-memory
+ * \note if the function is successful, \c engine must be freed with
+ *       \c ldab_bpf_engine_destroy() afterwards.
+ */
+
+int ldab_bpf_engine_create(struct bpf_engine *engine,
+			   const struct sock_fprog *const sfp)
+{
+	size_t a;
+	int rc;
+
+	assert(engine);
+
+	memset(engine, 0, sizeof(*engine));
+
+	if (!ldab_sock_filter_is_valid(sfp))
+		return EINVAL;
+
+	engine->insn = calloc(sfp->len, sizeof(*engine->insn));
+
+	if (!engine->insn)
+		return ENOMEM;
+
+	for (a = 0; a < sfp->len; a++) {
+		rc = bpf_engine_insn_decode(&sfp->filter[a], a, sfp->len,
+					    &engine->insn[a]);
+
+		if (rc) {
+			ldab_bpf_engine_destroy(engine);
+			return rc;
+		}
+	}
+
+	engine->len = sfp->len;
+
+	return 0;
+}
+
+/**
+ * \brief Release a BPF engine
+ * \param[in,out] engine	BPF engine to destroy
+ */
+
+void ldab_bpf_engine_destroy(struct bpf_engine *engine)
+{
+	assert(engine);
+
+	free(engine->insn);
+	memset(engine, 0, sizeof(*engine));
+}
+
+/* Taking the address of labels is a GNU extension */
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+
+/**
+ * \brief Run a BPF engine on a packet
+ * \param[in] engine	BPF engine to run
+ * \param[in] pkt	Pointer to the packet
+ * \param[in] wirelen	Length of the packet on the wire
+ * \param[in] buflen	Amount of packet bytes available at \c pkt
+ * \return the amount of bytes the filter accepts, 0 if the packet is rejected
+ * \note The results are the same as \c ldab_sock_filter_run()
+ */
+
+uint32_t ldab_bpf_engine_run(const struct bpf_engine *const engine,
+			     const uint8_t * const pkt, const size_t wirelen,
+			     const size_t buflen)
+{
+	static const void *const label[BPF_ENGINE_OP_NR] = {
+		[BPF_ENGINE_RET_K] = &&ret_k,
+		[BPF_ENGINE_RET_A] = &&ret_a,
+		[BPF_ENGINE_LD_W_ABS] = &&ld_w_abs,
+		[BPF_ENGINE_LD_H_ABS] = &&ld_h_abs,
+		[BPF_ENGINE_LD_B_ABS] = &&ld_b_abs,
+		[BPF_ENGINE_LD_W_IND] = &&ld_w_ind,
+		[BPF_ENGINE_LD_H_IND] = &&ld_h_ind,
+		[BPF_ENGINE_LD_B_IND] = &&ld_b_ind,
+		[BPF_ENGINE_LD_W_LEN] = &&ld_w_len,
+		[BPF_ENGINE_LDX_W_LEN] = &&ldx_w_len,
+		[BPF_ENGINE_LDX_MSH] = &&ldx_msh,
+		[BPF_ENGINE_LD_IMM] = &&ld_imm,
+		[BPF_ENGINE_LDX_IMM] = &&ldx_imm,
+		[BPF_ENGINE_LD_MEM] = &&ld_mem,
+		[BPF_ENGINE_LDX_MEM] = &&ldx_mem,
+		[BPF_ENGINE_ST] = &&st,
+		[BPF_ENGINE_STX] = &&stx,
+		[BPF_ENGINE_JA] = &&ja,
+		[BPF_ENGINE_JGT_K] = &&jgt_k,
+		[BPF_ENGINE_JGE_K] = &&jge_k,
+		[BPF_ENGINE_JEQ_K] = &&jeq_k,
+		[BPF_ENGINE_JSET_K] = &&jset_k,
+		[BPF_ENGINE_JGT_X] = &&jgt_x,
+		[BPF_ENGINE_JGE_X] = &&jge_x,
+		[BPF_ENGINE_JEQ_X] = &&jeq_x,
+		[BPF_ENGINE_JSET_X] = &&jset_x,
+		[BPF_ENGINE_ADD_X] = &&add_x,
+		[BPF_ENGINE_SUB_X] = &&sub_x,
+		[BPF_ENGINE_MUL_X] = &&mul_x,
+		[BPF_ENGINE_DIV_X] = &&div_x,
+		[BPF_ENGINE_AND_X] = &&and_x,
+		[BPF_ENGINE_OR_X] = &&or_x,
+		[BPF_ENGINE_LSH_X] = &&lsh_x,
+		[BPF_ENGINE_RSH_X] = &&rsh_x,
+		[BPF_ENGINE_ADD_K] = &&add_k,
+		[BPF_ENGINE_SUB_K] = &&sub_k,
+		[BPF_ENGINE_MUL_K] = &&mul_k,
+		[BPF_ENGINE_DIV_K] = &&div_k,
+		[BPF_ENGINE_AND_K] = &&and_k,
+		[BPF_ENGINE_OR_K] = &&or_k,
+		[BPF_ENGINE_LSH_K] = &&lsh_k,
+		[BPF_ENGINE_RSH_K] = &&rsh_k,
+		[BPF_ENGINE_NEG] = &&neg,
+		[BPF_ENGINE_TAX] = &&tax,
+		[BPF_ENGINE_TXA] = &&txa
+	};
+
+	const struct bpf_engine_insn *const insn = engine->insn;
+	const struct bpf_engine_insn *pc = insn;
+	uint32_t A = 0, X = 0, k;
+	uint32_t mem[BPF_MEMWORDS] = { 0 };
+
+#define DISPATCH()	goto *label[pc->op]
+#define NEXT()		do { pc++; DISPATCH(); } while (0)
+#define JUMP(cond)	do { pc = &insn[(cond) ? pc->jt : pc->jf]; DISPATCH(); } while (0)
+
+	assert(engine);
+	assert(engine->len);
+	assert(pkt);
+
+	DISPATCH();
+
+ ret_k:
+	return pc->k;
+ ret_a:
+	return A;
+ ld_w_abs:
+	if (pc->jt > buflen)
+		return 0;
+	k = pc->k;
+	A = (uint32_t) pkt[k] << 24 | (uint32_t) pkt[k + 1] << 16 |
+	    (uint32_t) pkt[k + 2] << 8 | (uint32_t) pkt[k + 3];
+	NEXT();
+ ld_h_abs:
+	if (pc->jt > buflen)
+		return 0;
+	k = pc->k;
+	A = (uint32_t) pkt[k] << 8 | pkt[k + 1];
+	NEXT();
+ ld_b_abs:
+	if (pc->jt > buflen)
+		return 0;
+	A = pkt[pc->k];
+	NEXT();
+ ld_w_ind:
+	k = X + pc->k;
+	if (pc->k > buflen || X > buflen - pc->k
+	    || sizeof(uint32_t) > buflen - k)
+		return 0;
+	A = (uint32_t) pkt[k] << 24 | (uint32_t) pkt[k + 1] << 16 |
+	    (uint32_t) pkt[k + 2] << 8 | (uint32_t) pkt[k + 3];
+	NEXT();
+ ld_h_ind:
+	k = X + pc->k;
+	if (pc->k > buflen || X > buflen - pc->k
+	    || sizeof(uint16_t) > buflen - k)
+		return 0;
+	A = (uint32_t) pkt[k] << 8 | pkt[k + 1];
+	NEXT();
+ ld_b_ind:
+	k = X + pc->k;
+	if (pc->k >= buflen || X >= buflen - pc->k)
+		return 0;
+	A = pkt[k];
+	NEXT();
+ ld_w_len:
+	A = wirelen;
+	NEXT();
+ ldx_w_len:
+	X = wirelen;
+	NEXT();
+ ldx_msh:
+	if (pc->jt > buflen)
+		return 0;
+	X = (pkt[pc->k] & 0xf) << 2;
+	NEXT();
+ ld_imm:
+	A = pc->k;
+	NEXT();
+ ldx_imm:
+	X = pc->k;
+	NEXT();
+ ld_mem:
+	A = mem[pc->k];
+	NEXT();
+ ldx_mem:
+	X = mem[pc->k];
+	NEXT();
+ st:
+	mem[pc->k] = A;
+	NEXT();
+ stx:
+	mem[pc->k] = X;
+	NEXT();
+ ja:
+	pc = &insn[pc->jt];
+	DISPATCH();
+ jgt_k:
+	JUMP(A > pc->k);
+ jge_k:
+	JUMP(A >= pc->k);
+ jeq_k:
+	JUMP(A == pc->k);
+ jset_k:
+	JUMP(A & pc->k);
+ jgt_x:
+	JUMP(A > X);
+ jge_x:
+	JUMP(A >= X);
+ jeq_x:
+	JUMP(A == X);
+ jset_x:
+	JUMP(A & X);
+ add_x:
+	A += X;
+	NEXT();
+ sub_x:
+	A -= X;
+	NEXT();
+ mul_x:
+	A *= X;
+	NEXT();
+ div_x:
+	if (X == 0)
+		return 0;
+	A /= X;
+	NEXT();
+ and_x:
+	A &= X;
+	NEXT();
+ or_x:
+	A |= X;
+	NEXT();
+ lsh_x:
+	A = X < 32 ? A << X : 0;
+	NEXT();
+ rsh_x:
+	A = X < 32 ? A >> X : 0;
+	NEXT();
+ add_k:
+	A += pc->k;
+	NEXT();
+ sub_k:
+	A -= pc->k;
+	NEXT();
+ mul_k:
+	A *= pc->k;
+	NEXT();
+ div_k:
+	A /= pc->k;
+	NEXT();
+ and_k:
+	A &= pc->k;
+	NEXT();
+ or_k:
+	A |= pc->k;
+	NEXT();
+ lsh_k:
+	A <<= pc->k;
+	NEXT();
+ rsh_k:
+	A >>= pc->k;
+	NEXT();
+ neg:
+	A = -A;
+	NEXT();
+ tax:
+	X = A;
+	NEXT();
+ txa:
+	A = X;
+	NEXT();
+
+#undef JUMP
+#undef NEXT
+#undef DISPATCH
+}
+
+#pragma GCC diagnostic pop
+
+/**
+ * \brief Run a BPF engine on an array of packets
+ * \param[in] engine	BPF engine to run
+ * \param[in] pkt	Array of packets to filter
+ * \param[in] pkt_nr	Amount of packets in the array
+ * \param[out] res	Per-packet filter result, may be \c NULL
+ * \return the amount of accepted packets
+ *
+ * The data of the next packet is prefetched while the current one is filtered.
+ */
+
+size_t ldab_bpf_engine_run_batch(const struct bpf_engine *const engine,
+				 const struct bpf_engine_pkt *const pkt,
+				 const size_t pkt_nr, uint32_t * const res)
+{
+	size_t a, accepted = 0;
+	uint32_t rc;
+
+	assert(engine);
+	assert(pkt || !pkt_nr);
+
+	for (a = 0; a < pkt_nr; a++) {
+		if (a + 1 < pkt_nr)
+			__builtin_prefetch(pkt[a + 1].data);
+
+		rc = ldab_bpf_engine_run(engine, pkt[a].data, pkt[a].wirelen,
+					 pkt[a].buflen);
+
+		if (res)
+			res[a] = rc;
+
+		accepted += rc != 0;
+	}
+
+	return accepted;
+}
@@ -0,0 +1,151 @@
+/**
+ * \file histogram.c
+ * \author written by Emmanuel Roullit emmanuel.roullit@gmail.com (c) 2013
+ * \date 2013
+ */
+
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <libdabba/histogram.h>
+
+/**
+ * \internal
+ * \brief Get the bucket of a value
+ * \param[in] value	value to look for
+ * \return index of the bucket holding \c value
+ */
+
+static size_t histogram_index(const uint32_t value)
+{
+	const uint32_t sub_nr = 1 << HISTOGRAM_SUB_BITS;
+	unsigned int msb, shift;
+
+	if (value < sub_nr)
+		return value;
+
+	msb = 31 - __builtin_clz(value);
+	shift = msb - HISTOGRAM_SUB_BITS;
+
+	return ((shift + 1) << HISTOGRAM_SUB_BITS) + ((value >> shift)
+						      & (sub_nr - 1));
+}
+
+/**
+ * \internal
+ * \brief Get the largest value of a bucket
+ * \param[in] index	index of the bucket
+ * \return the largest value held by the bucket
+ */
+
+static uint64_t histogram_bucket_max(const size_t index)
+{
+	const uint32_t sub_nr = 1 << HISTOGRAM_SUB_BITS;
+	unsigned int shift;
+
+	if (index < sub_nr)
+		return index;
+
+	shift = (index >> HISTOGRAM_SUB_BITS) - 1;
+
+	return ((uint64_t) (sub_nr + (index & (sub_nr - 1)) + 1) << shift) - 1;
+}
+
+/**
+ * \brief Record a value
+ * \param[in,out] hist	histogram to update
+ * \param[in] value	value to record, values over \c UINT32_MAX are
+ *			recorded as \c UINT32_MAX
+ * \note Only one thread may record values in a histogram.
+ */
+
+void ldab_histogram_record(struct histogram *hist, uint64_t value)
+{
+	uint64_t *bucket;
+
+	assert(hist);
+
+	if (value > UINT32_MAX)
+		value = UINT32_MAX;
+
+	bucket = &hist->bucket[histogram_index(value)];
+	__atomic_store_n(bucket, *bucket + 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * \brief Copy the buckets of a histogram being recorded
+ * \param[in] hist		histogram to copy
+ * \param[out] snapshot	copy of the histogram
+ * \note The values recorded during the copy may be partially taken.
+ */
+
+void ldab_histogram_get(const struct histogram *hist,
+			struct histogram *snapshot)
+{
+	size_t a;
+
+	assert(hist);
+	assert(snapshot);
+
+	for (a = 0; a < HISTOGRAM_BUCKET_NR; a++)
+		snapshot->bucket[a] =
+		    __atomic_load_n(&hist->bucket[a], __ATOMIC_RELAXED);
+}
+
+/**
+ * \brief Get the amount of recorded values
+ * \param[in] hist	histogram to count
+ * \return the amount of values recorded in \c hist
+ */
+
+uint64_t ldab_histogram_count(const struct histogram *hist)
+{
+	uint64_t count = 0;
+	size_t a;
+
+	assert(hist);
+
+	for (a = 0; a < HISTOGRAM_BUCKET_NR; a++)
+		count += hist->bucket[a];
+
+	return count;
+}
+
+/**
+ * \brief Get a percentile of the recorded values
+ * \param[in] hist		histogram to read
+ * \param[in] percentile	percentile between 0 and 100
+ * \return the largest value of the bucket reaching \c percentile, 0 if no
+ * value was recorded
+ * \note Read a snapshot taken by ldab_histogram_get() when values are
+ * recorded concurrently.
+ */
+
+uint64_t ldab_histogram_percentile(const struct histogram *hist,
+				   const double percentile)
+{
+	const uint64_t count = ldab_histogram_count(hist);
+	uint64_t rank, seen = 0;
+	size_t a;
+
+	assert(percentile >= 0 && percentile <= 100);
+
+	if (!count)
+		return 0;
+
+	rank = (uint64_t) (count * percentile / 100 + 0.5);
+
+	if (!rank)
+		rank = 1;
+
+	for (a = 0; a < HISTOGRAM_BUCKET_NR; a++) {
+		seen += hist->bucket[a];
+
+		if (seen >= rank)
+			break;
+	}
+
+	return histogram_bucket_max(a);
+}
@@ -0,0 +1,66 @@
+/**
+ * \file bpf-engine.h
+ * \author written by Emmanuel Roullit emmanuel.roullit@gmail.com (c) 2013
+ * \date 2013
+ */
+
+
+#ifndef BPF_ENGINE_H
+#define	BPF_ENGINE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <linux/filter.h>
+
+/**
+ * \brief Pre-decoded classic BPF instruction
+ */
+
+struct bpf_engine_insn {
+	uint32_t op; /**< Decoded operation index */
+	uint32_t k; /**< Generic multiuse field */
+	uint32_t jt; /**< Jump target if true, or load end offset */
+	uint32_t jf; /**< Jump target if false */
+};
+
+/**
+ * \brief Classic BPF program ready to be run in userspace
+ */
+
+struct bpf_engine {
+	struct bpf_engine_insn *insn; /**< Pre-decoded instructions */
+	size_t len; /**< Amount of pre-decoded instructions */
+};
+
+/**
+ * \brief Packet description used by the batch API
+ */
+
+struct bpf_engine_pkt {
+	const uint8_t *data; /**< Pointer to the packet data */
+	size_t wirelen; /**< Length of the packet on the wire */
+	size_t buflen; /**< Amount of packet bytes available at \c data */
+};
+
+int ldab_bpf_engine_create(struct bpf_engine *engine,
+			   const struct sock_fprog *const sfp);
+void ldab_bpf_engine_destroy(struct bpf_engine *engine);
+uint32_t ldab_bpf_engine_run(const struct bpf_engine *const engine,
+			     const uint8_t * const pkt, const size_t wirelen,
+			     const size_t buflen);
+size_t ldab_bpf_engine_run_batch(const struct bpf_engine *const engine,
+				 const struct bpf_engine_pkt *const pkt,
+				 const size_t pkt_nr, uint32_t * const res);
+
+/**
+ * \brief Tell if a BPF engine holds a program
+ * \param[in] engine	BPF engine to check
+ * \return 1 if a program is loaded, 0 otherwise
+ */
+
+static inline int bpf_engine_is_loaded(const struct bpf_engine *const engine)
+{
+	return engine->len != 0;
+}
+
+#endif				/* BPF_ENGINE_H */
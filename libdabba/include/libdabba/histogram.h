@@ -0,0 +1,49 @@
+/**
+ * \file histogram.h
+ * \author written by Emmanuel Roullit emmanuel.roullit@gmail.com (c) 2013
+ * \date 2013
+ */
+
+
+#ifndef HISTOGRAM_H
+#define	HISTOGRAM_H
+
+#include <stdint.h>
+
+/**
+ * \brief Amount of linear buckets per power of two, as a power of two
+ *
+ * Each power of two range is split in 8 buckets: a recorded value is known
+ * within 12.5%.
+ */
+
+#define HISTOGRAM_SUB_BITS 3
+
+/**
+ * \brief Amount of histogram buckets
+ *
+ * Values below \c 2^HISTOGRAM_SUB_BITS get a bucket each, every following
+ * power of two up to \c 2^32 is split in \c 2^HISTOGRAM_SUB_BITS buckets.
+ */
+
+#define HISTOGRAM_BUCKET_NR ((32 - HISTOGRAM_SUB_BITS + 1) << HISTOGRAM_SUB_BITS)
+
+/**
+ * \brief Log-linear histogram of 32 bits values
+ *
+ * A single thread records values with ldab_histogram_record(). Other threads
+ * read the buckets with ldab_histogram_get() without blocking it.
+ */
+
+struct histogram {
+	uint64_t bucket[HISTOGRAM_BUCKET_NR]; /**< amount of values per bucket */
+};
+
+void ldab_histogram_record(struct histogram *hist, uint64_t value);
+void ldab_histogram_get(const struct histogram *hist,
+			struct histogram *snapshot);
+uint64_t ldab_histogram_count(const struct histogram *hist);
+uint64_t ldab_histogram_percentile(const struct histogram *hist,
+				   const double percentile);
+
+#endif				/* HISTOGRAM_H */
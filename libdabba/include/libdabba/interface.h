@@ -9,6 +9,8 @@
 #define	NIC_H
 
 #include <stdint.h>
+#include <stddef.h>
+#include <linux/ethtool.h>
 
 /**
  * \brief Pseudo-interface name to indicate that all interfaces must be used
@@ -18,10 +20,21 @@
 #define ANY_INTERFACE "any"
 #endif				/* ANY_INTERFACE */
 
-struct ethtool_drvinfo;
-struct ethtool_cmd;
-struct ethtool_pauseparam;
-struct ethtool_coalesce;
+/**
+ * \brief Offload status of an interface
+ */
+
+struct dev_offload {
+	int rx_csum;		/**< receive checksum offload */
+	int tx_csum;		/**< transmit checksum offload */
+	int sg;			/**< scatter gather */
+	int tso;		/**< TCP segmentation offload */
+	int ufo;		/**< UDP fragmentation offload */
+	int gso;		/**< generic segmentation offload */
+	int gro;		/**< generic receive offload */
+	int lro;		/**< large receive offload */
+	int rxhash;		/**< receive hashing offload */
+};
 
 int ldab_devname_to_ifindex(const char *const dev, int *index);
 int ldab_ifindex_to_devname(const int index, char *dev, size_t dev_len);
@@ -56,6 +69,8 @@ int ldab_dev_large_rcv_offload_set(const char *const dev, int lro);
 int ldab_dev_rx_hash_offload_get(const char *const dev, int *rxhash);
 int ldab_dev_rx_hash_offload_set(const char *const dev, int rxhash);
 
+int ldab_dev_offload_get(const char *const dev, struct dev_offload *offload);
+
 int ldab_dev_link_get(const char *const dev, int *link);
 
 #endif				/* NIC_H */
@@ -0,0 +1,29 @@
+/**
+ * \file irq.h
+ * \author written by Emmanuel Roullit emmanuel.roullit@gmail.com (c) 2013
+ * \date 2013
+ */
+
+
+#ifndef IRQ_H
+#define	IRQ_H
+
+#include <sched.h>
+#include <libdabba/numa.h>
+
+/**
+ * \brief Default procfs mount point
+ */
+
+#ifndef PROC_ROOT
+#define PROC_ROOT "/proc"
+#endif				/* PROC_ROOT */
+
+int ldab_cpu_mask_parse(const char *const str, cpu_set_t * set);
+int ldab_dev_rx_cpus_get(const char *const proc_root,
+			 const char *const sysfs_root, const char *const dev,
+			 cpu_set_t * cpus);
+int ldab_cpu_siblings_get(const char *const sysfs_root, const cpu_set_t * cpus,
+			  cpu_set_t * siblings);
+
+#endif				/* IRQ_H */
@@ -0,0 +1,37 @@
+/**
+ * \file numa.h
+ * \author written by Emmanuel Roullit emmanuel.roullit@gmail.com (c) 2013
+ * \date 2013
+ */
+
+
+#ifndef NUMA_H
+#define	NUMA_H
+
+#include <stddef.h>
+#include <sched.h>
+
+/**
+ * \brief Default sysfs mount point
+ */
+
+#ifndef SYSFS_ROOT
+#define SYSFS_ROOT "/sys"
+#endif				/* SYSFS_ROOT */
+
+/**
+ * \brief NUMA node value meaning that no node is used
+ */
+
+#define NUMA_NODE_NONE -1
+
+int ldab_sysfs_attr_read(const char *const path, char *buf, const size_t len);
+int ldab_cpu_list_parse(const char *const str, cpu_set_t * set);
+int ldab_numa_node_count_get(const char *const sysfs_root, int *count);
+int ldab_numa_dev_node_get(const char *const sysfs_root, const char *const dev,
+			   int *node);
+int ldab_numa_node_cpus_get(const char *const sysfs_root, const int node,
+			    cpu_set_t * cpus);
+int ldab_numa_mempolicy_set(const int node);
+
+#endif				/* NUMA_H */
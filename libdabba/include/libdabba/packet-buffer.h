@@ -0,0 +1,56 @@
+/**
+ * \file packet-buffer.h
+ * \author written by Emmanuel Roullit emmanuel.roullit@gmail.com (c) 2013
+ * \date 2013
+ */
+
+
+#ifndef PACKET_BUFFER_H
+#define	PACKET_BUFFER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * \brief In-memory circular packet buffer
+ *
+ * The buffer holds the most recent packets as a sequence of PCAP records
+ * (\c struct \c pcap_sf_pkthdr followed by the packet payload).
+ * \c head and \c tail are byte offsets which only grow, the actual position in
+ * the buffer is the offset modulo the buffer size.
+ * Only one thread is allowed to push packets, any number of threads can
+ * take a snapshot of the buffer at the same time without blocking the writer.
+ */
+
+struct packet_buffer {
+	uint8_t *data; /**< Preallocated buffer memory */
+	uint64_t size; /**< Buffer size in bytes */
+	uint64_t duration; /**< Maximum packet age in seconds, 0 if unlimited */
+	uint64_t head; /**< Offset where the next record will be written */
+	uint64_t tail; /**< Offset of the oldest valid record */
+	uint64_t dropped; /**< Packets too large to fit in the buffer */
+};
+
+int ldab_packet_buffer_create(struct packet_buffer *pkt_buf,
+			      const uint64_t size, const uint64_t duration);
+void ldab_packet_buffer_destroy(struct packet_buffer *pkt_buf);
+int ldab_packet_buffer_push(struct packet_buffer *pkt_buf,
+			    const uint8_t * const pkt, const size_t pkt_len,
+			    const size_t pkt_snaplen, const uint64_t tv_sec,
+			    const uint64_t tv_usec);
+int ldab_packet_buffer_dump(struct packet_buffer *pkt_buf, const int fd);
+int ldab_packet_buffer_flush(struct packet_buffer *pkt_buf, const int fd);
+
+/**
+ * \brief Tell if a packet buffer is allocated
+ * \param[in] pkt_buf	Packet buffer to check
+ * \return 1 if the buffer is in use, 0 otherwise
+ */
+
+static inline int packet_buffer_is_enabled(const struct packet_buffer *const
+					   pkt_buf)
+{
+	return pkt_buf->data != NULL;
+}
+
+#endif				/* PACKET_BUFFER_H */
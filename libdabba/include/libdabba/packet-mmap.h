@@ -9,8 +9,22 @@
 #define	PACKET_MMAP_H
 
 #include <stdint.h>
+#include <stddef.h>
+#include <unistd.h>
 #include <linux/if_packet.h>
 
+/**
+ * \brief Highest page order used for a block when frames fit in smaller blocks
+ */
+
+#define PACKET_MMAP_PREFERRED_ORDER 3
+
+/**
+ * \brief Highest page order the kernel can allocate for a block
+ */
+
+#define PACKET_MMAP_MAX_ORDER 10
+
 /**
  * \brief Supported packet mmap types
  */
@@ -21,7 +35,7 @@ enum packet_mmap_type {
 };
 
 /**
- * \brief Supported packet mmap frame sizes
+ * \brief Common packet mmap frame sizes
  */
 
 enum packet_mmap_frame_size {
@@ -53,12 +67,32 @@ struct packet_mmap_header {
 	struct sockaddr_ll s_ll __attribute__ ((aligned(TPACKET_ALIGNMENT))); /**< Pocket metadata structure */
 };
 
+int ldab_packet_mmap_layout_get(struct tpacket_req *layout,
+				const size_t frame_size, const size_t frame_nr);
+int ldab_packet_mmap_budget_layout_get(struct tpacket_req *layout,
+				       const size_t frame_size,
+				       const size_t budget);
 int ldab_packet_mmap_create(struct packet_mmap *pkt_mmap,
 			   const char *const dev, const int pf_sock,
 			   const enum packet_mmap_type type,
-			   const enum packet_mmap_frame_size frame_size,
-			   const size_t frame_nr);
-
+			   const size_t frame_size, const size_t frame_nr);
+int ldab_packet_mmap_budget_create(struct packet_mmap *pkt_mmap,
+				  const char *const dev, const int pf_sock,
+				  const enum packet_mmap_type type,
+				  const size_t frame_size, const size_t budget);
+int ldab_packet_mmap_layout_create(struct packet_mmap *pkt_mmap,
+				   const char *const dev, const int pf_sock,
+				   const enum packet_mmap_type type,
+				   const struct tpacket_req *const layout);
+int ldab_packet_mmap_prepare(struct packet_mmap *pkt_mmap, const int pf_sock,
+			     const enum packet_mmap_type type,
+			     const struct tpacket_req *const layout);
+int ldab_packet_mmap_attach(struct packet_mmap *pkt_mmap,
+			    const char *const dev);
+int ldab_packet_mmap_index_attach(struct packet_mmap *pkt_mmap,
+				  const int ifindex);
+
+void ldab_packet_mmap_unmap(struct packet_mmap *pkt_mmap);
 void ldab_packet_mmap_destroy(struct packet_mmap *pkt_mmap);
 
 /**
@@ -66,21 +100,29 @@ void ldab_packet_mmap_destroy(struct packet_mmap *pkt_mmap);
  * \param[in] frame_size	Frame size to check in bytes
  * \return 1 if valid, 0 if invalid
  *
- * The frame size must match one the of supported frame size to be considered
- * valid.
+ * The frame size must be able to hold the frame headers, be a multiple of
+ * \c TPACKET_ALIGNMENT and fit in the largest block the kernel can allocate.
  */
 
 static inline int packet_mmap_frame_size_is_valid(const uint64_t frame_size)
 {
-	switch (frame_size) {
-	case PACKET_MMAP_ETH_FRAME_LEN:
-	case PACKET_MMAP_JUMBO_FRAME_LEN:
-	case PACKET_MMAP_SUPER_JUMBO_FRAME_LEN:
-		return 1;
-		break;
-	default:
-		return 0;
-	}
+	const uint64_t page_size = sysconf(_SC_PAGESIZE);
+
+	return frame_size >= TPACKET_HDRLEN
+	    && frame_size % TPACKET_ALIGNMENT == 0
+	    && frame_size <= page_size << PACKET_MMAP_MAX_ORDER;
+}
+
+/**
+ * \brief Get the amount of memory a packet mmap layout maps
+ * \param[in] layout	Packet mmap layout
+ * \return the packet mmap size in bytes
+ */
+
+static inline uint64_t packet_mmap_layout_size(const struct tpacket_req *const
+					       layout)
+{
+	return (uint64_t) layout->tp_block_size * layout->tp_block_nr;
 }
 
 #endif				/* PACKET_MMAP_H */
@@ -10,6 +10,80 @@
 
 #include <linux/filter.h>
 #include <libdabba/packet-mmap.h>
+#include <libdabba/packet-buffer.h>
+#include <libdabba/packet-stop.h>
+#include <libdabba/bpf-engine.h>
+#include <libdabba/histogram.h>
+
+/**
+ * \brief Packet capture trigger
+ *
+ * When a trigger socket filter is set, packets are only kept in the in-memory
+ * packet buffer until one of them matches the trigger. The buffer is then
+ * written to the PCAP file and the following packets are written directly
+ * until \c window seconds elapsed without another match.
+ */
+
+struct packet_trigger {
+	struct sock_fprog sfp; /**< trigger socket filter, empty if unused */
+	struct bpf_engine engine; /**< decoded trigger socket filter */
+	uint64_t window; /**< seconds to keep writing after a match */
+	uint64_t deadline; /**< time in seconds when writing stops */
+	uint64_t count; /**< amount of packets which matched the trigger */
+};
+
+/**
+ * \brief Packet capture ring resize states
+ */
+
+enum packet_rx_resize_state {
+	PACKET_RX_RESIZE_IDLE, /**< no ring switch in progress */
+	PACKET_RX_RESIZE_PENDING, /**< the capture must switch to the next ring */
+	PACKET_RX_RESIZE_DONE /**< the switch is over */
+};
+
+/**
+ * \brief Packet capture ring resize
+ *
+ * A running capture switches to a new packet mmap ring in three steps:
+ *      - the controlling thread publishes a prepared but unbound ring in
+ *        \c next and sets \c state to \c PACKET_RX_RESIZE_PENDING
+ *      - the capture thread binds \c next to its interface, drains its
+ *        current ring, unmaps it and starts reading \c next. It moves the
+ *        unmapped ring to \c prev, leaves the switch outcome in \c rc,
+ *        sets \c state to \c PACKET_RX_RESIZE_DONE and signals \c fd
+ *      - the controlling thread closes the socket of \c prev and sets
+ *        \c state back to \c PACKET_RX_RESIZE_IDLE
+ *
+ * If \c next cannot take over, the capture thread unmaps it instead and
+ * keeps reading its current ring.
+ * Releasing a packet socket waits for the packets in flight, the capture
+ * thread leaves it to the controlling thread so that it keeps reading.
+ */
+
+struct packet_rx_resize {
+	struct packet_mmap next; /**< ring to switch to */
+	struct packet_mmap prev; /**< ring unmapped by the last switch, only its socket and layout are left */
+	int rc; /**< outcome of the last switch */
+	int fd; /**< eventfd signaled once a switch is over, unused if not positive */
+	uint32_t state; /**< current \c packet_rx_resize_state */
+	uint32_t high_water; /**< highest amount of frames seen ready at once */
+};
+
+/**
+ * \brief Packet capture counters
+ *
+ * The capture thread updates the counters under the \c seq sequence counter
+ * of \c struct \c packet_rx, which is odd during an update. Readers take a
+ * consistent snapshot with ldab_packet_rx_counters_get() without blocking
+ * the capture.
+ */
+
+struct packet_rx_counters {
+	uint64_t packets; /**< frames read from the ring */
+	uint64_t bytes; /**< wire length of these frames */
+	uint64_t kept; /**< frames kept after sampling */
+};
 
 /**
  * \brief Packet capture structure
@@ -19,8 +93,26 @@ struct packet_rx {
 	struct packet_mmap pkt_mmap; /**< capture packet mmap structure */
 	struct sock_fprog sfp; /**< socket program for the capture packet mmap */
 	int pcap_fd; /**< pcap file descriptor */
+	struct packet_buffer buffer; /**< in-memory packet buffer */
+	struct packet_trigger trigger; /**< capture trigger */
+	uint32_t snaplen; /**< maximum captured packet length, 0 if unlimited */
+	uint32_t sampling; /**< only keep one packet out of \c sampling */
+	uint32_t sampling_count; /**< packets received since the last kept one */
+	struct packet_rx_resize resize; /**< packet mmap ring resize */
+	struct packet_stop stop; /**< capture stop request */
+	struct tpacket_stats stats; /**< socket statistics of the rings left */
+	uint32_t seq; /**< sequence counter of \c counters */
+	struct packet_rx_counters counters; /**< capture counters */
+	struct histogram residency; /**< time in microseconds sampled frames
+				      waited in the ring */
 };
 
+int ldab_packet_rx_resize_start(struct packet_rx *pkt_rx,
+				const struct packet_mmap *next);
+int ldab_packet_rx_resize_finish(struct packet_rx *pkt_rx,
+				 struct packet_mmap *prev);
+void ldab_packet_rx_counters_get(struct packet_rx *pkt_rx,
+				 struct packet_rx_counters *counters);
 void *ldab_packet_rx(void *arg);
 
 #endif				/* PACKET_RX_H */
@@ -0,0 +1,42 @@
+/**
+ * \file packet-stop.h
+ * \author written by Emmanuel Roullit emmanuel.roullit@gmail.com (c) 2013
+ * \date 2013
+ */
+
+
+#ifndef PACKET_STOP_H
+#define	PACKET_STOP_H
+
+#include <stdint.h>
+
+/**
+ * \brief Packet thread stop request
+ *
+ * The controlling thread raises \c requested and signals \c fd. The packet
+ * thread checks \c requested between batches of frames and polls \c fd
+ * together with its packet socket, so a stop request also ends a wait for
+ * packets.
+ */
+
+struct packet_stop {
+	int fd; /**< eventfd signaled on stop request */
+	uint32_t requested; /**< non-zero once the thread must stop */
+};
+
+int ldab_packet_stop_init(struct packet_stop *stop);
+void ldab_packet_stop_destroy(struct packet_stop *stop);
+int ldab_packet_stop_request(struct packet_stop *stop);
+
+/**
+ * \brief Tell if a packet thread must stop
+ * \param[in] stop	Stop request to check
+ * \return 1 if a stop was requested, 0 otherwise
+ */
+
+static inline int packet_stop_is_requested(struct packet_stop *const stop)
+{
+	return __atomic_load_n(&stop->requested, __ATOMIC_ACQUIRE) != 0;
+}
+
+#endif				/* PACKET_STOP_H */
@@ -9,6 +9,7 @@
 #define	PACKET_TX_H
 
 #include <libdabba/packet-mmap.h>
+#include <libdabba/packet-stop.h>
 
 /**
  * \brief Packet replay structure
@@ -17,6 +18,7 @@
 struct packet_tx {
 	struct packet_mmap pkt_mmap; /**< transmit packet mmap structure */
 	int pcap_fd; /**< pcap file descriptor */
+	struct packet_stop stop; /**< replay stop request */
 };
 
 int ldab_packet_tx_loss_set(const int sock, const int discard);
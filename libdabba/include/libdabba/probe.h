@@ -0,0 +1,36 @@
+/**
+ * \file probe.h
+ * \author written by Emmanuel Roullit emmanuel.roullit@gmail.com (c) 2013
+ * \date 2013
+ */
+
+
+#ifndef PROBE_H
+#define	PROBE_H
+
+/**
+ * \brief Static tracepoints of the libdabba packet loops
+ *
+ * When built with \c HAVE_SYS_SDT_H, the probes are USDT probes of the
+ * \c libdabba provider which \c perf and \c bpftrace can attach to, e.g.
+ * \c usdt:libdabba.so:libdabba:rx_batch. A probe nobody attached to is a
+ * single \c nop instruction. Without \c sys/sdt.h, the probes are compiled
+ * out.
+ */
+
+#ifdef HAVE_SYS_SDT_H
+#include <sys/sdt.h>
+
+#define LDAB_PROBE1(name, a) DTRACE_PROBE1(libdabba, name, a)
+#define LDAB_PROBE2(name, a, b) DTRACE_PROBE2(libdabba, name, a, b)
+#define LDAB_PROBE3(name, a, b, c) DTRACE_PROBE3(libdabba, name, a, b, c)
+#else
+/* The arguments are type checked but not evaluated */
+#define LDAB_PROBE1(name, a) do { (void)sizeof(a); } while (0)
+#define LDAB_PROBE2(name, a, b) \
+	do { (void)sizeof(a); (void)sizeof(b); } while (0)
+#define LDAB_PROBE3(name, a, b, c) \
+	do { (void)sizeof(a); (void)sizeof(b); (void)sizeof(c); } while (0)
+#endif				/* HAVE_SYS_SDT_H */
+
+#endif				/* PROBE_H */
@@ -8,10 +8,17 @@
 #ifndef SOCK_FILTER_H
 #define	SOCK_FILTER_H
 
+#include <stdint.h>
+#include <stddef.h>
 #include <linux/filter.h>
 
 int ldab_sock_filter_attach(const int sock, const struct sock_fprog *const sfp);
 int ldab_sock_filter_detach(const int sock);
+int ldab_sock_filter_is_locked(const int sock);
 int ldab_sock_filter_is_valid(const struct sock_fprog *const bpf);
+uint32_t ldab_sock_filter_run(const struct sock_fprog *const sfp,
+			      const uint8_t * const pkt, const size_t wirelen,
+			      const size_t buflen);
+int ldab_sock_filter_optimize(struct sock_fprog *const sfp);
 
 #endif				/* SOCK_FILTER_H */
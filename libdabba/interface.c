@@ -7,8 +7,12 @@
 
 #include <assert.h>
 #include <errno.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <string.h>
 #include <unistd.h>
+#include <pthread.h>
 
 #include <sys/socket.h>
 #include <sys/ioctl.h>
@@ -19,32 +23,140 @@
 #include <linux/ethtool.h>
 #include <linux/sockios.h>
 
+#include <libdabba/macros.h>
 #include <libdabba/interface.h>
 
+/**
+ * \internal
+ * \brief Control socket of the calling thread, -1 until it is opened
+ */
+
+static __thread int dev_ctl_sock = -1;
+
+/**
+ * \internal
+ * \brief Key closing the control socket of a thread when it exits
+ */
+
+static pthread_key_t dev_ctl_sock_key;
+static pthread_once_t dev_ctl_sock_once = PTHREAD_ONCE_INIT;
+
+/**
+ * \internal
+ * \brief Offload status bits and the kernel features they are made of
+ */
+
+static const struct dev_feature {
+	const char *name;	/**< kernel feature name */
+	size_t offset;		/**< offset of the status in \c struct dev_offload */
+} dev_features[] = {
+	{"rx-checksum", offsetof(struct dev_offload, rx_csum)},
+	{"tx-checksum-ipv4", offsetof(struct dev_offload, tx_csum)},
+	{"tx-checksum-ip-generic", offsetof(struct dev_offload, tx_csum)},
+	{"tx-checksum-ipv6", offsetof(struct dev_offload, tx_csum)},
+	{"tx-scatter-gather", offsetof(struct dev_offload, sg)},
+	{"tx-tcp-segmentation", offsetof(struct dev_offload, tso)},
+	{"tx-tcp-ecn-segmentation", offsetof(struct dev_offload, tso)},
+	{"tx-tcp-mangleid-segmentation", offsetof(struct dev_offload, tso)},
+	{"tx-tcp6-segmentation", offsetof(struct dev_offload, tso)},
+	{"tx-udp-fragmentation", offsetof(struct dev_offload, ufo)},
+	{"tx-generic-segmentation", offsetof(struct dev_offload, gso)},
+	{"rx-gro", offsetof(struct dev_offload, gro)},
+	{"rx-lro", offsetof(struct dev_offload, lro)},
+	{"rx-hashing", offsetof(struct dev_offload, rxhash)},
+};
+
+/**
+ * \internal
+ * \brief Amount of kernel features, 0 until their names are loaded
+ */
+
+static __thread uint32_t dev_feature_nr;
+
+/**
+ * \internal
+ * \brief Kernel feature bit of each \c dev_features entry, -1 if unknown
+ */
+
+static __thread int dev_feature_bit[ARRAY_SIZE(dev_features)];
+
+/**
+ * \internal
+ * \brief Close the control socket of an exiting thread
+ * \param[in]	arg	Control socket descriptor plus one
+ */
+
+static void dev_ctl_sock_close(void *arg)
+{
+	close((int)(intptr_t) arg - 1);
+}
+
+/**
+ * \internal
+ * \brief Create the key closing the control socket of exiting threads
+ */
+
+static void dev_ctl_sock_key_create(void)
+{
+	pthread_key_create(&dev_ctl_sock_key, dev_ctl_sock_close);
+}
+
+/**
+ * \internal
+ * \brief Get the control socket of the calling thread
+ * \param[out]	sock	Control socket descriptor
+ * \return 0 on success, \c errno from \c socket(2) on failure
+ *
+ * The socket is opened on first use and kept until the thread exits, so
+ * successive interface requests do not pay for its creation.
+ */
+
+static int dev_ctl_sock_get(int *sock)
+{
+	int fd;
+
+	assert(sock);
+
+	if (dev_ctl_sock < 0) {
+		pthread_once(&dev_ctl_sock_once, dev_ctl_sock_key_create);
+
+		fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+
+		if (fd < 0)
+			return errno;
+
+		pthread_setspecific(dev_ctl_sock_key, (void *)(intptr_t) (fd + 1));
+		dev_ctl_sock = fd;
+	}
+
+	*sock = dev_ctl_sock;
+
+	return 0;
+}
+
 /**
  * \internal
  * \brief Perform an \c ioctl(2) call on an interface request structure
  * \param[in]	ifr	Pointer to interface request structure to use
  * \param[out]	request Ioctl command to perform
- * \return 0 on success, \c errno from \c socket(2), \c ioctl(2)
- * \return or \c close(2) on failure
+ * \return 0 on success, \c errno from \c socket(2) or \c ioctl(2)
+ * \return on failure
+ * \see dev_ctl_sock_get()
  */
 
 static int dev_kernel_request(struct ifreq *ifr, const int request)
 {
-	int rc, sock;
+	int rc, sock = -1;
 
 	assert(ifr);
 
-	sock = socket(AF_INET, SOCK_DGRAM, 0);
+	rc = dev_ctl_sock_get(&sock);
 
-	if (sock < 0)
-		return errno;
+	if (rc)
+		return rc;
 
 	rc = ioctl(sock, request, ifr);
 
-	close(sock);
-
 	return rc ? errno : rc;
 }
 
@@ -643,6 +755,172 @@ int ldab_dev_rx_hash_offload_set(const char *const dev, int rxhash)
 	return dev_ethtool_request(dev, ETHTOOL_SFLAGS, &flags);
 }
 
+/**
+ * \internal
+ * \brief Load the kernel feature names to locate the offload status bits
+ * \param[in]       dev	        interface name
+ * \return 0 on success, \c EOPNOTSUPP if the kernel does not report its
+ * features, else on failure
+ * \note Feature names are the same for all interfaces, they are loaded once
+ * per thread.
+ */
+
+static int dev_features_load(const char *const dev)
+{
+	uint64_t buf[(sizeof(struct ethtool_sset_info) + sizeof(uint32_t) +
+		      sizeof(uint64_t) - 1) / sizeof(uint64_t)];
+	struct ethtool_sset_info *sset = (struct ethtool_sset_info *)buf;
+	struct ethtool_gstrings *strings;
+	struct ifreq ifr;
+	size_t a, i;
+	int rc;
+
+	memset(buf, 0, sizeof(buf));
+	memset(&ifr, 0, sizeof(ifr));
+	strncpy(ifr.ifr_name, dev, sizeof(ifr.ifr_name) - 1);
+	sset->cmd = ETHTOOL_GSSET_INFO;
+	sset->sset_mask = 1ULL << ETH_SS_FEATURES;
+	ifr.ifr_data = (caddr_t) sset;
+
+	rc = dev_kernel_request(&ifr, SIOCETHTOOL);
+
+	if (rc)
+		return rc;
+
+	if (!(sset->sset_mask & (1ULL << ETH_SS_FEATURES)) || !sset->data[0])
+		return EOPNOTSUPP;
+
+	strings = calloc(1, sizeof(*strings) + sset->data[0] * ETH_GSTRING_LEN);
+
+	if (!strings)
+		return ENOMEM;
+
+	strings->cmd = ETHTOOL_GSTRINGS;
+	strings->string_set = ETH_SS_FEATURES;
+	strings->len = sset->data[0];
+	ifr.ifr_data = (caddr_t) strings;
+
+	rc = dev_kernel_request(&ifr, SIOCETHTOOL);
+
+	for (a = 0; !rc && a < ARRAY_SIZE(dev_features); a++) {
+		dev_feature_bit[a] = -1;
+
+		for (i = 0; i < strings->len; i++)
+			if (!strncmp((char *)&strings->data[i * ETH_GSTRING_LEN],
+				     dev_features[a].name, ETH_GSTRING_LEN)) {
+				dev_feature_bit[a] = i;
+				break;
+			}
+	}
+
+	if (!rc)
+		dev_feature_nr = strings->len;
+
+	free(strings);
+
+	return rc;
+}
+
+/**
+ * \internal
+ * \brief Get the interface offload status with one legacy request per status
+ * \param[in]       dev	        interface name
+ * \param[out]      offload	pointer to the offload status
+ * \return 0 on success, the error of the last failing request otherwise
+ */
+
+static int dev_offload_legacy_get(const char *const dev,
+				  struct dev_offload *offload)
+{
+	int rc = 0, err;
+
+	err = ldab_dev_rx_csum_offload_get(dev, &offload->rx_csum);
+	rc = err ? err : rc;
+	err = ldab_dev_tx_csum_offload_get(dev, &offload->tx_csum);
+	rc = err ? err : rc;
+	err = ldab_dev_scatter_gather_get(dev, &offload->sg);
+	rc = err ? err : rc;
+	err = ldab_dev_tcp_seg_offload_get(dev, &offload->tso);
+	rc = err ? err : rc;
+	err = ldab_dev_udp_frag_offload_get(dev, &offload->ufo);
+	rc = err ? err : rc;
+	err = ldab_dev_generic_seg_offload_get(dev, &offload->gso);
+	rc = err ? err : rc;
+	err = ldab_dev_generic_rcv_offload_get(dev, &offload->gro);
+	rc = err ? err : rc;
+	err = ldab_dev_large_rcv_offload_get(dev, &offload->lro);
+	rc = err ? err : rc;
+	err = ldab_dev_rx_hash_offload_get(dev, &offload->rxhash);
+	rc = err ? err : rc;
+
+	offload->lro = !!offload->lro;
+	offload->rxhash = !!offload->rxhash;
+
+	return rc;
+}
+
+/**
+ * \brief Get all the offload status of an interface
+ * \param[in]       dev	        interface name
+ * \param[out]      offload	pointer to the offload status
+ * \return 0 on success, non zero if the offload status could not be fetched.
+ * \see dev_kernel_request()
+ *
+ * All the offload status are read at once with \c ETHTOOL_GFEATURES.
+ * Kernels not reporting their features are queried with one legacy ethtool
+ * request per offload status instead.
+ */
+
+int ldab_dev_offload_get(const char *const dev, struct dev_offload *offload)
+{
+	struct ethtool_gfeatures *features;
+	struct ifreq ifr;
+	size_t a, blocks;
+	int rc = 0, bit;
+
+	assert(dev);
+	assert(offload);
+
+	memset(offload, 0, sizeof(*offload));
+
+	if (!dev_feature_nr)
+		rc = dev_features_load(dev);
+
+	if (rc == EOPNOTSUPP || rc == EINVAL)
+		return dev_offload_legacy_get(dev, offload);
+
+	if (rc)
+		return rc;
+
+	blocks = (dev_feature_nr + 31) / 32;
+	features = calloc(1, sizeof(*features) + blocks *
+			  sizeof(features->features[0]));
+
+	if (!features)
+		return ENOMEM;
+
+	memset(&ifr, 0, sizeof(ifr));
+	strncpy(ifr.ifr_name, dev, sizeof(ifr.ifr_name) - 1);
+	features->cmd = ETHTOOL_GFEATURES;
+	features->size = blocks;
+	ifr.ifr_data = (caddr_t) features;
+
+	rc = dev_kernel_request(&ifr, SIOCETHTOOL);
+
+	for (a = 0; !rc && a < ARRAY_SIZE(dev_features); a++) {
+		bit = dev_feature_bit[a];
+
+		if (bit >= 0
+		    && features->features[bit / 32].active & (1U << bit % 32))
+			*(int *)((uint8_t *) offload + dev_features[a].offset) =
+			    1;
+	}
+
+	free(features);
+
+	return rc;
+}
+
 /**
  * \brief Get the interface link status
  * \param[in]       dev	        interface name
@@ -0,0 +1,257 @@
+/**
+ * \file irq.c
+ * \author written by Emmanuel Roullit emmanuel.roullit@gmail.com (c) 2013
+ * \date 2013
+ */
+
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif				/* _GNU_SOURCE */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <assert.h>
+#include <limits.h>
+#include <dirent.h>
+
+#include <libdabba/irq.h>
+
+/**
+ * \internal
+ * \brief Tell if an interrupt serves the receive queues of an interface
+ * \param[in]           name	        Interrupt name from \c /proc/interrupts
+ * \param[in]           dev	        Interface name
+ * \return 1 if the interrupt serves receive queues, 0 otherwise
+ *
+ * Drivers name their queue interrupts after the interface, like "eth0",
+ * "eth0-rx-0" or "eth0-TxRx-0". Transmit-only interrupts are ignored.
+ */
+
+static int irq_name_is_rx(const char *const name, const char *const dev)
+{
+	const size_t len = strlen(dev);
+	const char *suffix = name + len;
+
+	if (strncmp(name, dev, len))
+		return 0;
+
+	if (*suffix == '\0')
+		return 1;
+
+	if (*suffix != '-')
+		return 0;
+
+	return strcasestr(suffix, "rx") || !strcasestr(suffix, "tx");
+}
+
+/**
+ * \brief Parse a hexadecimal CPU mask like "00000000,0000000f"
+ * \param[in]           str	        Mask to parse
+ * \param[out]          set	        Set of the CPUs in the mask
+ * \return 0 on success, \c EINVAL if the mask is malformed
+ */
+
+int ldab_cpu_mask_parse(const char *const str, cpu_set_t * set)
+{
+	size_t i, cpu = 0;
+	int b, v;
+
+	assert(str);
+	assert(set);
+
+	CPU_ZERO(set);
+
+	for (i = strlen(str); i > 0; i--) {
+		const unsigned char c = str[i - 1];
+
+		if (c == ',')
+			continue;
+
+		if (!isxdigit(c))
+			return EINVAL;
+
+		v = isdigit(c) ? c - '0' : tolower(c) - 'a' + 10;
+
+		for (b = 0; b < 4; b++, cpu++)
+			if (v & (1 << b) && cpu < CPU_SETSIZE)
+				CPU_SET(cpu, set);
+	}
+
+	return 0;
+}
+
+/**
+ * \internal
+ * \brief Get the CPUs handling the interrupts of an interface receive queues
+ * \param[in]           proc_root	procfs mount point
+ * \param[in]           dev	        Interface name
+ * \param[out]          cpus	        CPUs handling the interrupts
+ */
+
+static void dev_rx_irq_cpus_get(const char *const proc_root,
+				const char *const dev, cpu_set_t * cpus)
+{
+	char path[PATH_MAX], buf[1024], *line = NULL, *name, *end;
+	size_t len = 0;
+	unsigned long irq;
+	cpu_set_t irq_cpus;
+	FILE *f;
+
+	snprintf(path, sizeof(path), "%s/interrupts", proc_root);
+
+	f = fopen(path, "r");
+
+	if (!f)
+		return;
+
+	while (getline(&line, &len, f) > 0) {
+		irq = strtoul(line, &end, 10);
+
+		/* Skip the header and the architecture specific interrupts */
+		if (end == line || *end != ':')
+			continue;
+
+		for (end = line + strlen(line); end > line && isspace(end[-1]);
+		     end--)
+			end[-1] = '\0';
+
+		name = strrchr(line, ' ');
+		name = name ? name + 1 : line;
+
+		if (!irq_name_is_rx(name, dev))
+			continue;
+
+		snprintf(path, sizeof(path), "%s/irq/%lu/smp_affinity_list",
+			 proc_root, irq);
+
+		if (ldab_sysfs_attr_read(path, buf, sizeof(buf))
+		    || ldab_cpu_list_parse(buf, &irq_cpus))
+			continue;
+
+		CPU_OR(cpus, cpus, &irq_cpus);
+	}
+
+	free(line);
+	fclose(f);
+}
+
+/**
+ * \internal
+ * \brief Get the CPUs of an interface receive packet steering
+ * \param[in]           sysfs_root	sysfs mount point
+ * \param[in]           dev	        Interface name
+ * \param[out]          cpus	        CPUs processing received packets
+ */
+
+static void dev_rx_rps_cpus_get(const char *const sysfs_root,
+				const char *const dev, cpu_set_t * cpus)
+{
+	char path[PATH_MAX], buf[1024];
+	cpu_set_t rps_cpus;
+	struct dirent *entry;
+	DIR *dir;
+
+	snprintf(path, sizeof(path), "%s/class/net/%s/queues", sysfs_root, dev);
+
+	dir = opendir(path);
+
+	if (!dir)
+		return;
+
+	while ((entry = readdir(dir)) != NULL) {
+		if (strncmp(entry->d_name, "rx-", strlen("rx-")))
+			continue;
+
+		snprintf(path, sizeof(path), "%s/class/net/%s/queues/%s/rps_cpus",
+			 sysfs_root, dev, entry->d_name);
+
+		if (ldab_sysfs_attr_read(path, buf, sizeof(buf))
+		    || ldab_cpu_mask_parse(buf, &rps_cpus))
+			continue;
+
+		CPU_OR(cpus, cpus, &rps_cpus);
+	}
+
+	closedir(dir);
+}
+
+/**
+ * \brief Get the CPUs processing the packets received on an interface
+ * \param[in]           proc_root	procfs mount point
+ * \param[in]           sysfs_root	sysfs mount point
+ * \param[in]           dev	        Interface name
+ * \param[out]          cpus	        CPUs processing received packets
+ * \return 0 on success, \c ENOENT if no CPU could be found
+ *
+ * The CPUs handling the interrupts of the receive queues are looked up in
+ * \c /proc/interrupts first. When the interface has no dedicated interrupt,
+ * the CPUs configured for receive packet steering are used instead.
+ */
+
+int ldab_dev_rx_cpus_get(const char *const proc_root,
+			 const char *const sysfs_root, const char *const dev,
+			 cpu_set_t * cpus)
+{
+	assert(proc_root);
+	assert(sysfs_root);
+	assert(dev);
+	assert(cpus);
+
+	CPU_ZERO(cpus);
+
+	dev_rx_irq_cpus_get(proc_root, dev, cpus);
+
+	if (!CPU_COUNT(cpus))
+		dev_rx_rps_cpus_get(sysfs_root, dev, cpus);
+
+	return CPU_COUNT(cpus) ? 0 : ENOENT;
+}
+
+/**
+ * \brief Add the SMT siblings of a CPU set
+ * \param[in]           sysfs_root	sysfs mount point
+ * \param[in]           cpus	        CPUs to look up
+ * \param[out]          siblings	\c cpus and their SMT siblings
+ * \return 0 on success, \c EINVAL if \c cpus is empty
+ * \note CPUs without topology information are their own only sibling.
+ */
+
+int ldab_cpu_siblings_get(const char *const sysfs_root, const cpu_set_t * cpus,
+			  cpu_set_t * siblings)
+{
+	char path[PATH_MAX], buf[1024];
+	cpu_set_t thread_siblings;
+	size_t cpu;
+
+	assert(sysfs_root);
+	assert(cpus);
+	assert(siblings);
+
+	if (!CPU_COUNT(cpus))
+		return EINVAL;
+
+	CPU_ZERO(siblings);
+
+	for (cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+		if (!CPU_ISSET(cpu, cpus))
+			continue;
+
+		CPU_SET(cpu, siblings);
+
+		snprintf(path, sizeof(path),
+			 "%s/devices/system/cpu/cpu%zu/topology/thread_siblings_list",
+			 sysfs_root, cpu);
+
+		if (ldab_sysfs_attr_read(path, buf, sizeof(buf))
+		    || ldab_cpu_list_parse(buf, &thread_siblings))
+			continue;
+
+		CPU_OR(siblings, siblings, &thread_siblings);
+	}
+
+	return 0;
+}
@@ -0,0 +1,263 @@
+/**
+ * \file numa.c
+ * \author written by Emmanuel Roullit emmanuel.roullit@gmail.com (c) 2013
+ * \date 2013
+ */
+
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif				/* _GNU_SOURCE */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#include <libdabba/interface.h>
+#include <libdabba/numa.h>
+
+#ifndef MPOL_DEFAULT
+#define MPOL_DEFAULT 0
+#endif				/* MPOL_DEFAULT */
+
+#ifndef MPOL_PREFERRED
+#define MPOL_PREFERRED 1
+#endif				/* MPOL_PREFERRED */
+
+/**
+ * \internal
+ * \brief Highest amount of NUMA nodes a memory policy can refer to
+ */
+
+#define NUMA_NODE_MAX 1024
+
+/**
+ * \brief Read the first line of a sysfs or procfs attribute
+ * \param[in]           path	        Path of the attribute to read
+ * \param[out]          buf	        Buffer to fill
+ * \param[in]           len	        Length of the buffer
+ * \return 0 on success, \c errno from \c open(2) or \c read(2) on failure
+ */
+
+int ldab_sysfs_attr_read(const char *const path, char *buf, const size_t len)
+{
+	ssize_t rd;
+	int fd;
+
+	assert(path);
+	assert(buf);
+	assert(len);
+
+	fd = open(path, O_RDONLY);
+
+	if (fd < 0)
+		return errno;
+
+	rd = read(fd, buf, len - 1);
+
+	if (rd < 0) {
+		rd = errno;
+		close(fd);
+		return rd;
+	}
+
+	close(fd);
+
+	buf[rd] = '\0';
+	buf[strcspn(buf, "\n")] = '\0';
+
+	return 0;
+}
+
+/**
+ * \brief Parse a CPU or NUMA node list like "0-3,8,10-11"
+ * \param[in]           str	        List to parse
+ * \param[out]          set	        Set of the listed numbers
+ * \return 0 on success, \c EINVAL if the list is malformed
+ * \note An empty list gives an empty set.
+ */
+
+int ldab_cpu_list_parse(const char *const str, cpu_set_t * set)
+{
+	const char *p = str;
+	char *end;
+	unsigned long a, b;
+
+	assert(str);
+	assert(set);
+
+	CPU_ZERO(set);
+
+	while (*p) {
+		a = strtoul(p, &end, 10);
+
+		if (end == p)
+			return EINVAL;
+
+		b = a;
+		p = end;
+
+		if (*p == '-') {
+			b = strtoul(++p, &end, 10);
+
+			if (end == p || b < a)
+				return EINVAL;
+
+			p = end;
+		}
+
+		if (b >= CPU_SETSIZE)
+			return EINVAL;
+
+		for (; a <= b; a++)
+			CPU_SET(a, set);
+
+		if (*p == ',')
+			p++;
+		else if (*p)
+			return EINVAL;
+	}
+
+	return 0;
+}
+
+/**
+ * \brief Get the amount of online NUMA nodes
+ * \param[in]           sysfs_root      sysfs mount point
+ * \param[out]          count           Amount of online NUMA nodes
+ * \return 0 on success, else on failure
+ * \note A kernel without NUMA support has a single node.
+ */
+
+int ldab_numa_node_count_get(const char *const sysfs_root, int *count)
+{
+	char path[PATH_MAX], buf[256];
+	cpu_set_t nodes;
+	int rc;
+
+	assert(sysfs_root);
+	assert(count);
+
+	*count = 1;
+
+	snprintf(path, sizeof(path), "%s/devices/system/node/online",
+		 sysfs_root);
+
+	rc = ldab_sysfs_attr_read(path, buf, sizeof(buf));
+
+	if (rc)
+		return rc == ENOENT ? 0 : rc;
+
+	rc = ldab_cpu_list_parse(buf, &nodes);
+
+	if (!rc && CPU_COUNT(&nodes))
+		*count = CPU_COUNT(&nodes);
+
+	return rc;
+}
+
+/**
+ * \brief Get the NUMA node an interface is attached to
+ * \param[in]           sysfs_root      sysfs mount point
+ * \param[in]           dev             Interface name
+ * \param[out]          node            NUMA node of the interface,
+ *                                      \c NUMA_NODE_NONE if unknown
+ * \return 0 on success, else on failure
+ * \note Virtual interfaces and the "any" pseudo-interface have no NUMA node.
+ */
+
+int ldab_numa_dev_node_get(const char *const sysfs_root, const char *const dev,
+			   int *node)
+{
+	char path[PATH_MAX], buf[32];
+	int rc;
+
+	assert(sysfs_root);
+	assert(dev);
+	assert(node);
+
+	*node = NUMA_NODE_NONE;
+
+	if (strcmp(dev, ANY_INTERFACE) == 0)
+		return 0;
+
+	snprintf(path, sizeof(path), "%s/class/net/%s/device/numa_node",
+		 sysfs_root, dev);
+
+	rc = ldab_sysfs_attr_read(path, buf, sizeof(buf));
+
+	if (rc)
+		return rc == ENOENT ? 0 : rc;
+
+	*node = strtol(buf, NULL, 10);
+
+	if (*node < 0)
+		*node = NUMA_NODE_NONE;
+
+	return 0;
+}
+
+/**
+ * \brief Get the CPUs of a NUMA node
+ * \param[in]           sysfs_root      sysfs mount point
+ * \param[in]           node            NUMA node
+ * \param[out]          cpus            CPUs of the NUMA node
+ * \return 0 on success, else on failure
+ */
+
+int ldab_numa_node_cpus_get(const char *const sysfs_root, const int node,
+			    cpu_set_t * cpus)
+{
+	char path[PATH_MAX], buf[1024];
+	int rc;
+
+	assert(sysfs_root);
+	assert(cpus);
+
+	if (node < 0)
+		return EINVAL;
+
+	snprintf(path, sizeof(path), "%s/devices/system/node/node%i/cpulist",
+		 sysfs_root, node);
+
+	rc = ldab_sysfs_attr_read(path, buf, sizeof(buf));
+
+	return rc ? rc : ldab_cpu_list_parse(buf, cpus);
+}
+
+/**
+ * \brief Make the calling thread allocate its memory on a NUMA node
+ * \param[in]           node            Preferred NUMA node,
+ *                                      \c NUMA_NODE_NONE restores the default
+ *                                      memory policy
+ * \return 0 on success, \c errno from \c set_mempolicy(2) on failure
+ *
+ * The memory policy also applies to the memory the kernel allocates on behalf
+ * of the thread, like packet mmap rings, and is inherited by the threads it
+ * creates.
+ */
+
+int ldab_numa_mempolicy_set(const int node)
+{
+	unsigned long mask[NUMA_NODE_MAX / (CHAR_BIT * sizeof(unsigned long))];
+	const unsigned long bits = CHAR_BIT * sizeof(unsigned long);
+
+	if (node >= NUMA_NODE_MAX)
+		return EINVAL;
+
+	if (node < 0)
+		return syscall(SYS_set_mempolicy, MPOL_DEFAULT, NULL, 0) ?
+		    errno : 0;
+
+	memset(mask, 0, sizeof(mask));
+	mask[node / bits] = 1UL << (node % bits);
+
+	return syscall(SYS_set_mempolicy, MPOL_PREFERRED, mask,
+		       NUMA_NODE_MAX + 1) ? errno : 0;
+}
@@ -0,0 +1,300 @@
+/**
+ * \file packet-buffer.c
+ * \author written by Emmanuel Roullit emmanuel.roullit@gmail.com (c) 2013
+ * \date 2013
+ */
+
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <assert.h>
+
+#include <sys/mman.h>
+#include <sys/param.h>
+
+#include <libdabba/pcap.h>
+#include <libdabba/packet-buffer.h>
+
+/**
+ * \internal
+ * \brief Copy data into the circular buffer
+ * \param[in,out] pkt_buf	Packet buffer to write to
+ * \param[in] off		Logical offset where to start writing
+ * \param[in] src		Data to copy
+ * \param[in] len		Amount of bytes to copy
+ */
+
+static void packet_buffer_copy_in(struct packet_buffer *pkt_buf,
+				  const uint64_t off, const void *src,
+				  const size_t len)
+{
+	const size_t pos = off % pkt_buf->size;
+	const size_t first = MIN(len, pkt_buf->size - pos);
+
+	memcpy(&pkt_buf->data[pos], src, first);
+	memcpy(pkt_buf->data, (const uint8_t *)src + first, len - first);
+}
+
+/**
+ * \internal
+ * \brief Copy data out of the circular buffer
+ * \param[in] pkt_buf		Packet buffer to read from
+ * \param[in] off		Logical offset where to start reading
+ * \param[out] dst		Destination buffer
+ * \param[in] len		Amount of bytes to copy
+ */
+
+static void packet_buffer_copy_out(const struct packet_buffer *pkt_buf,
+				   const uint64_t off, void *dst,
+				   const size_t len)
+{
+	const size_t pos = off % pkt_buf->size;
+	const size_t first = MIN(len, pkt_buf->size - pos);
+
+	memcpy(dst, &pkt_buf->data[pos], first);
+	memcpy((uint8_t *) dst + first, pkt_buf->data, len - first);
+}
+
+/**
+ * \internal
+ * \brief Write a contiguous range of bytes to a file
+ * \param[in] fd		File descriptor to write to
+ * \param[in] buf		Bytes to write
+ * \param[in] len		Amount of bytes to write
+ * \return 0 on success, \c errno value on failure
+ */
+
+static int packet_buffer_write(const int fd, const uint8_t * buf, size_t len)
+{
+	ssize_t written;
+
+	while (len) {
+		written = write(fd, buf, len);
+
+		if (written < 0)
+			return errno;
+
+		buf += written;
+		len -= written;
+	}
+
+	return 0;
+}
+
+/**
+ * \brief Allocate a circular packet buffer
+ * \param[out] pkt_buf	Packet buffer to create
+ * \param[in] size	Buffer size in bytes
+ * \param[in] duration	Maximum age in seconds of the buffered packets,
+ *			0 to only limit the buffer by its size
+ * \return 0 on success, \c EINVAL on invalid size, \c ENOMEM on failure
+ * \note The buffer memory is faulted in at creation so that pushing packets
+ *       never triggers a page fault in the capture thread.
+ */
+
+int ldab_packet_buffer_create(struct packet_buffer *pkt_buf,
+			      const uint64_t size, const uint64_t duration)
+{
+	assert(pkt_buf);
+
+	memset(pkt_buf, 0, sizeof(*pkt_buf));
+
+	if (size < sizeof(struct pcap_sf_pkthdr))
+		return EINVAL;
+
+	pkt_buf->data = mmap(NULL, size, PROT_READ | PROT_WRITE,
+			     MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+
+	if (pkt_buf->data == MAP_FAILED) {
+		pkt_buf->data = NULL;
+		return ENOMEM;
+	}
+
+	pkt_buf->size = size;
+	pkt_buf->duration = duration;
+
+	return 0;
+}
+
+/**
+ * \brief Release a circular packet buffer
+ * \param[in,out] pkt_buf	Packet buffer to destroy
+ */
+
+void ldab_packet_buffer_destroy(struct packet_buffer *pkt_buf)
+{
+	assert(pkt_buf);
+
+	if (pkt_buf->data)
+		munmap(pkt_buf->data, pkt_buf->size);
+
+	memset(pkt_buf, 0, sizeof(*pkt_buf));
+}
+
+/**
+ * \brief Append a packet to a circular packet buffer
+ * \param[in,out] pkt_buf	Packet buffer to write to
+ * \param[in] pkt		Pointer to the packet to write
+ * \param[in] pkt_len		Valid length of the packet
+ * \param[in] pkt_snaplen	Captured length of the packet
+ * \param[in] tv_sec		Seconds after Epoch
+ * \param[in] tv_usec		Microseconds after Epoch
+ * \return 0 on success, \c ENOBUFS if the packet cannot fit in the buffer
+ *
+ * The oldest packets are evicted until the new packet fits and every buffered
+ * packet is younger than the configured duration.
+ * The tail offset is published before any evicted byte is overwritten
+ * so that concurrent readers can detect which part of their copy is stale.
+ * \warning Only one thread may push packets to a given buffer.
+ */
+
+int ldab_packet_buffer_push(struct packet_buffer *pkt_buf,
+			    const uint8_t * const pkt, const size_t pkt_len,
+			    const size_t pkt_snaplen, const uint64_t tv_sec,
+			    const uint64_t tv_usec)
+{
+	struct pcap_sf_pkthdr sf_hdr;
+	const uint64_t rec_len = sizeof(sf_hdr) + pkt_snaplen;
+	uint64_t head = pkt_buf->head, tail = pkt_buf->tail;
+
+	assert(pkt_buf);
+	assert(pkt);
+
+	if (rec_len > pkt_buf->size) {
+		pkt_buf->dropped++;
+		return ENOBUFS;
+	}
+
+	while (tail < head) {
+		packet_buffer_copy_out(pkt_buf, tail, &sf_hdr, sizeof(sf_hdr));
+
+		if (head + rec_len - tail <= pkt_buf->size
+		    && (!pkt_buf->duration
+			|| sf_hdr.ts.tv_sec + pkt_buf->duration >= tv_sec))
+			break;
+
+		tail += sizeof(sf_hdr) + sf_hdr.caplen;
+	}
+
+	if (tail != pkt_buf->tail) {
+		__atomic_store_n(&pkt_buf->tail, tail, __ATOMIC_RELEASE);
+		__atomic_thread_fence(__ATOMIC_RELEASE);
+	}
+
+	memset(&sf_hdr, 0, sizeof(sf_hdr));
+
+	sf_hdr.ts.tv_sec = tv_sec;
+	sf_hdr.ts.tv_usec = tv_usec;
+	sf_hdr.caplen = pkt_snaplen;
+	sf_hdr.len = pkt_len;
+
+	packet_buffer_copy_in(pkt_buf, head, &sf_hdr, sizeof(sf_hdr));
+	packet_buffer_copy_in(pkt_buf, head + sizeof(sf_hdr), pkt, pkt_snaplen);
+
+	__atomic_store_n(&pkt_buf->head, head + rec_len, __ATOMIC_RELEASE);
+
+	return 0;
+}
+
+/**
+ * \brief Write a snapshot of a circular packet buffer
+ * \param[in] pkt_buf	Packet buffer to read from
+ * \param[in] fd	PCAP file descriptor to write the packets to
+ * \return 0 on success, \c errno value on failure
+ *
+ * The buffer content is copied without stopping the writer. The tail offset
+ * is read before the head offset so that the copied range is never negative.
+ * Once the copy is done, the tail offset is read again: every record
+ * starting before the new tail might have been overwritten during the copy
+ * and is discarded from the snapshot.
+ */
+
+int ldab_packet_buffer_dump(struct packet_buffer *pkt_buf, const int fd)
+{
+	uint64_t head, tail, valid;
+	uint8_t *snapshot;
+	size_t len, off;
+	int rc = 0;
+
+	assert(pkt_buf);
+	assert(fd > 0);
+
+	/* The tail never passes the head it was published with */
+	tail = __atomic_load_n(&pkt_buf->tail, __ATOMIC_ACQUIRE);
+	head = __atomic_load_n(&pkt_buf->head, __ATOMIC_ACQUIRE);
+
+	if (tail > head)
+		return 0;
+
+	/* Bytes older than one buffer size are overwritten already */
+	if (head - tail > pkt_buf->size)
+		tail = head - pkt_buf->size;
+
+	len = head - tail;
+
+	if (!len)
+		return 0;
+
+	snapshot = malloc(len);
+
+	if (!snapshot)
+		return ENOMEM;
+
+	packet_buffer_copy_out(pkt_buf, tail, snapshot, len);
+
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	valid = __atomic_load_n(&pkt_buf->tail, __ATOMIC_RELAXED);
+
+	/* The writer went all the way around, nothing left is consistent */
+	if (valid >= head)
+		goto out;
+
+	off = valid - tail;
+	rc = packet_buffer_write(fd, &snapshot[off], len - off);
+
+ out:
+	free(snapshot);
+	return rc;
+}
+
+/**
+ * \brief Write and empty a circular packet buffer
+ * \param[in,out] pkt_buf	Packet buffer to flush
+ * \param[in] fd		PCAP file descriptor to write the packets to
+ * \return 0 on success, \c errno value on failure
+ * \warning Only the thread pushing packets to the buffer may flush it.
+ *
+ * Nothing is pushed during the flush, so the records are written straight
+ * from the buffer, in at most two pieces when they wrap around its end.
+ */
+
+int ldab_packet_buffer_flush(struct packet_buffer *pkt_buf, const int fd)
+{
+	uint64_t head, tail;
+	size_t pos, first;
+	int rc;
+
+	assert(pkt_buf);
+	assert(fd > 0);
+
+	head = pkt_buf->head;
+	tail = pkt_buf->tail;
+
+	if (head == tail)
+		return 0;
+
+	pos = tail % pkt_buf->size;
+	first = MIN(head - tail, pkt_buf->size - pos);
+
+	rc = packet_buffer_write(fd, &pkt_buf->data[pos], first);
+
+	if (!rc)
+		rc = packet_buffer_write(fd, pkt_buf->data,
+					 head - tail - first);
+
+	__atomic_store_n(&pkt_buf->tail, head, __ATOMIC_RELEASE);
+
+	return rc;
+}
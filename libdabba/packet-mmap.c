@@ -10,6 +10,8 @@
 #include <string.h>
 #include <unistd.h>
 #include <assert.h>
+#include <limits.h>
+#include <stdint.h>
 
 #include <sys/mman.h>
 #include <sys/socket.h>
@@ -71,10 +73,9 @@ static int packet_mmap_mmap(struct packet_mmap *pkt_mmap)
 	assert(pkt_mmap);
 
 	pkt_mmap->buf =
-	    mmap(0,
-		 pkt_mmap->layout.tp_block_size *
-		 pkt_mmap->layout.tp_block_nr, PROT_READ | PROT_WRITE,
-		 MAP_SHARED | MAP_LOCKED, pkt_mmap->pf_sock, 0);
+	    mmap(0, packet_mmap_layout_size(&pkt_mmap->layout),
+		 PROT_READ | PROT_WRITE, MAP_SHARED | MAP_LOCKED,
+		 pkt_mmap->pf_sock, 0);
 
 	if (pkt_mmap->buf == MAP_FAILED)
 		return (EINVAL);
@@ -94,8 +95,7 @@ static void packet_mmap_munmap(struct packet_mmap *pkt_mmap)
 
 	if (pkt_mmap->buf) {
 		munmap(pkt_mmap->buf,
-		       pkt_mmap->layout.tp_block_size *
-		       pkt_mmap->layout.tp_block_nr);
+		       packet_mmap_layout_size(&pkt_mmap->layout));
 
 		pkt_mmap->buf = NULL;
 	}
@@ -136,6 +136,8 @@ static int packet_mmap_bind(struct packet_mmap *pkt_mmap)
 
 static int packet_mmap_vector_create(struct packet_mmap *pkt_mmap)
 {
+	const size_t frame_per_block =
+	    pkt_mmap->layout.tp_block_size / pkt_mmap->layout.tp_frame_size;
 	size_t a;
 
 	assert(pkt_mmap);
@@ -147,9 +149,13 @@ static int packet_mmap_vector_create(struct packet_mmap *pkt_mmap)
 	if (!pkt_mmap->vec)
 		return (ENOMEM);
 
+	/* Frames never cross block boundaries, blocks may end with unused bytes */
 	for (a = 0; a < pkt_mmap->layout.tp_frame_nr; a++) {
 		pkt_mmap->vec[a].iov_base =
-		    &pkt_mmap->buf[a * pkt_mmap->layout.tp_frame_size];
+		    &pkt_mmap->buf[(a / frame_per_block) *
+				   pkt_mmap->layout.tp_block_size +
+				   (a % frame_per_block) *
+				   pkt_mmap->layout.tp_frame_size];
 
 		pkt_mmap->vec[a].iov_len = pkt_mmap->layout.tp_frame_size;
 	}
@@ -170,6 +176,25 @@ static void packet_mmap_vector_destroy(struct packet_mmap *pkt_mmap)
 	free(pkt_mmap->vec);
 }
 
+/**
+ * \brief Unmap a packet mmap from the userspace
+ * \param[in,out] pkt_mmap	packet mmap to unmap
+ *
+ * The ring stays registered to its socket, which keeps its layout and is
+ * released by the kernel once the socket is closed. Unlike
+ * \c ldab_packet_mmap_destroy(), this does not wait for the packets in
+ * flight.
+ */
+
+void ldab_packet_mmap_unmap(struct packet_mmap *pkt_mmap)
+{
+	assert(pkt_mmap);
+
+	packet_mmap_vector_destroy(pkt_mmap);
+	pkt_mmap->vec = NULL;
+	packet_mmap_munmap(pkt_mmap);
+}
+
 /**
  * \brief Destroy a packet mmap
  * \param[in,out] pkt_mmap	packet mmap to destroy
@@ -187,58 +212,140 @@ void ldab_packet_mmap_destroy(struct packet_mmap *pkt_mmap)
 }
 
 /**
- * \brief Create a packet mmap
+ * \internal
+ * \brief Find an allocation-friendly block size for a frame size
+ * \param[in] frame_size	Packet mmap frame size
+ * \return the block size in bytes, 0 if the frame size is invalid
+ *
+ * Every page order from the smallest one holding a frame up to
+ * \c PACKET_MMAP_PREFERRED_ORDER is considered. The block size wasting the
+ * smallest share of its memory is chosen, the smallest block wins ties.
+ * Low page orders keep the kernel allocations easy to satisfy.
+ */
+
+static size_t packet_mmap_block_size_get(const size_t frame_size)
+{
+	const size_t page_size = sysconf(_SC_PAGESIZE);
+	size_t order, block_size, waste, best = 0, best_waste = 0;
+
+	if (!packet_mmap_frame_size_is_valid(frame_size))
+		return 0;
+
+	for (order = 0; order <= PACKET_MMAP_MAX_ORDER; order++) {
+		block_size = page_size << order;
+
+		if (block_size < frame_size)
+			continue;
+
+		waste = block_size % frame_size;
+
+		/* Compare waste / block_size ratios without rounding */
+		if (!best || waste * best < best_waste * block_size) {
+			best = block_size;
+			best_waste = waste;
+		}
+
+		if (order >= PACKET_MMAP_PREFERRED_ORDER)
+			break;
+	}
+
+	return best;
+}
+
+/**
+ * \brief Compute a packet mmap layout from a frame count
+ * \param[out] layout		Resulting packet mmap layout
+ * \param[in] frame_size	Packet mmap frame size
+ * \param[in] frame_nr		Minimum amount of frames
+ * \return 0 on success, \c EINVAL on invalid input or if the layout does
+ *         not fit in a \c struct \c tpacket_req or in the address space
+ * \note The frame number is rounded up to fill the last block.
+ */
+
+int ldab_packet_mmap_layout_get(struct tpacket_req *layout,
+				const size_t frame_size, const size_t frame_nr)
+{
+	const size_t block_size = packet_mmap_block_size_get(frame_size);
+	size_t frame_per_block, block_nr;
+
+	assert(layout);
+
+	if (!block_size || !frame_nr || frame_nr > UINT_MAX)
+		return EINVAL;
+
+	frame_per_block = block_size / frame_size;
+	block_nr = (frame_nr + frame_per_block - 1) / frame_per_block;
+
+	/* The frame count is rounded up, it may not fit anymore */
+	if (block_nr > UINT_MAX / frame_per_block
+	    || block_nr > SIZE_MAX / block_size)
+		return EINVAL;
+
+	layout->tp_frame_size = frame_size;
+	layout->tp_block_size = block_size;
+	layout->tp_block_nr = block_nr;
+	layout->tp_frame_nr = block_nr * frame_per_block;
+
+	return 0;
+}
+
+/**
+ * \brief Compute a packet mmap layout from a memory budget
+ * \param[out] layout		Resulting packet mmap layout
+ * \param[in] frame_size	Packet mmap frame size
+ * \param[in] budget		Maximum packet mmap size in bytes
+ * \return 0 on success, \c EINVAL if the budget cannot hold a single block
+ * \note The budget is capped to \c UINT_MAX bytes so that the frame count
+ *       fits in a \c struct \c tpacket_req.
+ */
+
+int ldab_packet_mmap_budget_layout_get(struct tpacket_req *layout,
+				       const size_t frame_size,
+				       const size_t budget)
+{
+	const size_t block_size = packet_mmap_block_size_get(frame_size);
+	const size_t capped = MIN(budget, (size_t) UINT_MAX);
+
+	assert(layout);
+
+	if (!block_size || capped < block_size)
+		return EINVAL;
+
+	return ldab_packet_mmap_layout_get(layout, frame_size,
+					   capped / block_size *
+					   (block_size / frame_size));
+}
+
+/**
+ * \brief Create an unbound packet mmap from a computed layout
  * \param[in,out]       pkt_mmap	packet mmap to create
- * \param[in]           dev		Device name
  * \param[in]           pf_sock		Open PF_PACKET socket
  * \param[in]           type		Packet mmap type to create
- * \param[in]           frame_size	Maximum packet mmap frame size
- * \param[in]           page_order	Page order to use to create a block
- * \param[in]           frame_nr	Total amount of frame in the packet mmap
+ * \param[in]           layout		Packet mmap layout to register
  * \return 0 on success, else on failure
  *
- * To create a packet mmap, the input frame_size and the size must be a power of
- * two. Also the frame and block number must be bigger than zero.
+ * The ring is registered, mapped and its I/O vector is built, but the socket
+ * is left unbound until \c ldab_packet_mmap_attach() is called.
+ * A socket opened with a null protocol does not receive any packet meanwhile.
  */
 
-int ldab_packet_mmap_create(struct packet_mmap *pkt_mmap,
-			   const char *const dev, const int pf_sock,
-			   const enum packet_mmap_type type,
-			   const enum packet_mmap_frame_size frame_size,
-			   const size_t frame_nr)
+int ldab_packet_mmap_prepare(struct packet_mmap *pkt_mmap, const int pf_sock,
+			     const enum packet_mmap_type type,
+			     const struct tpacket_req *const layout)
 {
 	static int (*const pkt_mmap_fn[]) (struct packet_mmap * pkt_mmap) = {
-	packet_mmap_register,
-		    packet_mmap_mmap,
-		    packet_mmap_vector_create, packet_mmap_bind};
+	packet_mmap_register, packet_mmap_mmap, packet_mmap_vector_create};
 	int rc = 0;
 	size_t a;
 
 	assert(pkt_mmap);
-	assert(dev);
-
-	if (!powerof2(frame_size) || !powerof2(frame_nr))
-		return EINVAL;
+	assert(layout);
 
 	memset(pkt_mmap, 0, sizeof(*pkt_mmap));
 
-	rc = ldab_devname_to_ifindex(dev, &pkt_mmap->ifindex);
-
-	if (rc != 0)
-		return rc;
-
 	pkt_mmap->type = type;
 	pkt_mmap->pf_sock = pf_sock;
-
-	pkt_mmap->layout.tp_frame_size = frame_size;
-	pkt_mmap->layout.tp_block_nr = frame_nr / 8;
-	pkt_mmap->layout.tp_block_size = 8 * frame_size;
-	pkt_mmap->layout.tp_frame_nr = frame_nr;
-
-	if (pkt_mmap->layout.tp_frame_nr == 0
-	    || pkt_mmap->layout.tp_block_nr == 0) {
-		return EINVAL;
-	}
+	pkt_mmap->layout = *layout;
 
 	for (a = 0; a < ARRAY_SIZE(pkt_mmap_fn); a++) {
 		rc = pkt_mmap_fn[a] (pkt_mmap);
@@ -252,3 +359,184 @@ int ldab_packet_mmap_create(struct packet_mmap *pkt_mmap,
 
 	return rc;
 }
+
+/**
+ * \brief Bind a prepared packet mmap to an interface
+ * \param[in,out]       pkt_mmap	packet mmap to bind
+ * \param[in]           dev		Device name
+ * \return 0 on success, else on failure
+ * \note The packet mmap is left untouched on failure.
+ */
+
+int ldab_packet_mmap_attach(struct packet_mmap *pkt_mmap,
+			    const char *const dev)
+{
+	int ifindex, rc;
+
+	assert(pkt_mmap);
+	assert(pkt_mmap->buf);
+	assert(dev);
+
+	rc = ldab_devname_to_ifindex(dev, &ifindex);
+
+	if (rc)
+		return rc;
+
+	return ldab_packet_mmap_index_attach(pkt_mmap, ifindex);
+}
+
+/**
+ * \brief Bind a prepared packet mmap to an interface index
+ * \param[in,out]       pkt_mmap	packet mmap to bind
+ * \param[in]           ifindex		Interface index
+ * \return 0 on success, error code from \c bind(2) on failure
+ * \note The packet mmap is left untouched on failure.
+ */
+
+int ldab_packet_mmap_index_attach(struct packet_mmap *pkt_mmap,
+				  const int ifindex)
+{
+	int rc;
+
+	assert(pkt_mmap);
+	assert(pkt_mmap->buf);
+
+	pkt_mmap->ifindex = ifindex;
+	rc = packet_mmap_bind(pkt_mmap);
+
+	if (rc)
+		pkt_mmap->ifindex = 0;
+
+	return rc;
+}
+
+/**
+ * \internal
+ * \brief Create a packet mmap from a computed layout
+ * \param[in,out]       pkt_mmap	packet mmap to create, with its layout set
+ * \param[in]           dev		Device name
+ * \param[in]           pf_sock		Open PF_PACKET socket
+ * \param[in]           type		Packet mmap type to create
+ * \return 0 on success, else on failure
+ */
+
+static int packet_mmap_setup(struct packet_mmap *pkt_mmap,
+			     const char *const dev, const int pf_sock,
+			     const enum packet_mmap_type type)
+{
+	const struct tpacket_req layout = pkt_mmap->layout;
+	int ifindex, rc;
+
+	/* Fail on unknown devices before allocating the ring */
+	rc = ldab_devname_to_ifindex(dev, &ifindex);
+
+	if (rc != 0)
+		return rc;
+
+	rc = ldab_packet_mmap_prepare(pkt_mmap, pf_sock, type, &layout);
+
+	if (rc)
+		return rc;
+
+	rc = ldab_packet_mmap_attach(pkt_mmap, dev);
+
+	if (rc)
+		ldab_packet_mmap_destroy(pkt_mmap);
+
+	return rc;
+}
+
+/**
+ * \brief Create a packet mmap
+ * \param[in,out]       pkt_mmap	packet mmap to create
+ * \param[in]           dev		Device name
+ * \param[in]           pf_sock		Open PF_PACKET socket
+ * \param[in]           type		Packet mmap type to create
+ * \param[in]           frame_size	Maximum packet mmap frame size
+ * \param[in]           frame_nr	Minimum amount of frame in the packet mmap
+ * \return 0 on success, else on failure
+ *
+ * The block geometry is computed by \c ldab_packet_mmap_layout_get().
+ */
+
+int ldab_packet_mmap_create(struct packet_mmap *pkt_mmap,
+			   const char *const dev, const int pf_sock,
+			   const enum packet_mmap_type type,
+			   const size_t frame_size, const size_t frame_nr)
+{
+	int rc;
+
+	assert(pkt_mmap);
+	assert(dev);
+
+	memset(pkt_mmap, 0, sizeof(*pkt_mmap));
+
+	rc = ldab_packet_mmap_layout_get(&pkt_mmap->layout, frame_size,
+					 frame_nr);
+
+	if (rc)
+		return rc;
+
+	return packet_mmap_setup(pkt_mmap, dev, pf_sock, type);
+}
+
+/**
+ * \brief Create a packet mmap fitting in a memory budget
+ * \param[in,out]       pkt_mmap	packet mmap to create
+ * \param[in]           dev		Device name
+ * \param[in]           pf_sock		Open PF_PACKET socket
+ * \param[in]           type		Packet mmap type to create
+ * \param[in]           frame_size	Maximum packet mmap frame size
+ * \param[in]           budget		Maximum packet mmap size in bytes
+ * \return 0 on success, else on failure
+ *
+ * The block geometry is computed by \c ldab_packet_mmap_budget_layout_get().
+ */
+
+int ldab_packet_mmap_budget_create(struct packet_mmap *pkt_mmap,
+				  const char *const dev, const int pf_sock,
+				  const enum packet_mmap_type type,
+				  const size_t frame_size, const size_t budget)
+{
+	int rc;
+
+	assert(pkt_mmap);
+	assert(dev);
+
+	memset(pkt_mmap, 0, sizeof(*pkt_mmap));
+
+	rc = ldab_packet_mmap_budget_layout_get(&pkt_mmap->layout, frame_size,
+						budget);
+
+	if (rc)
+		return rc;
+
+	return packet_mmap_setup(pkt_mmap, dev, pf_sock, type);
+}
+
+/**
+ * \brief Create a packet mmap from a computed layout
+ * \param[in,out]       pkt_mmap	packet mmap to create
+ * \param[in]           dev		Device name
+ * \param[in]           pf_sock		Open PF_PACKET socket
+ * \param[in]           type		Packet mmap type to create
+ * \param[in]           layout		Packet mmap layout, from
+ *					\c ldab_packet_mmap_layout_get() or
+ *					\c ldab_packet_mmap_budget_layout_get()
+ * \return 0 on success, else on failure
+ */
+
+int ldab_packet_mmap_layout_create(struct packet_mmap *pkt_mmap,
+				   const char *const dev, const int pf_sock,
+				   const enum packet_mmap_type type,
+				   const struct tpacket_req *const layout)
+{
+	assert(pkt_mmap);
+	assert(dev);
+	assert(layout);
+
+	memset(pkt_mmap, 0, sizeof(*pkt_mmap));
+	pkt_mmap->layout = *layout;
+
+	return packet_mmap_setup(pkt_mmap, dev, pf_sock, type);
+}
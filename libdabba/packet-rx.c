@@ -10,11 +10,535 @@
 #include <unistd.h>
 #include <sys/uio.h>
 #include <sys/param.h>
+#include <time.h>
+#include <errno.h>
 #include <poll.h>
+#include <sys/socket.h>
 
 #include <libdabba/packet-rx.h>
 #include <libdabba/pcap.h>
 #include <libdabba/macros.h>
+#include <libdabba/probe.h>
+
+/**
+ * \brief Longest time in milliseconds to wait for frames before checking
+ * whether the capture must switch to another ring
+ */
+
+#define PACKET_RX_POLL_TIMEOUT 100
+
+/**
+ * \brief Measure the ring residency of one frame out of this amount
+ */
+
+#define PACKET_RX_RESIDENCY_SAMPLING 8
+
+/**
+ * \internal
+ * \brief Run the trigger of a capture on a frame
+ * \param[in,out] pkt_rx	Pointer to packet rx thread structure
+ * \param[in] mmap_hdr		Pointer to the received frame header
+ * \param[in] pkt		Pointer to the received packet
+ * \param[in] caplen		Length of the packet available in the ring
+ *
+ * Until the trigger matches, frames are only kept in the in-memory buffer.
+ * A match flushes the buffer to the PCAP file and opens a writing window,
+ * which every further match extends.
+ * \note The trigger sees every frame in full, regardless of the sampling
+ * rate and the snapshot length of the capture.
+ */
+
+static void packet_rx_trigger_match(struct packet_rx *pkt_rx,
+				    struct packet_mmap_header *mmap_hdr,
+				    const uint8_t * const pkt,
+				    const size_t caplen)
+{
+	struct packet_trigger *trigger = &pkt_rx->trigger;
+	const uint64_t sec = mmap_hdr->tp_h.tp_sec;
+
+	if (!ldab_bpf_engine_run(&trigger->engine, pkt, mmap_hdr->tp_h.tp_len,
+				 caplen))
+		return;
+
+	if (sec >= trigger->deadline)
+		ldab_packet_buffer_flush(&pkt_rx->buffer, pkt_rx->pcap_fd);
+
+	trigger->deadline = sec + trigger->window + 1;
+	trigger->count++;
+}
+
+/**
+ * \internal
+ * \brief Count a frame read from the ring
+ * \param[in,out] pkt_rx	Pointer to packet rx thread structure
+ * \param[in] len		Wire length of the frame
+ * \param[in] kept		Non-zero if the frame passed the sampling
+ * \note Only the capture thread updates the counters.
+ */
+
+static void packet_rx_counters_update(struct packet_rx *pkt_rx,
+				      const uint32_t len, const int kept)
+{
+	struct packet_rx_counters *counters = &pkt_rx->counters;
+	const uint32_t seq = pkt_rx->seq;
+
+	__atomic_store_n(&pkt_rx->seq, seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	__atomic_store_n(&counters->packets, counters->packets + 1,
+			 __ATOMIC_RELAXED);
+	__atomic_store_n(&counters->bytes, counters->bytes + len,
+			 __ATOMIC_RELAXED);
+
+	if (kept)
+		__atomic_store_n(&counters->kept, counters->kept + 1,
+				 __ATOMIC_RELAXED);
+
+	__atomic_store_n(&pkt_rx->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+/**
+ * \brief Take a consistent snapshot of the capture counters
+ * \param[in] pkt_rx		Pointer to packet rx thread structure
+ * \param[out] counters	Snapshot of the capture counters
+ *
+ * The snapshot is taken again while the capture thread updates the counters,
+ * the capture thread never waits for readers.
+ */
+
+void ldab_packet_rx_counters_get(struct packet_rx *pkt_rx,
+				 struct packet_rx_counters *counters)
+{
+	uint32_t seq;
+
+	assert(pkt_rx);
+	assert(counters);
+
+	do {
+		seq = __atomic_load_n(&pkt_rx->seq, __ATOMIC_ACQUIRE);
+
+		counters->packets =
+		    __atomic_load_n(&pkt_rx->counters.packets,
+				    __ATOMIC_RELAXED);
+		counters->bytes =
+		    __atomic_load_n(&pkt_rx->counters.bytes, __ATOMIC_RELAXED);
+		counters->kept =
+		    __atomic_load_n(&pkt_rx->counters.kept, __ATOMIC_RELAXED);
+
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	} while ((seq & 1)
+		 || seq != __atomic_load_n(&pkt_rx->seq, __ATOMIC_RELAXED));
+}
+
+/**
+ * \internal
+ * \brief Record how long a frame waited in the ring
+ * \param[in,out] pkt_rx	Pointer to packet rx thread structure
+ * \param[in] mmap_hdr		Pointer to the received frame header
+ *
+ * The residency is the time between the kernel timestamp of the frame and
+ * now. Only one frame out of \c PACKET_RX_RESIDENCY_SAMPLING is measured to
+ * keep clock reads out of most frames.
+ * \note A frame timestamped in the future, e.g. after a clock step, is
+ * recorded with no residency.
+ */
+
+static void packet_rx_residency_record(struct packet_rx *pkt_rx,
+				       const struct packet_mmap_header
+				       *mmap_hdr)
+{
+	struct timespec now;
+	uint64_t stamp, consumed;
+
+	if (pkt_rx->counters.packets % PACKET_RX_RESIDENCY_SAMPLING)
+		return;
+
+	clock_gettime(CLOCK_REALTIME, &now);
+
+	stamp = (uint64_t) mmap_hdr->tp_h.tp_sec * 1000000 +
+	    mmap_hdr->tp_h.tp_usec;
+	consumed = (uint64_t) now.tv_sec * 1000000 + now.tv_nsec / 1000;
+
+	ldab_histogram_record(&pkt_rx->residency,
+			      consumed > stamp ? consumed - stamp : 0);
+}
+
+/**
+ * \internal
+ * \brief Process a frame received on the packet mmap RX ring
+ * \param[in,out] pkt_rx	Pointer to packet rx thread structure
+ * \param[in] mmap_hdr		Pointer to the received frame header
+ *
+ * The frame is written to the PCAP file and/or kept in the in-memory packet
+ * buffer when one is configured. The time it waited in the ring is sampled
+ * before, see packet_rx_residency_record().
+ * The trigger runs on the whole frame first, the sampling rate and the
+ * snapshot length only apply to what is written or buffered.
+ * The snapshot length and the sampling rate can be modified by another thread
+ * while the capture runs, they are read once per frame.
+ */
+
+static void packet_rx_frame_process(struct packet_rx *pkt_rx,
+				    struct packet_mmap_header *mmap_hdr)
+{
+	const uint8_t *pkt = (uint8_t *) mmap_hdr + mmap_hdr->tp_h.tp_mac;
+	const uint32_t max_snaplen =
+	    __atomic_load_n(&pkt_rx->snaplen, __ATOMIC_RELAXED);
+	const uint32_t sampling =
+	    __atomic_load_n(&pkt_rx->sampling, __ATOMIC_RELAXED);
+	const int triggered = bpf_engine_is_loaded(&pkt_rx->trigger.engine);
+	size_t snaplen = MIN(mmap_hdr->tp_h.tp_snaplen,
+			     pkt_rx->pkt_mmap.layout.tp_frame_size);
+
+	packet_rx_residency_record(pkt_rx, mmap_hdr);
+
+	if (triggered)
+		packet_rx_trigger_match(pkt_rx, mmap_hdr, pkt, snaplen);
+
+	if (sampling > 1 && ++pkt_rx->sampling_count < sampling) {
+		packet_rx_counters_update(pkt_rx, mmap_hdr->tp_h.tp_len, 0);
+		return;
+	}
+
+	pkt_rx->sampling_count = 0;
+	packet_rx_counters_update(pkt_rx, mmap_hdr->tp_h.tp_len, 1);
+
+	if (max_snaplen)
+		snaplen = MIN(snaplen, max_snaplen);
+
+	if (triggered) {
+		if (mmap_hdr->tp_h.tp_sec < pkt_rx->trigger.deadline)
+			ldab_pcap_write(pkt_rx->pcap_fd, pkt,
+					mmap_hdr->tp_h.tp_len, snaplen,
+					mmap_hdr->tp_h.tp_sec,
+					mmap_hdr->tp_h.tp_usec);
+		else
+			ldab_packet_buffer_push(&pkt_rx->buffer, pkt,
+						mmap_hdr->tp_h.tp_len,
+						snaplen,
+						mmap_hdr->tp_h.tp_sec,
+						mmap_hdr->tp_h.tp_usec);
+		return;
+	}
+
+	if (pkt_rx->pcap_fd > 0)
+		ldab_pcap_write(pkt_rx->pcap_fd, pkt, mmap_hdr->tp_h.tp_len,
+				snaplen, mmap_hdr->tp_h.tp_sec,
+				mmap_hdr->tp_h.tp_usec);
+
+	if (packet_buffer_is_enabled(&pkt_rx->buffer))
+		ldab_packet_buffer_push(&pkt_rx->buffer, pkt,
+					mmap_hdr->tp_h.tp_len, snaplen,
+					mmap_hdr->tp_h.tp_sec,
+					mmap_hdr->tp_h.tp_usec);
+}
+
+/**
+ * \brief Ask a running capture to switch to another packet mmap ring
+ * \param[in,out] pkt_rx	Pointer to packet rx thread structure
+ * \param[in] next		Packet mmap ring to switch to
+ * \return 0 on success, \c EBUSY if a previous switch is not finished
+ *
+ * \c next must be prepared with ldab_packet_mmap_prepare() on a socket
+ * which does not receive packets yet, with the same socket filter as the
+ * current ring. The capture thread binds it to the interface of the current
+ * ring when it switches over, so no packet is read twice and none is lost
+ * as long as the rings do not overflow.
+ */
+
+int ldab_packet_rx_resize_start(struct packet_rx *pkt_rx,
+				const struct packet_mmap *next)
+{
+	assert(pkt_rx);
+	assert(next);
+
+	if (__atomic_load_n(&pkt_rx->resize.state, __ATOMIC_ACQUIRE) !=
+	    PACKET_RX_RESIZE_IDLE)
+		return EBUSY;
+
+	pkt_rx->resize.next = *next;
+
+	__atomic_store_n(&pkt_rx->resize.state, PACKET_RX_RESIZE_PENDING,
+			 __ATOMIC_RELEASE);
+
+	return 0;
+}
+
+/**
+ * \brief Collect the outcome of a ring switch
+ * \param[in,out] pkt_rx	Pointer to packet rx thread structure
+ * \param[out] prev		Ring unmapped by the capture, with its socket and
+ *				layout left
+ * \return 0 if the capture switched rings, \c EAGAIN if the capture did not
+ * switch rings yet, \c EINVAL if no switch was requested, else the error
+ * which prevented the switch.
+ * \note The unmapped ring is the previous ring after a successful switch,
+ * the requested one otherwise. The caller is in charge of closing its socket.
+ */
+
+int ldab_packet_rx_resize_finish(struct packet_rx *pkt_rx,
+				 struct packet_mmap *prev)
+{
+	uint32_t state;
+
+	assert(pkt_rx);
+	assert(prev);
+
+	state = __atomic_load_n(&pkt_rx->resize.state, __ATOMIC_ACQUIRE);
+
+	if (state == PACKET_RX_RESIZE_IDLE)
+		return EINVAL;
+
+	if (state == PACKET_RX_RESIZE_PENDING)
+		return EAGAIN;
+
+	*prev = pkt_rx->resize.prev;
+	memset(&pkt_rx->resize.prev, 0, sizeof(pkt_rx->resize.prev));
+
+	__atomic_store_n(&pkt_rx->resize.state, PACKET_RX_RESIZE_IDLE,
+			 __ATOMIC_RELEASE);
+
+	return pkt_rx->resize.rc;
+}
+
+/**
+ * \internal
+ * \brief Process the frames left in the current ring
+ * \param[in,out] pkt_rx	Pointer to packet rx thread structure
+ * \param[in] index		Index of the next frame to read
+ *
+ * The frames are processed in their arrival order, starting from \c index.
+ * The ring is swept once, so the drain ends even if packets keep coming.
+ */
+
+static void packet_rx_ring_drain(struct packet_rx *pkt_rx, const size_t index)
+{
+	struct packet_mmap *pkt_mmap = &pkt_rx->pkt_mmap;
+	const size_t frame_nr = pkt_mmap->layout.tp_frame_nr;
+	size_t a;
+
+	for (a = 0; a < frame_nr; a++) {
+		struct packet_mmap_header *mmap_hdr =
+		    pkt_mmap->vec[(index + a) % frame_nr].iov_base;
+
+		if ((mmap_hdr->tp_h.tp_status & TP_STATUS_USER) ==
+		    TP_STATUS_USER) {
+			packet_rx_frame_process(pkt_rx, mmap_hdr);
+			mmap_hdr->tp_h.tp_status = TP_STATUS_KERNEL;
+		}
+	}
+}
+
+/**
+ * \internal
+ * \brief Add the statistics of the current ring socket to the capture ones
+ * \param[in,out] pkt_rx	Pointer to packet rx thread structure
+ * \note Reading \c PACKET_STATISTICS resets the socket counters.
+ */
+
+static void packet_rx_stats_update(struct packet_rx *pkt_rx)
+{
+	struct tpacket_stats stats;
+	socklen_t len = sizeof(stats);
+
+	if (getsockopt(pkt_rx->pkt_mmap.pf_sock, SOL_PACKET,
+		       PACKET_STATISTICS, &stats, &len))
+		return;
+
+	pkt_rx->stats.tp_packets += stats.tp_packets;
+	pkt_rx->stats.tp_drops += stats.tp_drops;
+}
+
+/**
+ * \internal
+ * \brief Get the fanout group of a packet socket, creating one if needed
+ * \param[in] sock	Bound packet socket
+ * \return The \c PACKET_FANOUT value of the group, 0 if the socket cannot
+ * be part of a fanout group.
+ *
+ * A socket outside of any fanout group is put alone in a new group whose
+ * program hands every packet to the second socket of the group, if any.
+ * The group keeps the single socket left once the first one is closed, so
+ * each ring joining the group takes over the whole traffic at once.
+ */
+
+static int packet_rx_fanout_get(const int sock)
+{
+	int fanout = 0;
+#ifdef PACKET_FANOUT
+	socklen_t len = sizeof(fanout);
+
+	if (getsockopt(sock, SOL_PACKET, PACKET_FANOUT, &fanout, &len))
+		return 0;
+
+#if defined(PACKET_FANOUT_CBPF) && defined(PACKET_FANOUT_FLAG_UNIQUEID)
+	if (!fanout) {
+		struct sock_filter second[] = {
+			BPF_STMT(BPF_RET | BPF_K, 1)
+		};
+		struct sock_fprog prog = {
+			.len = ARRAY_SIZE(second),
+			.filter = second
+		};
+
+		fanout = (PACKET_FANOUT_CBPF | PACKET_FANOUT_FLAG_UNIQUEID) << 16;
+		len = sizeof(fanout);
+
+		if (setsockopt(sock, SOL_PACKET, PACKET_FANOUT, &fanout,
+			       sizeof(fanout))
+		    || setsockopt(sock, SOL_PACKET, PACKET_FANOUT_DATA, &prog,
+				  sizeof(prog))
+		    || getsockopt(sock, SOL_PACKET, PACKET_FANOUT, &fanout,
+				  &len))
+			fanout = 0;
+	}
+#endif				/* PACKET_FANOUT_CBPF && PACKET_FANOUT_FLAG_UNIQUEID */
+#else
+	(void)sock;
+#endif				/* PACKET_FANOUT */
+
+	return fanout;
+}
+
+/**
+ * \internal
+ * \brief Bind the next ring to the interface of the current one
+ * \param[in,out] pkt_rx	Pointer to packet rx thread structure
+ * \return 0 on success, else on failure
+ *
+ * The next ring joins the fanout group of the current ring. In a group
+ * created for the switch, the next ring gets all the packets as soon as it
+ * joins, so none is read twice. In another group, it shares the traffic
+ * with the current ring until the current ring socket is closed.
+ */
+
+static int packet_rx_ring_handover(struct packet_rx *pkt_rx)
+{
+	struct packet_mmap *next = &pkt_rx->resize.next;
+	const int fanout = packet_rx_fanout_get(pkt_rx->pkt_mmap.pf_sock);
+	int rc;
+
+	rc = ldab_packet_mmap_index_attach(next, pkt_rx->pkt_mmap.ifindex);
+
+	if (rc)
+		return rc;
+
+#ifdef PACKET_FANOUT
+	if (fanout && setsockopt(next->pf_sock, SOL_PACKET, PACKET_FANOUT,
+				 &fanout, sizeof(fanout)))
+		return errno;
+#else
+	(void)fanout;
+#endif				/* PACKET_FANOUT */
+
+	return 0;
+}
+
+/**
+ * \internal
+ * \brief Switch to the next ring and unmap the current one
+ * \param[in,out] pkt_rx	Pointer to packet rx thread structure
+ * \param[in] index		Index of the next frame to read
+ * \return Index of the next frame to read in the ring read from now on
+ *
+ * The current ring is drained once the next ring took over, then unmapped.
+ * If the next ring cannot take over, it is unmapped and the capture goes on
+ * with its current ring.
+ */
+
+static size_t packet_rx_ring_switch(struct packet_rx *pkt_rx,
+				    const size_t index)
+{
+	struct packet_mmap *pkt_mmap = &pkt_rx->pkt_mmap;
+	struct packet_mmap prev;
+	const uint64_t one = 1;
+	size_t next_index = 0;
+	int rc;
+
+	LDAB_PROBE3(rx_switch, pkt_mmap->pf_sock, pkt_rx->resize.next.pf_sock,
+		    pkt_rx->resize.next.layout.tp_frame_nr);
+
+	rc = packet_rx_ring_handover(pkt_rx);
+
+	if (rc) {
+		prev = pkt_rx->resize.next;
+		next_index = index;
+	} else {
+		packet_rx_ring_drain(pkt_rx, index);
+		packet_rx_stats_update(pkt_rx);
+
+		prev = *pkt_mmap;
+		*pkt_mmap = pkt_rx->resize.next;
+		__atomic_store_n(&pkt_rx->resize.high_water, 0,
+				 __ATOMIC_RELAXED);
+	}
+
+	memset(&pkt_rx->resize.next, 0, sizeof(pkt_rx->resize.next));
+	ldab_packet_mmap_unmap(&prev);
+	pkt_rx->resize.prev = prev;
+	pkt_rx->resize.rc = rc;
+
+	__atomic_store_n(&pkt_rx->resize.state, PACKET_RX_RESIZE_DONE,
+			 __ATOMIC_RELEASE);
+
+	if (pkt_rx->resize.fd > 0
+	    && write(pkt_rx->resize.fd, &one, sizeof(one)) < 0)
+		assert(errno == EAGAIN);
+
+	return next_index;
+}
+
+/**
+ * \internal
+ * \brief Finish a capture which was asked to stop
+ * \param[in,out] pkt_rx	Pointer to packet rx thread structure
+ * \param[in] index		Index of the next frame to read
+ *
+ * The frames left in the ring are written, the PCAP file is flushed to disk
+ * and the final socket statistics are recorded in \c pkt_rx->stats.
+ */
+
+static void packet_rx_stop(struct packet_rx *pkt_rx, const size_t index)
+{
+	packet_rx_ring_drain(pkt_rx, index);
+	packet_rx_stats_update(pkt_rx);
+
+	if (pkt_rx->pcap_fd > 0)
+		fdatasync(pkt_rx->pcap_fd);
+}
+
+/**
+ * \internal
+ * \brief Update the ring occupancy high-water mark
+ * \param[in,out] pkt_rx	Pointer to packet rx thread structure
+ * \param[in] ready		Amount of frames processed without waiting
+ */
+
+static void packet_rx_high_water_update(struct packet_rx *pkt_rx,
+					const uint32_t ready)
+{
+	if (ready > __atomic_load_n(&pkt_rx->resize.high_water,
+				    __ATOMIC_RELAXED))
+		__atomic_store_n(&pkt_rx->resize.high_water, ready,
+				 __ATOMIC_RELAXED);
+}
+
+/**
+ * \internal
+ * \brief Clear the pending error of a packet socket
+ * \param[in] sock	Packet socket
+ *
+ * Errors like \c ENETDOWN, raised when the interface goes down, stay pending
+ * until read and make \c poll(2) return right away.
+ */
+
+static void packet_rx_error_clear(const int sock)
+{
+	int err;
+	socklen_t len = sizeof(err);
+
+	getsockopt(sock, SOL_SOCKET, SO_ERROR, &err, &len);
+}
 
 /**
  * \brief Receive packets coming from a packet mmap RX ring
@@ -22,54 +546,84 @@
  * \return Always return NULL
  *
  * This function will \c poll(2) until some packets are received on the configured
- * interface. For now this function does not much but it can be starting point
- * for PCAP function to dump the frames into a file or for a packet dissectors.
+ * interface. Received frames are handed to packet_rx_frame_process().
+ * While the ring is idle, the thread checks if it must switch to a resized
+ * ring. The amount of frames found ready in a row is recorded as the ring
+ * occupancy high-water mark.
+ * The stop request is checked while the ring is idle and once per ring
+ * turn. The thread then drains its ring and returns, see packet_rx_stop().
+ * \c pkt_rx->stop must be initialized with ldab_packet_stop_init().
+ * The \c rx_batch probe fires with the amount of frames read when the ring
+ * becomes idle, the \c rx_wakeup probe with the return value of \c poll(2).
+ * Pending socket errors are cleared so that a ring bound to a down interface
+ * keeps sleeping in \c poll(2).
  */
 
 void *ldab_packet_rx(void *arg)
 {
 	struct packet_rx *pkt_rx = arg;
 	struct packet_mmap *pkt_mmap = &pkt_rx->pkt_mmap;
-	struct pollfd pfd;
+	struct pollfd pfd[2];
 	size_t index = 0;
+	uint32_t ready = 0;
+	int events;
 
 	if (!arg)
 		return NULL;
 
-	memset(&pfd, 0, sizeof(pfd));
+	memset(pfd, 0, sizeof(pfd));
 
-	pfd.events = POLLIN | POLLRDNORM | POLLERR;
-	pfd.fd = pkt_mmap->pf_sock;
+	pfd[0].events = POLLIN | POLLRDNORM | POLLERR;
+	pfd[0].fd = pkt_mmap->pf_sock;
+	pfd[1].events = POLLIN;
+	pfd[1].fd = pkt_rx->stop.fd;
 
 	for (;;) {
-		for (index = 0; index < pkt_mmap->layout.tp_frame_nr; index++) {
-			struct packet_mmap_header *mmap_hdr =
-			    pkt_mmap->vec[index].iov_base;
+		struct packet_mmap_header *mmap_hdr =
+		    pkt_mmap->vec[index].iov_base;
 
-			if (mmap_hdr->tp_h.tp_status == TP_STATUS_KERNEL) {
-				if (poll(&pfd, 1, -1) < 0)
-					continue;
-			}
+		if ((mmap_hdr->tp_h.tp_status == TP_STATUS_KERNEL || !index)
+		    && packet_stop_is_requested(&pkt_rx->stop))
+			break;
+
+		if (mmap_hdr->tp_h.tp_status == TP_STATUS_KERNEL) {
+			if (ready)
+				LDAB_PROBE2(rx_batch, pkt_mmap->pf_sock, ready);
 
-			if ((mmap_hdr->tp_h.tp_status & TP_STATUS_USER) ==
-			    TP_STATUS_USER) {
-				if (pkt_rx->pcap_fd > 0) {
-					ldab_pcap_write(pkt_rx->pcap_fd,
-						       (uint8_t *) mmap_hdr +
-						       mmap_hdr->tp_h.tp_mac,
-						       mmap_hdr->tp_h.tp_len,
-						       MIN(mmap_hdr->tp_h.
-							   tp_snaplen,
-							   pkt_mmap->layout.
-							   tp_frame_size),
-						       mmap_hdr->tp_h.tp_sec,
-						       mmap_hdr->tp_h.tp_usec);
-				}
-
-				mmap_hdr->tp_h.tp_status = TP_STATUS_KERNEL;
+			packet_rx_high_water_update(pkt_rx, ready);
+			ready = 0;
+
+			if (__atomic_load_n
+			    (&pkt_rx->resize.state,
+			     __ATOMIC_ACQUIRE) == PACKET_RX_RESIZE_PENDING) {
+				index = packet_rx_ring_switch(pkt_rx, index);
+				pfd[0].fd = pkt_mmap->pf_sock;
+				continue;
 			}
+
+			/* Check the same frame again once woken up or after a timeout */
+			events = poll(pfd, ARRAY_SIZE(pfd),
+				      PACKET_RX_POLL_TIMEOUT);
+			LDAB_PROBE2(rx_wakeup, pkt_mmap->pf_sock, events);
+
+			if (events > 0 && pfd[0].revents & POLLERR)
+				packet_rx_error_clear(pkt_mmap->pf_sock);
+			continue;
 		}
+
+		if ((mmap_hdr->tp_h.tp_status & TP_STATUS_USER) ==
+		    TP_STATUS_USER) {
+			packet_rx_frame_process(pkt_rx, mmap_hdr);
+			mmap_hdr->tp_h.tp_status = TP_STATUS_KERNEL;
+
+			if (ready < pkt_mmap->layout.tp_frame_nr)
+				ready++;
+		}
+
+		index = (index + 1) % pkt_mmap->layout.tp_frame_nr;
 	}
 
+	packet_rx_stop(pkt_rx, index);
+
 	return NULL;
 }
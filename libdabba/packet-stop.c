@@ -0,0 +1,64 @@
+/**
+ * \file packet-stop.c
+ * \author written by Emmanuel Roullit emmanuel.roullit@gmail.com (c) 2013
+ * \date 2013
+ */
+
+
+#include <assert.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+#include <libdabba/packet-stop.h>
+
+/**
+ * \brief Initialize a packet thread stop request
+ * \param[out] stop	Stop request to initialize
+ * \return 0 on success, \c errno from \c eventfd(2) on failure
+ */
+
+int ldab_packet_stop_init(struct packet_stop *stop)
+{
+	assert(stop);
+
+	stop->requested = 0;
+	stop->fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+	return stop->fd < 0 ? errno : 0;
+}
+
+/**
+ * \brief Release a packet thread stop request
+ * \param[in,out] stop	Stop request to release
+ */
+
+void ldab_packet_stop_destroy(struct packet_stop *stop)
+{
+	assert(stop);
+
+	if (stop->fd >= 0)
+		close(stop->fd);
+
+	stop->fd = -1;
+}
+
+/**
+ * \brief Ask a packet thread to stop
+ * \param[in,out] stop	Stop request of the thread
+ * \return 0 on success, \c errno from \c write(2) on failure
+ * \note The flag is raised before the wake-up so that a woken up thread
+ * always sees it.
+ */
+
+int ldab_packet_stop_request(struct packet_stop *stop)
+{
+	const uint64_t one = 1;
+
+	assert(stop);
+	assert(stop->fd >= 0);
+
+	__atomic_store_n(&stop->requested, 1, __ATOMIC_RELEASE);
+
+	return write(stop->fd, &one, sizeof(one)) == sizeof(one) ? 0 : errno;
+}
@@ -14,6 +14,7 @@
 
 #include <libdabba/packet-tx.h>
 #include <libdabba/pcap.h>
+#include <libdabba/probe.h>
 
 int ldab_packet_tx_loss_set(const int sock, const int discard)
 {
@@ -26,6 +27,11 @@ int ldab_packet_tx_loss_set(const int sock, const int discard)
  * \brief Transmit packets coming from a packet mmap TX ring
  * \param[in] arg	Pointer to packet tx thread structure
  * \return Always return NULL
+ *
+ * The stop request is checked after each ring turn. The frames already
+ * queued are then sent before the thread returns.
+ * The \c tx_batch probe fires with the amount of frames queued in a ring
+ * turn, the \c tx_rewind probe when the PCAP file is replayed again.
  */
 
 void *ldab_packet_tx(void *arg)
@@ -34,7 +40,7 @@ void *ldab_packet_tx(void *arg)
 	struct packet_mmap *pkt_mmap = &pkt_tx->pkt_mmap;
 	struct packet_mmap_header *mmap_hdr;
 	struct pollfd pfd;
-	size_t a = 0;
+	size_t a = 0, queued;
 	ssize_t obytes;
 	int eof = 0;
 	size_t tplen = TPACKET_ALIGN(sizeof(mmap_hdr->tp_h));
@@ -49,6 +55,8 @@ void *ldab_packet_tx(void *arg)
 
 	for (;;) {
 		do {
+			queued = 0;
+
 			for (a = 0; a < pkt_mmap->layout.tp_frame_nr; a++) {
 				mmap_hdr = pkt_mmap->vec[a].iov_base;
 
@@ -71,15 +79,25 @@ void *ldab_packet_tx(void *arg)
 					mmap_hdr->tp_h.tp_snaplen = obytes;
 					mmap_hdr->tp_h.tp_status =
 					    TP_STATUS_SEND_REQUEST;
+					queued++;
 				}
 			}
 
+			LDAB_PROBE2(tx_batch, pkt_mmap->pf_sock, queued);
 			send(pkt_mmap->pf_sock, NULL, 0, MSG_DONTWAIT);
+
+			if (packet_stop_is_requested(&pkt_tx->stop))
+				goto out;
 		} while (!eof);
 
+		LDAB_PROBE1(tx_rewind, pkt_mmap->pf_sock);
 		ldab_pcap_rewind(pkt_tx->pcap_fd);
 		eof = 0;
 	}
 
+ out:
+	/* Wait until all queued frames are sent */
+	send(pkt_mmap->pf_sock, NULL, 0, 0);
+
 	return NULL;
 }
@@ -20,6 +20,7 @@
 
 #include <libdabba/pcap.h>
 #include <libdabba/macros.h>
+#include <libdabba/probe.h>
 
 /**
  * \internal
@@ -253,6 +254,8 @@ int ldab_pcap_close(const int fd)
  * \param[in] tv_usec Microseconds after Epoch
  * \return	Length of written packet on success,
  * 		-1 if either the packet header or packet payload could not be written
+ * \note The \c pcap_write_entry and \c pcap_write_return probes bracket the
+ * writes to time them.
  */
 
 ssize_t
@@ -274,18 +277,24 @@ ldab_pcap_write(const int fd, const uint8_t * const pkt,
 	sf_hdr.caplen = pkt_snaplen;
 	sf_hdr.len = pkt_len;
 
+	LDAB_PROBE2(pcap_write_entry, fd, sf_hdr.caplen);
+
 	written = write(fd, &sf_hdr, sizeof(sf_hdr));
 
 	if (written != sizeof(sf_hdr)) {
+		LDAB_PROBE2(pcap_write_return, fd, -1);
 		return (-1);
 	}
 
 	written = write(fd, pkt, sf_hdr.caplen);
 
 	if (written != (ssize_t) sf_hdr.caplen) {
+		LDAB_PROBE2(pcap_write_return, fd, -1);
 		return (-1);
 	}
 
+	LDAB_PROBE2(pcap_write_return, fd, written);
+
 	return (written);
 }
 
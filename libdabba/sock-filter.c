@@ -6,9 +6,43 @@
 
 
 #include <inttypes.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
 #include <sys/socket.h>
 #include <libdabba/sock-filter.h>
 
+/**
+ * \internal
+ * \brief Load a big-endian word from a packet
+ * \param[in] pkt	Pointer to the packet
+ * \param[in] k		Offset of the word in the packet
+ * \return the loaded word in host byte order
+ */
+
+static inline uint32_t sock_filter_load_word(const uint8_t * const pkt,
+					     const uint32_t k)
+{
+	return (uint32_t) pkt[k] << 24 | (uint32_t) pkt[k + 1] << 16 |
+	    (uint32_t) pkt[k + 2] << 8 | (uint32_t) pkt[k + 3];
+}
+
+/**
+ * \internal
+ * \brief Load a big-endian half word from a packet
+ * \param[in] pkt	Pointer to the packet
+ * \param[in] k		Offset of the half word in the packet
+ * \return the loaded half word in host byte order
+ */
+
+static inline uint16_t sock_filter_load_half(const uint8_t * const pkt,
+					     const uint32_t k)
+{
+	return (uint16_t) (pkt[k] << 8 | pkt[k + 1]);
+}
+
 /**
  * \brief Checks the input socket filter expression validity
  * \param[in] bpf Pointer to the socket filter to check
@@ -106,22 +140,23 @@ int ldab_sock_filter_is_valid(const struct sock_fprog *const bpf)
 			 * it's unlikely that len, if it truly reflects
 			 * the size of the program we've been handed,
 			 * will be anywhere near the maximum size of
-			 * a u_int.  We also don't check for backward
-			 * branches, as we currently support them in
-			 * userland for the protochain operation.
+			 * a u_int.  Offsets are still compared against
+			 * the remaining length rather than added to
+			 * from, so a wrapping offset cannot turn into a
+			 * backward branch the engines would loop on.
 			 */
 			from = i + 1;
 			switch (BPF_OP(p->code)) {
 			case BPF_JA:
-				if (from + p->k >= bpf->len)
+				if (p->k >= bpf->len - from)
 					return 0;
 				break;
 			case BPF_JEQ:
 			case BPF_JGT:
 			case BPF_JGE:
 			case BPF_JSET:
-				if (from + p->jt >= bpf->len
-				    || from + p->jf >= bpf->len)
+				if (p->jt >= bpf->len - from
+				    || p->jf >= bpf->len - from)
 					return 0;
 				break;
 			default:
@@ -153,6 +188,29 @@ int ldab_sock_filter_attach(const int sock, const struct sock_fprog *const sfp)
 			  sizeof(*sfp));
 }
 
+/**
+ * \brief Tell if the socket filter attached to a socket is locked
+ * \param[in] sock	Socket to check
+ * \return 1 if the socket filter cannot be changed anymore, 0 otherwise
+ * \note A socket filter is locked with the \c SO_LOCK_FILTER socket option.
+ */
+
+int ldab_sock_filter_is_locked(const int sock)
+{
+#ifdef SO_LOCK_FILTER
+	int locked = 0;
+	socklen_t len = sizeof(locked);
+
+	if (getsockopt(sock, SOL_SOCKET, SO_LOCK_FILTER, &locked, &len))
+		return 0;
+
+	return locked != 0;
+#else
+	(void)sock;
+	return 0;
+#endif				/* SO_LOCK_FILTER */
+}
+
 /**
  * \brief Clear socket filters attached to a socket
  * \param[in] sock	Socket to clear
@@ -165,3 +223,660 @@ int ldab_sock_filter_detach(const int sock)
 	return setsockopt(sock, SOL_SOCKET, SO_DETACH_FILTER, &foo,
 			  sizeof(foo));
 }
+
+/**
+ * \internal
+ * \brief Follow a jump in a socket filter
+ * \param[in] pc	Jump instruction
+ * \param[in] end	End of the socket filter
+ * \param[in] off	Jump offset
+ * \return the instruction preceding the jump target, or the last
+ *         instruction if the target is out of the filter so that it stops
+ */
+
+static inline const struct sock_filter *sock_filter_jump(const struct
+							  sock_filter *const pc,
+							  const struct
+							  sock_filter *const end,
+							  const uint32_t off)
+{
+	return off < (size_t)(end - pc) - 1 ? pc + off : end - 1;
+}
+
+/**
+ * \brief Run a socket filter on a packet in userspace
+ * \param[in] sfp	Socket filter to run
+ * \param[in] pkt	Pointer to the packet
+ * \param[in] wirelen	Length of the packet on the wire
+ * \param[in] buflen	Amount of packet bytes available at \c pkt
+ * \return the amount of bytes the filter accepts, 0 if the packet is rejected
+ * \note The socket filter must have been validated with
+ *       \c ldab_sock_filter_is_valid() beforehand.
+ *       Loads outside of the packet reject the packet, like the kernel does.
+ *       Linux ancillary data loads are not supported and reject the packet.
+ *       Jumps out of the filter reject the packet as well.
+ */
+
+uint32_t ldab_sock_filter_run(const struct sock_fprog *const sfp,
+			      const uint8_t * const pkt, const size_t wirelen,
+			      const size_t buflen)
+{
+	const struct sock_filter *pc, *end;
+	uint32_t A = 0, X = 0, k;
+	uint32_t mem[BPF_MEMWORDS] = { 0 };
+
+	assert(sfp);
+	assert(sfp->len);
+	assert(pkt);
+
+	end = sfp->filter + sfp->len;
+
+	for (pc = sfp->filter; pc < end; pc++) {
+		switch (pc->code) {
+		case BPF_RET | BPF_K:
+			return pc->k;
+		case BPF_RET | BPF_A:
+			return A;
+		case BPF_LD | BPF_W | BPF_ABS:
+			k = pc->k;
+			if (k > buflen || sizeof(uint32_t) > buflen - k)
+				return 0;
+			A = sock_filter_load_word(pkt, k);
+			break;
+		case BPF_LD | BPF_H | BPF_ABS:
+			k = pc->k;
+			if (k > buflen || sizeof(uint16_t) > buflen - k)
+				return 0;
+			A = sock_filter_load_half(pkt, k);
+			break;
+		case BPF_LD | BPF_B | BPF_ABS:
+			k = pc->k;
+			if (k >= buflen)
+				return 0;
+			A = pkt[k];
+			break;
+		case BPF_LD | BPF_W | BPF_LEN:
+			A = wirelen;
+			break;
+		case BPF_LDX | BPF_W | BPF_LEN:
+			X = wirelen;
+			break;
+		case BPF_LD | BPF_W | BPF_IND:
+			k = X + pc->k;
+			if (pc->k > buflen || X > buflen - pc->k
+			    || sizeof(uint32_t) > buflen - k)
+				return 0;
+			A = sock_filter_load_word(pkt, k);
+			break;
+		case BPF_LD | BPF_H | BPF_IND:
+			k = X + pc->k;
+			if (pc->k > buflen || X > buflen - pc->k
+			    || sizeof(uint16_t) > buflen - k)
+				return 0;
+			A = sock_filter_load_half(pkt, k);
+			break;
+		case BPF_LD | BPF_B | BPF_IND:
+			k = X + pc->k;
+			if (pc->k >= buflen || X >= buflen - pc->k)
+				return 0;
+			A = pkt[k];
+			break;
+		case BPF_LDX | BPF_MSH | BPF_B:
+			k = pc->k;
+			if (k >= buflen)
+				return 0;
+			X = (pkt[k] & 0xf) << 2;
+			break;
+		case BPF_LD | BPF_IMM:
+			A = pc->k;
+			break;
+		case BPF_LDX | BPF_IMM:
+			X = pc->k;
+			break;
+		case BPF_LD | BPF_MEM:
+			A = mem[pc->k];
+			break;
+		case BPF_LDX | BPF_MEM:
+			X = mem[pc->k];
+			break;
+		case BPF_ST:
+			mem[pc->k] = A;
+			break;
+		case BPF_STX:
+			mem[pc->k] = X;
+			break;
+		case BPF_JMP | BPF_JA:
+			pc = sock_filter_jump(pc, end, pc->k);
+			break;
+		case BPF_JMP | BPF_JGT | BPF_K:
+			pc = sock_filter_jump(pc, end,
+					      (A > pc->k) ? pc->jt : pc->jf);
+			break;
+		case BPF_JMP | BPF_JGE | BPF_K:
+			pc = sock_filter_jump(pc, end,
+					      (A >= pc->k) ? pc->jt : pc->jf);
+			break;
+		case BPF_JMP | BPF_JEQ | BPF_K:
+			pc = sock_filter_jump(pc, end,
+					      (A == pc->k) ? pc->jt : pc->jf);
+			break;
+		case BPF_JMP | BPF_JSET | BPF_K:
+			pc = sock_filter_jump(pc, end,
+					      (A & pc->k) ? pc->jt : pc->jf);
+			break;
+		case BPF_JMP | BPF_JGT | BPF_X:
+			pc = sock_filter_jump(pc, end,
+					      (A > X) ? pc->jt : pc->jf);
+			break;
+		case BPF_JMP | BPF_JGE | BPF_X:
+			pc = sock_filter_jump(pc, end,
+					      (A >= X) ? pc->jt : pc->jf);
+			break;
+		case BPF_JMP | BPF_JEQ | BPF_X:
+			pc = sock_filter_jump(pc, end,
+					      (A == X) ? pc->jt : pc->jf);
+			break;
+		case BPF_JMP | BPF_JSET | BPF_X:
+			pc = sock_filter_jump(pc, end,
+					      (A & X) ? pc->jt : pc->jf);
+			break;
+		case BPF_ALU | BPF_ADD | BPF_X:
+			A += X;
+			break;
+		case BPF_ALU | BPF_SUB | BPF_X:
+			A -= X;
+			break;
+		case BPF_ALU | BPF_MUL | BPF_X:
+			A *= X;
+			break;
+		case BPF_ALU | BPF_DIV | BPF_X:
+			if (X == 0)
+				return 0;
+			A /= X;
+			break;
+		case BPF_ALU | BPF_AND | BPF_X:
+			A &= X;
+			break;
+		case BPF_ALU | BPF_OR | BPF_X:
+			A |= X;
+			break;
+		case BPF_ALU | BPF_LSH | BPF_X:
+			A = X < 32 ? A << X : 0;
+			break;
+		case BPF_ALU | BPF_RSH | BPF_X:
+			A = X < 32 ? A >> X : 0;
+			break;
+		case BPF_ALU | BPF_ADD | BPF_K:
+			A += pc->k;
+			break;
+		case BPF_ALU | BPF_SUB | BPF_K:
+			A -= pc->k;
+			break;
+		case BPF_ALU | BPF_MUL | BPF_K:
+			A *= pc->k;
+			break;
+		case BPF_ALU | BPF_DIV | BPF_K:
+			A /= pc->k;
+			break;
+		case BPF_ALU | BPF_AND | BPF_K:
+			A &= pc->k;
+			break;
+		case BPF_ALU | BPF_OR | BPF_K:
+			A |= pc->k;
+			break;
+		case BPF_ALU | BPF_LSH | BPF_K:
+			A = pc->k < 32 ? A << pc->k : 0;
+			break;
+		case BPF_ALU | BPF_RSH | BPF_K:
+			A = pc->k < 32 ? A >> pc->k : 0;
+			break;
+		case BPF_ALU | BPF_NEG:
+			A = -A;
+			break;
+		case BPF_MISC | BPF_TAX:
+			X = A;
+			break;
+		case BPF_MISC | BPF_TXA:
+			A = X;
+			break;
+		default:
+			return 0;
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * \internal
+ * \brief Register content known at a given instruction
+ */
+
+struct sock_filter_reg {
+	uint16_t code; /**< Load instruction which set the register */
+	uint32_t k; /**< Load instruction operand */
+	uint8_t known; /**< 1 if the register content is known */
+	uint8_t seen; /**< 1 once at least one predecessor was merged */
+};
+
+/**
+ * \internal
+ * \brief Register state at the entry of an instruction
+ */
+
+struct sock_filter_state {
+	struct sock_filter_reg A; /**< Accumulator */
+	struct sock_filter_reg X; /**< Index register */
+	uint8_t reachable; /**< 1 if the instruction can be executed */
+};
+
+/**
+ * \internal
+ * \brief Tell if an instruction is an unconditional jump
+ * \param[in] sf	Instruction to check
+ * \return 1 if the instruction is \c BPF_JA, 0 otherwise
+ */
+
+static inline int sock_filter_is_ja(const struct sock_filter *const sf)
+{
+	return sf->code == (BPF_JMP | BPF_JA);
+}
+
+/**
+ * \internal
+ * \brief Tell if an instruction is a conditional jump
+ * \param[in] sf	Instruction to check
+ * \return 1 if the instruction is a conditional jump, 0 otherwise
+ */
+
+static inline int sock_filter_is_jcond(const struct sock_filter *const sf)
+{
+	return BPF_CLASS(sf->code) == BPF_JMP && !sock_filter_is_ja(sf);
+}
+
+/**
+ * \internal
+ * \brief Follow a chain of unconditional jumps
+ * \param[in] sfp	Socket filter program
+ * \param[in] pc	Index of the first instruction of the chain
+ * \return the index of the first instruction which is not a \c BPF_JA
+ */
+
+static uint32_t sock_filter_jump_follow(const struct sock_fprog *const sfp,
+					uint32_t pc)
+{
+	uint32_t hops;
+
+	/* Jumps only go forward, the chain cannot be longer than the program */
+	for (hops = 0; hops < sfp->len && sock_filter_is_ja(&sfp->filter[pc]);
+	     hops++)
+		pc += 1 + sfp->filter[pc].k;
+
+	return pc;
+}
+
+/**
+ * \internal
+ * \brief Thread jumps to their final destination
+ * \param[in,out] sfp	Socket filter program to optimize
+ * \return the amount of modified instructions
+ *
+ * Jumps landing on an unconditional jump are redirected to its destination,
+ * unconditional jumps to a return instruction are replaced by the return itself
+ * and conditional jumps whose branches meet become unconditional.
+ */
+
+static size_t sock_filter_jump_thread(struct sock_fprog *const sfp)
+{
+	struct sock_filter *sf;
+	uint32_t i, jt, jf;
+	size_t changed = 0;
+
+	for (i = 0; i < sfp->len; i++) {
+		sf = &sfp->filter[i];
+
+		if (sock_filter_is_ja(sf)) {
+			jt = sock_filter_jump_follow(sfp, i + 1 + sf->k);
+
+			if (BPF_CLASS(sfp->filter[jt].code) == BPF_RET) {
+				*sf = sfp->filter[jt];
+				changed++;
+			} else if (jt != i + 1 + sf->k) {
+				sf->k = jt - i - 1;
+				changed++;
+			}
+		} else if (sock_filter_is_jcond(sf)) {
+			jt = sock_filter_jump_follow(sfp, i + 1 + sf->jt);
+			jf = sock_filter_jump_follow(sfp, i + 1 + sf->jf);
+
+			/* Conditional jump offsets are only 8 bits wide */
+			if (jt - i - 1 <= UINT8_MAX && jt != i + 1 + sf->jt) {
+				sf->jt = jt - i - 1;
+				changed++;
+			}
+
+			if (jf - i - 1 <= UINT8_MAX && jf != i + 1 + sf->jf) {
+				sf->jf = jf - i - 1;
+				changed++;
+			}
+
+			if (sf->jt == sf->jf) {
+				sf->code = BPF_JMP | BPF_JA;
+				sf->k = sf->jt;
+				sf->jt = sf->jf = 0;
+				changed++;
+			}
+		}
+	}
+
+	return changed;
+}
+
+/**
+ * \internal
+ * \brief Describe the value a load instruction puts in a register
+ * \param[in] sf	Load instruction
+ * \param[out] reg	Register content description
+ *
+ * Only loads whose result only depends on the instruction itself are
+ * described, i.e. immediate, absolute packet, packet length and memory loads.
+ * Absolute loads from \c SKF_AD_OFF on are kernel ancillary data: they may
+ * depend on the registers or change on every load, e.g. \c SKF_AD_ALU_XOR_X
+ * or \c SKF_AD_RANDOM, so they are never described.
+ */
+
+static void sock_filter_reg_load(const struct sock_filter *const sf,
+				 struct sock_filter_reg *const reg)
+{
+	switch (BPF_MODE(sf->code)) {
+	case BPF_ABS:
+		if (sf->k >= (uint32_t) SKF_AD_OFF) {
+			reg->known = 0;
+			break;
+		}
+		/* fall through */
+	case BPF_IMM:
+	case BPF_LEN:
+	case BPF_MEM:
+	case BPF_MSH:
+		reg->code = sf->code;
+		reg->k = sf->k;
+		reg->known = 1;
+		break;
+	default:
+		reg->known = 0;
+		break;
+	}
+}
+
+/**
+ * \internal
+ * \brief Merge the register state of a predecessor into an instruction state
+ * \param[in,out] to	Register state to merge into
+ * \param[in] from	Register state of the predecessor
+ */
+
+static void sock_filter_reg_merge(struct sock_filter_reg *const to,
+				  const struct sock_filter_reg *const from)
+{
+	if (!to->seen) {
+		*to = *from;
+		to->seen = 1;
+	} else if (to->known
+		   && (!from->known || to->code != from->code
+		       || to->k != from->k))
+		to->known = 0;
+}
+
+/**
+ * \internal
+ * \brief Propagate the register state of an instruction to one of its successors
+ * \param[in,out] state	Register states of the whole program
+ * \param[in] to	Index of the successor
+ * \param[in] A		Accumulator state after the instruction
+ * \param[in] X		Index register state after the instruction
+ */
+
+static void sock_filter_state_propagate(struct sock_filter_state *const state,
+					const uint32_t to,
+					const struct sock_filter_reg *const A,
+					const struct sock_filter_reg *const X)
+{
+	sock_filter_reg_merge(&state[to].A, A);
+	sock_filter_reg_merge(&state[to].X, X);
+	state[to].reachable = 1;
+}
+
+/**
+ * \internal
+ * \brief Tell if a load instruction reloads the value a register already has
+ * \param[in] sf	Load instruction
+ * \param[in] reg	Register state before the instruction
+ * \return 1 if the load is redundant, 0 otherwise
+ */
+
+static inline int sock_filter_load_is_redundant(const struct sock_filter *const
+						sf,
+						const struct sock_filter_reg
+						*const reg)
+{
+	return reg->known && reg->code == sf->code && reg->k == sf->k;
+}
+
+/**
+ * \internal
+ * \brief Find unreachable instructions and redundant loads
+ * \param[in,out] sfp	Socket filter program to optimize
+ * \param[out] state	Register states of the whole program
+ * \return the amount of redundant loads turned into no-ops
+ *
+ * As classic BPF jumps only go forward, a single pass in program order sees
+ * every predecessor of an instruction before the instruction itself.
+ * Redundant loads are replaced by a \c BPF_JA with a zero offset.
+ */
+
+static size_t sock_filter_flow_analyze(struct sock_fprog *const sfp,
+				       struct sock_filter_state *const state)
+{
+	struct sock_filter *sf;
+	struct sock_filter_reg A, X;
+	uint32_t i;
+	size_t changed = 0;
+
+	memset(state, 0, sfp->len * sizeof(*state));
+
+	/* Registers are zeroed before the program runs */
+	state[0].reachable = 1;
+	state[0].A.seen = state[0].X.seen = 1;
+	state[0].A.known = state[0].X.known = 1;
+	state[0].A.code = BPF_LD | BPF_IMM;
+	state[0].X.code = BPF_LDX | BPF_IMM;
+
+	for (i = 0; i < sfp->len; i++) {
+		if (!state[i].reachable)
+			continue;
+
+		sf = &sfp->filter[i];
+		A = state[i].A;
+		X = state[i].X;
+
+		switch (BPF_CLASS(sf->code)) {
+		case BPF_LD:
+			if (sock_filter_load_is_redundant(sf, &A)) {
+				sf->code = BPF_JMP | BPF_JA;
+				sf->jt = sf->jf = sf->k = 0;
+				changed++;
+			} else
+				sock_filter_reg_load(sf, &A);
+			break;
+		case BPF_LDX:
+			if (sock_filter_load_is_redundant(sf, &X)) {
+				sf->code = BPF_JMP | BPF_JA;
+				sf->jt = sf->jf = sf->k = 0;
+				changed++;
+			} else
+				sock_filter_reg_load(sf, &X);
+			break;
+		case BPF_ST:
+			/* A still holds the value of its load, but M[k] changed */
+			if (X.known && BPF_MODE(X.code) == BPF_MEM && X.k == sf->k)
+				X.known = 0;
+			break;
+		case BPF_STX:
+			if (A.known && BPF_MODE(A.code) == BPF_MEM && A.k == sf->k)
+				A.known = 0;
+			break;
+		case BPF_ALU:
+			A.known = 0;
+			break;
+		case BPF_MISC:
+			if (BPF_MISCOP(sf->code) == BPF_TAX)
+				X.known = 0;
+			else
+				A.known = 0;
+			break;
+		case BPF_JMP:
+			if (sock_filter_is_ja(sf)) {
+				sock_filter_state_propagate(state, i + 1 + sf->k,
+							    &A, &X);
+			} else {
+				sock_filter_state_propagate(state,
+							    i + 1 + sf->jt,
+							    &A, &X);
+				sock_filter_state_propagate(state,
+							    i + 1 + sf->jf,
+							    &A, &X);
+			}
+			continue;
+		case BPF_RET:
+			continue;
+		}
+
+		sock_filter_state_propagate(state, i + 1, &A, &X);
+	}
+
+	return changed;
+}
+
+/**
+ * \internal
+ * \brief Remove unreachable instructions and no-op jumps
+ * \param[in,out] sfp	Socket filter program to optimize
+ * \param[in] state	Register states computed by the flow analysis
+ * \param[out] pos	Scratch array of \c sfp->len + 1 elements
+ * \return the amount of removed instructions
+ */
+
+static size_t sock_filter_dead_code_remove(struct sock_fprog *const sfp,
+					   const struct sock_filter_state
+					   *const state, uint32_t * const pos)
+{
+	struct sock_filter *sf;
+	uint32_t i, kept = 0;
+
+	/* pos[i] is the new index of the first kept instruction from i */
+	for (i = 0; i < sfp->len; i++) {
+		pos[i] = kept;
+
+		if (state[i].reachable
+		    && !(sock_filter_is_ja(&sfp->filter[i])
+			 && sfp->filter[i].k == 0))
+			kept++;
+	}
+
+	pos[sfp->len] = kept;
+
+	if (kept == sfp->len)
+		return 0;
+
+	for (i = 0; i < sfp->len; i++) {
+		if (pos[i] == pos[i + 1])
+			continue;
+
+		sf = &sfp->filter[i];
+
+		if (sock_filter_is_ja(sf))
+			sf->k = pos[i + 1 + sf->k] - pos[i] - 1;
+		else if (sock_filter_is_jcond(sf)) {
+			sf->jt = pos[i + 1 + sf->jt] - pos[i] - 1;
+			sf->jf = pos[i + 1 + sf->jf] - pos[i] - 1;
+		}
+
+		sfp->filter[pos[i]] = *sf;
+	}
+
+	i = sfp->len - kept;
+	sfp->len = kept;
+
+	return i;
+}
+
+/**
+ * \internal
+ * \brief Tell if a socket filter program only jumps forward
+ * \param[in] sfp	Socket filter program to check
+ * \return 1 if all jumps go forward, 0 otherwise
+ */
+
+static int sock_filter_is_forward_only(const struct sock_fprog *const sfp)
+{
+	uint32_t i;
+
+	for (i = 0; i < sfp->len; i++)
+		if (sock_filter_is_ja(&sfp->filter[i])
+		    && sfp->filter[i].k >= sfp->len - i - 1)
+			return 0;
+
+	return 1;
+}
+
+/**
+ * \brief Optimize a socket filter program
+ * \param[in,out] sfp	Socket filter program to optimize
+ * \return 0 on success, \c EINVAL if the program is invalid,
+ *         \c ENOMEM if the system is out-of-memory
+ *
+ * The following passes run until the program does not change anymore:
+ *      - Jump threading
+ *      - Redundant register load removal
+ *      - Dead code elimination
+ *
+ * The optimized program returns the same result for every packet and is
+ * never longer than the original one. Its instructions are rewritten in place.
+ * Programs which could jump backwards are left untouched.
+ */
+
+int ldab_sock_filter_optimize(struct sock_fprog *const sfp)
+{
+	struct sock_filter_state *state;
+	uint32_t *pos;
+	size_t changed;
+
+	if (!ldab_sock_filter_is_valid(sfp))
+		return EINVAL;
+
+	if (!sock_filter_is_forward_only(sfp))
+		return 0;
+
+	state = calloc(sfp->len, sizeof(*state));
+	pos = calloc(sfp->len + 1, sizeof(*pos));
+
+	if (!state || !pos) {
+		free(state);
+		free(pos);
+		return ENOMEM;
+	}
+
+	do {
+		changed = sock_filter_jump_thread(sfp);
+		changed += sock_filter_flow_analyze(sfp, state);
+		changed += sock_filter_dead_code_remove(sfp, state, pos);
+	} while (changed);
+
+	free(state);
+	free(pos);
+
+	assert(ldab_sock_filter_is_valid(sfp));
+
+	return 0;
+}
@@ -0,0 +1,122 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+
+#include <libdabba/macros.h>
+#include <libdabba/sock-filter.h>
+#include <libdabba/bpf-engine.h>
+
+#define PKT_NR 1024
+#define PKT_LEN 128
+#define ROUND_NR 2000
+
+/* tcp port 80 and ip host 127.0.0.1 */
+static struct sock_filter tcp_http[] = {
+	{0x28, 0, 0, 0x0000000c},
+	{0x15, 0, 14, 0x00000800},
+	{0x30, 0, 0, 0x00000017},
+	{0x15, 0, 12, 0x00000006},
+	{0x28, 0, 0, 0x00000014},
+	{0x45, 10, 0, 0x00001fff},
+	{0xb1, 0, 0, 0x0000000e},
+	{0x48, 0, 0, 0x0000000e},
+	{0x15, 2, 0, 0x00000050},
+	{0x48, 0, 0, 0x00000010},
+	{0x15, 0, 6, 0x00000050},
+	{0x20, 0, 0, 0x0000001a},
+	{0x15, 2, 0, 0x7f000001},
+	{0x20, 0, 0, 0x0000001e},
+	{0x15, 0, 2, 0x7f000001},
+	{0x6, 0, 0, 0x0000ffff},
+	{0x6, 0, 0, 0x00000000},
+	{0x6, 0, 0, 0x00000000},
+};
+
+static double bench_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+int main(void)
+{
+	static uint8_t data[PKT_NR][PKT_LEN];
+	struct bpf_engine_pkt pkt[PKT_NR];
+	struct sock_fprog sfp;
+	struct bpf_engine engine;
+	double start, naive, fast, batch;
+	size_t a, i, naive_nr = 0, fast_nr = 0, batch_nr = 0;
+
+	srand(0);
+
+	for (a = 0; a < PKT_NR; a++) {
+		for (i = 0; i < PKT_LEN; i++)
+			data[a][i] = rand();
+
+		data[a][12] = 0x08;
+		data[a][13] = 0x00;
+		data[a][14] = 0x45;
+		data[a][20] = data[a][21] = 0;
+		data[a][23] = 0x06;
+		memcpy(&data[a][26], "\x7f\x00\x00\x01", 4);
+
+		if (a % 4 == 0)
+			memcpy(&data[a][36], "\x00\x50", 2);
+
+		pkt[a].data = data[a];
+		pkt[a].wirelen = pkt[a].buflen = PKT_LEN;
+	}
+
+	sfp.filter = tcp_http;
+	sfp.len = ARRAY_SIZE(tcp_http);
+
+	assert(ldab_bpf_engine_create(&engine, &sfp) == 0);
+
+	start = bench_now();
+
+	for (i = 0; i < ROUND_NR; i++)
+		for (a = 0; a < PKT_NR; a++)
+			naive_nr += ldab_sock_filter_run(&sfp, pkt[a].data,
+							 pkt[a].wirelen,
+							 pkt[a].buflen) != 0;
+
+	naive = bench_now() - start;
+	start = bench_now();
+
+	for (i = 0; i < ROUND_NR; i++)
+		for (a = 0; a < PKT_NR; a++)
+			fast_nr += ldab_bpf_engine_run(&engine, pkt[a].data,
+						       pkt[a].wirelen,
+						       pkt[a].buflen) != 0;
+
+	fast = bench_now() - start;
+	start = bench_now();
+
+	for (i = 0; i < ROUND_NR; i++)
+		batch_nr += ldab_bpf_engine_run_batch(&engine, pkt, PKT_NR,
+						      NULL);
+
+	batch = bench_now() - start;
+
+	assert(naive_nr == fast_nr);
+	assert(naive_nr == batch_nr);
+
+	printf("---\n");
+	printf("  packets: %zu\n", (size_t)PKT_NR * ROUND_NR);
+	printf("  accepted: %zu\n", naive_nr);
+	printf("  switch interpreter ns/packet: %.2f\n",
+	       naive / (PKT_NR * ROUND_NR));
+	printf("  bpf engine ns/packet: %.2f\n", fast / (PKT_NR * ROUND_NR));
+	printf("  bpf engine batch ns/packet: %.2f\n",
+	       batch / (PKT_NR * ROUND_NR));
+
+	ldab_bpf_engine_destroy(&engine);
+
+	return (EXIT_SUCCESS);
+}
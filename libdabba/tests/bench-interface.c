@@ -0,0 +1,141 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <assert.h>
+#include <dirent.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <sys/ioctl.h>
+#include <net/if.h>
+#include <linux/sockios.h>
+
+#include <libdabba/macros.h>
+#include <libdabba/interface.h>
+
+#define DEV_MAX 16384
+#define ROUND_NR 10
+
+/* Legacy ethtool commands a full interface query used to issue */
+static const int legacy_cmds[] = {
+	ETHTOOL_GDRVINFO, ETHTOOL_GSET, ETHTOOL_GPAUSEPARAM, ETHTOOL_GCOALESCE,
+	ETHTOOL_GRXCSUM, ETHTOOL_GTXCSUM, ETHTOOL_GSG, ETHTOOL_GTSO,
+	ETHTOOL_GUFO, ETHTOOL_GGSO, ETHTOOL_GGRO, ETHTOOL_GFLAGS, ETHTOOL_GFLAGS
+};
+
+static double bench_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/* Query an interface with one socket per ethtool request */
+static void bench_legacy_query(const char *const dev)
+{
+	union {
+		struct ethtool_drvinfo driver;
+		struct ethtool_cmd settings;
+		struct ethtool_pauseparam pause;
+		struct ethtool_coalesce coalesce;
+		struct ethtool_value value;
+	} data;
+	struct ifreq ifr;
+	size_t a;
+	int sock;
+
+	for (a = 0; a < ARRAY_SIZE(legacy_cmds); a++) {
+		memset(&data, 0, sizeof(data));
+		memset(&ifr, 0, sizeof(ifr));
+		strncpy(ifr.ifr_name, dev, sizeof(ifr.ifr_name) - 1);
+		data.value.cmd = legacy_cmds[a];
+		ifr.ifr_data = (caddr_t) & data;
+
+		sock = socket(AF_INET, SOCK_DGRAM, 0);
+		assert(sock >= 0);
+		ioctl(sock, SIOCETHTOOL, &ifr);
+		close(sock);
+	}
+}
+
+/* Query an interface through the control socket of the thread */
+static void bench_query(const char *const dev)
+{
+	struct ethtool_drvinfo driver;
+	struct ethtool_cmd settings;
+	struct ethtool_pauseparam pause;
+	struct ethtool_coalesce coalesce;
+	struct dev_offload offload;
+
+	ldab_dev_driver_get(dev, &driver);
+	ldab_dev_settings_get(dev, &settings);
+	ldab_dev_pause_get(dev, &pause);
+	ldab_dev_coalesce_get(dev, &coalesce);
+	ldab_dev_offload_get(dev, &offload);
+}
+
+/* List the interfaces of the host, or use the ones given on command line */
+static size_t bench_dev_list(int argc, char **argv, const char **dev)
+{
+	struct dirent *entry;
+	DIR *dir;
+	size_t nr = 0;
+
+	for (; nr < (size_t)argc - 1 && nr < DEV_MAX; nr++)
+		dev[nr] = argv[nr + 1];
+
+	if (nr)
+		return nr;
+
+	dir = opendir("/sys/class/net");
+	assert(dir);
+
+	while ((entry = readdir(dir)) && nr < DEV_MAX) {
+		if (entry->d_name[0] == '.')
+			continue;
+
+		dev[nr] = strdup(entry->d_name);
+		assert(dev[nr]);
+		nr++;
+	}
+
+	closedir(dir);
+
+	return nr;
+}
+
+int main(int argc, char **argv)
+{
+	static const char *dev[DEV_MAX];
+	double start, legacy, shared;
+	size_t a, i, nr;
+
+	nr = bench_dev_list(argc, argv, dev);
+	assert(nr);
+
+	start = bench_now();
+
+	for (i = 0; i < ROUND_NR; i++)
+		for (a = 0; a < nr; a++)
+			bench_legacy_query(dev[a]);
+
+	legacy = bench_now() - start;
+	start = bench_now();
+
+	for (i = 0; i < ROUND_NR; i++)
+		for (a = 0; a < nr; a++)
+			bench_query(dev[a]);
+
+	shared = bench_now() - start;
+
+	printf("---\n");
+	printf("  interfaces: %zu\n", nr);
+	printf("  socket per request us/interface: %.2f\n",
+	       legacy / (nr * ROUND_NR * 1e3));
+	printf("  thread socket us/interface: %.2f\n",
+	       shared / (nr * ROUND_NR * 1e3));
+
+	return (EXIT_SUCCESS);
+}
@@ -0,0 +1,145 @@
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <errno.h>
+
+#include <libdabba/macros.h>
+#include <libdabba/sock-filter.h>
+#include <libdabba/bpf-engine.h>
+
+#define PKT_NR 256
+#define PKT_LEN 64
+
+/* ip and icmp and host 127.0.0.1 */
+static struct sock_filter localhost_icmp[] = {
+	{0x28, 0, 0, 0x0000000c},
+	{0x15, 0, 7, 0x00000800},
+	{0x30, 0, 0, 0x00000017},
+	{0x15, 0, 5, 0x00000001},
+	{0x20, 0, 0, 0x0000001a},
+	{0x15, 2, 0, 0x7f000001},
+	{0x20, 0, 0, 0x0000001e},
+	{0x15, 0, 1, 0x7f000001},
+	{0x6, 0, 0, 0x0000ffff},
+	{0x6, 0, 0, 0x00000000},
+};
+
+/* Exercise indirect loads, scratch memory, ALU and X register jumps */
+static struct sock_filter alu_mix[] = {
+	{BPF_LDX | BPF_MSH | BPF_B, 0, 0, 14},
+	{BPF_LD | BPF_H | BPF_IND, 0, 0, 14},
+	{BPF_ST, 0, 0, 0},
+	{BPF_ALU | BPF_AND | BPF_K, 0, 0, 0xff0f},
+	{BPF_ALU | BPF_OR | BPF_X, 0, 0, 0},
+	{BPF_ALU | BPF_LSH | BPF_K, 0, 0, 3},
+	{BPF_ALU | BPF_RSH | BPF_K, 0, 0, 40},
+	{BPF_ALU | BPF_ADD | BPF_K, 0, 0, 7},
+	{BPF_ALU | BPF_MUL | BPF_X, 0, 0, 0},
+	{BPF_ALU | BPF_SUB | BPF_K, 0, 0, 1},
+	{BPF_ALU | BPF_NEG, 0, 0, 0},
+	{BPF_MISC | BPF_TAX, 0, 0, 0},
+	{BPF_LD | BPF_MEM, 0, 0, 0},
+	{BPF_ALU | BPF_DIV | BPF_X, 0, 0, 0},
+	{BPF_JMP | BPF_JGT | BPF_X, 1, 0, 0},
+	{BPF_LD | BPF_W | BPF_LEN, 0, 0, 0},
+	{BPF_JMP | BPF_JSET | BPF_K, 0, 2, 0x10},
+	{BPF_LD | BPF_B | BPF_ABS, 0, 0, 0},
+	{BPF_JMP | BPF_JA, 0, 0, 1},
+	{BPF_LD | BPF_W | BPF_ABS, 0, 0, 0xfffff000},
+	{BPF_RET | BPF_A, 0, 0, 0},
+};
+
+static void test_bpf_engine_equivalence(struct sock_filter *filter,
+					const size_t len,
+					const struct bpf_engine_pkt *pkt)
+{
+	struct sock_fprog sfp = {.len = len,.filter = filter };
+	struct bpf_engine engine;
+	uint32_t res[PKT_NR];
+	size_t a, accepted = 0;
+
+	assert(ldab_bpf_engine_create(&engine, &sfp) == 0);
+	assert(bpf_engine_is_loaded(&engine));
+
+	for (a = 0; a < PKT_NR; a++) {
+		res[a] = ldab_sock_filter_run(&sfp, pkt[a].data, pkt[a].wirelen,
+					      pkt[a].buflen);
+		assert(ldab_bpf_engine_run(&engine, pkt[a].data,
+					   pkt[a].wirelen,
+					   pkt[a].buflen) == res[a]);
+		accepted += res[a] != 0;
+	}
+
+	memset(res, 0, sizeof(res));
+
+	assert(ldab_bpf_engine_run_batch(&engine, pkt, PKT_NR, res) ==
+	       accepted);
+
+	for (a = 0; a < PKT_NR; a++)
+		assert(res[a] == ldab_sock_filter_run(&sfp, pkt[a].data,
+						      pkt[a].wirelen,
+						      pkt[a].buflen));
+
+	ldab_bpf_engine_destroy(&engine);
+	assert(!bpf_engine_is_loaded(&engine));
+}
+
+int main(void)
+{
+	static uint8_t data[PKT_NR][PKT_LEN];
+	struct bpf_engine_pkt pkt[PKT_NR];
+	struct bpf_engine engine;
+	struct sock_fprog sfp;
+	struct sock_filter invalid[] = {
+		{BPF_MISC | 0x50, 0, 0, 0},
+		{BPF_RET | BPF_K, 0, 0, 0},
+	};
+	/* The jump offset wraps around to the first instruction */
+	struct sock_filter backward[] = {
+		{BPF_LD | BPF_IMM, 0, 0, 1},
+		{BPF_JMP | BPF_JA, 0, 0, 0xfffffffe},
+		{BPF_RET | BPF_K, 0, 0, 0xffff},
+	};
+	size_t a, i;
+
+	srand(0);
+
+	for (a = 0; a < PKT_NR; a++) {
+		for (i = 0; i < PKT_LEN; i++)
+			data[a][i] = rand();
+
+		/* Make a fair share of the packets localhost ICMP packets */
+		if (a % 2) {
+			data[a][12] = 0x08;
+			data[a][13] = 0x00;
+			data[a][14] = 0x45;
+			data[a][23] = 0x01;
+			memcpy(&data[a][26], "\x7f\x00\x00\x01", 4);
+		}
+
+		pkt[a].data = data[a];
+		pkt[a].wirelen = PKT_LEN + a;
+		pkt[a].buflen = a % 8 ? PKT_LEN : a % PKT_LEN;
+	}
+
+	test_bpf_engine_equivalence(localhost_icmp, ARRAY_SIZE(localhost_icmp),
+				    pkt);
+	test_bpf_engine_equivalence(alu_mix, ARRAY_SIZE(alu_mix), pkt);
+
+	/* Unsupported opcodes are refused */
+	sfp.filter = invalid;
+	sfp.len = ARRAY_SIZE(invalid);
+	assert(ldab_bpf_engine_create(&engine, &sfp) == EINVAL);
+
+	sfp.len = 0;
+	assert(ldab_bpf_engine_create(&engine, &sfp) == EINVAL);
+
+	/* Jumps must land strictly forward inside the program */
+	sfp.filter = backward;
+	sfp.len = ARRAY_SIZE(backward);
+	assert(!ldab_sock_filter_is_valid(&sfp));
+	assert(ldab_bpf_engine_create(&engine, &sfp) == EINVAL);
+
+	return (EXIT_SUCCESS);
+}
@@ -0,0 +1,76 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <assert.h>
+
+#include <libdabba/histogram.h>
+
+/* An empty histogram has no percentile */
+void test_histogram_empty(void)
+{
+	struct histogram hist;
+
+	memset(&hist, 0, sizeof(hist));
+
+	assert(ldab_histogram_count(&hist) == 0);
+	assert(ldab_histogram_percentile(&hist, 50) == 0);
+	assert(ldab_histogram_percentile(&hist, 100) == 0);
+}
+
+/* Small values are exact, larger ones are known within 12.5% */
+void test_histogram_precision(void)
+{
+	struct histogram hist;
+	uint64_t value, max;
+
+	for (value = 0; value < 8; value++) {
+		memset(&hist, 0, sizeof(hist));
+		ldab_histogram_record(&hist, value);
+		assert(ldab_histogram_percentile(&hist, 50) == value);
+	}
+
+	for (value = 8; value < UINT32_MAX; value = value * 3 + 1) {
+		memset(&hist, 0, sizeof(hist));
+		ldab_histogram_record(&hist, value);
+		max = ldab_histogram_percentile(&hist, 50);
+		assert(max >= value);
+		assert(max - value <= value / 8);
+	}
+
+	/* Values out of range land in the last bucket */
+	memset(&hist, 0, sizeof(hist));
+	ldab_histogram_record(&hist, UINT64_MAX);
+	assert(ldab_histogram_percentile(&hist, 50) == UINT32_MAX);
+}
+
+/* Percentiles of 1 to 1000 */
+void test_histogram_percentile(void)
+{
+	struct histogram hist, snapshot;
+	uint64_t value;
+
+	memset(&hist, 0, sizeof(hist));
+
+	for (value = 1; value <= 1000; value++)
+		ldab_histogram_record(&hist, value);
+
+	ldab_histogram_get(&hist, &snapshot);
+
+	assert(ldab_histogram_count(&snapshot) == 1000);
+	assert(ldab_histogram_percentile(&snapshot, 0) == 1);
+	assert(ldab_histogram_percentile(&snapshot, 50) >= 500);
+	assert(ldab_histogram_percentile(&snapshot, 50) <= 500 + 500 / 8);
+	assert(ldab_histogram_percentile(&snapshot, 99) >= 990);
+	assert(ldab_histogram_percentile(&snapshot, 99) <= 990 + 990 / 8);
+	assert(ldab_histogram_percentile(&snapshot, 100) >= 1000);
+	assert(ldab_histogram_percentile(&snapshot, 100) <= 1000 + 1000 / 8);
+}
+
+int main(void)
+{
+	test_histogram_empty();
+	test_histogram_precision();
+	test_histogram_percentile();
+
+	return EXIT_SUCCESS;
+}
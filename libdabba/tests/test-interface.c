@@ -0,0 +1,101 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <assert.h>
+#include <dirent.h>
+#include <pthread.h>
+
+#include <libdabba/interface.h>
+
+#define TEST_DEV "lo"
+
+/* Count the file descriptors opened by the process */
+size_t test_fd_count(void)
+{
+	DIR *dir = opendir("/proc/self/fd");
+	size_t nr = 0;
+
+	assert(dir);
+
+	while (readdir(dir))
+		nr++;
+
+	closedir(dir);
+
+	return nr;
+}
+
+/* The features request must report what the legacy requests report */
+void test_offload_get(void)
+{
+	struct dev_offload offload;
+	int value;
+
+	assert(ldab_dev_offload_get(TEST_DEV, &offload) == 0);
+
+	if (ldab_dev_rx_csum_offload_get(TEST_DEV, &value) == 0)
+		assert(offload.rx_csum == !!value);
+
+	if (ldab_dev_tx_csum_offload_get(TEST_DEV, &value) == 0)
+		assert(offload.tx_csum == !!value);
+
+	if (ldab_dev_scatter_gather_get(TEST_DEV, &value) == 0)
+		assert(offload.sg == !!value);
+
+	if (ldab_dev_tcp_seg_offload_get(TEST_DEV, &value) == 0)
+		assert(offload.tso == !!value);
+
+	if (ldab_dev_generic_seg_offload_get(TEST_DEV, &value) == 0)
+		assert(offload.gso == !!value);
+
+	if (ldab_dev_generic_rcv_offload_get(TEST_DEV, &value) == 0)
+		assert(offload.gro == !!value);
+
+	assert(ldab_dev_offload_get("dabbanosuchdev", &offload) == ENODEV);
+}
+
+/* Run interface requests from a short-lived thread */
+void *test_thread(void *arg)
+{
+	int *flags = arg;
+	short f;
+
+	assert(ldab_dev_flags_get(TEST_DEV, &f) == 0);
+	*flags = f;
+
+	return NULL;
+}
+
+/* Requests reuse the control socket of their thread, closed when it exits */
+void test_ctl_sock(void)
+{
+	pthread_t thread;
+	size_t nr;
+	short flags;
+	int a, thread_flags = 0;
+
+	assert(ldab_dev_flags_get(TEST_DEV, &flags) == 0);
+
+	nr = test_fd_count();
+
+	for (a = 0; a < 16; a++)
+		assert(ldab_dev_flags_get(TEST_DEV, &flags) == 0);
+
+	assert(test_fd_count() == nr);
+
+	assert(pthread_create(&thread, NULL, test_thread, &thread_flags) == 0);
+	assert(pthread_join(thread, NULL) == 0);
+
+	assert(thread_flags == flags);
+	assert(test_fd_count() == nr);
+}
+
+int main(void)
+{
+	test_ctl_sock();
+	test_offload_get();
+
+	return EXIT_SUCCESS;
+}
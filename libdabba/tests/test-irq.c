@@ -0,0 +1,122 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif				/* _GNU_SOURCE */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <assert.h>
+#include <limits.h>
+#include <sys/stat.h>
+
+#include <libdabba/irq.h>
+
+static char root[] = "irq-fixture-XXXXXX";
+
+static const char interrupts[] =
+    "           CPU0       CPU1       CPU2       CPU3\n"
+    "  0:         36          0          0          0   IO-APIC   2-edge      timer\n"
+    " 40:          0          0        100          0   PCI-MSI 524288-edge      eth0\n"
+    " 41:       1234          0          0          0   PCI-MSI 524289-edge      eth0-TxRx-0\n"
+    " 42:          0       5678          0          0   PCI-MSI 524290-edge      eth0-TxRx-1\n"
+    " 43:          0          0          0         12   PCI-MSI 524291-edge      eth0-tx-2\n"
+    " 44:          0          0          0         12   PCI-MSI 524292-edge      eth01-rx-0\n"
+    "NMI:          0          0          0          0   Non-maskable interrupts\n"
+    "LOC:       1000       1000       1000       1000   Local timer interrupts\n";
+
+/* Create a fixture file and its parent directories */
+void fixture_write(const char *const path, const char *const content)
+{
+	char buf[PATH_MAX];
+	char *p;
+	FILE *f;
+
+	snprintf(buf, sizeof(buf), "%s/%s", root, path);
+
+	for (p = strchr(buf + strlen(root) + 1, '/'); p; p = strchr(p + 1, '/')) {
+		*p = '\0';
+		assert(mkdir(buf, 0755) == 0 || errno == EEXIST);
+		*p = '/';
+	}
+
+	f = fopen(buf, "w");
+	assert(f);
+	fputs(content, f);
+	fclose(f);
+}
+
+void test_cpu_mask_parse(void)
+{
+	cpu_set_t set;
+
+	assert(ldab_cpu_mask_parse("0", &set) == 0);
+	assert(CPU_COUNT(&set) == 0);
+
+	assert(ldab_cpu_mask_parse("00000001,0000000f", &set) == 0);
+	assert(CPU_COUNT(&set) == 5);
+	assert(CPU_ISSET(0, &set) && CPU_ISSET(3, &set) && CPU_ISSET(32, &set));
+
+	assert(ldab_cpu_mask_parse("A0", &set) == 0);
+	assert(CPU_COUNT(&set) == 2);
+	assert(CPU_ISSET(5, &set) && CPU_ISSET(7, &set));
+
+	assert(ldab_cpu_mask_parse("0x1", &set) == EINVAL);
+}
+
+void test_dev_rx_cpus(const char *const proc, const char *const sys)
+{
+	cpu_set_t cpus, siblings;
+
+	/* eth0 and its receive queues, eth0-tx-2 and eth01-rx-0 do not match */
+	assert(ldab_dev_rx_cpus_get(proc, sys, "eth0", &cpus) == 0);
+	assert(CPU_COUNT(&cpus) == 3);
+	assert(CPU_ISSET(0, &cpus) && CPU_ISSET(1, &cpus) && CPU_ISSET(2, &cpus));
+
+	assert(ldab_cpu_siblings_get(sys, &cpus, &siblings) == 0);
+	assert(CPU_COUNT(&siblings) == 5);
+	assert(CPU_ISSET(4, &siblings) && CPU_ISSET(5, &siblings));
+	assert(!CPU_ISSET(6, &siblings));
+
+	/* Without interrupt, receive packet steering is used */
+	assert(ldab_dev_rx_cpus_get(proc, sys, "eth1", &cpus) == 0);
+	assert(CPU_COUNT(&cpus) == 2);
+	assert(CPU_ISSET(2, &cpus) && CPU_ISSET(3, &cpus));
+
+	assert(ldab_dev_rx_cpus_get(proc, sys, "eth2", &cpus) == ENOENT);
+
+	CPU_ZERO(&cpus);
+	assert(ldab_cpu_siblings_get(sys, &cpus, &siblings) == EINVAL);
+}
+
+int main(void)
+{
+	char proc[PATH_MAX], sys[PATH_MAX];
+
+	assert(mkdtemp(root));
+
+	snprintf(proc, sizeof(proc), "%s/proc", root);
+	snprintf(sys, sizeof(sys), "%s/sys", root);
+
+	fixture_write("proc/interrupts", interrupts);
+	fixture_write("proc/irq/40/smp_affinity_list", "2\n");
+	fixture_write("proc/irq/41/smp_affinity_list", "0\n");
+	fixture_write("proc/irq/42/smp_affinity_list", "1\n");
+	fixture_write("proc/irq/43/smp_affinity_list", "3\n");
+	fixture_write("proc/irq/44/smp_affinity_list", "3\n");
+	fixture_write("sys/devices/system/cpu/cpu0/topology/thread_siblings_list",
+		      "0,4\n");
+	fixture_write("sys/devices/system/cpu/cpu1/topology/thread_siblings_list",
+		      "1,5\n");
+	fixture_write("sys/class/net/eth1/queues/rx-0/rps_cpus", "00000004\n");
+	fixture_write("sys/class/net/eth1/queues/rx-1/rps_cpus", "00000008\n");
+	fixture_write("sys/class/net/eth1/queues/tx-0/xps_cpus", "00000001\n");
+
+	test_cpu_mask_parse();
+	test_dev_rx_cpus(proc, sys);
+
+	assert(system("rm -rf irq-fixture-*") == 0);
+
+	return EXIT_SUCCESS;
+}
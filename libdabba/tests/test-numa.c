@@ -0,0 +1,120 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif				/* _GNU_SOURCE */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <assert.h>
+#include <limits.h>
+#include <sys/stat.h>
+
+#include <libdabba/interface.h>
+#include <libdabba/numa.h>
+
+static char root[] = "numa-sysfs-XXXXXX";
+
+/* Create a sysfs attribute and its parent directories in the fixture tree */
+void fixture_write(const char *const path, const char *const content)
+{
+	char buf[PATH_MAX];
+	char *p;
+	FILE *f;
+
+	snprintf(buf, sizeof(buf), "%s/%s", root, path);
+
+	for (p = strchr(buf + strlen(root) + 1, '/'); p; p = strchr(p + 1, '/')) {
+		*p = '\0';
+		assert(mkdir(buf, 0755) == 0 || errno == EEXIST);
+		*p = '/';
+	}
+
+	f = fopen(buf, "w");
+	assert(f);
+	fprintf(f, "%s\n", content);
+	fclose(f);
+}
+
+void test_cpu_list_parse(void)
+{
+	cpu_set_t set;
+
+	assert(ldab_cpu_list_parse("", &set) == 0);
+	assert(CPU_COUNT(&set) == 0);
+
+	assert(ldab_cpu_list_parse("0-3,8,10-11", &set) == 0);
+	assert(CPU_COUNT(&set) == 7);
+	assert(CPU_ISSET(3, &set) && CPU_ISSET(8, &set) && CPU_ISSET(11, &set));
+	assert(!CPU_ISSET(4, &set) && !CPU_ISSET(9, &set));
+
+	assert(ldab_cpu_list_parse("3-1", &set) == EINVAL);
+	assert(ldab_cpu_list_parse("1,,2", &set) == EINVAL);
+	assert(ldab_cpu_list_parse("a", &set) == EINVAL);
+}
+
+void test_numa_dual_node(void)
+{
+	cpu_set_t cpus;
+	int count, node;
+
+	fixture_write("devices/system/node/online", "0-1");
+	fixture_write("devices/system/node/node0/cpulist", "0-3,8-11");
+	fixture_write("devices/system/node/node1/cpulist", "4-7,12-15");
+	fixture_write("class/net/eth0/device/numa_node", "1");
+	fixture_write("class/net/eth1/device/numa_node", "-1");
+	fixture_write("class/net/lo/mtu", "65536");
+
+	assert(ldab_numa_node_count_get(root, &count) == 0);
+	assert(count == 2);
+
+	assert(ldab_numa_dev_node_get(root, "eth0", &node) == 0);
+	assert(node == 1);
+
+	assert(ldab_numa_node_cpus_get(root, node, &cpus) == 0);
+	assert(CPU_COUNT(&cpus) == 8);
+	assert(CPU_ISSET(4, &cpus) && CPU_ISSET(15, &cpus));
+	assert(!CPU_ISSET(0, &cpus));
+
+	/* Unknown NUMA nodes */
+	assert(ldab_numa_dev_node_get(root, "eth1", &node) == 0);
+	assert(node == NUMA_NODE_NONE);
+	assert(ldab_numa_dev_node_get(root, "lo", &node) == 0);
+	assert(node == NUMA_NODE_NONE);
+	assert(ldab_numa_dev_node_get(root, ANY_INTERFACE, &node) == 0);
+	assert(node == NUMA_NODE_NONE);
+
+	assert(ldab_numa_node_cpus_get(root, 2, &cpus) == ENOENT);
+	assert(ldab_numa_node_cpus_get(root, NUMA_NODE_NONE, &cpus) == EINVAL);
+}
+
+void test_numa_no_node(void)
+{
+	int count;
+
+	/* A kernel without NUMA support has no node directory */
+	assert(ldab_numa_node_count_get("/nonexistent", &count) == 0);
+	assert(count == 1);
+}
+
+int main(void)
+{
+	int rc;
+
+	assert(mkdtemp(root));
+
+	test_cpu_list_parse();
+	test_numa_dual_node();
+	test_numa_no_node();
+
+	/* Memory policies might not be supported by the running kernel */
+	rc = ldab_numa_mempolicy_set(0);
+	assert(rc == 0 || rc == ENOSYS);
+	rc = ldab_numa_mempolicy_set(NUMA_NODE_NONE);
+	assert(rc == 0 || rc == ENOSYS);
+
+	assert(system("rm -rf numa-sysfs-*") == 0);
+
+	return EXIT_SUCCESS;
+}
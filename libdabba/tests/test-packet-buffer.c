@@ -0,0 +1,113 @@
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+
+#include <libdabba/pcap.h>
+#include <libdabba/packet-buffer.h>
+
+#define PKT_NR 20
+
+static const uint8_t icmp_dns[] = {
+	0x00, 0x1e, 0x65, 0x93, 0x1b, 0x6c, 0x00, 0x1d,
+	0x19, 0x84, 0x9c, 0xdc, 0x08, 0x00, 0x45, 0x00,
+	0x00, 0x54, 0xdb, 0x46, 0x00, 0x00, 0x38, 0x01,
+	0x4d, 0x41, 0x08, 0x08, 0x08, 0x08, 0xc0, 0xa8,
+	0x89, 0x69, 0x00, 0x00, 0xce, 0x1a, 0x12, 0x2d,
+	0x00, 0x02, 0xb7, 0xeb, 0xba, 0x4c, 0x00, 0x00,
+	0x00, 0x00, 0xee, 0xaa, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15,
+	0x16, 0x17, 0x18, 0x19, 0x1a, 0x1b, 0x1c, 0x1d,
+	0x1e, 0x1f, 0x20, 0x21, 0x22, 0x23, 0x24, 0x25,
+	0x26, 0x27, 0x28, 0x29, 0x2a, 0x2b, 0x2c, 0x2d,
+	0x2e, 0x2f, 0x30, 0x31, 0x32, 0x33, 0x34, 0x35,
+	0x36, 0x37
+};
+
+static const char test_path[] = "res-buffer.pcap";
+
+/* Write the buffer and check that the packets from first_sec are present */
+void test_packet_buffer_dump(struct packet_buffer *pkt_buf,
+			     const uint32_t first_sec,
+			     int (*write_out) (struct packet_buffer *,
+					       const int))
+{
+	struct pcap_sf_pkthdr sf_hdr;
+	uint8_t pkt[sizeof(icmp_dns)];
+	uint32_t sec = first_sec;
+	int fd;
+
+	assert((fd = ldab_pcap_create(test_path, LINKTYPE_EN10MB)) > 0);
+	assert(write_out(pkt_buf, fd) == 0);
+	assert(ldab_pcap_close(fd) == 0);
+
+	assert((fd = ldab_pcap_open(test_path, O_RDONLY)) > 0);
+
+	while (read(fd, &sf_hdr, sizeof(sf_hdr)) == sizeof(sf_hdr)) {
+		assert(sf_hdr.ts.tv_sec == (int32_t) sec);
+		assert(sf_hdr.caplen == sizeof(icmp_dns));
+		assert(read(fd, pkt, sizeof(pkt)) == sizeof(pkt));
+		assert(memcmp(pkt, icmp_dns, sizeof(pkt)) == 0);
+		sec++;
+	}
+
+	assert(sec == PKT_NR);
+
+	ldab_pcap_destroy(fd, test_path);
+}
+
+int main(void)
+{
+	struct packet_buffer pkt_buf;
+	const size_t rec_len = sizeof(struct pcap_sf_pkthdr) + sizeof(icmp_dns);
+	const size_t rec_nr = 8;
+	uint32_t a;
+
+	/* Too small to hold anything */
+	assert(ldab_packet_buffer_create(&pkt_buf, 1, 0) == EINVAL);
+
+	/* Size limited buffer keeps the most recent packets */
+	assert(ldab_packet_buffer_create(&pkt_buf, rec_nr * rec_len + 1, 0) ==
+	       0);
+
+	for (a = 0; a < PKT_NR; a++)
+		assert(ldab_packet_buffer_push
+		       (&pkt_buf, icmp_dns, sizeof(icmp_dns), sizeof(icmp_dns),
+			a, 0) == 0);
+
+	assert(pkt_buf.head - pkt_buf.tail == rec_nr * rec_len);
+	test_packet_buffer_dump(&pkt_buf, PKT_NR - rec_nr,
+				ldab_packet_buffer_dump);
+
+	/* Flushing writes the wrapped records in order and empties the buffer */
+	assert(pkt_buf.tail % pkt_buf.size + rec_nr * rec_len > pkt_buf.size);
+	test_packet_buffer_dump(&pkt_buf, PKT_NR - rec_nr,
+				ldab_packet_buffer_flush);
+	assert(pkt_buf.tail == pkt_buf.head);
+
+	/* Packets larger than the buffer are dropped */
+	assert(ldab_packet_buffer_push
+	       (&pkt_buf, icmp_dns, sizeof(icmp_dns), pkt_buf.size, 0,
+		0) == ENOBUFS);
+	assert(pkt_buf.dropped == 1);
+
+	ldab_packet_buffer_destroy(&pkt_buf);
+
+	/* Duration limited buffer keeps the last seconds of traffic */
+	assert(ldab_packet_buffer_create(&pkt_buf, 1 << 20, 5) == 0);
+
+	for (a = 0; a < PKT_NR; a++)
+		assert(ldab_packet_buffer_push
+		       (&pkt_buf, icmp_dns, sizeof(icmp_dns), sizeof(icmp_dns),
+			a, 0) == 0);
+
+	test_packet_buffer_dump(&pkt_buf, PKT_NR - 1 - 5,
+				ldab_packet_buffer_dump);
+
+	ldab_packet_buffer_destroy(&pkt_buf);
+
+	return (EXIT_SUCCESS);
+}
@@ -5,8 +5,11 @@
 #include <unistd.h>
 #include <errno.h>
 #include <assert.h>
+#include <limits.h>
+#include <stdint.h>
 #include <sys/socket.h>
 #include <sys/user.h>
+#include <sys/param.h>
 #include <arpa/inet.h>
 
 #include <linux/if_ether.h>
@@ -17,6 +20,40 @@
 
 #define MIN_FRAME_NR (1<<3)
 #define MAX_FRAME_NR (1<<16)
+#define BUDGET (1<<24)
+
+/* Check the block geometry computed for a frame size */
+void test_packet_mmap_layout(const size_t frame_size)
+{
+	struct tpacket_req layout;
+	const size_t page_size = sysconf(_SC_PAGESIZE);
+	size_t fnr;
+
+	for (fnr = 1; fnr < MAX_FRAME_NR; fnr = fnr * 3 + 1) {
+		assert(ldab_packet_mmap_layout_get(&layout, frame_size, fnr) ==
+		       0);
+		assert(layout.tp_frame_size == frame_size);
+		assert(layout.tp_frame_nr >= fnr);
+		assert(layout.tp_block_size % page_size == 0);
+		assert(powerof2(layout.tp_block_size / page_size));
+		assert(layout.tp_block_size >= frame_size);
+		assert(layout.tp_frame_nr ==
+		       layout.tp_block_nr * (layout.tp_block_size / frame_size));
+		/* Rounding up never adds a whole block */
+		assert(layout.tp_frame_nr - fnr <
+		       layout.tp_block_size / frame_size);
+	}
+
+	assert(ldab_packet_mmap_budget_layout_get(&layout, frame_size, BUDGET)
+	       == 0);
+	assert(layout.tp_block_size * layout.tp_block_nr <= BUDGET);
+	assert(layout.tp_block_size * (layout.tp_block_nr + 1) > BUDGET);
+
+	/* Small frames do not need high order blocks */
+	if (frame_size <= page_size)
+		assert(layout.tp_block_size <=
+		       page_size << PACKET_MMAP_PREFERRED_ORDER);
+}
 
 int main(int argc, char **argv)
 {
@@ -30,9 +67,29 @@ int main(int argc, char **argv)
 		PACKET_MMAP_SUPER_JUMBO_FRAME_LEN
 	};
 
+	struct tpacket_req layout;
+	const size_t layout_fsize[] = { 1600, 2048, 9216, 65536 };
+
 	assert(argc);
 	assert(argv);
 
+	for (i = 0; i < ARRAY_SIZE(layout_fsize); i++)
+		test_packet_mmap_layout(layout_fsize[i]);
+
+	/* Invalid frame sizes and too small budgets */
+	assert(ldab_packet_mmap_layout_get(&layout, 1500, 8) == EINVAL);
+	assert(ldab_packet_mmap_layout_get(&layout, 16, 8) == EINVAL);
+	assert(ldab_packet_mmap_layout_get(&layout, 2048, 0) == EINVAL);
+	assert(ldab_packet_mmap_budget_layout_get(&layout, 2048, 1024) ==
+	       EINVAL);
+
+	/* Frame counts must fit in a struct tpacket_req */
+	assert(ldab_packet_mmap_layout_get(&layout, 2048, UINT_MAX) == EINVAL);
+	assert(ldab_packet_mmap_layout_get(&layout, 2048, SIZE_MAX) == EINVAL);
+	assert(ldab_packet_mmap_budget_layout_get(&layout, 2048, SIZE_MAX) ==
+	       0);
+	assert(packet_mmap_layout_size(&layout) <= UINT_MAX);
+
 	assert(pf_sock > 0);
 
 	for (a = 0; a < ARRAY_SIZE(types); a++)
@@ -59,5 +116,45 @@ int main(int argc, char **argv)
 				ldab_packet_mmap_destroy(&pkt_rx);
 			}
 
+	for (a = 0; a < ARRAY_SIZE(types); a++) {
+		rc = ldab_packet_mmap_budget_create(&pkt_rx, ANY_INTERFACE,
+						   pf_sock, types[a], 1600,
+						   BUDGET);
+		assert(rc == 0 || rc == ENOMEM);
+		ldab_packet_mmap_destroy(&pkt_rx);
+	}
+
+	assert(ldab_packet_mmap_budget_layout_get(&layout, 1600, BUDGET) == 0);
+	assert(packet_mmap_layout_size(&layout) <= BUDGET);
+	rc = ldab_packet_mmap_layout_create(&pkt_rx, ANY_INTERFACE, pf_sock,
+					    PACKET_MMAP_RX, &layout);
+	assert(rc == 0 || rc == ENOMEM);
+
+	if (!rc)
+		assert(!memcmp(&pkt_rx.layout, &layout, sizeof(layout)));
+
+	ldab_packet_mmap_destroy(&pkt_rx);
+
+	/* Rings prepared on a protocol-less socket are bound later on */
+	close(pf_sock);
+	pf_sock = socket(PF_PACKET, SOCK_RAW, 0);
+	assert(pf_sock > 0);
+	assert(ldab_packet_mmap_layout_get(&layout, 2048, MIN_FRAME_NR) == 0);
+
+	rc = ldab_packet_mmap_prepare(&pkt_rx, pf_sock, PACKET_MMAP_RX,
+				      &layout);
+	assert(rc == 0 || rc == ENOMEM);
+
+	if (!rc) {
+		assert(pkt_rx.buf && pkt_rx.vec);
+		assert(pkt_rx.ifindex == 0);
+		assert(ldab_packet_mmap_attach(&pkt_rx, "nonexistent0") != 0);
+		assert(pkt_rx.buf);
+		assert(ldab_packet_mmap_attach(&pkt_rx, ANY_INTERFACE) == 0);
+		ldab_packet_mmap_destroy(&pkt_rx);
+	}
+
+	close(pf_sock);
+
 	return (success ? EXIT_SUCCESS : EXIT_FAILURE);
 }
@@ -0,0 +1,239 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/ip.h>
+#include <netinet/udp.h>
+#include <arpa/inet.h>
+
+#include <linux/if_ether.h>
+
+#include <libdabba/macros.h>
+#include <libdabba/packet-rx.h>
+#include <libdabba/pcap.h>
+
+#define TEST_PORT 47911
+#define TEST_PKT_NR 2000
+#define TEST_FRAME_NR 64
+
+static const char test_path[] = "rx-resize.pcap";
+
+/* Check the ring switch state transitions without a running capture */
+void test_packet_rx_resize_state(void)
+{
+	struct packet_rx pkt_rx;
+	struct packet_mmap next, prev;
+
+	memset(&pkt_rx, 0, sizeof(pkt_rx));
+	memset(&next, 0, sizeof(next));
+
+	assert(ldab_packet_rx_resize_finish(&pkt_rx, &prev) == EINVAL);
+	assert(ldab_packet_rx_resize_start(&pkt_rx, &next) == 0);
+	assert(ldab_packet_rx_resize_start(&pkt_rx, &next) == EBUSY);
+	assert(ldab_packet_rx_resize_finish(&pkt_rx, &prev) == EAGAIN);
+
+	pkt_rx.resize.state = PACKET_RX_RESIZE_DONE;
+	pkt_rx.resize.rc = ENODEV;
+
+	assert(ldab_packet_rx_resize_finish(&pkt_rx, &prev) == ENODEV);
+	assert(pkt_rx.resize.state == PACKET_RX_RESIZE_IDLE);
+}
+
+/* Check a stop request raises its flag and wakes up its eventfd */
+void test_packet_stop(void)
+{
+	struct packet_stop stop;
+	struct pollfd pfd;
+
+	assert(ldab_packet_stop_init(&stop) == 0);
+	assert(!packet_stop_is_requested(&stop));
+
+	memset(&pfd, 0, sizeof(pfd));
+	pfd.fd = stop.fd;
+	pfd.events = POLLIN;
+
+	assert(poll(&pfd, 1, 0) == 0);
+	assert(ldab_packet_stop_request(&stop) == 0);
+	assert(packet_stop_is_requested(&stop));
+	assert(poll(&pfd, 1, 0) == 1);
+
+	ldab_packet_stop_destroy(&stop);
+	assert(stop.fd == -1);
+}
+
+/* Create a packet mmap ring on the loopback interface */
+int test_ring_create(struct packet_mmap *pkt_mmap, const size_t frame_nr)
+{
+	int rc, sock = socket(PF_PACKET, SOCK_RAW, htons(ETH_P_ALL));
+
+	assert(sock > 0);
+
+	rc = ldab_packet_mmap_create(pkt_mmap, "lo", sock, PACKET_MMAP_RX,
+				     PACKET_MMAP_ETH_FRAME_LEN, frame_nr);
+	assert(rc == 0);
+
+	return sock;
+}
+
+/* Prepare a packet mmap ring which does not receive packets yet */
+int test_ring_prepare(struct packet_mmap *pkt_mmap, const size_t frame_nr)
+{
+	struct tpacket_req layout;
+	int rc, sock = socket(PF_PACKET, SOCK_RAW, 0);
+
+	assert(sock > 0);
+
+	rc = ldab_packet_mmap_layout_get(&layout, PACKET_MMAP_ETH_FRAME_LEN,
+					 frame_nr);
+	assert(rc == 0);
+
+	memset(pkt_mmap, 0, sizeof(*pkt_mmap));
+	rc = ldab_packet_mmap_prepare(pkt_mmap, sock, PACKET_MMAP_RX, &layout);
+	assert(rc == 0);
+
+	return sock;
+}
+
+/* Send a UDP datagram carrying a sequence number over the loopback */
+void test_send(const int sock, const uint32_t seq)
+{
+	struct sockaddr_in sin;
+
+	memset(&sin, 0, sizeof(sin));
+	sin.sin_family = AF_INET;
+	sin.sin_port = htons(TEST_PORT);
+	sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	assert(sendto(sock, &seq, sizeof(seq), 0, (struct sockaddr *)&sin,
+		      sizeof(sin)) == sizeof(seq));
+
+	/* Leave some time to the capture thread to keep up */
+	usleep(50);
+}
+
+/* Count the copies of each test datagram found in the pcap file */
+void test_pcap_check(uint8_t * seen)
+{
+	uint8_t pkt[PACKET_MMAP_ETH_FRAME_LEN];
+	const size_t off = ETH_HLEN + sizeof(struct iphdr);
+	struct udphdr udp;
+	uint32_t seq;
+	ssize_t len;
+	int fd = ldab_pcap_open(test_path, O_RDONLY);
+
+	assert(fd > 0);
+
+	while ((len = ldab_pcap_read(fd, pkt, sizeof(pkt))) > 0) {
+		if ((size_t)len < off + sizeof(udp) + sizeof(seq))
+			continue;
+
+		memcpy(&udp, &pkt[off], sizeof(udp));
+
+		if (udp.dest != htons(TEST_PORT))
+			continue;
+
+		memcpy(&seq, &pkt[off + sizeof(udp)], sizeof(seq));
+
+		if (seq < TEST_PKT_NR)
+			seen[seq]++;
+	}
+
+	ldab_pcap_close(fd);
+}
+
+int main(void)
+{
+	struct packet_rx pkt_rx;
+	struct packet_mmap next, prev;
+	struct packet_rx_counters counters, last;
+	uint8_t seen[TEST_PKT_NR] = { 0 };
+	pthread_t thread;
+	int old_sock, new_sock, udp_sock, rc;
+	uint32_t seq;
+
+	test_packet_rx_resize_state();
+	test_packet_stop();
+
+	memset(&pkt_rx, 0, sizeof(pkt_rx));
+	memset(&last, 0, sizeof(last));
+	assert(ldab_packet_stop_init(&pkt_rx.stop) == 0);
+
+	pkt_rx.pcap_fd = ldab_pcap_create(test_path, LINKTYPE_EN10MB);
+	assert(pkt_rx.pcap_fd > 0);
+
+	udp_sock = socket(AF_INET, SOCK_DGRAM, 0);
+	assert(udp_sock > 0);
+
+	old_sock = test_ring_create(&pkt_rx.pkt_mmap, TEST_FRAME_NR);
+
+	assert(pthread_create(&thread, NULL, ldab_packet_rx, &pkt_rx) == 0);
+
+	for (seq = 0; seq < TEST_PKT_NR / 2; seq++)
+		test_send(udp_sock, seq);
+
+	/* The capture thread binds the new ring when it switches over */
+	new_sock = test_ring_prepare(&next, TEST_FRAME_NR * 4);
+	assert(ldab_packet_rx_resize_start(&pkt_rx, &next) == 0);
+
+	for (; seq < TEST_PKT_NR; seq++) {
+		test_send(udp_sock, seq);
+
+		/* Without sampling, a consistent snapshot keeps all frames */
+		ldab_packet_rx_counters_get(&pkt_rx, &counters);
+		assert(counters.kept == counters.packets);
+		assert(counters.packets >= last.packets);
+		assert(counters.bytes >= last.bytes);
+		last = counters;
+	}
+
+	while ((rc = ldab_packet_rx_resize_finish(&pkt_rx, &prev)) == EAGAIN)
+		usleep(1000);
+
+	/* The capture thread unmapped its previous ring by itself */
+	assert(rc == 0);
+	assert(!prev.buf);
+	assert(prev.pf_sock == old_sock);
+	assert(prev.layout.tp_frame_nr == TEST_FRAME_NR);
+	assert(pkt_rx.pkt_mmap.pf_sock == new_sock);
+	assert(pkt_rx.pkt_mmap.layout.tp_frame_nr >= TEST_FRAME_NR * 4);
+
+	close(old_sock);
+
+	/* The capture thread writes the frames left in its ring before leaving */
+	assert(ldab_packet_stop_request(&pkt_rx.stop) == 0);
+	assert(pthread_join(thread, NULL) == 0);
+	assert(pkt_rx.stats.tp_packets >= TEST_PKT_NR);
+
+	ldab_packet_rx_counters_get(&pkt_rx, &counters);
+	assert(counters.packets >= TEST_PKT_NR);
+	assert(counters.kept == counters.packets);
+
+	/* One frame out of eight has its ring residency measured */
+	assert(ldab_histogram_count(&pkt_rx.residency) >= TEST_PKT_NR / 8);
+	assert(ldab_histogram_percentile(&pkt_rx.residency, 50) <=
+	       ldab_histogram_percentile(&pkt_rx.residency, 100));
+
+	ldab_packet_stop_destroy(&pkt_rx.stop);
+
+	ldab_pcap_close(pkt_rx.pcap_fd);
+	ldab_packet_mmap_destroy(&pkt_rx.pkt_mmap);
+	close(new_sock);
+	close(udp_sock);
+
+	test_pcap_check(seen);
+
+	/* Loopback frames are captured once sent and once received */
+	for (seq = 0; seq < TEST_PKT_NR; seq++)
+		assert(seen[seq] == 2);
+
+	unlink(test_path);
+
+	return EXIT_SUCCESS;
+}
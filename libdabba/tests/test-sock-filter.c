@@ -0,0 +1,266 @@
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include <libdabba/macros.h>
+#include <libdabba/sock-filter.h>
+
+static const uint8_t icmp_localhost[] = {
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x45, 0x00,
+	0x00, 0x54, 0xdb, 0x46, 0x40, 0x00, 0x40, 0x01,
+	0x61, 0x5f, 0x7f, 0x00, 0x00, 0x01, 0x7f, 0x00,
+	0x00, 0x01, 0x08, 0x00, 0xce, 0x1a, 0x12, 0x2d,
+	0x00, 0x02, 0xb7, 0xeb, 0xba, 0x4c, 0x00, 0x00
+};
+
+/* ip and icmp and host 127.0.0.1 */
+static struct sock_filter localhost_icmp[] = {
+	{0x28, 0, 0, 0x0000000c},
+	{0x15, 0, 7, 0x00000800},
+	{0x30, 0, 0, 0x00000017},
+	{0x15, 0, 5, 0x00000001},
+	{0x20, 0, 0, 0x0000001a},
+	{0x15, 2, 0, 0x7f000001},
+	{0x20, 0, 0, 0x0000001e},
+	{0x15, 0, 1, 0x7f000001},
+	{0x6, 0, 0, 0x0000ffff},
+	{0x6, 0, 0, 0x00000000},
+};
+
+/* icmp[icmptype] == icmp-echo, using indirect loads and scratch memory */
+static struct sock_filter icmp_echo[] = {
+	{BPF_LDX | BPF_MSH | BPF_B, 0, 0, 14},
+	{BPF_MISC | BPF_TXA, 0, 0, 0},
+	{BPF_ST, 0, 0, 3},
+	{BPF_LDX | BPF_MEM, 0, 0, 3},
+	{BPF_LD | BPF_B | BPF_IND, 0, 0, 14},
+	{BPF_JMP | BPF_JEQ | BPF_K, 0, 1, 8},
+	{BPF_RET | BPF_A, 0, 0, 0},
+	{BPF_RET | BPF_K, 0, 0, 0},
+};
+
+/* Accept the packet length divided by two */
+static struct sock_filter half_len[] = {
+	{BPF_LD | BPF_W | BPF_LEN, 0, 0, 0},
+	{BPF_LDX | BPF_IMM, 0, 0, 2},
+	{BPF_ALU | BPF_DIV | BPF_X, 0, 0, 0},
+	{BPF_RET | BPF_A, 0, 0, 0},
+};
+
+/* A ^ X loaded twice from the kernel ancillary data: 0 ^ 5 ^ 5 == 0 */
+static struct sock_filter ancillary[] = {
+	{BPF_LDX | BPF_IMM, 0, 0, 5},
+	{BPF_LD | BPF_W | BPF_ABS, 0, 0, SKF_AD_OFF + SKF_AD_ALU_XOR_X},
+	{BPF_LD | BPF_W | BPF_ABS, 0, 0, SKF_AD_OFF + SKF_AD_ALU_XOR_X},
+	{BPF_RET | BPF_A, 0, 0, 0},
+};
+
+/* Redundant loads, chained jumps and unreachable code */
+static struct sock_filter redundant[] = {
+	{BPF_LD | BPF_H | BPF_ABS, 0, 0, 12},
+	{BPF_LD | BPF_H | BPF_ABS, 0, 0, 12},
+	{BPF_JMP | BPF_JEQ | BPF_K, 0, 3, 0x0800},
+	{BPF_LD | BPF_H | BPF_ABS, 0, 0, 12},
+	{BPF_JMP | BPF_JA, 0, 0, 2},
+	{BPF_RET | BPF_K, 0, 0, 0x1234},
+	{BPF_JMP | BPF_JA, 0, 0, 1},
+	{BPF_JMP | BPF_JA, 0, 0, 0},
+	{BPF_LD | BPF_B | BPF_ABS, 0, 0, 23},
+	{BPF_JMP | BPF_JEQ | BPF_K, 1, 1, 0x01},
+	{BPF_RET | BPF_K, 0, 0, 0x5678},
+	{BPF_RET | BPF_A, 0, 0, 0},
+};
+
+/* Jumps wrapping back to the first instruction or past the end */
+static struct sock_filter out_of_bounds[] = {
+	{BPF_LD | BPF_IMM, 0, 0, 1},
+	{BPF_JMP | BPF_JA, 0, 0, 0xfffffffe},
+	{BPF_JMP | BPF_JEQ | BPF_K, 0, 1, 1},
+	{BPF_RET | BPF_K, 0, 0, 0xffff},
+};
+
+#define OPTIMIZE_ROUND_NR 2000
+#define OPTIMIZE_PROG_LEN 24
+#define OPTIMIZE_PKT_NR 64
+#define OPTIMIZE_PKT_LEN 48
+
+/* Instructions a random program is made of, jumps are handled separately */
+static const uint16_t random_code[] = {
+	BPF_LD | BPF_W | BPF_ABS, BPF_LD | BPF_H | BPF_ABS,
+	BPF_LD | BPF_B | BPF_ABS, BPF_LD | BPF_B | BPF_IND,
+	BPF_LD | BPF_W | BPF_LEN, BPF_LDX | BPF_W | BPF_LEN,
+	BPF_LDX | BPF_MSH | BPF_B, BPF_LD | BPF_IMM, BPF_LDX | BPF_IMM,
+	BPF_LD | BPF_MEM, BPF_LDX | BPF_MEM, BPF_ST, BPF_STX,
+	BPF_ALU | BPF_ADD | BPF_X, BPF_ALU | BPF_AND | BPF_K,
+	BPF_ALU | BPF_RSH | BPF_K, BPF_MISC | BPF_TAX, BPF_MISC | BPF_TXA
+};
+
+/* Generate a valid forward-only program with lots of optimization chances */
+static void random_prog_generate(struct sock_filter *prog, const size_t len)
+{
+	size_t i, left;
+
+	for (i = 0; i < len - 1; i++) {
+		left = len - i - 1;
+
+		switch (rand() % 4) {
+		case 0:
+			prog[i].code = BPF_JMP | BPF_JA;
+			prog[i].k = rand() % left;
+			prog[i].jt = prog[i].jf = 0;
+			break;
+		case 1:
+			prog[i].code = BPF_JMP | BPF_JEQ | BPF_K;
+			prog[i].k = rand() % 4;
+			prog[i].jt = rand() % left;
+			prog[i].jf = rand() % left;
+			break;
+		case 2:
+			prog[i].code = BPF_RET | (rand() % 2 ? BPF_A : BPF_K);
+			prog[i].k = rand() % 0x10000;
+			prog[i].jt = prog[i].jf = 0;
+			break;
+		default:
+			prog[i].code = random_code[rand() % ARRAY_SIZE(random_code)];
+			prog[i].k = rand() % 4;
+
+			/* Keep some loads inside the packet */
+			if (BPF_MODE(prog[i].code) == BPF_ABS
+			    || BPF_MODE(prog[i].code) == BPF_IND
+			    || BPF_MODE(prog[i].code) == BPF_MSH)
+				prog[i].k = rand() % OPTIMIZE_PKT_LEN;
+
+			prog[i].jt = prog[i].jf = 0;
+			break;
+		}
+	}
+
+	prog[len - 1].code = BPF_RET | BPF_A;
+	prog[len - 1].jt = prog[len - 1].jf = 0;
+	prog[len - 1].k = 0;
+}
+
+/* Check that optimized programs return the same results as the original ones */
+static void test_sock_filter_optimize_equivalence(void)
+{
+	uint8_t pkt[OPTIMIZE_PKT_NR][OPTIMIZE_PKT_LEN];
+	struct sock_filter prog[OPTIMIZE_PROG_LEN], opt[OPTIMIZE_PROG_LEN];
+	struct sock_fprog sfp, opt_sfp;
+	size_t a, i, before = 0, after = 0;
+
+	for (a = 0; a < OPTIMIZE_PKT_NR; a++)
+		for (i = 0; i < OPTIMIZE_PKT_LEN; i++)
+			pkt[a][i] = rand() % 4;
+
+	for (a = 0; a < OPTIMIZE_ROUND_NR; a++) {
+		random_prog_generate(prog, OPTIMIZE_PROG_LEN);
+		memcpy(opt, prog, sizeof(opt));
+
+		sfp.filter = prog;
+		sfp.len = ARRAY_SIZE(prog);
+		opt_sfp.filter = opt;
+		opt_sfp.len = ARRAY_SIZE(opt);
+
+		assert(ldab_sock_filter_is_valid(&sfp));
+		assert(ldab_sock_filter_optimize(&opt_sfp) == 0);
+		assert(ldab_sock_filter_is_valid(&opt_sfp));
+		assert(opt_sfp.len <= sfp.len);
+
+		for (i = 0; i < OPTIMIZE_PKT_NR; i++)
+			assert(ldab_sock_filter_run(&sfp, pkt[i], 1500, i % 2 ?
+						    OPTIMIZE_PKT_LEN : i) ==
+			       ldab_sock_filter_run(&opt_sfp, pkt[i], 1500,
+						    i % 2 ? OPTIMIZE_PKT_LEN :
+						    i));
+
+		before += sfp.len;
+		after += opt_sfp.len;
+	}
+
+	assert(after < before);
+}
+
+int main(void)
+{
+	struct sock_fprog sfp;
+	struct sock_filter opt[ARRAY_SIZE(redundant)];
+	struct sock_filter anc[ARRAY_SIZE(ancillary)];
+	uint8_t pkt[sizeof(icmp_localhost)];
+
+	sfp.filter = localhost_icmp;
+	sfp.len = ARRAY_SIZE(localhost_icmp);
+	assert(ldab_sock_filter_is_valid(&sfp));
+
+	assert(ldab_sock_filter_run
+	       (&sfp, icmp_localhost, sizeof(icmp_localhost),
+		sizeof(icmp_localhost)) == 0xffff);
+
+	/* Truncated packets are rejected */
+	assert(ldab_sock_filter_run(&sfp, icmp_localhost, 100, 0x1c) == 0);
+
+	/* Not an IPv4 packet */
+	memcpy(pkt, icmp_localhost, sizeof(pkt));
+	pkt[12] = 0x86;
+	pkt[13] = 0xdd;
+	assert(ldab_sock_filter_run(&sfp, pkt, sizeof(pkt), sizeof(pkt)) == 0);
+
+	sfp.filter = icmp_echo;
+	sfp.len = ARRAY_SIZE(icmp_echo);
+	assert(ldab_sock_filter_is_valid(&sfp));
+
+	assert(ldab_sock_filter_run
+	       (&sfp, icmp_localhost, sizeof(icmp_localhost),
+		sizeof(icmp_localhost)) == 8);
+
+	memcpy(pkt, icmp_localhost, sizeof(pkt));
+	pkt[34] = 0;
+	assert(ldab_sock_filter_run(&sfp, pkt, sizeof(pkt), sizeof(pkt)) == 0);
+
+	sfp.filter = half_len;
+	sfp.len = ARRAY_SIZE(half_len);
+	assert(ldab_sock_filter_is_valid(&sfp));
+
+	assert(ldab_sock_filter_run(&sfp, icmp_localhost, 1500, 0) == 750);
+
+	/* Out of bounds jumps are refused, and reject packets when run anyway */
+	sfp.filter = out_of_bounds;
+	sfp.len = ARRAY_SIZE(out_of_bounds);
+	assert(!ldab_sock_filter_is_valid(&sfp));
+	assert(ldab_sock_filter_run(&sfp, pkt, sizeof(pkt), sizeof(pkt)) == 0);
+
+	sfp.filter = &out_of_bounds[2];
+	sfp.len = 2;
+	assert(!ldab_sock_filter_is_valid(&sfp));
+	assert(ldab_sock_filter_run(&sfp, pkt, sizeof(pkt), sizeof(pkt)) == 0);
+
+	/* Already optimal programs are left as they are */
+	memcpy(opt, localhost_icmp, sizeof(localhost_icmp));
+	sfp.filter = opt;
+	sfp.len = ARRAY_SIZE(localhost_icmp);
+	assert(ldab_sock_filter_optimize(&sfp) == 0);
+	assert(sfp.len == ARRAY_SIZE(localhost_icmp));
+	assert(memcmp(opt, localhost_icmp, sizeof(localhost_icmp)) == 0);
+
+	memcpy(opt, redundant, sizeof(redundant));
+	sfp.filter = opt;
+	sfp.len = ARRAY_SIZE(redundant);
+	assert(ldab_sock_filter_optimize(&sfp) == 0);
+	assert(sfp.len == 3);
+	assert(opt[0].code == (BPF_LD | BPF_H | BPF_ABS));
+	assert(opt[1].code == (BPF_LD | BPF_B | BPF_ABS));
+	assert(opt[2].code == (BPF_RET | BPF_A));
+
+	/* Ancillary loads depend on the registers or change at each load */
+	memcpy(anc, ancillary, sizeof(ancillary));
+	sfp.filter = anc;
+	sfp.len = ARRAY_SIZE(ancillary);
+	assert(ldab_sock_filter_optimize(&sfp) == 0);
+	assert(sfp.len == ARRAY_SIZE(ancillary));
+	assert(memcmp(anc, ancillary, sizeof(ancillary)) == 0);
+
+	test_sock_filter_optimize_equivalence();
+
+	return (EXIT_SUCCESS);
+}